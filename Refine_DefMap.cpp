@@ -356,10 +356,13 @@ void RefineDefMap::OnGenerate(wxCommandEvent& evt)
     ApplyNewMap();
 }
 
-// Get the timestamp from the file modification timestamp of the defectmap .txt file
+// Get the timestamp from the file modification timestamp of the defect map file
 wxString RefineDefMap::DefectMapTimeString()
 {
-    wxString dfFileName = DefectMap::DefectMapFileName(pConfig->GetCurrentProfileId());
+    int profileId = pConfig->GetCurrentProfileId();
+    wxString dfFileName = DefectMap::DefectMapFileName(profileId);
+    if (!wxFileExists(dfFileName))
+        dfFileName = DefectMap::LegacyDefectMapFileName(profileId);
     if (wxFileExists(dfFileName))
     {
         wxDateTime when = wxFileModificationTime(dfFileName);
@@ -0,0 +1,95 @@
+/*
+ *  calibration_fit.cpp
+ *  PHD Guiding
+ *
+ *  Created by the PHD2 developers
+ *  Copyright (c) 2014 PHD2 Developers
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of Craig Stark, Stark Labs nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "phd.h"
+
+// the pulse only grows once the star has clearly moved, pixels
+static const double MotionDistance = 2.0;
+
+void CalibrationFit::AddSample(double duration, const PHD_Point& pos)
+{
+    Sample sample;
+    sample.duration = duration;
+    sample.pos = pos;
+    m_samples.push_back(sample);
+}
+
+bool CalibrationFit::Velocity(PHD_Point *velocity) const
+{
+    size_t n = m_samples.size();
+    if (n < 2)
+        return false;
+
+    double tm = 0.0, xm = 0.0, ym = 0.0;
+    for (size_t i = 0; i < n; i++)
+    {
+        tm += m_samples[i].duration;
+        xm += m_samples[i].pos.X;
+        ym += m_samples[i].pos.Y;
+    }
+    tm /= n;
+    xm /= n;
+    ym /= n;
+
+    double stt = 0.0, stx = 0.0, sty = 0.0;
+    for (size_t i = 0; i < n; i++)
+    {
+        double dt = m_samples[i].duration - tm;
+        stt += dt * dt;
+        stx += dt * (m_samples[i].pos.X - xm);
+        sty += dt * (m_samples[i].pos.Y - ym);
+    }
+    if (stt <= 0.0)
+        return false;
+
+    velocity->SetXY(stx / stt, sty / stt);
+    return true;
+}
+
+// The next pulse aims to cover the remaining distance in the steps left,
+// at most doubling from one step to the next and never moving the star
+// more than maxStepPixels.
+int CalibrationFit::NextPulse(int pulse, int minPulse, double dist, double distCrit, int stepsLeft, double maxStepPixels) const
+{
+    PHD_Point velocity;
+
+    if (dist < MotionDistance || !Velocity(&velocity) || velocity.Distance() <= 0.0)
+        return pulse;
+
+    double target = wxMin((distCrit - dist) * 1.1 / wxMax(stepsLeft, 1), maxStepPixels);
+    int next = (int) ceil(target / velocity.Distance());
+    next = wxMin(next, 2 * pulse);
+
+    return wxMax(next, minPulse);
+}
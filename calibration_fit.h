@@ -0,0 +1,70 @@
+/*
+ *  calibration_fit.h
+ *  PHD Guiding
+ *
+ *  Created by the PHD2 developers
+ *  Copyright (c) 2014 PHD2 Developers
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of Craig Stark, Stark Labs nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef CALIBRATION_FIT_INCLUDED
+#define CALIBRATION_FIT_INCLUDED
+
+// Fast calibration state for one direction: the star positions after each
+// calibration step, against the total pulse duration so far.
+//
+// A least squares fit over all the steps gives the star velocity per ms of
+// guide pulse, which is both a better rate and angle than the end points
+// alone and the basis for lengthening the pulses once the star is moving.
+
+class CalibrationFit
+{
+    struct Sample
+    {
+        double duration;        // total pulse duration so far, ms
+        PHD_Point pos;          // star position after the pulses
+    };
+
+    std::vector<Sample> m_samples;
+
+public:
+    void Reset(void) { m_samples.clear(); }
+    void AddSample(double duration, const PHD_Point& pos);
+    unsigned int SampleCount(void) const { return m_samples.size(); }
+
+    // the fitted star velocity, pixels per ms of guide pulse
+    bool Velocity(PHD_Point *velocity) const;
+
+    // The pulse for the next step, given the current pulse and the
+    // configured one, the distance moved so far and the distance needed,
+    // the steps the too-few-steps check still requires, and the most the
+    // star may move in one step
+    int NextPulse(int pulse, int minPulse, double dist, double distCrit, int stepsLeft, double maxStepPixels) const;
+};
+
+#endif
@@ -277,7 +277,7 @@ inline static int round_up(int v, int m)
     return round_down(v + m - 1, m);
 }
 
-static void flush_buffered_image(int cameraId, usImage& img)
+static void flush_buffered_image(int cameraId, unsigned char *buf, int size)
 {
     enum { NUM_IMAGE_BUFFERS = 2 }; // camera has 2 internal frame buffers
 
@@ -285,7 +285,7 @@ static void flush_buffered_image(int cameraId, usImage& img)
 
     for (unsigned int num_cleared = 0; num_cleared < NUM_IMAGE_BUFFERS; num_cleared++)
     {
-        ASI_ERROR_CODE status = ASIGetVideoData(cameraId, (unsigned char *) img.ImageData, img.NPixels * sizeof(unsigned short), 0);
+        ASI_ERROR_CODE status = ASIGetVideoData(cameraId, buf, size, 0);
         if (status != ASI_SUCCESS)
             break; // no more buffered frames
 
@@ -295,12 +295,6 @@ static void flush_buffered_image(int cameraId, usImage& img)
 
 bool Camera_ZWO::Capture(int duration, usImage& img, int options, const wxRect& subframe)
 {
-    if (img.Init(FullSize))
-    {
-        DisconnectWithAlert(CAPT_FAIL_MEMORY);
-        return true;
-    }
-
     wxRect frame;
     wxPoint subframePos; // position of subframe within frame
 
@@ -309,6 +303,13 @@ bool Camera_ZWO::Capture(int duration, usImage& img, int options, const wxRect&
     if (subframe.width <= 0 || subframe.height <= 0)
         useSubframe = false;
 
+    // when reading a subframe, only the subframe pixels are stored
+    if (useSubframe ? img.InitWindow(FullSize, subframe) : img.Init(FullSize))
+    {
+        DisconnectWithAlert(CAPT_FAIL_MEMORY);
+        return true;
+    }
+
     if (useSubframe)
     {
         // ensure transfer size is a multiple of 1024
@@ -374,7 +375,9 @@ bool Camera_ZWO::Capture(int duration, usImage& img, int options, const wxRect&
     // which could be quite stale. read out all buffered frames so the frame we
     // get is current
 
-    flush_buffered_image(m_cameraId, img);
+    int frameSize = frame.GetWidth() * frame.GetHeight();
+
+    flush_buffered_image(m_cameraId, m_buffer, frameSize);
 
     if (!m_capturing)
     {
@@ -383,8 +386,6 @@ bool Camera_ZWO::Capture(int duration, usImage& img, int options, const wxRect&
         m_capturing = true;
     }
 
-    int frameSize = frame.GetWidth() * frame.GetHeight();
-
     int poll = wxMin(duration, 100);
 
     CameraWatchdog watchdog(duration, duration + GetTimeoutMs() + 10000); // total timeout is 2 * duration + 15s (typically)
@@ -416,15 +417,10 @@ bool Camera_ZWO::Capture(int duration, usImage& img, int options, const wxRect&
 
     if (useSubframe)
     {
-        img.Subframe = subframe;
-
-        // Clear out the image
-        img.Clear();
-
         for (int y = 0; y < subframe.height; y++)
         {
             const unsigned char *src = m_buffer + (y + subframePos.y) * frame.width + subframePos.x;
-            unsigned short *dst = img.ImageData + (y + subframe.y) * FullSize.GetWidth() + subframe.x;
+            unsigned short *dst = &img.Pixel(subframe.x, subframe.y + y);
             for (int x = 0; x < subframe.width; x++)
                 *dst++ = *src++;
         }
@@ -106,6 +106,24 @@ bool Camera_OpenCVClass::Disconnect()
 }
 
 
+// read a frame and return its luma, grayscale frames are used as-is
+const Mat& Camera_OpenCVClass::ReadGray(void)
+{
+    if (!pCapDev->read(m_frame) || m_frame.empty())
+    {
+        throw ERROR_INFO("pCapDev->read failed");
+    }
+
+    if (m_frame.channels() == 1)
+    {
+        return m_frame;
+    }
+
+    // m_gray keeps its buffer as long as the frame size does not change
+    cvtColor(m_frame, m_gray, m_frame.channels() == 4 ? CV_BGRA2GRAY : CV_BGR2GRAY);
+    return m_gray;
+}
+
 bool Camera_OpenCVClass::Capture(int duration, usImage& img, int options, const wxRect& subframe)
 {
     bool bError = false;
@@ -113,8 +131,6 @@ bool Camera_OpenCVClass::Capture(int duration, usImage& img, int options, const
     try
     {
         wxStopWatch swatch;
-        Mat captured_frame;
-        int i, nframes;
 
         if (!pCapDev)
         {
@@ -127,10 +143,9 @@ bool Camera_OpenCVClass::Capture(int duration, usImage& img, int options, const
         }
 
         // Grab at least one frame...
-        pCapDev->read(captured_frame);
-        cvtColor(captured_frame,captured_frame,CV_RGB2GRAY);
+        const Mat *gray = &ReadGray();
 
-        cv::Size sz = captured_frame.size();
+        cv::Size sz = gray->size();
 
         if (img.Init(sz.width,sz.height))
         {
@@ -138,25 +153,45 @@ bool Camera_OpenCVClass::Capture(int duration, usImage& img, int options, const
             throw ERROR_INFO("img.Init failed");
         }
 
-        for (i=0; i<img.NPixels; i++)
-        {
-            img.ImageData[i] = 0;
-        }
+        m_accum.assign(img.NPixels, 0);
 
-        nframes = 0;
-        unsigned char *dptr;
-        dptr = captured_frame.data;
-        while (swatch.Time() < duration)
+        // ...and integrate frames until the exposure time is used up
+        int nframes = 0;
+        while (true)
         {
+            if (gray->depth() != CV_8U || gray->size() != sz)
+            {
+                throw ERROR_INFO("unexpected frame format");
+            }
+
+            for (int y = 0; y < sz.height; y++)
+            {
+                const unsigned char *src = gray->ptr<unsigned char>(y);
+                unsigned int *dst = &m_accum[y * sz.width];
+                for (int x = 0; x < sz.width; x++)
+                {
+                    dst[x] += src[x];
+                }
+            }
             nframes++;
-            pCapDev->read(captured_frame);
-            cvtColor(captured_frame,captured_frame,CV_RGB2GRAY);
-            dptr = captured_frame.data;
-            for (i=0; i<img.NPixels; i++)
+
+            if (swatch.Time() >= duration || WorkerThread::StopRequested())
             {
-                img.ImageData[i] += (unsigned int) dptr[i];
+                break;
             }
+
+            gray = &ReadGray();
         }
+
+        for (int i = 0; i < img.NPixels; i++)
+        {
+            unsigned int val = m_accum[i];
+            img.ImageData[i] = (unsigned short) (val > 65535 ? 65535 : val);
+        }
+
+        Debug.AddLine(wxString::Format("OpenCV: integrated %d frames in %ld ms", nframes, swatch.Time()));
+
+        if (options & CAPTURE_SUBTRACT_DARK) SubtractDark(img);
     }
     catch (wxString Msg)
     {
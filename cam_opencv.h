@@ -46,6 +46,13 @@ class Camera_OpenCVClass : public GuideCamera
 protected:
     cv::VideoCapture *pCapDev;
 
+    // reused from frame to frame so a capture does not allocate
+    cv::Mat m_frame;
+    cv::Mat m_gray;
+    std::vector<unsigned int> m_accum;
+
+    const cv::Mat& ReadGray(void);
+
 public:
     Camera_OpenCVClass(int devNumber);
     ~Camera_OpenCVClass(void);
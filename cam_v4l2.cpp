@@ -0,0 +1,413 @@
+/*
+ *  cam_v4l2.cpp
+ *  PHD Guiding
+ *
+ *  Created by the PHD2 developers
+ *  Copyright (c) 2014 PHD2 Developers
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of Craig Stark, Stark Labs nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "phd.h"
+
+#ifdef V4L2_CAMERA
+
+#include "camera.h"
+#include "cam_v4l2.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/select.h>
+#include <unistd.h>
+#include <linux/videodev2.h>
+
+static const unsigned int NumBuffers = 4;
+
+static int xioctl(int fd, unsigned long request, void *arg)
+{
+    int r;
+    do
+    {
+        r = ioctl(fd, request, arg);
+    } while (r == -1 && errno == EINTR);
+    return r;
+}
+
+// offset of the first luma byte and distance between luma bytes
+static void LumaLayout(unsigned int pixelFormat, int *first, int *step)
+{
+    switch (pixelFormat)
+    {
+    case V4L2_PIX_FMT_YUYV:
+        *first = 0;
+        *step = 2;
+        break;
+    case V4L2_PIX_FMT_UYVY:
+        *first = 1;
+        *step = 2;
+        break;
+    default: // V4L2_PIX_FMT_GREY
+        *first = 0;
+        *step = 1;
+        break;
+    }
+}
+
+Camera_V4L2Class::Camera_V4L2Class(int devNumber)
+{
+    Connected = false;
+    Name = _T("V4L2 webcam");
+    FullSize = wxSize(640, 480);
+    m_hasGuideOutput = false;
+    m_devNum = devNumber;
+    m_fd = -1;
+    m_pixelFormat = 0;
+    m_bytesPerLine = 0;
+}
+
+Camera_V4L2Class::~Camera_V4L2Class(void)
+{
+    Disconnect();
+}
+
+// use the current format if it carries a luma plane, otherwise ask for one
+bool Camera_V4L2Class::SetFormat(void)
+{
+    struct v4l2_format fmt;
+    memset(&fmt, 0, sizeof(fmt));
+    fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+
+    if (xioctl(m_fd, VIDIOC_G_FMT, &fmt) == -1)
+    {
+        return true;
+    }
+
+    static const unsigned int formats[] = { V4L2_PIX_FMT_GREY, V4L2_PIX_FMT_YUYV, V4L2_PIX_FMT_UYVY };
+
+    bool found = false;
+    for (unsigned int i = 0; i < WXSIZEOF(formats) && !found; i++)
+    {
+        found = fmt.fmt.pix.pixelformat == formats[i];
+    }
+
+    for (unsigned int i = 0; i < WXSIZEOF(formats) && !found; i++)
+    {
+        fmt.fmt.pix.pixelformat = formats[i];
+        fmt.fmt.pix.field = V4L2_FIELD_NONE;
+        found = xioctl(m_fd, VIDIOC_S_FMT, &fmt) == 0 && fmt.fmt.pix.pixelformat == formats[i];
+    }
+
+    if (!found)
+    {
+        return true;
+    }
+
+    m_pixelFormat = fmt.fmt.pix.pixelformat;
+    m_bytesPerLine = fmt.fmt.pix.bytesperline;
+    FullSize = wxSize(fmt.fmt.pix.width, fmt.fmt.pix.height);
+
+    int first, step;
+    LumaLayout(m_pixelFormat, &first, &step);
+    if (m_bytesPerLine < fmt.fmt.pix.width * step)
+    {
+        m_bytesPerLine = fmt.fmt.pix.width * step;
+    }
+
+    Debug.AddLine(wxString::Format("V4L2: format %.4s %dx%d bytesperline %u", (const char *) &m_pixelFormat,
+        FullSize.GetWidth(), FullSize.GetHeight(), m_bytesPerLine));
+
+    return false;
+}
+
+bool Camera_V4L2Class::MapBuffers(void)
+{
+    struct v4l2_requestbuffers req;
+    memset(&req, 0, sizeof(req));
+    req.count = NumBuffers;
+    req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    req.memory = V4L2_MEMORY_MMAP;
+
+    if (xioctl(m_fd, VIDIOC_REQBUFS, &req) == -1 || req.count < 2)
+    {
+        return true;
+    }
+
+    for (unsigned int i = 0; i < req.count; i++)
+    {
+        struct v4l2_buffer buf;
+        memset(&buf, 0, sizeof(buf));
+        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buf.memory = V4L2_MEMORY_MMAP;
+        buf.index = i;
+
+        if (xioctl(m_fd, VIDIOC_QUERYBUF, &buf) == -1)
+        {
+            return true;
+        }
+
+        MappedBuffer mb;
+        mb.length = buf.length;
+        mb.start = mmap(NULL, buf.length, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, buf.m.offset);
+        if (mb.start == MAP_FAILED)
+        {
+            return true;
+        }
+        m_buffers.push_back(mb);
+
+        if (xioctl(m_fd, VIDIOC_QBUF, &buf) == -1)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void Camera_V4L2Class::UnmapBuffers(void)
+{
+    for (unsigned int i = 0; i < m_buffers.size(); i++)
+    {
+        munmap(m_buffers[i].start, m_buffers[i].length);
+    }
+    m_buffers.clear();
+}
+
+void Camera_V4L2Class::CloseDevice(void)
+{
+    if (m_fd != -1)
+    {
+        enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        xioctl(m_fd, VIDIOC_STREAMOFF, &type);
+        UnmapBuffers();
+        close(m_fd);
+        m_fd = -1;
+    }
+}
+
+bool Camera_V4L2Class::Connect()
+{
+    bool bError = false;
+
+    try
+    {
+        wxString devName = wxString::Format("/dev/video%d", m_devNum);
+
+        m_fd = open(devName.fn_str(), O_RDWR | O_NONBLOCK);
+        if (m_fd == -1)
+        {
+            throw ERROR_INFO("V4L2: cannot open " + devName);
+        }
+
+        struct v4l2_capability cap;
+        memset(&cap, 0, sizeof(cap));
+        if (xioctl(m_fd, VIDIOC_QUERYCAP, &cap) == -1 ||
+            !(cap.capabilities & V4L2_CAP_VIDEO_CAPTURE) ||
+            !(cap.capabilities & V4L2_CAP_STREAMING))
+        {
+            throw ERROR_INFO("V4L2: not a streaming capture device");
+        }
+
+        if (SetFormat())
+        {
+            pFrame->Alert(_("The camera does not support a GREY, YUYV or UYVY video format"));
+            throw ERROR_INFO("V4L2: no usable pixel format");
+        }
+
+        if (MapBuffers())
+        {
+            throw ERROR_INFO("V4L2: buffer setup failed");
+        }
+
+        enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        if (xioctl(m_fd, VIDIOC_STREAMON, &type) == -1)
+        {
+            throw ERROR_INFO("V4L2: VIDIOC_STREAMON failed");
+        }
+
+        Debug.AddLine(wxString::Format("V4L2: connected to %s (%s)", devName, (const char *) cap.card));
+        Connected = true;
+    }
+    catch (wxString Msg)
+    {
+        POSSIBLY_UNUSED(Msg);
+        CloseDevice();
+        bError = true;
+    }
+
+    return bError;
+}
+
+bool Camera_V4L2Class::Disconnect()
+{
+    CloseDevice();
+    Connected = false;
+
+    return false;
+}
+
+// the driver keeps filling buffers between exposures, throw away the
+// frames that were taken before this exposure started
+void Camera_V4L2Class::DiscardQueuedFrames(void)
+{
+    while (true)
+    {
+        struct v4l2_buffer buf;
+        memset(&buf, 0, sizeof(buf));
+        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buf.memory = V4L2_MEMORY_MMAP;
+
+        if (xioctl(m_fd, VIDIOC_DQBUF, &buf) == -1)
+        {
+            break;
+        }
+        xioctl(m_fd, VIDIOC_QBUF, &buf);
+    }
+}
+
+void Camera_V4L2Class::AddFrame(int bufferIndex)
+{
+    int first, step;
+    LumaLayout(m_pixelFormat, &first, &step);
+
+    const unsigned char *frame = (const unsigned char *) m_buffers[bufferIndex].start;
+    int width = FullSize.GetWidth();
+    int height = FullSize.GetHeight();
+
+    for (int y = 0; y < height; y++)
+    {
+        const unsigned char *src = frame + y * m_bytesPerLine + first;
+        unsigned int *dst = &m_accum[y * width];
+        for (int x = 0; x < width; x++)
+        {
+            dst[x] += src[x * step];
+        }
+    }
+}
+
+bool Camera_V4L2Class::Capture(int duration, usImage& img, int options, const wxRect& subframe)
+{
+    bool bError = false;
+
+    try
+    {
+        if (m_fd == -1)
+        {
+            throw ERROR_INFO("V4L2: not connected");
+        }
+
+        if (img.Init(FullSize))
+        {
+            pFrame->Alert(_("Memory allocation error"));
+            throw ERROR_INFO("img.Init failed");
+        }
+
+        m_accum.assign(img.NPixels, 0);
+
+        DiscardQueuedFrames();
+
+        wxStopWatch swatch;
+        int nframes = 0;
+
+        // integrate frames until the exposure time is used up, at least one
+        while (nframes == 0 || swatch.Time() < duration)
+        {
+            if (WorkerThread::StopRequested())
+            {
+                throw ERROR_INFO("V4L2: capture interrupted");
+            }
+
+            fd_set fds;
+            FD_ZERO(&fds);
+            FD_SET(m_fd, &fds);
+
+            // wake up regularly to check for a stop request
+            struct timeval tv;
+            tv.tv_sec = 0;
+            tv.tv_usec = 250000;
+
+            int r = select(m_fd + 1, &fds, NULL, NULL, &tv);
+            if (r == -1 && errno != EINTR)
+            {
+                throw ERROR_INFO("V4L2: select failed");
+            }
+            if (r <= 0)
+            {
+                if (swatch.Time() > duration + GetTimeoutMs())
+                {
+                    throw ERROR_INFO("V4L2: timeout waiting for frame");
+                }
+                continue;
+            }
+
+            struct v4l2_buffer buf;
+            memset(&buf, 0, sizeof(buf));
+            buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+            buf.memory = V4L2_MEMORY_MMAP;
+
+            if (xioctl(m_fd, VIDIOC_DQBUF, &buf) == -1)
+            {
+                if (errno == EAGAIN)
+                {
+                    continue;
+                }
+                throw ERROR_INFO("V4L2: VIDIOC_DQBUF failed");
+            }
+
+            if (buf.index < m_buffers.size() && !(buf.flags & V4L2_BUF_FLAG_ERROR))
+            {
+                AddFrame(buf.index);
+                nframes++;
+            }
+
+            if (xioctl(m_fd, VIDIOC_QBUF, &buf) == -1)
+            {
+                throw ERROR_INFO("V4L2: VIDIOC_QBUF failed");
+            }
+        }
+
+        for (int i = 0; i < img.NPixels; i++)
+        {
+            unsigned int val = m_accum[i];
+            img.ImageData[i] = (unsigned short) (val > 65535 ? 65535 : val);
+        }
+
+        Debug.AddLine(wxString::Format("V4L2: integrated %d frames in %ld ms", nframes, swatch.Time()));
+
+        if (options & CAPTURE_SUBTRACT_DARK) SubtractDark(img);
+    }
+    catch (wxString Msg)
+    {
+        POSSIBLY_UNUSED(Msg);
+        bError = true;
+    }
+
+    return bError;
+}
+
+#endif // V4L2_CAMERA
@@ -0,0 +1,73 @@
+/*
+ *  cam_v4l2.h
+ *  PHD Guiding
+ *
+ *  Created by the PHD2 developers
+ *  Copyright (c) 2014 PHD2 Developers
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of Craig Stark, Stark Labs nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef CAM_V4L2_H_INCLUDED
+#define CAM_V4L2_H_INCLUDED
+
+// Webcams and UVC guide cameras through the Linux V4L2 API. Frames are
+// streamed into mmap'd driver buffers and the luma plane is read straight
+// out of them, so GREY, YUYV and UYVY cameras need no color conversion.
+class Camera_V4L2Class : public GuideCamera
+{
+    struct MappedBuffer
+    {
+        void *start;
+        size_t length;
+    };
+
+    int m_devNum;
+    int m_fd;
+    unsigned int m_pixelFormat;
+    unsigned int m_bytesPerLine;
+    std::vector<MappedBuffer> m_buffers;
+    std::vector<unsigned int> m_accum;
+
+    bool SetFormat(void);
+    bool MapBuffers(void);
+    void UnmapBuffers(void);
+    void CloseDevice(void);
+    void DiscardQueuedFrames(void);
+    void AddFrame(int bufferIndex);
+
+public:
+    Camera_V4L2Class(int devNumber);
+    ~Camera_V4L2Class(void);
+
+    bool    Capture(int duration, usImage& img, int options, const wxRect& subframe);
+    bool    Connect();
+    bool    Disconnect();
+    void    InitCapture() { return; }
+};
+
+#endif // CAM_V4L2_H_INCLUDED
@@ -219,8 +219,20 @@ void CamCalImportDialog::OnOk(wxCommandEvent& evt)
 
     if (m_sourceDarksProfileId != -1)
     {
+        // release the mapping of this profile's library so the file can be replaced
+        if (pCamera)
+            pCamera->ClearDarks();
+
         sourceName = MyFrame::DarkLibFileName(m_sourceDarksProfileId);
         destName = MyFrame::DarkLibFileName(m_thisProfileId);
+        if (!wxFileExists(sourceName))
+        {
+            // the source profile still has a library in the old format, it gets converted when loaded
+            sourceName = MyFrame::LegacyDarkLibFileName(m_sourceDarksProfileId);
+            if (wxFileExists(destName))
+                wxRemoveFile(destName);
+            destName = MyFrame::LegacyDarkLibFileName(m_thisProfileId);
+        }
         if (wxCopyFile(sourceName, destName, true))
         {
             Debug.Write(wxString::Format("Dark library imported from profile %d to profile %d\n", m_sourceDarksProfileId, m_thisProfileId));
@@ -104,6 +104,10 @@ wxSize UNDEFINED_FRAME_SIZE = wxSize(0, 0);
 #include "cam_opencv.h"
 #endif
 
+#if defined (V4L2_CAMERA)
+#include "cam_v4l2.h"
+#endif
+
 #if defined (WDM_CAMERA)
  #include "cam_WDM.h"
 #endif
@@ -193,6 +197,11 @@ GuideCamera::GuideCamera(void)
 
     CurrentDarkFrame = NULL;
     CurrentDefectMap = NULL;
+    m_darkModel = NULL;
+    m_fittedModel = NULL;
+    m_darkModelThread = NULL;
+    m_darkLibFile = NULL;
+    m_pagedDark = NULL;
 
     GuideCameraGain = pConfig->Profile.GetInt("/camera/gain", DefaultGuideCameraGain);
     m_timeoutMs = pConfig->Profile.GetInt("/camera/TimeoutMs", DefaultGuideCameraTimeoutMs);
@@ -294,6 +303,10 @@ wxArrayString GuideCamera::List(void)
     CameraList.Add(_T("OpenCV webcam 1"));
     CameraList.Add(_T("OpenCV webcam 2"));
 #endif
+#if defined (V4L2_CAMERA)
+    CameraList.Add(_T("V4L2 webcam 1"));
+    CameraList.Add(_T("V4L2 webcam 2"));
+#endif
 #if defined (WDM_CAMERA)
     CameraList.Add(_T("Windows WDM-style webcam camera"));
 #endif
@@ -451,6 +464,18 @@ GuideCamera *GuideCamera::Factory(const wxString& choice)
             pReturn = new Camera_OpenCVClass(dev);
         }
 #endif
+#if defined (V4L2_CAMERA)
+        else if (choice.Find(_T("V4L2 webcam")) + 1) {
+            // "V4L2 webcam 1" is /dev/video0, "V4L2 webcam 2" is /dev/video1;
+            // match the trailing index, not the "2" in "V4L2"
+            int dev = 0;
+            if (choice.EndsWith(_T(" 2")))
+            {
+                dev = 1;
+            }
+            pReturn = new Camera_V4L2Class(dev);
+        }
+#endif
 #if defined (WDM_CAMERA)
         else if (choice.Find(_T("Windows WDM")) + 1) {
             pReturn = new Camera_WDMClass();
@@ -948,30 +973,296 @@ void GuideCamera::AddDark(usImage *dark)
         if (pos != Darks.end())
         {
             usImage *prior = pos->second;
-            if (prior == CurrentDarkFrame)
+            if (!prior)
+                prior = m_pagedDark && m_pagedDark->ImgExpDur == expdur ? m_pagedDark : NULL;
+            if (prior && prior == CurrentDarkFrame)
                 CurrentDarkFrame = dark;
+            if (prior == m_pagedDark)
+                m_pagedDark = NULL;
             delete prior;
         }
 
+        Darks[expdur] = dark;
+
     } // lock scope
+}
+
+// Fits the dark model from the library file in the background so that loading
+// a library never waits for the fit, and hands the model to the camera
+class DarkModelThread : public wxThread
+{
+    GuideCamera *m_camera;
+    wxString m_filename;
+
+public:
+    DarkModelThread(GuideCamera *camera, const wxString& filename)
+        : wxThread(wxTHREAD_JOINABLE),
+          m_camera(camera),
+          m_filename(filename)
+    {
+    }
 
-    Darks[expdur] = dark;
+protected:
+    ExitCode Entry()
+    {
+        // use a separate instance of the library so nothing is shared with
+        // the main thread
+        DarkLibraryFile lib;
+        DarkModel *model = new DarkModel();
+        std::vector<int> exposures;
+
+        if (!lib.Open(m_filename))
+            lib.GetExposures(&exposures);
+
+        // the frames are read one at a time, so the library is never in
+        // memory or mapped all at once
+        DarkLibraryReader frames(lib);
+        if (!lib.IsOpen() || model->Fit(exposures, lib.FrameSize(), frames, this))
+        {
+            delete model;
+            return (ExitCode) 0;
+        }
+
+        m_camera->SetFittedDarkModel(model);
+
+        // have the main thread select the synthesized dark for the current exposure
+        wxQueueEvent(pFrame, new wxThreadEvent(wxEVT_THREAD, DARK_MODEL_FITTED_EVENT));
+
+        return (ExitCode) 0;
+    }
+};
+
+void GuideCamera::SetFittedDarkModel(DarkModel *model)
+{
+    wxCriticalSectionLocker lck(DarkFrameLock);
+    delete m_fittedModel;
+    m_fittedModel = model;
+}
+
+void GuideCamera::StopDarkModelFit(void)
+{
+    // must not be called with DarkFrameLock held, the thread takes it to hand
+    // over the model
+    if (m_darkModelThread)
+    {
+        m_darkModelThread->Delete();
+        delete m_darkModelThread;
+        m_darkModelThread = NULL;
+    }
 }
 
 void GuideCamera::SelectDark(int exposureDuration)
 {
-    // select the dark frame with the smallest exposure >= the requested exposure.
-    // if there are no darks with exposures > the select exposure, select the dark with the greatest exposure
+    // use the library dark if we have one with exactly the requested exposure. Otherwise
+    // synthesize a dark for the exposure from the dark model. If there is no model yet
+    // (fewer than two darks, or the fit is still running), select the dark frame with the
+    // smallest exposure >= the requested exposure, or the dark with the greatest exposure
+    // if there are none longer
+    //
+    // Darks, the library file and the dark model in use are only changed by the main
+    // thread, which is also the only caller, so the dark is found or built without
+    // holding DarkFrameLock. The lock is only held to switch the camera thread over to
+    // the new dark, so dark subtraction is never held up by paging or synthesis.
+
+    DarkModel *oldModel = NULL;
 
-    wxCriticalSectionLocker lck(DarkFrameLock);
+    { // lock scope
+        wxCriticalSectionLocker lck(DarkFrameLock);
+        if (m_fittedModel)
+        {
+            // the old model's darks may still be in use, free it after the switch
+            oldModel = m_darkModel;
+            m_darkModel = m_fittedModel;
+            m_fittedModel = NULL;
+        }
+    } // lock scope
+
+    const usImage *dark = NULL;
+    usImage *paged = NULL;
+    usImage *synthesized = NULL;
+
+    ExposureImgMap::const_iterator exact = Darks.find(exposureDuration);
+    if (exact != Darks.end())
+    {
+        dark = PageInDark(exact, &paged);
+    }
+    else
+    {
+        if (m_darkModel)
+        {
+            dark = m_darkModel->Cached(exposureDuration);
+            if (!dark)
+                dark = synthesized = m_darkModel->Synthesize(exposureDuration);
+        }
+
+        if (!dark)
+        {
+            ExposureImgMap::const_iterator it = Darks.lower_bound(exposureDuration);
+            if (it == Darks.end() && !Darks.empty())
+                --it;
+            if (it != Darks.end())
+                dark = PageInDark(it, &paged);
+        }
+    }
+
+    usImage *oldPaged = NULL;
+
+    { // lock scope
+        wxCriticalSectionLocker lck(DarkFrameLock);
+
+        CurrentDarkFrame = dark;
+
+        // caching may drop an older synthesized dark, which is no longer current
+        if (synthesized)
+            m_darkModel->AddToCache(synthesized);
+
+        // only keep a copy of a library dark while it is in use
+        if (paged || m_pagedDark != CurrentDarkFrame)
+        {
+            oldPaged = m_pagedDark;
+            m_pagedDark = paged;
+        }
+    } // lock scope
+
+    delete oldPaged;
+    delete oldModel;
+}
+
+const usImage *GuideCamera::PageInDark(ExposureImgMap::const_iterator it, usImage **paged)
+{
+    // returns the dark for it, setting *paged if a new copy had to be made
+    // from the library file
+
+    if (it->second)
+        return it->second;
+
+    // the dark is only in the library file, read just this frame
+
+    if (m_pagedDark && m_pagedDark->ImgExpDur == it->first)
+        return m_pagedDark;
+
+    if (!m_darkLibFile)
+        return NULL;
+
+    usImage *img = new usImage();
+    if (img->Init(m_darkLibFile->FrameSize()) || m_darkLibFile->ReadFrame(it->first, img->ImageData))
+    {
+        delete img;
+        return NULL;
+    }
+    img->ImgExpDur = it->first;
+    img->CalcStats();
+
+    *paged = img;
+
+    return img;
+}
+
+// Supplies the camera's darks to DarkLibraryFile::Save, reading the ones
+// that are only in the library file one at a time
+class CameraDarkFrames : public DarkFrameSource
+{
+    const ExposureImgMap& m_darks;
+    DarkLibraryReader m_reader;
+
+public:
+    CameraDarkFrames(const ExposureImgMap& darks, const DarkLibraryFile& lib) : m_darks(darks), m_reader(lib) { }
+
+    const unsigned short *Frame(int exposure)
+    {
+        ExposureImgMap::const_iterator it = m_darks.find(exposure);
+        if (it == m_darks.end())
+            return NULL;
+        return it->second ? it->second->ImageData : m_reader.Frame(exposure);
+    }
+};
+
+bool GuideCamera::GetDarkExposures(std::vector<int> *exposures, wxSize *size) const
+{
+    // list the exposures of every usable dark, wherever it lives; returns
+    // true if the darks are not all the same size
+
+    exposures->clear();
+    *size = wxSize();
 
-    CurrentDarkFrame = 0;
     for (ExposureImgMap::const_iterator it = Darks.begin(); it != Darks.end(); ++it)
     {
-        CurrentDarkFrame = it->second;
-        if (it->first >= exposureDuration)
-            break;
+        wxSize sz;
+
+        if (it->second)
+        {
+            if (it->second->IsWindowed())
+                continue;
+            sz = it->second->Size;
+        }
+        else
+        {
+            if (!m_darkLibFile)
+                continue;
+            sz = m_darkLibFile->FrameSize();
+        }
+
+        if (exposures->empty())
+            *size = sz;
+        else if (sz != *size)
+            return true;
+
+        exposures->push_back(it->first);
+    }
+
+    return false;
+}
+
+void GuideCamera::SetDarkLibrary(DarkLibraryFile *darkLib)
+{
+    // takes ownership of darkLib, replacing all current darks
+
+    ClearDarks();
+
+    { // lock scope
+        wxCriticalSectionLocker lck(DarkFrameLock);
+
+        m_darkLibFile = darkLib;
+
+        std::vector<int> exposures;
+        darkLib->GetExposures(&exposures);
+        for (std::vector<int>::const_iterator it = exposures.begin(); it != exposures.end(); ++it)
+            Darks[*it] = NULL;
+    } // lock scope
+
+    if (Darks.size() >= 2)
+    {
+        m_darkModelThread = new DarkModelThread(this, darkLib->FileName());
+        if (m_darkModelThread->Run() != wxTHREAD_NO_ERROR)
+        {
+            Debug.AddLine("SetDarkLibrary: could not start dark model thread");
+            delete m_darkModelThread;
+            m_darkModelThread = NULL;
+        }
+    }
+}
+
+bool GuideCamera::SaveDarkLibrary(const wxString& filename, const wxString& note)
+{
+    // the darks are only changed by the main thread, so they can be read
+    // without DarkFrameLock. The library file may be replaced by the new one
+    // next, so stop any fit that is still reading it; the new library gets
+    // its own fit when it is attached.
+
+    StopDarkModelFit();
+
+    std::vector<int> exposures;
+    wxSize size;
+    if (GetDarkExposures(&exposures, &size))
+    {
+        Debug.AddLine("SaveDarkLibrary: dark frames differ in size");
+        return true;
     }
+
+    DarkLibraryFile noLib;
+    CameraDarkFrames frames(Darks, m_darkLibFile ? *m_darkLibFile : noLib);
+
+    return DarkLibraryFile::Save(filename, exposures, size, frames, note);
 }
 
 void GuideCamera::ClearDefectMap()
@@ -995,6 +1286,8 @@ void GuideCamera::SetDefectMap(DefectMap *defectMap)
 
 void GuideCamera::ClearDarks()
 {
+    StopDarkModelFit();
+
     wxCriticalSectionLocker lck(DarkFrameLock);
     while (!Darks.empty())
     {
@@ -1003,6 +1296,14 @@ void GuideCamera::ClearDarks()
         Darks.erase(it);
     }
     CurrentDarkFrame = NULL;
+    delete m_pagedDark;
+    m_pagedDark = NULL;
+    delete m_darkLibFile;
+    m_darkLibFile = NULL;
+    delete m_darkModel;
+    m_darkModel = NULL;
+    delete m_fittedModel;
+    m_fittedModel = NULL;
 }
 
 void GuideCamera::SubtractDark(usImage& img)
@@ -81,13 +81,28 @@ enum CaptureOptionBits
     CAPTURE_BPM_REVIEW = CAPTURE_SUBTRACT_DARK,
 };
 
+class DarkModel;
+class DarkLibraryFile;
+class DarkModelThread;
+
 class GuideCamera :  public wxMessageBoxProxy, public OnboardST4
 {
     friend class CameraConfigDialogPane;
+    friend class DarkModelThread;
 
 protected:
     bool            m_hasGuideOutput;
     int             m_timeoutMs;
+    DarkModel      *m_darkModel;       // fitted from the dark library, used for exposures not in the library
+    DarkModel      *m_fittedModel;     // model fitted in the background, taken into use by SelectDark
+    DarkModelThread *m_darkModelThread; // fits the dark model after the library is loaded
+    DarkLibraryFile *m_darkLibFile;    // dark library, holds the darks with a NULL entry in Darks
+    usImage        *m_pagedDark;       // copy of the library dark currently in use
+
+    bool            GetDarkExposures(std::vector<int> *exposures, wxSize *size) const;
+    const usImage  *PageInDark(ExposureImgMap::const_iterator it, usImage **paged);
+    void            StopDarkModelFit(void);
+    void            SetFittedDarkModel(DarkModel *model);
 
 public:
     int             GuideCameraGain;
@@ -107,8 +122,8 @@ public:
     double          PixelSize;
 
     wxCriticalSection DarkFrameLock; // dark frames can be accessed in the main thread or the camera worker thread
-    usImage        *CurrentDarkFrame;
-    ExposureImgMap  Darks; // map exposure => dark frame
+    const usImage  *CurrentDarkFrame;
+    ExposureImgMap  Darks; // map exposure => dark frame, NULL if the frame is only in the library file
     DefectMap      *CurrentDefectMap;
 
     static wxArrayString List(void);
@@ -138,6 +153,8 @@ public:
     virtual wxString GetSettingsSummary();
     void            AddDark(usImage *dark);
     void            SelectDark(int exposureDuration);
+    void            SetDarkLibrary(DarkLibraryFile *darkLib);
+    bool            SaveDarkLibrary(const wxString& filename, const wxString& note);
     void            SetDefectMap(DefectMap *newMap);
     void            ClearDefectMap(void);
     void            ClearDarks(void);
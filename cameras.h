@@ -102,6 +102,7 @@
 # define CAM_QHY5
 # define INDI_CAMERA
 # define ZWO_ASI
+# define V4L2_CAMERA
 #endif
 
 // Currently unused
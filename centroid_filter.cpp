@@ -0,0 +1,144 @@
+/*
+ *  centroid_filter.cpp
+ *  PHD Guiding
+ *
+ *  Created by the PHD2 developers
+ *  Copyright (c) 2014 PHD2 Developers
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of Craig Stark, Stark Labs nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "phd.h"
+
+// the initial measurement variance, before the seeing has been estimated
+static const double InitialNoise = 0.25;
+// lower bound on the estimated measurement variance (0.05 px)
+static const double MinNoise = 0.0025;
+// initial variance of the offset rate
+static const double InitialRateVariance = 0.01;
+// weight given to each innovation when estimating the measurement noise
+static const double NoiseWeight = 0.05;
+// innovations larger than this many sigma are treated as a real jump
+static const double JumpSigma = 4.0;
+// default process noise: the residual drift changes slowly compared to the seeing
+static const double DefaultProcessNoise = 1.0e-4;
+
+CentroidFilter::CentroidFilter(void)
+    : m_accel(DefaultProcessNoise)
+{
+    Reset();
+}
+
+void CentroidFilter::Reset(void)
+{
+    m_time = 0.0;
+    m_pos = 0.0;
+    m_vel = 0.0;
+    m_p00 = m_p01 = m_p11 = 0.0;
+    m_noise = InitialNoise;
+    m_count = 0;
+}
+
+void CentroidFilter::Advance(double t)
+{
+    double dt = t - m_time;
+    if (dt <= 0.0)
+        return;
+
+    m_pos += m_vel * dt;
+
+    // P = F P F' + Q for a constant-rate model driven by white acceleration
+    double const q = m_accel;
+    m_p00 += 2.0 * dt * m_p01 + dt * dt * m_p11 + q * dt * dt * dt / 3.0;
+    m_p01 += dt * m_p11 + q * dt * dt / 2.0;
+    m_p11 += q * dt;
+
+    m_time = t;
+}
+
+void CentroidFilter::Measure(double t, double x)
+{
+    if (m_count == 0)
+    {
+        m_time = t;
+        m_pos = x;
+        m_vel = 0.0;
+        m_p00 = m_noise;
+        m_p01 = 0.0;
+        m_p11 = InitialRateVariance;
+        m_count = 1;
+        return;
+    }
+
+    Advance(t);
+
+    double const innov = x - m_pos;
+
+    if (innov * innov > JumpSigma * JumpSigma * (m_p00 + m_noise))
+    {
+        // the star really moved (a bump, a gust, a cable snag): open up the
+        // position variance so the estimate follows it instead of the seeing
+        // estimate absorbing it
+        m_p00 += innov * innov;
+    }
+    else
+    {
+        // the innovation variance is P00 + R, so each innovation gives an
+        // estimate of R
+        m_noise += NoiseWeight * (innov * innov - m_p00 - m_noise);
+        if (m_noise < MinNoise)
+            m_noise = MinNoise;
+    }
+
+    double const s = m_p00 + m_noise;
+    double const k0 = m_p00 / s;
+    double const k1 = m_p01 / s;
+
+    m_pos += k0 * innov;
+    m_vel += k1 * innov;
+
+    m_p11 -= k1 * m_p01;
+    m_p01 *= 1.0 - k0;
+    m_p00 *= 1.0 - k0;
+
+    ++m_count;
+}
+
+void CentroidFilter::Correct(double t, double dx)
+{
+    if (m_count == 0)
+        return;
+
+    Advance(t);
+    m_pos -= dx;
+}
+
+double CentroidFilter::Predict(double t) const
+{
+    double dt = t - m_time;
+    return dt > 0.0 ? m_pos + m_vel * dt : m_pos;
+}
@@ -0,0 +1,80 @@
+/*
+ *  centroid_filter.h
+ *  PHD Guiding
+ *
+ *  Created by the PHD2 developers
+ *  Copyright (c) 2014 PHD2 Developers
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of Craig Stark, Stark Labs nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef CENTROID_FILTER_INCLUDED
+#define CENTROID_FILTER_INCLUDED
+
+// Kalman filter for the guide star offset along one mount axis.
+//
+// The state is the offset and its rate of change. Each centroid is a noisy
+// measurement of the offset at the exposure midpoint, and each guide pulse is
+// a known control input that moves the offset by the amount corrected. The
+// filter can then predict the offset at the time the next pulse is issued,
+// which both smooths the seeing and compensates for the delay between the
+// exposure midpoint and the pulse.
+//
+// Times are in seconds and offsets in pixels. The measurement noise is
+// estimated from the innovations so the filter adapts to the seeing.
+
+class CentroidFilter
+{
+    double m_time;              // time of the state estimate
+    double m_pos;               // offset
+    double m_vel;               // offset rate, pixels per second
+    double m_p00, m_p01, m_p11; // state covariance
+    double m_noise;             // measurement variance
+    double m_accel;             // process noise spectral density, px^2/s^3
+    unsigned int m_count;
+
+    void Advance(double t);
+
+public:
+    CentroidFilter(void);
+
+    void Reset(void);
+    void SetProcessNoise(double accel) { m_accel = accel; }
+    bool IsValid(void) const { return m_count > 0; }
+
+    // add the centroid offset x measured at time t
+    void Measure(double t, double x);
+    // a guide pulse issued at time t reduced the offset by dx
+    void Correct(double t, double dx);
+    // the predicted offset at time t
+    double Predict(double t) const;
+
+    double Rate(void) const { return m_vel; }
+    double MeasurementNoise(void) const { return sqrt(m_noise); }
+};
+
+#endif
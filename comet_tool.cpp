@@ -38,6 +38,8 @@
 
 #include <wx/valnum.h>
 
+#include <algorithm>
+
 struct CometToolWin : public wxDialog
 {
     wxToggleButton *m_enable;
@@ -54,7 +56,13 @@ struct CometToolWin : public wxDialog
     bool m_training;
     wxTimer m_timer;
 
-    PHD_Point m_startPos;
+    struct TrainingSample
+    {
+        double t;       // hours since the start of training
+        PHD_Point pos;  // lock position
+    };
+
+    std::vector<TrainingSample> m_samples;
     wxLongLong_t m_startTime;
 
     CometToolWin();
@@ -72,6 +80,7 @@ struct CometToolWin : public wxDialog
     void OnStop(wxCommandEvent& event);
 
     void UpdateGuiderShift();
+    void AddSample();
     void CalcRate();
     void UpdateStatus();
 };
@@ -248,8 +257,9 @@ void CometToolWin::OnStart(wxCommandEvent& event)
         pFrame->pNudgeLock = NudgeLockTool::CreateNudgeLockToolWindow();
     pFrame->pNudgeLock->Show();
 
-    m_startPos = pFrame->pGuider->LockPosition();
     m_startTime = ::wxGetUTCTimeMillis().GetValue();
+    m_samples.clear();
+    AddSample();
 
     pFrame->pGuider->EnableLockPosShift(true);
 
@@ -284,10 +294,102 @@ void CometToolWin::OnTimer(wxTimerEvent& WXUNUSED(evt))
     UpdateStatus();
 }
 
+void CometToolWin::AddSample()
+{
+    TrainingSample sample;
+    sample.t = (double) (::wxGetUTCTimeMillis().GetValue() - m_startTime) / 3600000.0; // hours
+    sample.pos = pFrame->pGuider->LockPosition();
+    m_samples.push_back(sample);
+}
+
+// Least-squares fit of a straight track through the lock positions recorded
+// at each adjustment during training. Samples far from the fitted track, more
+// than 3 times the robust standard deviation of the residuals, are dropped
+// and the fit repeated so that a mistaken adjustment does not skew the rate.
+// Returns true if there are not enough usable samples.
+static bool FitRate(const std::vector<CometToolWin::TrainingSample>& samples, PHD_Point *rate)
+{
+    enum { MaxPasses = 3 };
+    static const double MinOutlierDist = 0.5; // px
+
+    std::vector<bool> used(samples.size(), true);
+    bool fitted = false;
+
+    for (int pass = 0; pass < MaxPasses; pass++)
+    {
+        double n = 0.0, st = 0.0, sx = 0.0, sy = 0.0;
+        for (size_t i = 0; i < samples.size(); i++)
+        {
+            if (!used[i])
+                continue;
+            n += 1.0;
+            st += samples[i].t;
+            sx += samples[i].pos.X;
+            sy += samples[i].pos.Y;
+        }
+        if (n < 2.0)
+            break;
+
+        double tm = st / n, xm = sx / n, ym = sy / n;
+        double stt = 0.0, stx = 0.0, sty = 0.0;
+        for (size_t i = 0; i < samples.size(); i++)
+        {
+            if (!used[i])
+                continue;
+            double dt = samples[i].t - tm;
+            stt += dt * dt;
+            stx += dt * (samples[i].pos.X - xm);
+            sty += dt * (samples[i].pos.Y - ym);
+        }
+        if (stt <= 0.0)
+            break;
+
+        rate->SetXY(stx / stt, sty / stt);
+        fitted = true;
+
+        if (n < 4.0)
+            break;
+
+        // distance of each sample from the fitted track
+        std::vector<double> resid(samples.size());
+        std::vector<double> tmp;
+        for (size_t i = 0; i < samples.size(); i++)
+        {
+            double dt = samples[i].t - tm;
+            resid[i] = hypot(samples[i].pos.X - (xm + rate->X * dt), samples[i].pos.Y - (ym + rate->Y * dt));
+            if (used[i])
+                tmp.push_back(resid[i]);
+        }
+        std::nth_element(tmp.begin(), tmp.begin() + tmp.size() / 2, tmp.end());
+        double limit = wxMax(MinOutlierDist, 3.0 * 1.4826 * tmp[tmp.size() / 2]);
+
+        bool changed = false;
+        for (size_t i = 0; i < samples.size(); i++)
+        {
+            if (used[i] && resid[i] > limit)
+            {
+                Debug.AddLine("CometTool: ignore training sample at %.4fh (%.2f, %.2f), residual %.2f > %.2f",
+                              samples[i].t, samples[i].pos.X, samples[i].pos.Y, resid[i], limit);
+                used[i] = false;
+                changed = true;
+            }
+        }
+        if (!changed)
+            break;
+    }
+
+    return !fitted;
+}
+
 void CometToolWin::CalcRate()
 {
-    double dt = (double) (::wxGetUTCTimeMillis().GetValue() - m_startTime) / 3600000.0; // hours
-    PHD_Point rate = (pFrame->pGuider->LockPosition() - m_startPos) / dt;
+    AddSample();
+
+    PHD_Point rate;
+    if (FitRate(m_samples, &rate))
+        return;
+
+    Debug.AddLine("CometTool: rate %.2f, %.2f px/hr from %u samples", rate.X, rate.Y, (unsigned int) m_samples.size());
     pFrame->pGuider->SetLockPosShiftRate(rate, UNIT_PIXELS, false);
 }
 
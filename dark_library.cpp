@@ -0,0 +1,261 @@
+/*
+ *  dark_library.cpp
+ *  PHD Guiding
+ *
+ *  Created by the PHD2 developers
+ *  Copyright (c) 2014 PHD2 Developers
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of Craig Stark, Stark Labs nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "phd.h"
+
+// Dark library file layout, all integers little-endian:
+//
+//   char[8]  magic "PHD2DRK1"
+//   uint32   frame width
+//   uint32   frame height
+//   uint32   frame count
+//   uint32   length in bytes of the note text
+//   index    count x { int32 exposure (ms), uint32 reserved, uint32 offset low, uint32 offset high }
+//   char[]   note text, UTF-8
+//   frames   width x height uint16 pixels each, starting on a page boundary
+
+static const char DarkLibMagic[8] = { 'P', 'H', 'D', '2', 'D', 'R', 'K', '1' };
+enum { DLB_HEADER_SIZE = 24, DLB_INDEX_ENTRY_SIZE = 16, DLB_ALIGN = 4096 };
+
+inline static unsigned int get_u32(const unsigned char *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int) p[3] << 24);
+}
+
+inline static void put_u32(std::vector<unsigned char>& buf, unsigned int v)
+{
+    buf.push_back((unsigned char) v);
+    buf.push_back((unsigned char) (v >> 8));
+    buf.push_back((unsigned char) (v >> 16));
+    buf.push_back((unsigned char) (v >> 24));
+}
+
+inline static wxUint64 align_up(wxUint64 pos)
+{
+    return (pos + DLB_ALIGN - 1) & ~(wxUint64) (DLB_ALIGN - 1);
+}
+
+bool DarkLibraryFile::Open(const wxString& filename)
+{
+    Close();
+
+#if wxBYTE_ORDER == wxBIG_ENDIAN
+    // the frames are read as they are stored, so they must already be in host byte order
+    Debug.AddLine("DarkLibraryFile: dark library is not supported on big-endian hosts");
+    return true;
+#else
+
+    try
+    {
+        wxFile file(filename);
+        if (!file.IsOpened())
+            throw ERROR_INFO("cannot open file");
+
+        wxFileOffset const size = file.Length();
+
+        unsigned char hdr[DLB_HEADER_SIZE];
+        if (size < DLB_HEADER_SIZE || file.Read(hdr, DLB_HEADER_SIZE) != DLB_HEADER_SIZE ||
+            memcmp(hdr, DarkLibMagic, sizeof(DarkLibMagic)) != 0)
+        {
+            throw ERROR_INFO("not a PHD2 dark library file");
+        }
+
+        unsigned int const width = get_u32(hdr + 8);
+        unsigned int const height = get_u32(hdr + 12);
+        unsigned int const count = get_u32(hdr + 16);
+        unsigned int const noteLen = get_u32(hdr + 20);
+
+        if (width == 0 || height == 0 || width > 0xffff || height > 0xffff)
+            throw ERROR_INFO("bad frame size");
+
+        if (count > (size - DLB_HEADER_SIZE) / DLB_INDEX_ENTRY_SIZE ||
+            noteLen > size - DLB_HEADER_SIZE - (wxFileOffset) count * DLB_INDEX_ENTRY_SIZE)
+        {
+            throw ERROR_INFO("truncated header");
+        }
+
+        // the index and the note
+        size_t const rest = count * DLB_INDEX_ENTRY_SIZE + noteLen;
+        std::vector<unsigned char> buf(rest + 1);
+        if (file.Read(&buf[0], rest) != (ssize_t) rest)
+            throw ERROR_INFO("truncated header");
+
+        wxUint64 const frameBytes = (wxUint64) width * height * sizeof(unsigned short);
+        const unsigned char *entry = &buf[0];
+
+        for (unsigned int i = 0; i < count; i++, entry += DLB_INDEX_ENTRY_SIZE)
+        {
+            int const exposure = (int) get_u32(entry);
+            wxUint64 const offset = get_u32(entry + 8) | ((wxUint64) get_u32(entry + 12) << 32);
+
+            if (offset % DLB_ALIGN != 0 || offset > (wxUint64) size || frameBytes > (wxUint64) size - offset)
+                throw ERROR_INFO("bad frame offset");
+
+            m_offsets[exposure] = offset;
+        }
+
+        m_note = wxString::FromUTF8(reinterpret_cast<const char *>(entry), noteLen);
+        m_size = wxSize(width, height);
+        m_filename = filename;
+    }
+    catch (wxString Msg)
+    {
+        POSSIBLY_UNUSED(Msg);
+        Debug.AddLine(wxString::Format("DarkLibraryFile: cannot use %s", filename));
+        Close();
+        return true;
+    }
+
+    Debug.AddLine(wxString::Format("DarkLibraryFile: opened %s, %u frames %d x %d", filename,
+        (unsigned int) m_offsets.size(), m_size.GetWidth(), m_size.GetHeight()));
+
+    return false;
+#endif
+}
+
+void DarkLibraryFile::Close()
+{
+    m_offsets.clear();
+    m_note.clear();
+    m_filename.clear();
+    m_size = wxSize();
+}
+
+void DarkLibraryFile::GetExposures(std::vector<int> *exposures) const
+{
+    exposures->clear();
+    for (std::map<int, wxUint64>::const_iterator it = m_offsets.begin(); it != m_offsets.end(); ++it)
+        exposures->push_back(it->first);
+}
+
+bool DarkLibraryFile::ReadFrame(int exposure, unsigned short *dst) const
+{
+    // only uses state that does not change while the file is open, so frames
+    // can be read from any thread
+
+    std::map<int, wxUint64>::const_iterator it = m_offsets.find(exposure);
+    if (it == m_offsets.end())
+        return true;
+
+    size_t const frameBytes = m_size.GetWidth() * m_size.GetHeight() * sizeof(unsigned short);
+
+    {
+        MappedFile map;
+        if (!map.Open(m_filename, it->second, frameBytes))
+        {
+            memcpy(dst, map.Data(), frameBytes);
+            return false;
+        }
+    }
+
+    // mapping can fail when the address space is short; read the frame instead
+    wxFile file(m_filename);
+    if (!file.IsOpened() || file.Seek((wxFileOffset) it->second) == wxInvalidOffset ||
+        file.Read(dst, frameBytes) != (ssize_t) frameBytes)
+    {
+        Debug.AddLine(wxString::Format("DarkLibraryFile: cannot read frame %d from %s", exposure, m_filename));
+        return true;
+    }
+
+    return false;
+}
+
+const unsigned short *DarkLibraryReader::Frame(int exposure)
+{
+    m_buf.resize(m_lib.FrameSize().GetWidth() * m_lib.FrameSize().GetHeight());
+    if (m_buf.empty() || m_lib.ReadFrame(exposure, &m_buf[0]))
+        return NULL;
+    return &m_buf[0];
+}
+
+bool DarkLibraryFile::Save(const wxString& filename, const std::vector<int>& exposures, const wxSize& size,
+                           DarkFrameSource& frames, const wxString& note)
+{
+#if wxBYTE_ORDER == wxBIG_ENDIAN
+    Debug.AddLine("DarkLibraryFile: dark library is not supported on big-endian hosts");
+    return true;
+#else
+
+    const wxScopedCharBuffer noteText(note.ToUTF8());
+    size_t const noteLen = noteText.length();
+    size_t const frameBytes = size.GetWidth() * size.GetHeight() * sizeof(unsigned short);
+
+    std::vector<unsigned char> hdr;
+    hdr.insert(hdr.end(), DarkLibMagic, DarkLibMagic + sizeof(DarkLibMagic));
+    put_u32(hdr, size.GetWidth());
+    put_u32(hdr, size.GetHeight());
+    put_u32(hdr, (unsigned int) exposures.size());
+    put_u32(hdr, (unsigned int) noteLen);
+
+    wxUint64 offset = align_up(DLB_HEADER_SIZE + exposures.size() * DLB_INDEX_ENTRY_SIZE + noteLen);
+    for (std::vector<int>::const_iterator it = exposures.begin(); it != exposures.end(); ++it)
+    {
+        put_u32(hdr, (unsigned int) *it);
+        put_u32(hdr, 0);
+        put_u32(hdr, (unsigned int) (offset & 0xffffffff));
+        put_u32(hdr, (unsigned int) (offset >> 32));
+        offset = align_up(offset + frameBytes);
+    }
+    hdr.insert(hdr.end(), noteText.data(), noteText.data() + noteLen);
+
+    bool err = false;
+    {
+        wxFile file(filename, wxFile::write);
+        std::vector<unsigned char> pad(DLB_ALIGN, 0);
+
+        err = !file.IsOpened() || file.Write(&hdr[0], hdr.size()) != hdr.size();
+        wxUint64 pos = hdr.size();
+
+        for (std::vector<int>::const_iterator it = exposures.begin(); !err && it != exposures.end(); ++it)
+        {
+            const unsigned short *pixels = frames.Frame(*it);
+            size_t padLen = (size_t) (align_up(pos) - pos);
+            err = !pixels ||
+                file.Write(&pad[0], padLen) != padLen ||
+                file.Write(pixels, frameBytes) != frameBytes;
+            pos += padLen + frameBytes;
+            Debug.AddLine("saving dark frame exposure = %d", *it);
+        }
+    }
+
+    if (err)
+    {
+        Debug.AddLine(wxString::Format("Failed to save dark library to %s", filename));
+        wxRemoveFile(filename);
+        return true;
+    }
+
+    return false;
+#endif
+}
@@ -0,0 +1,86 @@
+/*
+ *  dark_library.h
+ *  PHD Guiding
+ *
+ *  Created by the PHD2 developers
+ *  Copyright (c) 2014 PHD2 Developers
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of Craig Stark, Stark Labs nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef DARK_LIBRARY_INCLUDED
+#define DARK_LIBRARY_INCLUDED
+
+// Supplies dark frame pixels one exposure at a time, so the frames of a
+// library never have to be in memory together
+class DarkFrameSource
+{
+public:
+    virtual ~DarkFrameSource() { }
+    // the pixels of the dark for exposure, valid until the next call; NULL on error
+    virtual const unsigned short *Frame(int exposure) = 0;
+};
+
+// Dark library file holding uncompressed 16-bit dark frames at page-aligned
+// offsets. Only the header is read when the file is opened. A frame is read
+// when it is used, through a mapping of just that frame, so the library can
+// be larger than the address space.
+
+class DarkLibraryFile
+{
+    wxString m_filename;
+    wxSize m_size;
+    wxString m_note;
+    std::map<int, wxUint64> m_offsets; // exposure => file offset of the frame
+
+public:
+    bool Open(const wxString& filename); // returns true on error
+    void Close();
+
+    bool IsOpen() const { return !m_filename.IsEmpty(); }
+    const wxString& FileName() const { return m_filename; }
+    const wxSize& FrameSize() const { return m_size; }
+    const wxString& Note() const { return m_note; }
+    void GetExposures(std::vector<int> *exposures) const;
+    bool ReadFrame(int exposure, unsigned short *dst) const; // returns true on error
+
+    static bool Save(const wxString& filename, const std::vector<int>& exposures, const wxSize& size,
+                     DarkFrameSource& frames, const wxString& note); // returns true on error
+};
+
+// DarkFrameSource reading the frames of a library file
+class DarkLibraryReader : public DarkFrameSource
+{
+    const DarkLibraryFile& m_lib;
+    std::vector<unsigned short> m_buf;
+
+public:
+    DarkLibraryReader(const DarkLibraryFile& lib) : m_lib(lib) { }
+    const unsigned short *Frame(int exposure);
+};
+
+#endif
@@ -0,0 +1,214 @@
+/*
+ *  dark_model.cpp
+ *  PHD Guiding
+ *
+ *  Created by the PHD2 developers
+ *  Copyright (c) 2014 PHD2 Developers
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of Craig Stark, Stark Labs nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "phd.h"
+
+// synthesized darks kept around so that switching back and forth between
+// a few exposure durations does not recompute the frame each time
+static const unsigned int MaxCachedDarks = 2;
+
+DarkModel::DarkModel()
+{
+}
+
+DarkModel::~DarkModel()
+{
+    Clear();
+}
+
+void DarkModel::ClearCache()
+{
+    while (!m_cache.empty())
+    {
+        delete m_cache.front();
+        m_cache.pop_front();
+    }
+}
+
+void DarkModel::Clear()
+{
+    ClearCache();
+    m_bias.clear();
+    m_rate.clear();
+    m_size = wxSize();
+}
+
+bool DarkModel::Fit(const std::vector<int>& exposures, const wxSize& size, DarkFrameSource& frames, wxThread *thread)
+{
+    Clear();
+
+    // ordinary least squares per pixel, v = bias + rate * t, accumulated one
+    // dark at a time so we never need more than the two model planes and
+    // one dark frame
+
+    double sumT = 0.0;
+    unsigned int n = 0;
+
+    for (std::vector<int>::const_iterator it = exposures.begin(); it != exposures.end(); ++it)
+    {
+        if (*it <= 0)
+            continue;
+        sumT += *it;
+        ++n;
+    }
+
+    if (n < 2)
+    {
+        Debug.AddLine("DarkModel: need at least two dark exposures, have %u", n);
+        return true;
+    }
+
+    double const meanT = sumT / n;
+    double sTT = 0.0;
+    for (std::vector<int>::const_iterator it = exposures.begin(); it != exposures.end(); ++it)
+    {
+        if (*it <= 0)
+            continue;
+        double const dt = *it - meanT;
+        sTT += dt * dt;
+    }
+
+    unsigned int const npix = size.GetWidth() * size.GetHeight();
+    m_bias.assign(npix, 0.f);
+    m_rate.assign(npix, 0.f);
+
+    float *const bias = &m_bias[0];
+    float *const rate = &m_rate[0];
+    float const wMean = (float)(1.0 / n);
+
+    for (std::vector<int>::const_iterator it = exposures.begin(); it != exposures.end(); ++it)
+    {
+        if (*it <= 0)
+            continue;
+
+        if (thread && thread->TestDestroy())
+        {
+            Clear();
+            return true;
+        }
+
+        const unsigned short *const src = frames.Frame(*it);
+        if (!src)
+        {
+            Debug.AddLine("DarkModel: cannot read dark for exposure %d", *it);
+            Clear();
+            return true;
+        }
+
+        float const wRate = (float)((*it - meanT) / sTT);
+
+        for (unsigned int i = 0; i < npix; i++)
+        {
+            float const v = (float) src[i];
+            bias[i] += wMean * v;
+            rate[i] += wRate * v;
+        }
+    }
+
+    // bias = mean(v) - rate * mean(t)
+    float const t0 = (float) meanT;
+    for (unsigned int i = 0; i < npix; i++)
+        bias[i] -= rate[i] * t0;
+
+    m_size = size;
+
+    Debug.AddLine(wxString::Format("DarkModel: fitted %u darks, %d x %d, exposures %d .. %d ms",
+        n, size.GetWidth(), size.GetHeight(), exposures.front(), exposures.back()));
+
+    return false;
+}
+
+const usImage *DarkModel::Cached(int exposureDuration)
+{
+    for (std::list<usImage *>::iterator it = m_cache.begin(); it != m_cache.end(); ++it)
+    {
+        if ((*it)->ImgExpDur == exposureDuration)
+        {
+            usImage *img = *it;
+            if (it != m_cache.begin())
+            {
+                m_cache.erase(it);
+                m_cache.push_front(img);
+            }
+            return img;
+        }
+    }
+
+    return NULL;
+}
+
+usImage *DarkModel::Synthesize(int exposureDuration) const
+{
+    if (!IsValid())
+        return NULL;
+
+    usImage *img = new usImage();
+    if (img->Init(m_size))
+    {
+        delete img;
+        return NULL;
+    }
+
+    // straight-line loop over the float planes so the compiler can vectorize it
+    unsigned int const npix = m_bias.size();
+    const float *const bias = &m_bias[0];
+    const float *const rate = &m_rate[0];
+    unsigned short *const dst = img->ImageData;
+    float const t = (float) exposureDuration;
+
+    for (unsigned int i = 0; i < npix; i++)
+    {
+        float v = bias[i] + rate[i] * t + 0.5f;
+        v = v < 0.f ? 0.f : v;
+        v = v > 65535.f ? 65535.f : v;
+        dst[i] = (unsigned short) v;
+    }
+
+    img->ImgExpDur = exposureDuration;
+    img->CalcStats();
+
+    Debug.AddLine("DarkModel: synthesized dark for exposure %d ms", exposureDuration);
+
+    return img;
+}
+
+void DarkModel::AddToCache(usImage *img)
+{
+    m_cache.push_front(img);
+    while (m_cache.size() > MaxCachedDarks)
+    {
+        delete m_cache.back();
+        m_cache.pop_back();
+    }
+}
@@ -0,0 +1,69 @@
+/*
+ *  dark_model.h
+ *  PHD Guiding
+ *
+ *  Created by the PHD2 developers
+ *  Copyright (c) 2014 PHD2 Developers
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of Craig Stark, Stark Labs nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef DARK_MODEL_INCLUDED
+#define DARK_MODEL_INCLUDED
+
+// Per-pixel linear dark model (bias + dark current rate) fitted from the
+// dark library, used to synthesize a dark frame for exposures that are not
+// in the library. The model is fitted in a background thread; once fitted it
+// is only used by the main thread.
+
+class DarkFrameSource;
+
+class DarkModel
+{
+    wxSize m_size;
+    std::vector<float> m_bias;  // ADU at zero exposure
+    std::vector<float> m_rate;  // ADU per millisecond of exposure
+    std::list<usImage *> m_cache; // synthesized darks, most recently used first
+
+    DarkModel(const DarkModel&);
+    DarkModel& operator=(const DarkModel&);
+
+    void ClearCache();
+
+public:
+    DarkModel();
+    ~DarkModel();
+
+    bool Fit(const std::vector<int>& exposures, const wxSize& size, DarkFrameSource& frames, wxThread *thread = 0); // returns true on error or if the thread is being deleted
+    void Clear();
+    bool IsValid() const { return !m_bias.empty(); }
+    const usImage *Cached(int exposureDuration);
+    usImage *Synthesize(int exposureDuration) const; // caller owns the new image until it is passed to AddToCache
+    void AddToCache(usImage *img);
+};
+
+#endif
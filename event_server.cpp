@@ -36,7 +36,6 @@
 
 #include <wx/sstream.h>
 #include <wx/sckstrm.h>
-#include <sstream>
 
 EventServer EvtServer;
 
@@ -50,11 +49,14 @@ enum
     MSG_PROTOCOL_VERSION = 1,
 };
 
-static const wxString literal_null("null");
-static const wxString literal_true("true");
-static const wxString literal_false("false");
+// largest single request line accepted from a client
+static const int DefaultMaxRequestSize = 64 * 1024;
 
-static wxString state_name(EXPOSED_STATE st)
+// lowest non-zero subscription max_rate, in events per second; the minimum
+// interval between events, in milliseconds, must fit in an unsigned int
+static const double MinEventRate = 1.0 / (24. * 3600.);
+
+static const char *state_name(EXPOSED_STATE st)
 {
     switch (st)
     {
@@ -69,175 +71,126 @@ static wxString state_name(EXPOSED_STATE st)
     }
 }
 
-static wxString json_escape(const wxString& s)
-{
-    wxString t(s);
-    static const wxString BACKSLASH("\\");
-    static const wxString BACKSLASHBACKSLASH("\\\\");
-    static const wxString DQUOT("\"");
-    static const wxString BACKSLASHDQUOT("\\\"");
-    t.Replace(BACKSLASH, BACKSLASHBACKSLASH);
-    t.Replace(DQUOT, BACKSLASHDQUOT);
-    return t;
-}
+static NULL_TYPE NULL_VALUE;
 
-template<char LDELIM, char RDELIM>
-struct JSeq
-{
-    wxString m_s;
-    bool m_first;
-    bool m_closed;
-    JSeq() : m_first(true), m_closed(false) { m_s << LDELIM; }
-    void close() { m_s << RDELIM; m_closed = true; }
-    wxString str() { if (!m_closed) close(); return m_s; }
-};
-
-typedef JSeq<'[', ']'> JAry;
-typedef JSeq<'{', '}'> JObj;
-
-static JAry& operator<<(JAry& a, const wxString& str)
+static NV NVMount(const Mount *mount)
 {
-    if (a.m_first)
-        a.m_first = false;
-    else
-        a.m_s << ',';
-    a.m_s << json_escape(str);
-    return a;
+    return NV("Mount", mount->Name());
 }
 
-static JAry& operator<<(JAry& a, double d)
+static JObj& operator<<(JObj& j, const PHD_Point& pt)
 {
-    return a << wxString::Format("%.2f", d);
+    return j << NV("X", pt.X, 3) << NV("Y", pt.Y, 3);
 }
 
-static JAry& operator<<(JAry& a, int i)
+static JAry& operator<<(JAry& a, const JObj& j)
 {
-    return a << wxString::Format("%d", i);
+    a.sep();
+    a.m_s.append(j.buf());
+    return a;
 }
 
-static wxString json_format(const json_value *j)
-{
-    if (!j)
-        return literal_null;
+// the host name does not change while we are running, and looking it up
+// for every event is a system call
+static const wxString& host_name()
+{
+    static wxString s_host;
+    if (s_host.IsEmpty())
+        s_host = wxGetHostName();
+    return s_host;
+}
+
+enum EventType
+{
+    EV_VERSION,
+    EV_LOCK_POSITION_SET,
+    EV_CALIBRATION_COMPLETE,
+    EV_STAR_SELECTED,
+    EV_START_GUIDING,
+    EV_PAUSED,
+    EV_START_CALIBRATION,
+    EV_APP_STATE,
+    EV_SETTLING,
+    EV_SETTLE_DONE,
+    EV_CALIBRATION_FAILED,
+    EV_CALIBRATION_DATA_FLIPPED,
+    EV_LOOPING_EXPOSURES,
+    EV_LOOPING_EXPOSURES_STOPPED,
+    EV_STAR_LOST,
+    EV_GUIDING_STOPPED,
+    EV_RESUMED,
+    EV_GUIDE_STEP,
+    EV_GUIDING_DITHERED,
+    EV_LOCK_POSITION_LOST,
+    EV_ALERT,
+
+    EV_COUNT
+};
 
-    switch (j->type) {
-    default:
-    case JSON_NULL: return literal_null;
-    case JSON_OBJECT: {
-        wxString ret("{");
-        bool first = true;
-        json_for_each (jj, j)
-        {
-            if (first)
-                first = false;
-            else
-                ret << ",";
-            ret << '"' << jj->name << "\":" << json_format(jj);
-        }
-        ret << "}";
-        return ret;
-    }
-    case JSON_ARRAY: {
-        wxString ret("[");
-        bool first = true;
-        json_for_each (jj, j)
-        {
-            if (first)
-                first = false;
-            else
-                ret << ",";
-            ret << json_format(jj);
-        }
-        ret << "]";
-        return ret;
-    }
-    case JSON_STRING: return '"' + json_escape(j->string_value) + '"';
-    case JSON_INT:    return wxString::Format("%d", j->int_value);
-    case JSON_FLOAT:  return wxString::Format("%g", (double) j->float_value);
-    case JSON_BOOL:   return j->int_value ? literal_true : literal_false;
-    }
-}
-
-struct NULL_TYPE { } NULL_VALUE;
-
-// name-value pair
-struct NV
-{
-    wxString n;
-    wxString v;
-    NV(const wxString& n_, const wxString& v_) : n(n_), v('"' + json_escape(v_) + '"') { }
-    NV(const wxString& n_, const char *v_) : n(n_), v('"' + json_escape(v_) + '"') { }
-    NV(const wxString& n_, const wchar_t *v_) : n(n_), v('"' + json_escape(v_) + '"') { }
-    NV(const wxString& n_, int v_) : n(n_), v(wxString::Format("%d", v_)) { }
-    NV(const wxString& n_, double v_) : n(n_), v(wxString::Format("%g", v_)) { }
-    NV(const wxString& n_, double v_, int prec) : n(n_), v(wxString::Format("%.*f", prec, v_)) { }
-    NV(const wxString& n_, bool v_) : n(n_), v(v_ ? literal_true : literal_false) { }
-    template<typename T>
-    NV(const wxString& n_, const std::vector<T>& vec);
-    NV(const wxString& n_, JAry& ary) : n(n_), v(ary.str()) { }
-    NV(const wxString& n_, JObj& obj) : n(n_), v(obj.str()) { }
-    NV(const wxString& n_, const json_value *v_) : n(n_), v(json_format(v_)) { }
-    NV(const wxString& n_, const PHD_Point& p) : n(n_) { JAry ary; ary << p.X << p.Y; v = ary.str(); }
-    NV(const wxString& n_, const wxPoint& p) : n(n_) { JAry ary; ary << p.x << p.y; v = ary.str(); }
-    NV(const wxString& n_, const NULL_TYPE& nul) : n(n_), v(literal_null) { }
+// indexed by EventType
+static const char *const event_names[] =
+{
+    "Version",
+    "LockPositionSet",
+    "CalibrationComplete",
+    "StarSelected",
+    "StartGuiding",
+    "Paused",
+    "StartCalibration",
+    "AppState",
+    "Settling",
+    "SettleDone",
+    "CalibrationFailed",
+    "CalibrationDataFlipped",
+    "LoopingExposures",
+    "LoopingExposuresStopped",
+    "StarLost",
+    "GuidingStopped",
+    "Resumed",
+    "GuideStep",
+    "GuidingDithered",
+    "LockPositionLost",
+    "Alert",
 };
 
-template<typename T>
-NV::NV(const wxString& n_, const std::vector<T>& vec)
-    : n(n_)
+wxCOMPILE_TIME_ASSERT(WXSIZEOF(event_names) == EV_COUNT, EventNamesSize);
+
+static bool event_type(const char *name, EventType *type)
 {
-    std::ostringstream os;
-    os << '[';
-    for (unsigned int i = 0; i < vec.size(); i++)
+    for (unsigned int i = 0; i < EV_COUNT; i++)
     {
-        if (i != 0)
-            os << ',';
-        os << vec[i];
+        if (strcmp(name, event_names[i]) == 0)
+        {
+            *type = (EventType) i;
+            return true;
+        }
     }
-    os << ']';
-    v = os.str();
-}
-
-static JObj& operator<<(JObj& j, const NV& nv)
-{
-    if (j.m_first)
-        j.m_first = false;
-    else
-        j.m_s << ',';
-    j.m_s << '"' << nv.n << "\":" << nv.v;
-    return j;
-}
-
-static NV NVMount(const Mount *mount)
-{
-    return NV("Mount", mount->Name());
-}
-
-static JObj& operator<<(JObj& j, const PHD_Point& pt)
-{
-    return j << NV("X", pt.X, 3) << NV("Y", pt.Y, 3);
+    return false;
 }
 
-static JAry& operator<<(JAry& a, JObj& j)
-{
-    return a << j.str();
-}
+// Events are built one at a time and sent before the next one is started,
+// so they all share one buffer, which stops growing after the first few
+// guide steps.
+static JBuf s_evbuf;
 
 struct Ev : public JObj
 {
-    Ev(const wxString& event)
+    EventType type;
+
+    Ev(EventType type_)
+        : JObj(s_evbuf), type(type_)
     {
         double const now = ::wxGetUTCTimeMillis().ToDouble() / 1000.0;
-        *this << NV("Event", event)
+        *this << NV("Event", event_names[type])
             << NV("Timestamp", now, 3)
-            << NV("Host", wxGetHostName())
+            << NV("Host", host_name())
             << NV("Inst", pFrame->GetInstanceNumber());
     }
 };
 
 static Ev ev_message_version()
 {
-    Ev ev("Version");
+    Ev ev(EV_VERSION);
     ev << NV("PHDVersion", PHDVERSION)
         << NV("PHDSubver", PHDSUBVER)
         << NV("MsgVersion", MSG_PROTOCOL_VERSION);
@@ -246,14 +199,14 @@ static Ev ev_message_version()
 
 static Ev ev_set_lock_position(const PHD_Point& xy)
 {
-    Ev ev("LockPositionSet");
+    Ev ev(EV_LOCK_POSITION_SET);
     ev << xy;
     return ev;
 }
 
 static Ev ev_calibration_complete(Mount *mount)
 {
-    Ev ev("CalibrationComplete");
+    Ev ev(EV_CALIBRATION_COMPLETE);
     ev << NVMount(mount);
 
     if (mount->IsStepGuider())
@@ -266,38 +219,38 @@ static Ev ev_calibration_complete(Mount *mount)
 
 static Ev ev_star_selected(const PHD_Point& pos)
 {
-    Ev ev("StarSelected");
+    Ev ev(EV_STAR_SELECTED);
     ev << pos;
     return ev;
 }
 
 static Ev ev_start_guiding()
 {
-    return Ev("StartGuiding");
+    return Ev(EV_START_GUIDING);
 }
 
 static Ev ev_paused()
 {
-    return Ev("Paused");
+    return Ev(EV_PAUSED);
 }
 
 static Ev ev_start_calibration(Mount *mount)
 {
-    Ev ev("StartCalibration");
+    Ev ev(EV_START_CALIBRATION);
     ev << NVMount(mount);
     return ev;
 }
 
 static Ev ev_app_state(EXPOSED_STATE st = Guider::GetExposedState())
 {
-    Ev ev("AppState");
+    Ev ev(EV_APP_STATE);
     ev << NV("State", state_name(st));
     return ev;
 }
 
 static Ev ev_settling(double distance, double time, double settleTime)
 {
-    Ev ev("Settling");
+    Ev ev(EV_SETTLING);
 
     ev << NV("Distance", distance, 2)
        << NV("Time", time, 1)
@@ -306,9 +259,9 @@ static Ev ev_settling(double distance, double time, double settleTime)
     return ev;
 }
 
-static Ev ev_settle_done(const wxString& errorMsg)
+static Ev ev_settle_done(const wxString& errorMsg, const SettleDoneInfo& info)
 {
-    Ev ev("SettleDone");
+    Ev ev(EV_SETTLE_DONE);
 
     int status = errorMsg.IsEmpty() ? 0 : 1;
 
@@ -319,50 +272,213 @@ static Ev ev_settle_done(const wxString& errorMsg)
         ev << NV("Error", errorMsg);
     }
 
+    if (info.frames > 0)
+    {
+        ev << NV("TotalFrames", info.frames)
+           << NV("DroppedFrames", info.droppedFrames)
+           << NV("SettleTime", info.settleTime, 1)
+           << NV("Distance", info.distance, 2)
+           << NV("Converged", info.converged);
+
+        if (info.haveFit)
+        {
+            ev << NV("FitDistance", info.fitDistance, 2)
+               << NV("FitBound", info.fitBound, 2)
+               << NV("DecayTime", info.decayTime, 1);
+        }
+    }
+
     return ev;
 }
 
-static void send_buf(wxSocketClient *client, const wxCharBuffer& buf)
+// Requests are newline-delimited. Input is accumulated until one or more
+// complete lines are available; any partial line is kept for the next read.
+struct ClientReadBuf
+{
+    enum { READ_SIZE = 4096 };
+
+    JBuf buf;          // received bytes not yet dispatched
+    size_t scanned;    // bytes at the start of buf known not to contain an end of line
+    bool discarding;   // skipping the remainder of an oversized request
+    bool busy;         // dispatching requests
+    bool closed;       // disconnected while dispatching; destroyed once dispatching returns
+
+    ClientReadBuf() : scanned(0), discarding(false), busy(false), closed(false) { }
+};
+
+struct ClientData
+{
+    // output that could not be written without blocking; it is sent when
+    // the socket becomes writable again
+    enum { MAX_PENDING = 1024 * 1024 };
+
+    ClientReadBuf rdbuf;
+    JBuf wrbuf;
+    unsigned int dropped;
+
+    // responses to this client's requests are built here; requests from one
+    // client are handled one at a time, so these are reused for every response
+    JBuf response;
+    JBuf batch;
+
+    // event subscription: a bit per EventType, plus an optional minimum
+    // interval between events of each type (0 = no limit)
+    unsigned int eventMask;
+    unsigned int minIntervalMs[EV_COUNT];
+    wxLongLong lastSent[EV_COUNT];
+
+    ClientData() : dropped(0) { SubscribeAll(); }
+
+    void SubscribeAll()
+    {
+        eventMask = (1U << EV_COUNT) - 1;
+        for (unsigned int i = 0; i < EV_COUNT; i++)
+            minIntervalMs[i] = 0;
+    }
+
+    bool Wants(EventType type, const wxLongLong& now) const
+    {
+        if ((eventMask & (1U << type)) == 0)
+            return false;
+        return minIntervalMs[type] == 0 || now - lastSent[type] >= (long) minIntervalMs[type];
+    }
+};
+
+inline static ClientData *client_data(wxSocketClient *cli)
+{
+    return (ClientData *) cli->GetClientData();
+}
+
+inline static ClientReadBuf *client_rdbuf(wxSocketClient *cli)
+{
+    return &client_data(cli)->rdbuf;
+}
+
+static void destroy_client(wxSocketClient *cli)
+{
+    ClientData *data = client_data(cli);
+    cli->Destroy();
+    delete data;
+}
+
+// A request handler that yields to the event loop can see its client
+// disconnect. The client is still in use then, so it is only marked closed,
+// and handle_cli_input destroys it when the handler returns.
+static void close_client(wxSocketClient *cli)
+{
+    ClientReadBuf *rdbuf = client_rdbuf(cli);
+    if (rdbuf->busy)
+        rdbuf->closed = true;
+    else
+        destroy_client(cli);
+}
+
+static void cli_write(wxSocketClient *cli, ClientData *data, const char *p, size_t len)
+{
+    if (data->wrbuf.len() == 0)
+    {
+        cli->Write(p, len);
+        size_t n = cli->Error() && cli->LastError() != wxSOCKET_WOULDBLOCK ? len : cli->LastCount();
+        p += n;
+        len -= n;
+    }
+
+    data->wrbuf.append(p, len);
+}
+
+static void send_buf(wxSocketClient *cli, const JBuf& buf)
+{
+    ClientData *data = client_data(cli);
+
+    // never send part of a message; a client that is not reading its socket
+    // loses whole messages instead
+    if (data->wrbuf.len() + buf.len() + 2 > ClientData::MAX_PENDING)
+    {
+        if (data->dropped++ == 0)
+            Debug.AddLine("evsrv: cli %p output buffer full, dropping messages", cli);
+        return;
+    }
+
+    if (data->dropped)
+    {
+        Debug.AddLine("evsrv: cli %p dropped %u messages", cli, data->dropped);
+        data->dropped = 0;
+    }
+
+    cli_write(cli, data, buf.data(), buf.len());
+    cli_write(cli, data, "\r\n", 2);
+}
+
+static void flush_output(wxSocketClient *cli)
 {
-    client->Write(buf.data(), buf.length());
-    client->Write("\r\n", 2);
+    ClientData *data = client_data(cli);
+
+    if (data->wrbuf.len() == 0)
+        return;
+
+    cli->Write(data->wrbuf.data(), data->wrbuf.len());
+    if (cli->Error() && cli->LastError() != wxSOCKET_WOULDBLOCK)
+        data->wrbuf.reset();
+    else
+        data->wrbuf.consume(cli->LastCount());
 }
 
 static void do_notify1(wxSocketClient *client, const JAry& ary)
 {
-    send_buf(client, JAry(ary).str().ToUTF8());
+    send_buf(client, ary.buf());
 }
 
 static void do_notify1(wxSocketClient *client, const JObj& j)
 {
-    send_buf(client, JObj(j).str().ToUTF8());
+    send_buf(client, j.buf());
 }
 
-static void do_notify(const EventServer::CliSockSet& cli, const JObj& jj)
+// true if at least one client will accept an event of the given type now;
+// callers check this before building the event so that events nobody
+// wants are never serialized
+static bool wanted(const EventServer::CliSockSet& cli, EventType type)
 {
-    wxCharBuffer buf = JObj(jj).str().ToUTF8();
+    if (cli.empty())
+        return false;
+
+    wxLongLong now = ::wxGetUTCTimeMillis();
 
     for (EventServer::CliSockSet::const_iterator it = cli.begin();
         it != cli.end(); ++it)
     {
-        send_buf(*it, buf);
+        if (client_data(*it)->Wants(type, now))
+            return true;
     }
-}
 
-inline static void simple_notify(const EventServer::CliSockSet& cli, const wxString& ev)
-{
-    if (!cli.empty())
-        do_notify(cli, Ev(ev));
+    return false;
 }
 
-inline static void simple_notify_ev(const EventServer::CliSockSet& cli, const Ev& ev)
+static void do_notify(const EventServer::CliSockSet& cli, const Ev& ev)
 {
-    if (!cli.empty())
-        do_notify(cli, ev);
+    const JBuf& buf = ev.buf();
+    wxLongLong now = ::wxGetUTCTimeMillis();
+
+    for (EventServer::CliSockSet::const_iterator it = cli.begin();
+        it != cli.end(); ++it)
+    {
+        ClientData *data = client_data(*it);
+        if (data->Wants(ev.type, now))
+        {
+            data->lastSent[ev.type] = now;
+            send_buf(*it, buf);
+        }
+    }
 }
 
-#define SIMPLE_NOTIFY(s) simple_notify(m_eventServerClients, s)
-#define SIMPLE_NOTIFY_EV(ev) simple_notify_ev(m_eventServerClients, ev)
+#define SIMPLE_NOTIFY(type) do { \
+    if (wanted(m_eventServerClients, type)) \
+        do_notify(m_eventServerClients, Ev(type)); \
+} while (false)
+
+#define SIMPLE_NOTIFY_EV(type, ev) do { \
+    if (wanted(m_eventServerClients, type)) \
+        do_notify(m_eventServerClients, ev); \
+} while (false)
 
 static void send_catchup_events(wxSocketClient *cli)
 {
@@ -403,53 +519,6 @@ static void send_catchup_events(wxSocketClient *cli)
     do_notify1(cli, ev_app_state());
 }
 
-struct ClientReadBuf
-{
-    enum { SIZE = 1024 };
-    char buf[SIZE];
-    char *dest;
-
-    ClientReadBuf() { reset(); }
-    size_t avail() const { return &buf[SIZE] - dest; }
-    void reset() { dest = &buf[0]; }
-};
-
-inline static ClientReadBuf *client_rdbuf(wxSocketClient *cli)
-{
-    return (ClientReadBuf *) cli->GetClientData();
-}
-
-static void destroy_client(wxSocketClient *cli)
-{
-    ClientReadBuf *buf = client_rdbuf(cli);
-    cli->Destroy();
-    delete buf;
-}
-
-static void drain_input(wxSocketInputStream& sis)
-{
-    while (sis.CanRead())
-    {
-        char buf[1024];
-        if (sis.Read(buf, sizeof(buf)).LastRead() == 0)
-            break;
-    }
-}
-
-static bool find_eol(char *p, size_t len)
-{
-    const char *end = p + len;
-    for (; p < end; p++)
-    {
-        if (*p == '\r' || *p == '\n')
-        {
-            *p = 0;
-            return true;
-        }
-    }
-    return false;
-}
-
 enum {
     JSONRPC_PARSE_ERROR = -32700,
     JSONRPC_INVALID_REQUEST = -32600,
@@ -458,11 +527,24 @@ enum {
     JSONRPC_INTERNAL_ERROR = -32603,
 };
 
-static NV jrpc_error(int code, const wxString& msg)
+struct JRpcError
 {
-    JObj err;
-    err << NV("code", code) << NV("message", msg);
-    return NV("error", err);
+    int code;
+    const wxString *msg;
+    JRpcError(int code_, const wxString& msg_) : code(code_), msg(&msg_) { }
+};
+
+static JRpcError jrpc_error(int code, const wxString& msg)
+{
+    return JRpcError(code, msg);
+}
+
+static JObj& operator<<(JObj& j, const JRpcError& e)
+{
+    JObj err(j, "error");
+    err << NV("code", e.code) << NV("message", *e.msg);
+    err.close();
+    return j;
 }
 
 template<typename T>
@@ -484,7 +566,7 @@ static NV jrpc_id(const json_value *id)
 
 struct JRpcResponse : public JObj
 {
-    JRpcResponse() { *this << NV("jsonrpc", "2.0"); }
+    explicit JRpcResponse(wxSocketClient *cli) : JObj(client_data(cli)->response) { *this << NV("jsonrpc", "2.0"); }
 };
 
 static wxString parser_error(const JsonParser& parser)
@@ -548,22 +630,20 @@ static void get_exposure_durations(JObj& response, const json_value *params)
 
 static void get_profiles(JObj& response, const json_value *params)
 {
-    JAry ary;
     wxArrayString names = pConfig->ProfileNames();
+    JAry ary(response, "result");
     for (unsigned int i = 0; i < names.size(); i++)
     {
         wxString name = names[i];
         int id = pConfig->GetProfileId(name);
         if (id)
         {
-            JObj t;
+            JObj t(ary);
             t << NV("id", id) << NV("name", name);
             if (id == pConfig->GetCurrentProfileId())
                 t << NV("selected", true);
-            ary << t;
         }
     }
-    response << jrpc_result(ary);
 }
 
 static void set_exposure(JObj& response, const json_value *params)
@@ -590,9 +670,8 @@ static void get_profile(JObj& response, const json_value *params)
 {
     int id = pConfig->GetCurrentProfileId();
     wxString name = pConfig->GetCurrentProfile();
-    JObj t;
+    JObj t(response, "result");
     t << NV("id", id) << NV("name", name);
-    response << jrpc_result(t);
 }
 
 static bool all_equipment_connected()
@@ -926,7 +1005,7 @@ static void set_lock_shift_enabled(JObj& response, const json_value *params)
 static void get_lock_shift_params(JObj& response, const json_value *params)
 {
     const LockPosShiftParams& lockShift = pFrame->pGuider->GetLockPosShiftParams();
-    JObj rslt;
+    JObj rslt(response, "result");
     rslt << NV("enabled", lockShift.shiftEnabled);
     if (lockShift.shiftRate.IsValid())
     {
@@ -934,7 +1013,6 @@ static void get_lock_shift_params(JObj& response, const json_value *params)
              << NV("units", lockShift.shiftUnits == UNIT_ARCSEC ? "arcsec/hr" : "pixels/hr")
              << NV("axes", lockShift.shiftIsMountCoords ? "RA/Dec" : "X/Y");
     }
-    response << jrpc_result(rslt);
 }
 
 static bool get_double(double *d, const json_value *j)
@@ -1080,15 +1158,16 @@ static void save_image(JObj& response, const json_value *params)
         return;
     }
 
-    JObj rslt;
+    JObj rslt(response, "result");
     rslt << NV("filename", fname);
-    response << jrpc_result(rslt);
 }
 
 static bool parse_settle(SettleParams *settle, const json_value *j, wxString *error)
 {
     bool found_pixels = false, found_time = false, found_timeout = false;
 
+    settle->fast = false;
+
     json_for_each (t, j)
     {
         if (float_param("pixels", t, &settle->tolerancePx))
@@ -1109,6 +1188,11 @@ static bool parse_settle(SettleParams *settle, const json_value *j, wxString *er
             found_timeout = true;
             continue;
         }
+        if (strcmp(t->name, "fast") == 0 && t->type == JSON_BOOL)
+        {
+            settle->fast = t->int_value ? true : false;
+            continue;
+        }
     }
 
     bool ok = found_pixels && found_time && found_timeout;
@@ -1127,6 +1211,7 @@ static void guide(JObj& response, const json_value *params)
     //     frames [integer]
     //     time [integer]
     //     timeout [integer]
+    //     fast [bool] - optional, also settle once the error trend has converged
     //   recalibrate: boolean
     //
     // {"method": "guide", "params": [{"pixels": 0.5, "time": 6, "timeout": 30}, false], "id": 42}
@@ -1175,6 +1260,7 @@ static void dither(JObj& response, const json_value *params)
     //     frames [integer]
     //     time [integer]
     //     timeout [integer]
+    //     fast [bool] - optional, also settle once the error trend has converged
     //
     // {"method": "dither", "params": [10, false, {"pixels": 1.5, "time": 8, "timeout": 30}], "id": 42}
 
@@ -1215,6 +1301,98 @@ static void dither(JObj& response, const json_value *params)
         response << jrpc_error(1, error);
 }
 
+// {"method": "subscribe", "params": [{"events": ["AppState", "GuideStep"], "max_rate": {"GuideStep": 1}}], "id": 1}
+//
+// events: event names to receive; when omitted the client receives all events
+// max_rate: optional maximum rate in events per second for each named event type;
+//   0 means no limit, otherwise the rate must be at least one event per day
+//
+// The catch-up events sent on connection describe the current state and go
+// out before the client can subscribe, so they are never filtered.
+static void subscribe(wxSocketClient *cli, JObj& response, const json_value *params)
+{
+    const json_value *p0;
+    if (!params || (p0 = at(params, 0)) == 0 || p0->type != JSON_OBJECT)
+    {
+        response << jrpc_error(JSONRPC_INVALID_PARAMS, "expected subscription object param");
+        return;
+    }
+
+    unsigned int mask = (1U << EV_COUNT) - 1;
+    unsigned int minIntervalMs[EV_COUNT] = { 0 };
+
+    json_for_each (j, p0)
+    {
+        if (strcmp(j->name, "events") == 0)
+        {
+            if (j->type != JSON_ARRAY)
+            {
+                response << jrpc_error(JSONRPC_INVALID_PARAMS, "expected events array");
+                return;
+            }
+            mask = 0;
+            json_for_each (e, j)
+            {
+                EventType type;
+                if (!event_type(string_val(e), &type))
+                {
+                    response << jrpc_error(JSONRPC_INVALID_PARAMS, wxString::Format("unknown event %s", string_val(e)));
+                    return;
+                }
+                mask |= 1U << type;
+            }
+        }
+        else if (strcmp(j->name, "max_rate") == 0)
+        {
+            if (j->type != JSON_OBJECT)
+            {
+                response << jrpc_error(JSONRPC_INVALID_PARAMS, "expected max_rate object");
+                return;
+            }
+            json_for_each (r, j)
+            {
+                EventType type;
+                double rate;
+                if (!event_type(r->name, &type))
+                {
+                    response << jrpc_error(JSONRPC_INVALID_PARAMS, wxString::Format("unknown event %s", r->name));
+                    return;
+                }
+                if (!float_param(r, &rate) || rate < 0.0)
+                {
+                    response << jrpc_error(JSONRPC_INVALID_PARAMS, "expected non-negative max_rate value");
+                    return;
+                }
+                if (rate > 0.0 && rate < MinEventRate)
+                {
+                    response << jrpc_error(JSONRPC_INVALID_PARAMS, "max_rate value must be 0 or at least one event per day");
+                    return;
+                }
+                minIntervalMs[type] = rate > 0.0 ? (unsigned int) ceil(1000.0 / rate) : 0;
+            }
+        }
+        else
+        {
+            response << jrpc_error(JSONRPC_INVALID_PARAMS, "unknown subscription attribute name");
+            return;
+        }
+    }
+
+    ClientData *data = client_data(cli);
+    data->eventMask = mask;
+
+    for (unsigned int i = 0; i < EV_COUNT; i++)
+        data->minIntervalMs[i] = minIntervalMs[i];
+
+    JObj rslt(response, "result");
+    JAry events(rslt, "events");
+    for (unsigned int i = 0; i < EV_COUNT; i++)
+    {
+        if (mask & (1U << i))
+            events << event_names[i];
+    }
+}
+
 static void dump_request(const wxSocketClient *cli, const json_value *req)
 {
     Debug.AddLine(wxString::Format("evsrv: cli %p request: %s", cli, json_format(req)));
@@ -1222,10 +1400,10 @@ static void dump_request(const wxSocketClient *cli, const json_value *req)
 
 static void dump_response(const wxSocketClient *cli, const JRpcResponse& resp)
 {
-    Debug.AddLine(wxString::Format("evsrv: cli %p response: %s", cli, const_cast<JRpcResponse&>(resp).str()));
+    Debug.AddLine(wxString::Format("evsrv: cli %p response: %s", cli, resp.str()));
 }
 
-static bool handle_request(const wxSocketClient *cli, JObj& response, const json_value *req)
+static bool handle_request(wxSocketClient *cli, JObj& response, const json_value *req)
 {
     const json_value *method;
     const json_value *params;
@@ -1275,6 +1453,14 @@ static bool handle_request(const wxSocketClient *cli, JObj& response, const json
         { "save_image", &save_image, },
     };
 
+    // methods that act on the requesting client's connection
+    static struct {
+        const char *name;
+        void (*fn)(wxSocketClient *cli, JObj& response, const json_value *params);
+    } cli_methods[] = {
+        { "subscribe", &subscribe, },
+    };
+
     for (unsigned int i = 0; i < WXSIZEOF(methods); i++)
     {
         if (strcmp(method->string_value, methods[i].name) == 0)
@@ -1292,6 +1478,23 @@ static bool handle_request(const wxSocketClient *cli, JObj& response, const json
         }
     }
 
+    for (unsigned int i = 0; i < WXSIZEOF(cli_methods); i++)
+    {
+        if (strcmp(method->string_value, cli_methods[i].name) == 0)
+        {
+            (*cli_methods[i].fn)(cli, response, params);
+            if (id)
+            {
+                response << jrpc_id(id);
+                return true;
+            }
+            else
+            {
+                return false;
+            }
+        }
+    }
+
     if (id)
     {
         response << jrpc_error(JSONRPC_METHOD_NOT_FOUND, "method not found") << jrpc_id(id);
@@ -1307,7 +1510,7 @@ static void handle_cli_input_complete(wxSocketClient *cli, char *input, JsonPars
 {
     if (!parser.Parse(input))
     {
-        JRpcResponse response;
+        JRpcResponse response(cli);
         response << jrpc_error(JSONRPC_PARSE_ERROR, parser_error(parser)) << jrpc_id(0);
         dump_response(cli, response);
         do_notify1(cli, response);
@@ -1320,12 +1523,15 @@ static void handle_cli_input_complete(wxSocketClient *cli, char *input, JsonPars
     {
         // a batch request
 
-        JAry ary;
+        JAry ary(client_data(cli)->batch);
 
         bool found = false;
         json_for_each (req, root)
         {
-            JRpcResponse response;
+            if (client_rdbuf(cli)->closed)
+                return;
+
+            JRpcResponse response(cli);
             if (handle_request(cli, response, req))
             {
                 dump_response(cli, response);
@@ -1342,7 +1548,7 @@ static void handle_cli_input_complete(wxSocketClient *cli, char *input, JsonPars
         // a single request
 
         const json_value *const req = root;
-        JRpcResponse response;
+        JRpcResponse response(cli);
         if (handle_request(cli, response, req))
         {
             dump_response(cli, response);
@@ -1351,44 +1557,105 @@ static void handle_cli_input_complete(wxSocketClient *cli, char *input, JsonPars
     }
 }
 
-static void handle_cli_input(wxSocketClient *cli, JsonParser& parser)
+static void send_too_big(wxSocketClient *cli)
 {
-    ClientReadBuf *rdbuf = client_rdbuf(cli);
+    JRpcResponse response(cli);
+    response << jrpc_error(JSONRPC_INTERNAL_ERROR, "too big") << jrpc_id(0);
+    do_notify1(cli, response);
+}
 
-    wxSocketInputStream sis(*cli);
-    size_t avail = rdbuf->avail();
+// dispatch each complete line in the read buffer, in order
+static void dispatch_lines(wxSocketClient *cli, ClientReadBuf *rdbuf, JsonParser& parser, size_t maxRequestSize)
+{
+    char *p = rdbuf->buf.data();
+    size_t const len = rdbuf->buf.len();
+    size_t begin = 0;
 
-    while (sis.CanRead())
+    for (size_t pos = rdbuf->scanned; pos < len; pos++)
     {
-        if (avail == 0)
+        if (p[pos] != '\r' && p[pos] != '\n')
+            continue;
+
+        if (rdbuf->discarding)
         {
-            drain_input(sis);
+            rdbuf->discarding = false;
+        }
+        else if (pos > begin)
+        {
+            char *line = p + begin;
+            size_t linelen = pos - begin;
 
-            JRpcResponse response;
-            response << jrpc_error(JSONRPC_INTERNAL_ERROR, "too big") << jrpc_id(0);
-            do_notify1(cli, response);
+            if (linelen > maxRequestSize)
+                send_too_big(cli);
+            else if (memchr(line, 0, linelen))
+            {
+                JRpcResponse response(cli);
+                response << jrpc_error(JSONRPC_PARSE_ERROR, "invalid JSON request: embedded NUL character") << jrpc_id(0);
+                do_notify1(cli, response);
+            }
+            else
+            {
+                line[linelen] = 0;
+                handle_cli_input_complete(cli, line, parser);
 
-            rdbuf->reset();
-            break;
+                // the client went away while a handler was yielding
+                if (rdbuf->closed)
+                    return;
+            }
         }
-        size_t n = sis.Read(rdbuf->dest, avail).LastRead();
-        if (n == 0)
-            break;
 
-        if (find_eol(rdbuf->dest, n))
+        begin = pos + 1;
+    }
+
+    rdbuf->buf.consume(begin);
+    rdbuf->scanned = rdbuf->buf.len();
+
+    if (rdbuf->discarding || rdbuf->scanned > maxRequestSize)
+    {
+        // the request is already too big; drop what we have and skip the
+        // rest of it up to the next end of line
+        if (!rdbuf->discarding)
         {
-            drain_input(sis);
-            handle_cli_input_complete(cli, &rdbuf->buf[0], parser);
-            rdbuf->reset();
-            break;
+            send_too_big(cli);
+            rdbuf->discarding = true;
         }
+        rdbuf->buf.reset();
+        rdbuf->scanned = 0;
+    }
+}
+
+static void handle_cli_input(wxSocketClient *cli, JsonParser& parser, size_t maxRequestSize)
+{
+    ClientReadBuf *rdbuf = client_rdbuf(cli);
+
+    // a request handler that yields to the event loop can bring us back here
+    // for the same client; the outer invocation will pick up the new input
+    if (rdbuf->busy)
+        return;
+
+    rdbuf->busy = true;
+
+    wxSocketInputStream sis(*cli);
 
-        rdbuf->dest += n;
-        avail -= n;
+    while (!rdbuf->closed && sis.CanRead())
+    {
+        char *dest = rdbuf->buf.reserve(ClientReadBuf::READ_SIZE);
+        size_t n = sis.Read(dest, ClientReadBuf::READ_SIZE).LastRead();
+        if (n == 0)
+            break;
+        rdbuf->buf.extend(n);
+
+        dispatch_lines(cli, rdbuf, parser, maxRequestSize);
     }
+
+    rdbuf->busy = false;
+
+    if (rdbuf->closed)
+        destroy_client(cli);
 }
 
 EventServer::EventServer()
+    : m_maxRequestSize(DefaultMaxRequestSize)
 {
 }
 
@@ -1417,6 +1684,9 @@ bool EventServer::EventServerStart(unsigned int instanceId)
         return true;
     }
 
+    int maxRequestSize = pConfig->Global.GetInt("/EventServer/MaxRequestSize", DefaultMaxRequestSize);
+    m_maxRequestSize = maxRequestSize < 1024 ? 1024 : (size_t) maxRequestSize;
+
     m_serverSocket->SetEventHandler(*this, EVENT_SERVER_ID);
     m_serverSocket->SetNotify(wxSOCKET_CONNECTION_FLAG);
     m_serverSocket->Notify(true);
@@ -1434,7 +1704,7 @@ void EventServer::EventServerStop()
     for (CliSockSet::const_iterator it = m_eventServerClients.begin();
          it != m_eventServerClients.end(); ++it)
     {
-        destroy_client(*it);
+        close_client(*it);
     }
     m_eventServerClients.clear();
 
@@ -1459,10 +1729,10 @@ void EventServer::OnEventServerEvent(wxSocketEvent& event)
     Debug.AddLine("evsrv: cli %p connect", client);
 
     client->SetEventHandler(*this, EVENT_SERVER_CLIENT_ID);
-    client->SetNotify(wxSOCKET_LOST_FLAG | wxSOCKET_INPUT_FLAG);
+    client->SetNotify(wxSOCKET_LOST_FLAG | wxSOCKET_INPUT_FLAG | wxSOCKET_OUTPUT_FLAG);
     client->SetFlags(wxSOCKET_NOWAIT);
     client->Notify(true);
-    client->SetClientData(new ClientReadBuf());
+    client->SetClientData(new ClientData());
 
     send_catchup_events(client);
 
@@ -1481,11 +1751,15 @@ void EventServer::OnEventServerClientEvent(wxSocketEvent& event)
         if (n != 1)
             Debug.AddLine("client disconnected but not present in client set!");
 
-        destroy_client(cli);
+        close_client(cli);
     }
     else if (event.GetSocketEvent() == wxSOCKET_INPUT)
     {
-        handle_cli_input(cli, m_parser);
+        handle_cli_input(cli, m_parser, m_maxRequestSize);
+    }
+    else if (event.GetSocketEvent() == wxSOCKET_OUTPUT)
+    {
+        flush_output(cli);
     }
     else
     {
@@ -1495,15 +1769,15 @@ void EventServer::OnEventServerClientEvent(wxSocketEvent& event)
 
 void EventServer::NotifyStartCalibration(Mount *mount)
 {
-    SIMPLE_NOTIFY_EV(ev_start_calibration(mount));
+    SIMPLE_NOTIFY_EV(EV_START_CALIBRATION, ev_start_calibration(mount));
 }
 
 void EventServer::NotifyCalibrationFailed(Mount *mount, const wxString& msg)
 {
-    if (m_eventServerClients.empty())
+    if (!wanted(m_eventServerClients, EV_CALIBRATION_FAILED))
         return;
 
-    Ev ev("CalibrationFailed");
+    Ev ev(EV_CALIBRATION_FAILED);
     ev << NVMount(mount) << NV("Reason", msg);
 
     do_notify(m_eventServerClients, ev);
@@ -1511,7 +1785,7 @@ void EventServer::NotifyCalibrationFailed(Mount *mount, const wxString& msg)
 
 void EventServer::NotifyCalibrationComplete(Mount *mount)
 {
-    if (m_eventServerClients.empty())
+    if (!wanted(m_eventServerClients, EV_CALIBRATION_COMPLETE))
         return;
 
     do_notify(m_eventServerClients, ev_calibration_complete(mount));
@@ -1519,10 +1793,10 @@ void EventServer::NotifyCalibrationComplete(Mount *mount)
 
 void EventServer::NotifyCalibrationDataFlipped(Mount *mount)
 {
-    if (m_eventServerClients.empty())
+    if (!wanted(m_eventServerClients, EV_CALIBRATION_DATA_FLIPPED))
         return;
 
-    Ev ev("CalibrationDataFlipped");
+    Ev ev(EV_CALIBRATION_DATA_FLIPPED);
     ev << NVMount(mount);
 
     do_notify(m_eventServerClients, ev);
@@ -1530,10 +1804,10 @@ void EventServer::NotifyCalibrationDataFlipped(Mount *mount)
 
 void EventServer::NotifyLooping(unsigned int exposure)
 {
-    if (m_eventServerClients.empty())
+    if (!wanted(m_eventServerClients, EV_LOOPING_EXPOSURES))
         return;
 
-    Ev ev("LoopingExposures");
+    Ev ev(EV_LOOPING_EXPOSURES);
     ev << NV("Frame", (int) exposure);
 
     do_notify(m_eventServerClients, ev);
@@ -1541,20 +1815,20 @@ void EventServer::NotifyLooping(unsigned int exposure)
 
 void EventServer::NotifyLoopingStopped()
 {
-    SIMPLE_NOTIFY("LoopingExposuresStopped");
+    SIMPLE_NOTIFY(EV_LOOPING_EXPOSURES_STOPPED);
 }
 
 void EventServer::NotifyStarSelected(const PHD_Point& pt)
 {
-    SIMPLE_NOTIFY_EV(ev_star_selected(pt));
+    SIMPLE_NOTIFY_EV(EV_STAR_SELECTED, ev_star_selected(pt));
 }
 
 void EventServer::NotifyStarLost(const FrameDroppedInfo& info)
 {
-    if (m_eventServerClients.empty())
+    if (!wanted(m_eventServerClients, EV_STAR_LOST))
         return;
 
-    Ev ev("StarLost");
+    Ev ev(EV_STAR_LOST);
 
     ev << NV("Frame", info.frameNumber)
        << NV("Time", info.time, 3)
@@ -1573,30 +1847,30 @@ void EventServer::NotifyStarLost(const FrameDroppedInfo& info)
 
 void EventServer::NotifyStartGuiding()
 {
-    SIMPLE_NOTIFY_EV(ev_start_guiding());
+    SIMPLE_NOTIFY_EV(EV_START_GUIDING, ev_start_guiding());
 }
 
 void EventServer::NotifyGuidingStopped()
 {
-    SIMPLE_NOTIFY("GuidingStopped");
+    SIMPLE_NOTIFY(EV_GUIDING_STOPPED);
 }
 
 void EventServer::NotifyPaused()
 {
-    SIMPLE_NOTIFY_EV(ev_paused());
+    SIMPLE_NOTIFY_EV(EV_PAUSED, ev_paused());
 }
 
 void EventServer::NotifyResumed()
 {
-    SIMPLE_NOTIFY("Resumed");
+    SIMPLE_NOTIFY(EV_RESUMED);
 }
 
 void EventServer::NotifyGuideStep(const GuideStepInfo& step)
 {
-    if (m_eventServerClients.empty())
+    if (!wanted(m_eventServerClients, EV_GUIDE_STEP))
         return;
 
-    Ev ev("GuideStep");
+    Ev ev(EV_GUIDE_STEP);
 
     ev << NV("Frame", step.frameNumber)
        << NV("Time", step.time, 3)
@@ -1629,6 +1903,23 @@ void EventServer::NotifyGuideStep(const GuideStepInfo& step)
        << NV("SNR", step.starSNR, 2)
        << NV("AvgDist", step.avgDist, 2);
 
+    if (step.starHFD > 0.0)
+        ev << NV("HFD", step.starHFD, 2);
+
+    if (step.starFWHM > 0.0)
+        ev << NV("FWHM", step.starFWHM, 2);
+
+    const StarMetrics& metrics = *step.starMetrics;
+    if (metrics.Valid)
+    {
+        ev << NV("Background", metrics.Background, 1)
+           << NV("Noise", metrics.Noise, 1)
+           << NV("PeakADU", (int) metrics.Peak)
+           << NV("Eccentricity", metrics.Eccentricity, 3);
+        if (metrics.Saturated)
+            ev << NV("Saturated", true);
+    }
+
     if (step.starError)
        ev << NV("ErrorCode", step.starError);
 
@@ -1643,10 +1934,10 @@ void EventServer::NotifyGuideStep(const GuideStepInfo& step)
 
 void EventServer::NotifyGuidingDithered(double dx, double dy)
 {
-    if (m_eventServerClients.empty())
+    if (!wanted(m_eventServerClients, EV_GUIDING_DITHERED))
         return;
 
-    Ev ev("GuidingDithered");
+    Ev ev(EV_GUIDING_DITHERED);
     ev << NV("dx", dx, 3) << NV("dy", dy, 3);
 
     do_notify(m_eventServerClients, ev);
@@ -1654,7 +1945,7 @@ void EventServer::NotifyGuidingDithered(double dx, double dy)
 
 void EventServer::NotifySetLockPosition(const PHD_Point& xy)
 {
-    if (m_eventServerClients.empty())
+    if (!wanted(m_eventServerClients, EV_LOCK_POSITION_SET))
         return;
 
     do_notify(m_eventServerClients, ev_set_lock_position(xy));
@@ -1662,12 +1953,12 @@ void EventServer::NotifySetLockPosition(const PHD_Point& xy)
 
 void EventServer::NotifyLockPositionLost()
 {
-    SIMPLE_NOTIFY("LockPositionLost");
+    SIMPLE_NOTIFY(EV_LOCK_POSITION_LOST);
 }
 
 void EventServer::NotifyAppState()
 {
-    if (m_eventServerClients.empty())
+    if (!wanted(m_eventServerClients, EV_APP_STATE))
         return;
 
     do_notify(m_eventServerClients, ev_app_state());
@@ -1675,7 +1966,7 @@ void EventServer::NotifyAppState()
 
 void EventServer::NotifySettling(double distance, double time, double settleTime)
 {
-    if (m_eventServerClients.empty())
+    if (!wanted(m_eventServerClients, EV_SETTLING))
         return;
 
     Ev ev(ev_settling(distance, time, settleTime));
@@ -1685,12 +1976,12 @@ void EventServer::NotifySettling(double distance, double time, double settleTime
     do_notify(m_eventServerClients, ev);
 }
 
-void EventServer::NotifySettleDone(const wxString& errorMsg)
+void EventServer::NotifySettleDone(const wxString& errorMsg, const SettleDoneInfo& info)
 {
-    if (m_eventServerClients.empty())
+    if (!wanted(m_eventServerClients, EV_SETTLE_DONE))
         return;
 
-    Ev ev(ev_settle_done(errorMsg));
+    Ev ev(ev_settle_done(errorMsg, info));
 
     Debug.AddLine(wxString::Format("evsrv: %s", ev.str()));
 
@@ -1699,10 +1990,10 @@ void EventServer::NotifySettleDone(const wxString& errorMsg)
 
 void EventServer::NotifyAlert(const wxString& msg, int type)
 {
-    if (m_eventServerClients.empty())
+    if (!wanted(m_eventServerClients, EV_ALERT))
         return;
 
-    Ev ev("Alert");
+    Ev ev(EV_ALERT);
     ev << NV("Msg", msg);
 
     wxString s;
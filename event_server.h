@@ -38,6 +38,8 @@
 #include <set>
 #include "json_parser.h"
 
+struct SettleDoneInfo;
+
 class EventServer : public wxEvtHandler
 {
 public:
@@ -47,6 +49,7 @@ private:
     JsonParser m_parser;
     wxSocketServer *m_serverSocket;
     CliSockSet m_eventServerClients;
+    size_t m_maxRequestSize;
 
 public:
     EventServer();
@@ -73,7 +76,7 @@ public:
     void NotifyLockPositionLost();
     void NotifyAppState();
     void NotifySettling(double distance, double time, double settleTime);
-    void NotifySettleDone(const wxString& errorMsg);
+    void NotifySettleDone(const wxString& errorMsg, const SettleDoneInfo& info);
     void NotifyAlert(const wxString& msg, int type);
 
 private:
@@ -0,0 +1,688 @@
+/*
+ *  frame_server.cpp
+ *  PHD Guiding
+ *
+ *  Created by the PHD2 developers
+ *  Copyright (c) 2014 PHD2 Developers
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of Craig Stark, Stark Labs nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "phd.h"
+
+#include <zlib.h>
+
+FrameServer FrameSrv;
+
+BEGIN_EVENT_TABLE(FrameServer, wxEvtHandler)
+    EVT_SOCKET(FRAME_SERVER_ID, FrameServer::OnServerEvent)
+    EVT_SOCKET(FRAME_SERVER_CLIENT_ID, FrameServer::OnClientEvent)
+    EVT_THREAD(FRAME_SERVER_ENCODED_ID, FrameServer::OnFrameEncoded)
+END_EVENT_TABLE()
+
+enum
+{
+    FRAME_PROTOCOL_VERSION = 1,
+    FRAME_HEADER_SIZE = 44,
+
+    FRAME_FLAG_DELTA = 1 << 0,
+    FRAME_FLAG_ZLIB = 1 << 1,
+    FRAME_FLAG_FULL = 1 << 2,   // frame is the (possibly decimated) full frame rather than the star ROI
+
+    MAX_REQUEST_SIZE = 4096,
+    MAX_DECIMATE = 16,
+};
+
+enum FrameMode
+{
+    FRAME_MODE_ROI,
+    FRAME_MODE_FULL,
+};
+
+struct FrameClient
+{
+    unsigned int id;
+    wxSocketClient *sock;
+    std::string rdbuf;
+
+    bool subscribed;
+    FrameMode mode;
+    unsigned int decimate;
+    bool zlib;
+    bool delta;
+    unsigned int minIntervalMs;
+
+    // true from the time a frame is handed to the encoder until it has been
+    // completely written to the socket; new frames are skipped meanwhile
+    bool busy;
+    wxLongLong lastSent;
+    std::vector<unsigned char> wrbuf;
+    size_t wrpos;
+    std::string replies;        // unwritten JSON-RPC replies; held back while a frame is in progress
+
+    FrameClient(unsigned int id_, wxSocketClient *sock_)
+        : id(id_), sock(sock_), subscribed(false), mode(FRAME_MODE_ROI), decimate(1),
+        zlib(true), delta(true), minIntervalMs(1000), busy(false), wrpos(0)
+    {
+    }
+};
+
+struct FrameJob
+{
+    unsigned int clientId;
+    unsigned int frameNumber;
+    unsigned int flags;
+    wxLongLong timestamp;
+    wxSize fullSize;
+    wxRect rect;            // region covered, in full-frame pixels
+    unsigned int decimate;
+    unsigned int width;     // dimensions of the pixel data
+    unsigned int height;
+    std::vector<unsigned short> pixels;
+    std::vector<unsigned char> out;
+};
+
+class FrameEncoderThread : public wxThread
+{
+    wxEvtHandler *m_handler;
+    wxMessageQueue<FrameJob *> m_queue;
+
+public:
+    FrameEncoderThread(wxEvtHandler *handler)
+        : wxThread(wxTHREAD_JOINABLE), m_handler(handler)
+    {
+    }
+
+    void Post(FrameJob *job) { m_queue.Post(job); }
+    void RequestTerminate() { m_queue.Post(0); }
+
+protected:
+    ExitCode Entry();
+};
+
+static void put_u16(unsigned char *p, unsigned int v)
+{
+    p[0] = (unsigned char)(v & 0xff);
+    p[1] = (unsigned char)((v >> 8) & 0xff);
+}
+
+static void put_u32(unsigned char *p, unsigned int v)
+{
+    put_u16(p, v & 0xffff);
+    put_u16(p + 2, (v >> 16) & 0xffff);
+}
+
+// header layout, all values little-endian:
+//
+//   0  char[4] "PHDF"
+//   4  u16     protocol version
+//   6  u16     header size
+//   8  u32     frame number
+//  12  u32     flags (FRAME_FLAG_xxx)
+//  16  u32     timestamp, ms since the epoch, low word
+//  20  u32     timestamp, high word
+//  24  u16     full frame width
+//  26  u16     full frame height
+//  28  u16     x of the region covered
+//  30  u16     y of the region covered
+//  32  u16     width of the pixel data
+//  34  u16     height of the pixel data
+//  36  u32     payload size in bytes
+//  40  u16     decimation factor
+//  42  u16     reserved
+static void WriteFrameHeader(unsigned char *p, const FrameJob& job, unsigned int payloadSize)
+{
+    memcpy(p, "PHDF", 4);
+    put_u16(p + 4, FRAME_PROTOCOL_VERSION);
+    put_u16(p + 6, FRAME_HEADER_SIZE);
+    put_u32(p + 8, job.frameNumber);
+    put_u32(p + 12, job.flags);
+    put_u32(p + 16, job.timestamp.GetLo());
+    put_u32(p + 20, (unsigned int) job.timestamp.GetHi());
+    put_u16(p + 24, job.fullSize.x);
+    put_u16(p + 26, job.fullSize.y);
+    put_u16(p + 28, job.rect.x);
+    put_u16(p + 30, job.rect.y);
+    put_u16(p + 32, job.width);
+    put_u16(p + 34, job.height);
+    put_u32(p + 36, payloadSize);
+    put_u16(p + 40, job.decimate);
+    put_u16(p + 42, 0);
+}
+
+static void EncodeFrame(FrameJob *job)
+{
+    unsigned int const w = job->width;
+    unsigned int const h = job->height;
+    unsigned short *px = job->pixels.empty() ? 0 : &job->pixels[0];
+
+    if ((job->flags & FRAME_FLAG_DELTA) && px)
+    {
+        // each pixel becomes the difference from its left neighbor, and the
+        // first pixel of a row the difference from the first pixel of the row
+        // above (mod 2^16, so the filter is lossless). Rows are processed
+        // bottom-up so the row above is still unfiltered.
+        for (unsigned int y = h; y-- > 0; )
+        {
+            unsigned short *row = px + y * w;
+            for (unsigned int x = w - 1; x > 0; x--)
+                row[x] = (unsigned short)(row[x] - row[x - 1]);
+            if (y > 0)
+                row[0] = (unsigned short)(row[0] - row[-(int) w]);
+        }
+    }
+
+    size_t const npix = (size_t) w * h;
+    std::vector<unsigned char> raw(npix * 2);
+    for (size_t i = 0; i < npix; i++)
+        put_u16(&raw[i * 2], px[i]);
+
+    const unsigned char *payload = raw.empty() ? 0 : &raw[0];
+    size_t payloadSize = raw.size();
+    std::vector<unsigned char> packed;
+
+    if (job->flags & FRAME_FLAG_ZLIB)
+    {
+        uLongf packedSize = compressBound((uLong) raw.size());
+        packed.resize(packedSize);
+        if (compress2(&packed[0], &packedSize, payload, (uLong) raw.size(), Z_BEST_SPEED) == Z_OK)
+        {
+            payload = &packed[0];
+            payloadSize = packedSize;
+        }
+        else
+        {
+            job->flags &= ~FRAME_FLAG_ZLIB;
+        }
+    }
+
+    job->out.resize(FRAME_HEADER_SIZE + payloadSize);
+    WriteFrameHeader(&job->out[0], *job, (unsigned int) payloadSize);
+    if (payloadSize)
+        memcpy(&job->out[FRAME_HEADER_SIZE], payload, payloadSize);
+
+    // the pixel copy is no longer needed; free it before the job crosses back
+    // to the main thread
+    std::vector<unsigned short>().swap(job->pixels);
+}
+
+wxThread::ExitCode FrameEncoderThread::Entry()
+{
+    Debug.AddLine("FrameEncoderThread::Entry() begins");
+
+    while (true)
+    {
+        FrameJob *job;
+        if (m_queue.Receive(job) != wxMSGQUEUE_NO_ERROR || !job)
+            break;
+
+        EncodeFrame(job);
+
+        wxThreadEvent *event = new wxThreadEvent(wxEVT_THREAD, FRAME_SERVER_ENCODED_ID);
+        event->SetPayload<FrameJob *>(job);
+        wxQueueEvent(m_handler, event);
+    }
+
+    Debug.AddLine("FrameEncoderThread::Entry() ends");
+
+    return (wxThread::ExitCode) 0;
+}
+
+FrameServer::FrameServer()
+    : m_serverSocket(0), m_nextClientId(1), m_encoder(0)
+{
+}
+
+FrameServer::~FrameServer()
+{
+}
+
+bool FrameServer::FrameServerStart(unsigned int instanceId)
+{
+    if (m_serverSocket)
+    {
+        Debug.AddLine("attempt to start frame server when it is already started?");
+        return false;
+    }
+
+    unsigned int port = 4500 + instanceId - 1;
+    wxIPV4address addr;
+    addr.Service(port);
+    m_serverSocket = new wxSocketServer(addr);
+
+    if (!m_serverSocket->Ok())
+    {
+        Debug.AddLine(wxString::Format("Frame server failed to start - Could not listen at port %u", port));
+        delete m_serverSocket;
+        m_serverSocket = NULL;
+        return true;
+    }
+
+    m_encoder = new FrameEncoderThread(this);
+    if (m_encoder->Create() != wxTHREAD_NO_ERROR || m_encoder->Run() != wxTHREAD_NO_ERROR)
+    {
+        Debug.AddLine("Frame server failed to start - could not start encoder thread");
+        delete m_encoder;
+        m_encoder = NULL;
+        delete m_serverSocket;
+        m_serverSocket = NULL;
+        return true;
+    }
+
+    m_serverSocket->SetEventHandler(*this, FRAME_SERVER_ID);
+    m_serverSocket->SetNotify(wxSOCKET_CONNECTION_FLAG);
+    m_serverSocket->Notify(true);
+
+    Debug.AddLine(wxString::Format("frame server started, listening on port %u", port));
+
+    return false;
+}
+
+void FrameServer::FrameServerStop()
+{
+    if (!m_serverSocket)
+        return;
+
+    while (!m_clients.empty())
+        DestroyClient(m_clients.begin()->second);
+
+    if (m_encoder)
+    {
+        m_encoder->RequestTerminate();
+        m_encoder->Wait();
+        delete m_encoder;
+        m_encoder = NULL;
+    }
+
+    delete m_serverSocket;
+    m_serverSocket = NULL;
+
+    Debug.AddLine("frame server stopped");
+}
+
+FrameClient *FrameServer::FindClient(wxSocketBase *sock)
+{
+    for (ClientMap::iterator it = m_clients.begin(); it != m_clients.end(); ++it)
+    {
+        if (it->second->sock == sock)
+            return it->second;
+    }
+    return 0;
+}
+
+void FrameServer::DestroyClient(FrameClient *client)
+{
+    m_clients.erase(client->id);
+    client->sock->Destroy();
+    delete client;
+}
+
+void FrameServer::OnServerEvent(wxSocketEvent& event)
+{
+    wxSocketServer *server = static_cast<wxSocketServer *>(event.GetSocket());
+
+    if (event.GetSocketEvent() != wxSOCKET_CONNECTION)
+        return;
+
+    wxSocketClient *sock = static_cast<wxSocketClient *>(server->Accept(false));
+
+    if (!sock)
+        return;
+
+    Debug.AddLine("frmsrv: cli %p connect", sock);
+
+    sock->SetEventHandler(*this, FRAME_SERVER_CLIENT_ID);
+    sock->SetNotify(wxSOCKET_LOST_FLAG | wxSOCKET_INPUT_FLAG | wxSOCKET_OUTPUT_FLAG);
+    sock->SetFlags(wxSOCKET_NOWAIT);
+    sock->Notify(true);
+
+    FrameClient *client = new FrameClient(m_nextClientId++, sock);
+    m_clients[client->id] = client;
+}
+
+void FrameServer::OnClientEvent(wxSocketEvent& event)
+{
+    FrameClient *client = FindClient(event.GetSocket());
+
+    if (!client)
+        return;
+
+    switch (event.GetSocketEvent())
+    {
+    case wxSOCKET_LOST:
+        Debug.AddLine("frmsrv: cli %p disconnect", client->sock);
+        DestroyClient(client);
+        break;
+    case wxSOCKET_INPUT:
+        HandleClientInput(client);
+        break;
+    case wxSOCKET_OUTPUT:
+        Flush(client);
+        break;
+    default:
+        Debug.AddLine("frmsrv: unexpected client socket event %d", event.GetSocketEvent());
+        break;
+    }
+}
+
+void FrameServer::HandleClientInput(FrameClient *client)
+{
+    char buf[1024];
+
+    while (true)
+    {
+        client->sock->Read(buf, sizeof(buf));
+        size_t n = client->sock->LastCount();
+        if (n == 0)
+            break;
+        client->rdbuf.append(buf, n);
+    }
+
+    size_t pos;
+    while ((pos = client->rdbuf.find_first_of("\r\n")) != std::string::npos)
+    {
+        std::string line(client->rdbuf, 0, pos);
+        client->rdbuf.erase(0, pos + 1);
+        if (!line.empty())
+            HandleRequest(client, &line[0]);
+    }
+
+    if (client->rdbuf.size() > MAX_REQUEST_SIZE)
+    {
+        Debug.AddLine("frmsrv: cli %p request too big", client->sock);
+        client->rdbuf.clear();
+    }
+}
+
+void FrameServer::SendResponse(FrameClient *client, const wxString& s)
+{
+    wxCharBuffer buf = (s + "\r\n").ToUTF8();
+    client->replies.append(buf.data(), buf.length());
+    Flush(client);
+}
+
+static wxString response(const json_value *id, const wxString& result)
+{
+    wxString idstr = id && id->type == JSON_INT ? wxString::Format("%d", id->int_value) : wxString("null");
+    return wxString::Format("{\"jsonrpc\":\"2.0\",%s,\"id\":%s}", result, idstr);
+}
+
+static wxString error_response(const json_value *id, const char *msg)
+{
+    return response(id, wxString::Format("\"error\":{\"code\":-32602,\"message\":\"%s\"}", msg));
+}
+
+void FrameServer::HandleRequest(FrameClient *client, char *line)
+{
+    static JsonParser parser;
+
+    if (!parser.Parse(line))
+    {
+        SendResponse(client, "{\"jsonrpc\":\"2.0\",\"error\":{\"code\":-32700,\"message\":\"invalid JSON request\"},\"id\":null}");
+        return;
+    }
+
+    const json_value *root = parser.Root();
+    const json_value *method = 0, *params = 0, *id = 0;
+
+    if (root->type == JSON_OBJECT)
+    {
+        json_for_each (t, root)
+        {
+            if (strcmp(t->name, "method") == 0 && t->type == JSON_STRING)
+                method = t;
+            else if (strcmp(t->name, "params") == 0)
+                params = t;
+            else if (strcmp(t->name, "id") == 0)
+                id = t;
+        }
+    }
+
+    if (!method || strcmp(method->string_value, "subscribe_frames") != 0)
+    {
+        SendResponse(client, response(id, "\"error\":{\"code\":-32601,\"message\":\"method not found\"}"));
+        return;
+    }
+
+    FrameMode mode = FRAME_MODE_ROI;
+    unsigned int decimate = 1;
+    bool zlib = true;
+    bool delta = true;
+    double maxRate = 1.0;
+
+    const json_value *opts = params && params->type == JSON_ARRAY ? params->first_child : params;
+    if (opts)
+    {
+        if (opts->type != JSON_OBJECT)
+        {
+            SendResponse(client, error_response(id, "expected subscription object param"));
+            return;
+        }
+
+        json_for_each (t, opts)
+        {
+            if (strcmp(t->name, "mode") == 0 && t->type == JSON_STRING)
+            {
+                if (strcmp(t->string_value, "roi") == 0)
+                    mode = FRAME_MODE_ROI;
+                else if (strcmp(t->string_value, "full") == 0)
+                    mode = FRAME_MODE_FULL;
+                else
+                {
+                    SendResponse(client, error_response(id, "expected mode \\\"roi\\\" or \\\"full\\\""));
+                    return;
+                }
+            }
+            else if (strcmp(t->name, "decimate") == 0 && t->type == JSON_INT &&
+                     t->int_value >= 1 && t->int_value <= MAX_DECIMATE)
+            {
+                decimate = t->int_value;
+            }
+            else if (strcmp(t->name, "compression") == 0 && t->type == JSON_STRING)
+            {
+                if (strcmp(t->string_value, "zlib") == 0)
+                    zlib = true;
+                else if (strcmp(t->string_value, "none") == 0)
+                    zlib = false;
+                else
+                {
+                    SendResponse(client, error_response(id, "expected compression \\\"zlib\\\" or \\\"none\\\""));
+                    return;
+                }
+            }
+            else if (strcmp(t->name, "delta") == 0 && t->type == JSON_BOOL)
+            {
+                delta = t->int_value ? true : false;
+            }
+            else if (strcmp(t->name, "max_rate") == 0 && (t->type == JSON_INT || t->type == JSON_FLOAT))
+            {
+                maxRate = t->type == JSON_INT ? (double) t->int_value : (double) t->float_value;
+                if (maxRate < 0.0)
+                    maxRate = 0.0;
+            }
+            else
+            {
+                SendResponse(client, error_response(id, "invalid subscription attribute"));
+                return;
+            }
+        }
+    }
+
+    client->mode = mode;
+    client->decimate = decimate;
+    client->zlib = zlib;
+    client->delta = delta;
+    client->minIntervalMs = maxRate > 0.0 ? (unsigned int) ceil(1000.0 / maxRate) : 0;
+
+    SendResponse(client, response(id, "\"result\":0"));
+
+    client->subscribed = true;
+
+    Debug.AddLine("frmsrv: cli %p subscribe mode=%s decimate=%u zlib=%d delta=%d interval=%ums", client->sock,
+        mode == FRAME_MODE_ROI ? "roi" : "full", decimate, zlib, delta, client->minIntervalMs);
+}
+
+// write as much as the socket will take; returns the number of bytes
+// written, or len if the connection is going away (wxSOCKET_LOST will clean
+// up)
+static size_t write_some(wxSocketBase *sock, const void *buf, size_t len)
+{
+    sock->Write(buf, len);
+    size_t n = sock->LastCount();
+    if (n == 0 && sock->Error() && sock->LastError() != wxSOCKET_WOULDBLOCK)
+        return len;
+    return n;
+}
+
+void FrameServer::Flush(FrameClient *client)
+{
+    if (!client->wrbuf.empty())
+    {
+        while (client->wrpos < client->wrbuf.size())
+        {
+            size_t n = write_some(client->sock, &client->wrbuf[client->wrpos], client->wrbuf.size() - client->wrpos);
+            if (n == 0)
+                return; // wait for wxSOCKET_OUTPUT
+            client->wrpos += n;
+        }
+
+        client->wrbuf.clear();
+        client->wrpos = 0;
+        client->busy = false;
+    }
+
+    // never write a reply into the middle of a binary frame; replies queued
+    // while the frame is being encoded go out once it has been sent
+    if (client->busy)
+        return;
+
+    while (!client->replies.empty())
+    {
+        size_t n = write_some(client->sock, client->replies.data(), client->replies.size());
+        if (n == 0)
+            return; // wait for wxSOCKET_OUTPUT
+        client->replies.erase(0, n);
+    }
+}
+
+void FrameServer::OnFrameEncoded(wxThreadEvent& event)
+{
+    FrameJob *job = event.GetPayload<FrameJob *>();
+
+    ClientMap::iterator it = m_clients.find(job->clientId);
+    if (it != m_clients.end())
+    {
+        FrameClient *client = it->second;
+        client->wrbuf.swap(job->out);
+        client->wrpos = 0;
+        Flush(client);
+    }
+
+    delete job;
+}
+
+// copy the pixels a client asked for out of the guider's image
+static void CopyPixels(FrameJob *job, const usImage *img)
+{
+    unsigned int const d = job->decimate;
+    job->width = (job->rect.width + d - 1) / d;
+    job->height = (job->rect.height + d - 1) / d;
+    job->pixels.resize((size_t) job->width * job->height);
+
+    unsigned short *dst = job->pixels.empty() ? 0 : &job->pixels[0];
+
+    // a windowed image holds only part of the frame; the rest is sent as black
+    const wxRect& data = img->DataRect;
+    bool const inside = data.Contains(job->rect);
+
+    for (unsigned int y = 0; y < job->height; y++)
+    {
+        int const sy = job->rect.y + y * d;
+        if (inside && d == 1)
+        {
+            memcpy(dst, &img->Pixel(job->rect.x, sy), job->width * sizeof(unsigned short));
+            dst += job->width;
+        }
+        else
+        {
+            for (unsigned int x = 0; x < job->width; x++)
+            {
+                int const sx = job->rect.x + x * d;
+                *dst++ = img->HasPixel(sx, sy) ? img->Pixel(sx, sy) : 0;
+            }
+        }
+    }
+}
+
+void FrameServer::NotifyFrame(const usImage *pImage, const wxRect& roi, int frameNumber)
+{
+    if (m_clients.empty() || !m_encoder || !pImage || !pImage->ImageData)
+        return;
+
+    wxRect const full(pImage->Size);
+    wxLongLong const now = ::wxGetUTCTimeMillis();
+
+    for (ClientMap::iterator it = m_clients.begin(); it != m_clients.end(); ++it)
+    {
+        FrameClient *client = it->second;
+
+        // a frame must not start while a reply is only partly written
+        if (!client->subscribed || client->busy || !client->replies.empty())
+            continue;
+
+        if (client->minIntervalMs && now - client->lastSent < (long) client->minIntervalMs)
+            continue;
+
+        FrameJob *job = new FrameJob();
+        job->clientId = client->id;
+        job->frameNumber = frameNumber;
+        job->timestamp = now;
+        job->fullSize = pImage->Size;
+        job->flags = (client->delta ? FRAME_FLAG_DELTA : 0) | (client->zlib ? FRAME_FLAG_ZLIB : 0);
+
+        wxRect box(roi);
+        box.Intersect(full);
+
+        if (client->mode == FRAME_MODE_ROI && !box.IsEmpty())
+        {
+            job->rect = box;
+            job->decimate = 1;
+        }
+        else
+        {
+            job->rect = full;
+            job->decimate = client->decimate;
+            job->flags |= FRAME_FLAG_FULL;
+        }
+
+        CopyPixels(job, pImage);
+
+        client->busy = true;
+        client->lastSent = now;
+        m_encoder->Post(job);
+    }
+}
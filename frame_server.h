@@ -0,0 +1,114 @@
+/*
+ *  frame_server.h
+ *  PHD Guiding
+ *
+ *  Created by the PHD2 developers
+ *  Copyright (c) 2014 PHD2 Developers
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of Craig Stark, Stark Labs nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef FRAME_SERVER_INCLUDED
+#define FRAME_SERVER_INCLUDED
+
+#include <map>
+
+class FrameEncoderThread;
+struct FrameJob;
+struct FrameClient;
+
+/*
+ * The frame server streams guide camera frames to remote monitoring clients on
+ * a side channel next to the event server (port 4500 + instance - 1).
+ *
+ * A client connects and sends a newline-terminated JSON-RPC request:
+ *
+ *   {"method": "subscribe_frames", "params": [{"mode": "roi", "decimate": 2,
+ *     "compression": "zlib", "delta": true, "max_rate": 1}], "id": 1}
+ *
+ *   mode        "roi" for the star's search region (default), or "full" for
+ *               the whole frame. In roi mode the full frame is sent while no
+ *               star is selected.
+ *   decimate    full-frame decimation factor, 1-16 (default 1)
+ *   compression "none" or "zlib" (default "zlib")
+ *   delta       apply a lossless horizontal delta filter before compressing
+ *               (default true)
+ *   max_rate    maximum frames per second, 0 for no limit (default 1)
+ *
+ * The server replies with a JSON-RPC response line. After that, each frame is
+ * sent as a binary message: a FRAME_HEADER_SIZE byte little-endian header
+ * (see WriteFrameHeader) followed by the payload.
+ *
+ * Only the requested pixels are copied out of the guider's image, on the
+ * main thread. Filtering, compression and buffering happen on a background
+ * thread. A client that is still waiting for its previous frame to be
+ * encoded or sent skips frames, so a slow client never holds up guiding.
+ */
+class FrameServer : public wxEvtHandler
+{
+public:
+    typedef std::map<unsigned int, FrameClient *> ClientMap;
+
+private:
+    wxSocketServer *m_serverSocket;
+    ClientMap m_clients;
+    unsigned int m_nextClientId;
+    FrameEncoderThread *m_encoder;
+
+public:
+    FrameServer();
+    ~FrameServer(void);
+
+    bool FrameServerStart(unsigned int instanceId);
+    void FrameServerStop();
+
+    bool HasClients() const;
+    void NotifyFrame(const usImage *pImage, const wxRect& roi, int frameNumber);
+
+private:
+    void OnServerEvent(wxSocketEvent& evt);
+    void OnClientEvent(wxSocketEvent& evt);
+    void OnFrameEncoded(wxThreadEvent& evt);
+
+    FrameClient *FindClient(wxSocketBase *sock);
+    void DestroyClient(FrameClient *client);
+    void HandleClientInput(FrameClient *client);
+    void HandleRequest(FrameClient *client, char *line);
+    void SendResponse(FrameClient *client, const wxString& s);
+    void Flush(FrameClient *client);
+
+    wxDECLARE_EVENT_TABLE();
+};
+
+extern FrameServer FrameSrv;
+
+inline bool FrameServer::HasClients() const
+{
+    return !m_clients.empty();
+}
+
+#endif
@@ -859,10 +859,12 @@ bool GearDialog::DoConnectCamera(void)
         {
             int currProfileId = pConfig->GetCurrentProfileId();
             wxString darkName = MyFrame::DarkLibFileName(currProfileId);
+            wxString legacyDarkName = MyFrame::LegacyDarkLibFileName(currProfileId);
             wxString bpmName = DefectMap::DefectMapFileName(currProfileId);
+            wxString legacyBpmName = DefectMap::LegacyDefectMapFileName(currProfileId);
 
             // Can't use standard checks because we don't want to consider sensor-size
-            if (wxFileExists(darkName) || wxFileExists(bpmName))
+            if (wxFileExists(darkName) || wxFileExists(legacyDarkName) || wxFileExists(bpmName) || wxFileExists(legacyBpmName))
             {
                 wxString msg = _("By changing cameras in this profile, you won't be able to use the existing dark library or bad-pixel maps. You should consider"
                     " creating a new profile for this set-up.  Do you want to proceed with changes to this profile?");
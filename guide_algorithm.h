@@ -77,6 +77,9 @@ public:
 
     virtual void reset(void) = 0;
     virtual double result(double input) = 0;
+    // the correction actually issued for the last result(), after the
+    // duration limits and the Dec guide mode, in the same units and sign
+    virtual void correctionApplied(double correction) { }
 
     virtual ConfigDialogPane *GetConfigDialogPane(wxWindow *pParent)=0;
     virtual GraphControlPane *GetGraphControlPane(wxWindow *pParent, const wxString& label) { return NULL; };
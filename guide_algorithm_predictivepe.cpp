@@ -0,0 +1,425 @@
+/*
+ *  guide_algorithm_predictivepe.cpp
+ *  PHD Guiding
+ *
+ *  Created by the PHD2 developers
+ *  Copyright (c) 2014 PHD2 Developers
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of Craig Stark, Stark Labs nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "phd.h"
+
+static const double DefaultMinMove = 0.2;
+static const double DefaultAggressiveness = 70.0;
+static const double DefaultPredictionGain = 80.0;
+static const double DefaultPeriod = 0.0;            // search for the periods
+
+// a longer gap between guide steps means guiding was stopped, and the
+// mount may have been slewed, so the model starts over
+static const double MaxStepGap = 60.0;
+
+GuideAlgorithmPredictivePE::GuideAlgorithmPredictivePE(Mount *pMount, GuideAxis axis)
+    : GuideAlgorithm(pMount, axis)
+{
+    double minMove = pConfig->Profile.GetDouble(GetConfigPath() + "/minMove", DefaultMinMove);
+    SetMinMove(minMove);
+
+    double aggr = pConfig->Profile.GetDouble(GetConfigPath() + "/Aggressiveness", DefaultAggressiveness);
+    SetAggressiveness(aggr);
+
+    double gain = pConfig->Profile.GetDouble(GetConfigPath() + "/PredictionGain", DefaultPredictionGain);
+    SetPredictionGain(gain);
+
+    double period = pConfig->Profile.GetDouble(GetConfigPath() + "/Period", DefaultPeriod);
+    SetPeriod(period);
+
+    m_lastTime = -1.0;
+    reset();
+}
+
+GuideAlgorithmPredictivePE::~GuideAlgorithmPredictivePE(void)
+{
+}
+
+GUIDE_ALGORITHM GuideAlgorithmPredictivePE::Algorithm(void)
+{
+    return GUIDE_ALGORITHM_PREDICTIVE_PE;
+}
+
+double GuideAlgorithmPredictivePE::Now(void) const
+{
+    return (double) (::wxGetUTCTimeMillis().GetValue() - m_startTime) / 1000.0;
+}
+
+void GuideAlgorithmPredictivePE::reset(void)
+{
+    if (m_lastTime >= 0.0 && Now() - m_lastTime <= MaxStepGap)
+    {
+        // a dither or a short pause moved the lock position; keep what we
+        // have learned and splice the new positions onto the old ones
+        m_rebase = true;
+        return;
+    }
+
+    m_predictor.Reset();
+    m_startTime = ::wxGetUTCTimeMillis().GetValue();
+    m_lastTime = -1.0;
+    m_interval = 0.0;
+    m_correctionSum = 0.0;
+    m_lastPosition = 0.0;
+    m_rebase = false;
+}
+
+double GuideAlgorithmPredictivePE::result(double input)
+{
+    if (m_lastTime >= 0.0 && Now() - m_lastTime > MaxStepGap)
+    {
+        m_lastTime = -1.0;
+        reset();
+    }
+
+    double const now = Now();
+
+    if (m_lastTime >= 0.0)
+    {
+        double const dt = now - m_lastTime;
+        if (dt > 0.0)
+            m_interval = m_interval > 0.0 ? 0.8 * m_interval + 0.2 * dt : dt;
+    }
+
+    if (m_rebase)
+    {
+        // continue the uncorrected position from where it would have been
+        double const expected = m_lastPosition + m_predictor.Predict(m_lastTime, now);
+        m_correctionSum = expected - input;
+        m_rebase = false;
+    }
+
+    // where the star would be without our corrections
+    double const position = input + m_correctionSum;
+
+    m_predictor.AddSample(now, position);
+    m_predictor.Fit();
+
+    m_lastTime = now;
+    m_lastPosition = position;
+
+    double reactive = 0.0;
+    if (fabs(input) >= m_minMove)
+        reactive = input * m_aggressiveness / 100.0;
+
+    // feed forward the motion expected before the next correction
+    double predicted = 0.0;
+    if (m_predictor.IsValid() && m_interval > 0.0)
+        predicted = m_predictor.Predict(now, now + m_interval) * m_predictionGain / 100.0;
+
+    double dReturn = reactive + predicted;
+
+    Debug.Write(wxString::Format("GuideAlgorithmPredictivePE::Result() returns %.2f from input %.2f (reactive %.2f predicted %.2f, %d terms)\n",
+        dReturn, input, reactive, predicted, m_predictor.IsValid() ? m_predictor.NumTerms() : 0));
+
+    return dReturn;
+}
+
+void GuideAlgorithmPredictivePE::correctionApplied(double correction)
+{
+    // only what the mount actually moved shifts the star; a clamped or
+    // suppressed correction must not be counted in full
+    m_correctionSum += correction;
+}
+
+double GuideAlgorithmPredictivePE::GetMinMove(void)
+{
+    return m_minMove;
+}
+
+bool GuideAlgorithmPredictivePE::SetMinMove(double minMove)
+{
+    bool bError = false;
+
+    try
+    {
+        if (minMove < 0)
+        {
+            throw ERROR_INFO("invalid minMove");
+        }
+
+        m_minMove = minMove;
+    }
+    catch (wxString Msg)
+    {
+        POSSIBLY_UNUSED(Msg);
+        bError = true;
+        m_minMove = DefaultMinMove;
+    }
+
+    pConfig->Profile.SetDouble(GetConfigPath() + "/minMove", m_minMove);
+
+    return bError;
+}
+
+double GuideAlgorithmPredictivePE::GetAggressiveness(void)
+{
+    return m_aggressiveness;
+}
+
+bool GuideAlgorithmPredictivePE::SetAggressiveness(double aggressiveness)
+{
+    bool bError = false;
+
+    try
+    {
+        if (aggressiveness < 0.0 || aggressiveness > 100.0)
+        {
+            throw ERROR_INFO("invalid aggressiveness");
+        }
+
+        m_aggressiveness = aggressiveness;
+    }
+    catch (wxString Msg)
+    {
+        POSSIBLY_UNUSED(Msg);
+        bError = true;
+        m_aggressiveness = DefaultAggressiveness;
+    }
+
+    pConfig->Profile.SetDouble(GetConfigPath() + "/Aggressiveness", m_aggressiveness);
+
+    return bError;
+}
+
+double GuideAlgorithmPredictivePE::GetPredictionGain(void)
+{
+    return m_predictionGain;
+}
+
+bool GuideAlgorithmPredictivePE::SetPredictionGain(double gain)
+{
+    bool bError = false;
+
+    try
+    {
+        if (gain < 0.0 || gain > 100.0)
+        {
+            throw ERROR_INFO("invalid prediction gain");
+        }
+
+        m_predictionGain = gain;
+    }
+    catch (wxString Msg)
+    {
+        POSSIBLY_UNUSED(Msg);
+        bError = true;
+        m_predictionGain = DefaultPredictionGain;
+    }
+
+    pConfig->Profile.SetDouble(GetConfigPath() + "/PredictionGain", m_predictionGain);
+
+    return bError;
+}
+
+double GuideAlgorithmPredictivePE::GetPeriod(void)
+{
+    return m_period;
+}
+
+bool GuideAlgorithmPredictivePE::SetPeriod(double period)
+{
+    bool bError = false;
+
+    try
+    {
+        if (period < 0.0)
+        {
+            throw ERROR_INFO("invalid period");
+        }
+
+        m_period = period;
+    }
+    catch (wxString Msg)
+    {
+        POSSIBLY_UNUSED(Msg);
+        bError = true;
+        m_period = DefaultPeriod;
+    }
+
+    m_predictor.SetPeriod(m_period);
+
+    pConfig->Profile.SetDouble(GetConfigPath() + "/Period", m_period);
+
+    return bError;
+}
+
+ConfigDialogPane *GuideAlgorithmPredictivePE::GetConfigDialogPane(wxWindow *pParent)
+{
+    return new GuideAlgorithmPredictivePEConfigDialogPane(pParent, this);
+}
+
+wxString GuideAlgorithmPredictivePE::GetSettingsSummary()
+{
+    // return a loggable summary of current mount settings
+    return wxString::Format("Aggressiveness = %.3f, Prediction gain = %.3f, Minimum move = %.3f, Period = %.1f\n",
+        GetAggressiveness(),
+        GetPredictionGain(),
+        GetMinMove(),
+        GetPeriod()
+        );
+}
+
+GuideAlgorithmPredictivePE::
+GuideAlgorithmPredictivePEConfigDialogPane::
+GuideAlgorithmPredictivePEConfigDialogPane(wxWindow *pParent, GuideAlgorithmPredictivePE *pGuideAlgorithm)
+    : ConfigDialogPane(_("Predictive PEC Guide Algorithm"), pParent)
+{
+    int width;
+
+    m_pGuideAlgorithm = pGuideAlgorithm;
+
+    width = StringWidth(_T("0000.0"));
+    m_pAggressiveness = new wxSpinCtrlDouble(pParent, wxID_ANY, _T("foo2"), wxPoint(-1, -1),
+        wxSize(width + 30, -1), wxSP_ARROW_KEYS, 0.0, 100.0, 0.0, 5.0, _T("Aggressiveness"));
+    m_pAggressiveness->SetDigits(2);
+
+    DoAdd(_("Aggressiveness"), m_pAggressiveness,
+        wxString::Format(_("How much of the current error to correct, percent. Default = %.f%%"), DefaultAggressiveness));
+
+    m_pPredictionGain = new wxSpinCtrlDouble(pParent, wxID_ANY, _T("foo2"), wxPoint(-1, -1),
+        wxSize(width + 30, -1), wxSP_ARROW_KEYS, 0.0, 100.0, 0.0, 5.0, _T("PredictionGain"));
+    m_pPredictionGain->SetDigits(2);
+
+    DoAdd(_("Prediction gain"), m_pPredictionGain,
+        wxString::Format(_("How much of the periodic error predicted for the next exposure to correct in advance, percent. Default = %.f%%"), DefaultPredictionGain));
+
+    m_pMinMove = new wxSpinCtrlDouble(pParent, wxID_ANY, _T("foo2"), wxPoint(-1, -1),
+        wxSize(width + 30, -1), wxSP_ARROW_KEYS, 0.0, 20.0, 0.0, 0.05, _T("MinMove"));
+    m_pMinMove->SetDigits(2);
+
+    DoAdd(_("Minimum Move (pixels)"), m_pMinMove,
+        wxString::Format(_("How many (fractional) pixels must the star move to trigger a reactive guide pulse? Default = %.2f"), DefaultMinMove));
+
+    m_pPeriod = new wxSpinCtrlDouble(pParent, wxID_ANY, _T("foo2"), wxPoint(-1, -1),
+        wxSize(width + 30, -1), wxSP_ARROW_KEYS, 0.0, 3600.0, 0.0, 1.0, _T("Period"));
+    m_pPeriod->SetDigits(1);
+
+    DoAdd(_("Worm period (seconds)"), m_pPeriod,
+        _("Period of the mount's periodic error, if known. Set to 0 to find the periods from the guiding data."));
+}
+
+GuideAlgorithmPredictivePE::
+GuideAlgorithmPredictivePEConfigDialogPane::
+~GuideAlgorithmPredictivePEConfigDialogPane(void)
+{
+}
+
+void GuideAlgorithmPredictivePE::
+GuideAlgorithmPredictivePEConfigDialogPane::
+LoadValues(void)
+{
+    m_pAggressiveness->SetValue(m_pGuideAlgorithm->GetAggressiveness());
+    m_pPredictionGain->SetValue(m_pGuideAlgorithm->GetPredictionGain());
+    m_pMinMove->SetValue(m_pGuideAlgorithm->GetMinMove());
+    m_pPeriod->SetValue(m_pGuideAlgorithm->GetPeriod());
+}
+
+void GuideAlgorithmPredictivePE::
+GuideAlgorithmPredictivePEConfigDialogPane::
+UnloadValues(void)
+{
+    m_pGuideAlgorithm->SetAggressiveness(m_pAggressiveness->GetValue());
+    m_pGuideAlgorithm->SetPredictionGain(m_pPredictionGain->GetValue());
+    m_pGuideAlgorithm->SetMinMove(m_pMinMove->GetValue());
+    m_pGuideAlgorithm->SetPeriod(m_pPeriod->GetValue());
+}
+
+GraphControlPane *GuideAlgorithmPredictivePE::GetGraphControlPane(wxWindow *pParent, const wxString& label)
+{
+    return new GuideAlgorithmPredictivePEGraphControlPane(pParent, this, label);
+}
+
+GuideAlgorithmPredictivePE::
+GuideAlgorithmPredictivePEGraphControlPane::
+GuideAlgorithmPredictivePEGraphControlPane(wxWindow *pParent, GuideAlgorithmPredictivePE *pGuideAlgorithm, const wxString& label)
+: GraphControlPane(pParent, label)
+{
+    int width;
+
+    m_pGuideAlgorithm = pGuideAlgorithm;
+
+    width = StringWidth(_T("000.00"));
+    m_pAggressiveness = new wxSpinCtrlDouble(this, wxID_ANY, wxEmptyString, wxDefaultPosition,
+        wxSize(width + 30, -1), wxSP_ARROW_KEYS, 0.0, 100.0, 0.0, 5.0, _T("Aggressiveness"));
+    m_pAggressiveness->SetDigits(2);
+    m_pAggressiveness->Bind(wxEVT_COMMAND_SPINCTRLDOUBLE_UPDATED, &GuideAlgorithmPredictivePE::GuideAlgorithmPredictivePEGraphControlPane::OnAggrSpinCtrlDouble, this);
+    DoAdd(m_pAggressiveness, _("Agg"));
+
+    m_pPredictionGain = new wxSpinCtrlDouble(this, wxID_ANY, wxEmptyString, wxDefaultPosition,
+        wxSize(width + 30, -1), wxSP_ARROW_KEYS, 0.0, 100.0, 0.0, 5.0, _T("PredictionGain"));
+    m_pPredictionGain->SetDigits(2);
+    m_pPredictionGain->Bind(wxEVT_COMMAND_SPINCTRLDOUBLE_UPDATED, &GuideAlgorithmPredictivePE::GuideAlgorithmPredictivePEGraphControlPane::OnGainSpinCtrlDouble, this);
+    DoAdd(m_pPredictionGain, _("Pred"));
+
+    m_pMinMove = new wxSpinCtrlDouble(this, wxID_ANY, wxEmptyString, wxDefaultPosition,
+        wxSize(width + 30, -1), wxSP_ARROW_KEYS, 0.0, 20.0, 0.0, 0.05, _T("MinMove"));
+    m_pMinMove->SetDigits(2);
+    m_pMinMove->Bind(wxEVT_COMMAND_SPINCTRLDOUBLE_UPDATED, &GuideAlgorithmPredictivePE::GuideAlgorithmPredictivePEGraphControlPane::OnMinMoveSpinCtrlDouble, this);
+    DoAdd(m_pMinMove, _("MnMo"));
+
+    m_pAggressiveness->SetValue(m_pGuideAlgorithm->GetAggressiveness());
+    m_pPredictionGain->SetValue(m_pGuideAlgorithm->GetPredictionGain());
+    m_pMinMove->SetValue(m_pGuideAlgorithm->GetMinMove());
+}
+
+GuideAlgorithmPredictivePE::
+GuideAlgorithmPredictivePEGraphControlPane::
+~GuideAlgorithmPredictivePEGraphControlPane(void)
+{
+}
+
+void GuideAlgorithmPredictivePE::
+GuideAlgorithmPredictivePEGraphControlPane::
+OnAggrSpinCtrlDouble(wxSpinDoubleEvent& evt)
+{
+    m_pGuideAlgorithm->SetAggressiveness(m_pAggressiveness->GetValue());
+    GuideLog.SetGuidingParam(m_pGuideAlgorithm->GetAxis() + " Predictive PEC aggressiveness", m_pAggressiveness->GetValue());
+}
+
+void GuideAlgorithmPredictivePE::
+GuideAlgorithmPredictivePEGraphControlPane::
+OnGainSpinCtrlDouble(wxSpinDoubleEvent& evt)
+{
+    m_pGuideAlgorithm->SetPredictionGain(m_pPredictionGain->GetValue());
+    GuideLog.SetGuidingParam(m_pGuideAlgorithm->GetAxis() + " Predictive PEC prediction gain", m_pPredictionGain->GetValue());
+}
+
+void GuideAlgorithmPredictivePE::
+GuideAlgorithmPredictivePEGraphControlPane::
+OnMinMoveSpinCtrlDouble(wxSpinDoubleEvent& evt)
+{
+    m_pGuideAlgorithm->SetMinMove(m_pMinMove->GetValue());
+    GuideLog.SetGuidingParam(m_pGuideAlgorithm->GetAxis() + " Predictive PEC minimum move", m_pMinMove->GetValue());
+}
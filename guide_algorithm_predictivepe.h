@@ -0,0 +1,112 @@
+/*
+ *  guide_algorithm_predictivepe.h
+ *  PHD Guiding
+ *
+ *  Created by the PHD2 developers
+ *  Copyright (c) 2014 PHD2 Developers
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of Craig Stark, Stark Labs nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef GUIDE_ALGORITHM_PREDICTIVEPE_H_INCLUDED
+#define GUIDE_ALGORITHM_PREDICTIVEPE_H_INCLUDED
+
+class GuideAlgorithmPredictivePE : public GuideAlgorithm
+{
+    PEPredictor m_predictor;
+    double m_aggressiveness;
+    double m_predictionGain;
+    double m_minMove;
+    double m_period;
+
+    wxLongLong_t m_startTime;
+    double m_lastTime;              // seconds, < 0 before the first sample
+    double m_interval;              // smoothed time between guide steps
+    double m_correctionSum;         // total of the corrections the mount has issued
+    double m_lastPosition;          // last uncorrected position fed to the model
+    bool m_rebase;
+
+    double Now(void) const;
+
+protected:
+    class GuideAlgorithmPredictivePEConfigDialogPane : public ConfigDialogPane
+    {
+        GuideAlgorithmPredictivePE *m_pGuideAlgorithm;
+        wxSpinCtrlDouble *m_pAggressiveness;
+        wxSpinCtrlDouble *m_pPredictionGain;
+        wxSpinCtrlDouble *m_pMinMove;
+        wxSpinCtrlDouble *m_pPeriod;
+    public:
+        GuideAlgorithmPredictivePEConfigDialogPane(wxWindow *pParent, GuideAlgorithmPredictivePE *pGuideAlgorithm);
+        virtual ~GuideAlgorithmPredictivePEConfigDialogPane(void);
+
+        virtual void LoadValues(void);
+        virtual void UnloadValues(void);
+    };
+
+    class GuideAlgorithmPredictivePEGraphControlPane : public GraphControlPane
+    {
+    public:
+        GuideAlgorithmPredictivePEGraphControlPane(wxWindow *pParent, GuideAlgorithmPredictivePE *pGuideAlgorithm, const wxString& label);
+        ~GuideAlgorithmPredictivePEGraphControlPane(void);
+
+    private:
+        GuideAlgorithmPredictivePE *m_pGuideAlgorithm;
+        wxSpinCtrlDouble *m_pAggressiveness;
+        wxSpinCtrlDouble *m_pPredictionGain;
+        wxSpinCtrlDouble *m_pMinMove;
+        void OnAggrSpinCtrlDouble(wxSpinDoubleEvent& evt);
+        void OnGainSpinCtrlDouble(wxSpinDoubleEvent& evt);
+        void OnMinMoveSpinCtrlDouble(wxSpinDoubleEvent& evt);
+    };
+
+    double GetAggressiveness(void);
+    bool SetAggressiveness(double aggressiveness);
+    double GetPredictionGain(void);
+    bool SetPredictionGain(double gain);
+    double GetPeriod(void);
+    bool SetPeriod(double period);
+
+    friend class GuideAlgorithmPredictivePEConfigDialogPane;
+
+public:
+    GuideAlgorithmPredictivePE(Mount *pMount, GuideAxis axis);
+    virtual ~GuideAlgorithmPredictivePE(void);
+    virtual GUIDE_ALGORITHM Algorithm(void);
+
+    virtual void reset(void);
+    virtual double result(double input);
+    virtual void correctionApplied(double correction);
+    virtual ConfigDialogPane *GetConfigDialogPane(wxWindow *pParent);
+    virtual GraphControlPane *GetGraphControlPane(wxWindow *pParent, const wxString& label);
+    virtual wxString GetSettingsSummary();
+    virtual wxString GetGuideAlgorithmClassName(void) const { return "Predictive PEC"; }
+    virtual double GetMinMove(void);
+    virtual bool SetMinMove(double minMove);
+};
+
+#endif /* GUIDE_ALGORITHM_PREDICTIVEPE_H_INCLUDED */
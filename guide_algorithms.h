@@ -48,6 +48,7 @@ enum GUIDE_ALGORITHM
     GUIDE_ALGORITHM_LOWPASS,
     GUIDE_ALGORITHM_LOWPASS2,
     GUIDE_ALGORITHM_RESIST_SWITCH,
+    GUIDE_ALGORITHM_PREDICTIVE_PE,
 };
 
 #include "guide_algorithm.h"
@@ -56,5 +57,7 @@ enum GUIDE_ALGORITHM
 #include "guide_algorithm_lowpass.h"
 #include "guide_algorithm_lowpass2.h"
 #include "guide_algorithm_resistswitch.h"
+#include "guiding_analyzer.h"
+#include "guide_algorithm_predictivepe.h"
 
 #endif /* GUIDE_ALGORITHMS_H_INCLUDED */
@@ -112,7 +112,12 @@ Guider::Guider(wxWindow *parent, int xSize, int ySize) :
     m_displayedImage = new wxImage(XWinSize,YWinSize,true);
     m_paused = PAUSE_NONE;
     m_starFoundTimestamp = 0;
+    m_positionTime = 0.0;
     m_avgDistanceNeedReset = false;
+    m_ditherRecenterActive = false;
+    m_ditherRecenterMoves = 0;
+    m_ditherRecenterDecReversed = false;
+    m_decBacklash = 0.0;
     m_lockPosShift.shiftEnabled = false;
     m_lockPosShift.shiftRate.SetXY(0., 0.);
     m_lockPosShift.shiftUnits = UNIT_ARCSEC;
@@ -741,11 +746,10 @@ MOVE_LOCK_RESULT Guider::MoveLockPosition(const PHD_Point& mountDelta)
 
         if (IsFastRecenterEnabled())
         {
-            m_ditherRecenterRemaining.SetXY(fabs(mountDelta.X), fabs(mountDelta.Y));
-            m_ditherRecenterDir.x = mountDelta.X < 0.0 ? 1 : -1;
-            m_ditherRecenterDir.y = mountDelta.Y < 0.0 ? 1 : -1;
-            double f = (double) GetMaxMovePixels() / m_ditherRecenterRemaining.Distance();
-            m_ditherRecenterStep.SetXY(f * m_ditherRecenterRemaining.X, f * m_ditherRecenterRemaining.Y);
+            m_ditherRecenterActive = true;
+            m_ditherRecenterMoves = 0;
+            m_ditherRecenterGain.SetXY(1.0, 1.0);
+            m_ditherRecenterDecReversed = false;
         }
     }
     catch (wxString Msg)
@@ -856,7 +860,7 @@ void Guider::SetState(GUIDER_STATE newState)
             case STATE_GUIDING:
                 assert(pMount);
 
-                m_ditherRecenterRemaining.Invalidate();  // reset dither fast recenter state
+                m_ditherRecenterActive = false;  // reset dither fast recenter state
 
                 pMount->AdjustCalibrationForScopePointing();
                 if (pSecondaryMount)
@@ -1001,6 +1005,7 @@ void Guider::Reset(bool fullReset)
 void Guider::UpdateGuideState(usImage *pImage, bool bStopping)
 {
     wxString statusMessage;
+    bool const newFrame = pImage != NULL;
 
     try
     {
@@ -1013,6 +1018,23 @@ void Guider::UpdateGuideState(usImage *pImage, bool bStopping)
             usImage *pPrevImage = m_pCurrentImage;
             m_pCurrentImage = pImage;
             delete pPrevImage;
+
+            if (FrameSrv.HasClients())
+            {
+                // stream the guide star's neighbourhood; the bounding box is
+                // empty while full frames are being forced, so fall back to a
+                // search-region box around the locked star. The frame server
+                // sends the full frame only when there is no star.
+                wxRect roi(GetBoundingBox());
+                if (roi.IsEmpty() && IsLocked() && CurrentPosition().IsValid())
+                {
+                    int const halfwidth = GetMaxMovePixels();
+                    roi = wxRect(ROUND(CurrentPosition().X) - halfwidth, ROUND(CurrentPosition().Y) - halfwidth,
+                                 2 * halfwidth + 1, 2 * halfwidth + 1);
+                }
+                roi.Intersect(wxRect(pImage->Size));
+                FrameSrv.NotifyFrame(pImage, roi, pFrame->m_frameCounter);
+            }
         }
         else
         {
@@ -1090,6 +1112,11 @@ void Guider::UpdateGuideState(usImage *pImage, bool bStopping)
         }
         statusMessage = info.status;
 
+        if (pImage->ImgStartTimeMs)
+            m_positionTime = (pImage->ImgStartTimeMs + pImage->ImgExpDur / 2) / 1000.0;
+        else
+            m_positionTime = ::wxGetUTCTimeMillis().ToDouble() / 1000.0;
+
         // we have a star selected, so re-enable subframes
         if (m_forceFullFrame)
         {
@@ -1200,34 +1227,7 @@ void Guider::UpdateGuideState(usImage *pImage, bool bStopping)
                 EvtServer.NotifyStartGuiding();
                 break;
             case STATE_GUIDING:
-                if (m_ditherRecenterRemaining.IsValid())
-                {
-                    // fast recenter after dither taking large steps and bypassing
-                    // guide algorithms (normalMove=false)
-
-                    PHD_Point step(wxMin(m_ditherRecenterRemaining.X, m_ditherRecenterStep.X),
-                                   wxMin(m_ditherRecenterRemaining.Y, m_ditherRecenterStep.Y));
-
-                    Debug.AddLine(wxString::Format("dither recenter: remaining=(%.1f,%.1f) step=(%.1f,%.1f)",
-                        m_ditherRecenterRemaining.X * m_ditherRecenterDir.x,
-                        m_ditherRecenterRemaining.Y * m_ditherRecenterDir.y,
-                        step.X * m_ditherRecenterDir.x, step.Y * m_ditherRecenterDir.y));
-
-                    m_ditherRecenterRemaining -= step;
-                    if (m_ditherRecenterRemaining.X < 0.5 && m_ditherRecenterRemaining.Y < 0.5)
-                    {
-                        // fast recenter is done
-                        m_ditherRecenterRemaining.Invalidate();
-                        // reset distance tracker
-                        m_avgDistanceNeedReset = true;
-                    }
-
-                    PHD_Point mountCoords(step.X * m_ditherRecenterDir.x, step.Y * m_ditherRecenterDir.y);
-                    PHD_Point cameraCoords;
-                    pMount->TransformMountCoordinatesToCameraCoordinates(mountCoords, cameraCoords);
-                    pFrame->SchedulePrimaryMove(pMount, cameraCoords, false);
-                }
-                else
+                if (!m_ditherRecenterActive || !DitherRecenterMove())
                 {
                     // ordinary guide step
                     s_deflectionLogger.Log(CurrentPosition());
@@ -1253,17 +1253,147 @@ void Guider::UpdateGuideState(usImage *pImage, bool bStopping)
 
     pFrame->UpdateButtonsStatus();
 
+    // the logger copies the frame and writes it on its own thread
+    if (newFrame && !bStopping && m_state >= STATE_SELECTED && pFrame->IsImageLoggingEnabled())
+    {
+        const PHD_Point& star = CurrentPosition().IsValid() ? CurrentPosition() : LockPosition();
+        if (star.IsValid())
+            ImageLogger::LogFrame(*pImage, star, LockPosition(), pFrame->m_frameCounter);
+    }
+
     UpdateImageDisplay(pImage);
 
     Debug.AddLine("UpdateGuideState exits: " + statusMessage);
 }
 
+// Fast recenter after a dither. Every frame the measured residual is turned
+// into the largest pulses the mount allows on each axis, using the calibrated
+// rates and the max RA/Dec durations, and the move bypasses the guide
+// algorithms. Replanning from the measured residual absorbs calibration rate
+// errors, and a move that reverses the dec direction is padded with the
+// backlash measured on earlier reversals. Returns false when the star is close
+// enough for the guide algorithms to take over.
+bool Guider::DitherRecenterMove(void)
+{
+    static const double DoneDistance = 0.5; // pixels per axis
+    static const int MaxMoves = 10;
+
+    PHD_Point residual;
+
+    if (!CurrentPosition().IsValid() ||
+        pMount->TransformCameraCoordinatesToMountCoordinates(CurrentPosition() - LockPosition(), residual))
+    {
+        m_ditherRecenterActive = false;
+        return false;
+    }
+
+    if (m_ditherRecenterMoves > 0)
+    {
+        // compare how far the last move took the star with what was commanded
+        PHD_Point moved = m_ditherRecenterResidual - residual;
+
+        if (fabs(m_ditherRecenterMove.X) >= 1.0)
+        {
+            double g = moved.X / m_ditherRecenterMove.X;
+            m_ditherRecenterGain.X = wxMax(0.5, wxMin(2.0, (m_ditherRecenterGain.X + g) / 2.0));
+        }
+
+        if (fabs(m_ditherRecenterMove.Y) >= 1.0)
+        {
+            if (m_ditherRecenterDecReversed)
+            {
+                // whatever the gears absorbed on the reversal is backlash
+                double shortfall = fabs(m_ditherRecenterMove.Y) - (m_ditherRecenterMove.Y > 0.0 ? moved.Y : -moved.Y);
+                shortfall = wxMax(0.0, wxMin((double) GetMaxMovePixels(), shortfall));
+                m_decBacklash = m_decBacklash > 0.0 ? (m_decBacklash + shortfall) / 2.0 : shortfall;
+            }
+            else
+            {
+                double g = moved.Y / m_ditherRecenterMove.Y;
+                m_ditherRecenterGain.Y = wxMax(0.5, wxMin(2.0, (m_ditherRecenterGain.Y + g) / 2.0));
+            }
+        }
+    }
+
+    if ((fabs(residual.X) < DoneDistance && fabs(residual.Y) < DoneDistance) || m_ditherRecenterMoves >= MaxMoves)
+    {
+        Debug.AddLine(wxString::Format("dither recenter: done after %d moves, residual=(%.2f,%.2f)",
+            m_ditherRecenterMoves, residual.X, residual.Y));
+        m_ditherRecenterActive = false;
+        // reset distance tracker
+        m_avgDistanceNeedReset = true;
+        return false;
+    }
+
+    PHD_Point move(fabs(residual.X) < DoneDistance ? 0.0 : residual.X / m_ditherRecenterGain.X,
+                   fabs(residual.Y) < DoneDistance ? 0.0 : residual.Y / m_ditherRecenterGain.Y);
+
+    int raMoves = 1, decMoves = 1;
+    bool decReversed = false;
+    Scope *scope = dynamic_cast<Scope *>(pMount);
+
+    if (scope)
+    {
+        // largest single move on each axis the mount allows, pixels
+        double maxRa = scope->GetMaxRaDuration() * pMount->xRate();
+        double maxDec = scope->GetMaxDecDuration() * pMount->yRate();
+
+        if (maxRa > 0.0)
+        {
+            raMoves = (int) ceil(fabs(move.X) / maxRa);
+            move.X = wxMax(-maxRa, wxMin(maxRa, move.X));
+        }
+        if (maxDec > 0.0)
+        {
+            decMoves = (int) ceil(fabs(move.Y) / maxDec);
+            move.Y = wxMax(-maxDec, wxMin(maxDec, move.Y));
+        }
+    }
+
+    // keep the star inside the search region
+    double maxMove = (double) GetMaxMovePixels();
+    double dist = move.Distance();
+    if (dist > maxMove)
+        move *= maxMove / dist;
+
+    if (scope && move.Y != 0.0)
+    {
+        GUIDE_DIRECTION decDir = move.Y > 0.0 ? SOUTH : NORTH;
+        GUIDE_DIRECTION lastDir = scope->LastDecDirection();
+        decReversed = lastDir != NONE && lastDir != decDir;
+        if (decReversed)
+            move.Y += move.Y > 0.0 ? m_decBacklash : -m_decBacklash;
+    }
+
+    Debug.AddLine(wxString::Format("dither recenter: residual=(%.2f,%.2f) move=(%.2f,%.2f) gain=(%.2f,%.2f) "
+        "planned moves=%d dec reversed=%d backlash=%.2f", residual.X, residual.Y, move.X, move.Y,
+        m_ditherRecenterGain.X, m_ditherRecenterGain.Y, wxMax(raMoves, decMoves), decReversed, m_decBacklash));
+
+    m_ditherRecenterResidual = residual;
+    m_ditherRecenterMove = move;
+    m_ditherRecenterDecReversed = decReversed;
+    ++m_ditherRecenterMoves;
+
+    PHD_Point cameraCoords;
+    pMount->TransformMountCoordinatesToCameraCoordinates(move, cameraCoords);
+    pFrame->SchedulePrimaryMove(pMount, cameraCoords, false);
+
+    return true;
+}
+
+// The lock position is shifted to where it will be at the midpoint of the
+// next exposure rather than to where it is now. The guide correction computed
+// from it stays in effect for the whole of the next exposure, so aiming at the
+// midpoint removes the lag of half an exposure plus the frame overhead that a
+// moving target otherwise has.
 bool Guider::ShiftLockPosition(void)
 {
-    m_lockPosition.UpdateShift();
+    wxLongLong_t now = ::wxGetUTCTimeMillis().GetValue();
+    wxLongLong_t midpoint = now + pFrame->GetTimeLapse() + pFrame->RequestedExposureDuration() / 2;
+    m_lockPosition.UpdateShift(midpoint);
     bool isValid = IsValidLockPosition(m_lockPosition);
-    Debug.AddLine("ShiftLockPos: new pos = %.2f, %.2f valid=%d",
-                  m_lockPosition.X, m_lockPosition.Y, isValid);
+    Debug.AddLine("ShiftLockPos: new pos = %.2f, %.2f at +%.2fs valid=%d",
+                  m_lockPosition.X, m_lockPosition.Y, (double)(midpoint - now) / 1000., isValid);
     return !isValid;
 }
 
@@ -143,10 +143,15 @@ class Guider : public wxWindow
     PHD_Point m_polarAlignCircleCenter;
     PauseType m_paused;
     ShiftPoint m_lockPosition;
-    PHD_Point m_ditherRecenterStep;
-    wxPoint m_ditherRecenterDir;
-    PHD_Point m_ditherRecenterRemaining;
+    bool m_ditherRecenterActive;
+    int m_ditherRecenterMoves;          // fast recenter moves made since the dither
+    PHD_Point m_ditherRecenterResidual; // residual the last move was planned from, mount coords
+    PHD_Point m_ditherRecenterMove;     // last fast recenter move, mount coords
+    PHD_Point m_ditherRecenterGain;     // measured / commanded motion per axis
+    bool m_ditherRecenterDecReversed;   // the last move reversed the dec direction
+    double m_decBacklash;               // learned dec backlash, pixels
     time_t m_starFoundTimestamp;  // timestamp when star was last found
+    double m_positionTime;        // exposure midpoint of the current position, UTC seconds
     double m_avgDistance;         // averaged distance for distance reporting
     bool m_avgDistanceNeedReset;
     GUIDER_STATE m_state;
@@ -268,10 +273,14 @@ public:
     virtual bool AutoSelect(void) = 0;
 
     virtual const PHD_Point& CurrentPosition(void) = 0;
+    double CurrentPositionTime(void) const { return m_positionTime; }
     virtual wxRect GetBoundingBox(void) = 0;
     virtual int GetMaxMovePixels(void) = 0;
     virtual double StarMass(void) = 0;
     virtual double SNR(void) = 0;
+    virtual double HFD(void) = 0;
+    virtual double FWHM(void) = 0;
+    virtual const StarMetrics& CurrentStarMetrics(void) = 0;
     virtual int StarError(void) = 0;
 
     usImage *CurrentImage(void);
@@ -285,6 +294,7 @@ public:
 
 private:
     void UpdateLockPosShiftCameraCoords(void);
+    bool DitherRecenterMove(void);
     DECLARE_EVENT_TABLE()
 };
 
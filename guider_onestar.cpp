@@ -141,14 +141,331 @@ public:
     }
 };
 
+// Places and sizes the guide subframe for the next exposure. The subframe is
+// centered where the star is expected to be once the pending guide correction
+// has been applied, and is widened by the recent prediction error. When the
+// star is lost the subframe is enlarged in steps before falling back to full
+// frames.
+class SubframeTracker
+{
+    enum { MaxEscalation = 3 };
+
+    PHD_Point m_lastPos;      // where the star was last found
+    PHD_Point m_correction;   // camera offset sent to the mount for the pending move
+    PHD_Point m_predicted;    // where we expect the star in the next frame
+    double m_gain;            // fraction of the offset the mount actually removes
+    double m_errVar;          // running mean square prediction error (px^2)
+    int m_escalation;         // number of consecutive lost frames
+
+public:
+
+    SubframeTracker()
+    {
+        Reset();
+    }
+
+    void Reset(void)
+    {
+        m_lastPos.Invalidate();
+        m_correction.Invalidate();
+        m_predicted.Invalidate();
+        m_gain = 0.5;
+        m_errVar = 0.0;
+        m_escalation = 0;
+    }
+
+    // called when the star was found at pos; guiding indicates that a guide
+    // correction of (pos - lockPos) is about to be sent to the mount
+    void StarFound(const PHD_Point& pos, const PHD_Point& lockPos, bool guiding)
+    {
+        static const double alpha = 0.2;
+
+        if (m_predicted.IsValid() && m_correction.IsValid() && m_lastPos.IsValid())
+        {
+            double ex = pos.X - m_predicted.X;
+            double ey = pos.Y - m_predicted.Y;
+            m_errVar += alpha * (0.5 * (ex * ex + ey * ey) - m_errVar);
+
+            // how much of the requested correction showed up in the star motion
+            double c2 = m_correction.X * m_correction.X + m_correction.Y * m_correction.Y;
+            if (c2 >= 0.25)
+            {
+                double moved = ((m_lastPos.X - pos.X) * m_correction.X +
+                                (m_lastPos.Y - pos.Y) * m_correction.Y) / c2;
+                m_gain += alpha * (wxMax(0.0, wxMin(moved, 1.0)) - m_gain);
+            }
+        }
+
+        m_escalation = 0;
+        m_lastPos = pos;
+
+        if (guiding && lockPos.IsValid())
+        {
+            m_correction = pos - lockPos;
+            m_predicted = pos - m_correction * m_gain;
+        }
+        else
+        {
+            m_correction.Invalidate();
+            m_predicted = pos;
+        }
+    }
+
+    void StarLost(void)
+    {
+        if (m_escalation <= MaxEscalation)
+            ++m_escalation;
+        // no move follows a lost frame, so the star should be where it was
+        if (m_lastPos.IsValid())
+            m_predicted = m_lastPos;
+        m_correction.Invalidate();
+    }
+
+    const PHD_Point& Predicted(void) const
+    {
+        return m_predicted;
+    }
+
+    bool FullFrameNeeded(void) const
+    {
+        return m_escalation > MaxEscalation;
+    }
+
+    bool Escalating(void) const
+    {
+        return m_escalation > 0 && m_escalation <= MaxEscalation;
+    }
+
+    // half-width of the star search around the predicted position: the
+    // configured region, widened by 3 sigma of the prediction error (at most
+    // doubled). Lost frames do not widen it; a larger box would change the
+    // star's SNR and could pick up a brighter neighbor.
+    int FindRegion(int searchRegion) const
+    {
+        int margin = (int) ceil(3.0 * sqrt(m_errVar));
+        return searchRegion + wxMin(margin, searchRegion);
+    }
+
+    // subframe half-width: the search region, doubled for each lost frame
+    int SubframeRegion(int searchRegion) const
+    {
+        return FindRegion(searchRegion) << wxMin(m_escalation, (int) MaxEscalation);
+    }
+};
+
 static const double DefaultMassChangeThreshold = 0.5;
 
+// Secondary guide stars. Each secondary star gives its own estimate of the
+// primary star position: where it was found, less its offset from the primary.
+// The estimates that pass the quality checks are combined with the primary
+// star position in a weighted mean, which averages down the centroid noise
+// and the part of the seeing motion that is not common to all the stars.
+class SecondaryStars
+{
+public:
+    struct Entry
+    {
+        Star star;
+        PHD_Point offset;   // position relative to the primary star
+        double mass;        // smoothed star mass
+        int lost;           // consecutive frames the star was not usable
+        bool used;          // star contributed to the last position
+    };
+
+private:
+    enum { MaxLostFrames = 10 };
+
+    std::vector<Entry> m_stars;
+
+    class FindBody : public ParallelBody
+    {
+        std::vector<Entry>& m_stars;
+        const usImage *m_pImage;
+        int m_searchRegion;
+        Star::FindMode m_mode;
+        PHD_Point m_primary;
+
+    public:
+        FindBody(std::vector<Entry>& stars, const usImage *pImage, int searchRegion,
+                 Star::FindMode mode, const PHD_Point& primary)
+            : m_stars(stars), m_pImage(pImage), m_searchRegion(searchRegion),
+              m_mode(mode), m_primary(primary)
+        {
+        }
+
+        void Run(int begin, int end)
+        {
+            for (int i = begin; i < end; i++)
+            {
+                Entry& e = m_stars[i];
+                PHD_Point expected = m_primary + e.offset;
+                e.star.Find(m_pImage, m_searchRegion, ROUND(expected.X), ROUND(expected.Y), m_mode);
+            }
+        }
+    };
+
+    static double Median(std::vector<double>& v)
+    {
+        size_t mid = v.size() / 2;
+        std::nth_element(v.begin(), v.begin() + mid, v.end());
+        return v[mid];
+    }
+
+public:
+
+    void Reset(void)
+    {
+        m_stars.clear();
+    }
+
+    const std::vector<Entry>& Stars(void) const
+    {
+        return m_stars;
+    }
+
+    // Starts tracking the candidate stars that are clear of the primary
+    // star's search box and can be centroided without saturation
+    void Init(const usImage *pImage, int searchRegion, const PHD_Point& primary,
+              const std::vector<PHD_Point>& candidates, unsigned int maxStars)
+    {
+        m_stars.clear();
+
+        for (std::vector<PHD_Point>::const_iterator it = candidates.begin();
+             it != candidates.end() && m_stars.size() < maxStars; ++it)
+        {
+            if (fabs(it->X - primary.X) <= searchRegion && fabs(it->Y - primary.Y) <= searchRegion)
+                continue;
+
+            Entry e;
+            e.star.Find(pImage, searchRegion, ROUND(it->X), ROUND(it->Y), Star::FIND_CENTROID);
+            if (e.star.GetError() != Star::STAR_OK)
+                continue;
+            e.offset = e.star - primary;
+            e.mass = e.star.Mass;
+            e.lost = 0;
+            e.used = false;
+            m_stars.push_back(e);
+        }
+
+        Debug.AddLine("MultiStar: tracking %u secondary stars", (unsigned int) m_stars.size());
+    }
+
+    // Finds the secondary stars relative to the newly found primary star and
+    // replaces the primary star position with the combined estimate. Returns
+    // the number of secondary stars that contributed.
+    int Update(const usImage *pImage, int searchRegion, Star::FindMode mode, Star& primary,
+               double massThreshold)
+    {
+        static const double MinSNR = 6.0;
+        static const double MinOutlierDist = 1.0;   // px
+        static const double OutlierFactor = 3.0;
+        static const double MassAlpha = 0.1;
+        static const double OffsetAlpha = 0.01;
+
+        if (m_stars.empty())
+            return 0;
+
+        FindBody body(m_stars, pImage, searchRegion, mode, primary);
+        parallel_for(0, (int) m_stars.size(), body, 1);
+
+        // each good secondary star's estimate of the primary star position,
+        // as a deviation from where the primary star was found
+        std::vector<double> dx, dy;
+        dx.push_back(0.0);
+        dy.push_back(0.0);
+
+        for (std::vector<Entry>::iterator it = m_stars.begin(); it != m_stars.end(); ++it)
+        {
+            it->used = it->star.GetError() == Star::STAR_OK &&
+                it->star.SNR >= MinSNR &&
+                fabs(it->star.Mass - it->mass) <= massThreshold * it->mass;
+            if (it->used)
+            {
+                dx.push_back(it->star.X - it->offset.X - primary.X);
+                dy.push_back(it->star.Y - it->offset.Y - primary.Y);
+            }
+        }
+
+        // reject estimates far from the median of all the estimates
+        std::vector<double> tmp(dx);
+        double medx = Median(tmp);
+        tmp = dy;
+        double medy = Median(tmp);
+
+        std::vector<double> dist(dx.size());
+        for (size_t i = 0; i < dx.size(); i++)
+            dist[i] = hypot(dx[i] - medx, dy[i] - medy);
+        tmp = dist;
+        double limit = wxMax(MinOutlierDist, OutlierFactor * Median(tmp));
+
+        // inverse-variance weights: the centroid error of each star scales as 1/SNR
+        double sumw = primary.SNR * primary.SNR;
+        double sumx = 0.0;
+        double sumy = 0.0;
+        int used = 0;
+
+        size_t k = 1;
+        for (std::vector<Entry>::iterator it = m_stars.begin(); it != m_stars.end(); ++it)
+        {
+            if (!it->used)
+                continue;
+            if (dist[k] > limit)
+            {
+                Debug.AddLine("MultiStar: reject star at (%.2f, %.2f) dev %.2f > %.2f", it->star.X, it->star.Y, dist[k], limit);
+                it->used = false;
+            }
+            else
+            {
+                double w = it->star.SNR * it->star.SNR;
+                sumw += w;
+                sumx += w * dx[k];
+                sumy += w * dy[k];
+                ++used;
+            }
+            ++k;
+        }
+
+        primary.SetXY(primary.X + sumx / sumw, primary.Y + sumy / sumw);
+
+        // follow slow changes in the star offsets (field rotation, differential
+        // refraction) and drop stars that have been unusable for a while
+        std::vector<Entry>::iterator it = m_stars.begin();
+        while (it != m_stars.end())
+        {
+            if (it->used)
+            {
+                it->offset += ((it->star - primary) - it->offset) * OffsetAlpha;
+                it->mass += MassAlpha * (it->star.Mass - it->mass);
+                it->lost = 0;
+            }
+            else if (++it->lost > MaxLostFrames)
+            {
+                Debug.AddLine("MultiStar: dropping secondary star at offset (%.1f, %.1f)", it->offset.X, it->offset.Y);
+                it = m_stars.erase(it);
+                continue;
+            }
+            ++it;
+        }
+
+        Debug.AddLine("MultiStar: %d of %u secondary stars used, shift (%.2f, %.2f)", used,
+                      (unsigned int) m_stars.size(), sumx / sumw, sumy / sumw);
+
+        return used;
+    }
+};
+
 enum {
     MIN_SEARCH_REGION = 5,
     DEFAULT_SEARCH_REGION = 15,
     MAX_SEARCH_REGION = 50,
 };
 
+enum {
+    MIN_GUIDE_STARS = 2,
+    DEFAULT_GUIDE_STARS = 9,
+    MAX_GUIDE_STARS = 24,
+};
+
 BEGIN_EVENT_TABLE(GuiderOneStar, Guider)
     EVT_PAINT(GuiderOneStar::OnPaint)
     EVT_LEFT_DOWN(GuiderOneStar::OnLClick)
@@ -157,7 +474,9 @@ END_EVENT_TABLE()
 // Define a constructor for the guide canvas
 GuiderOneStar::GuiderOneStar(wxWindow *parent)
     : Guider(parent, XWinSize, YWinSize),
-      m_massChecker(new MassChecker())
+      m_massChecker(new MassChecker()),
+      m_subframe(new SubframeTracker()),
+      m_secondary(new SecondaryStars())
 {
     SetState(STATE_UNINITIALIZED);
 }
@@ -165,6 +484,8 @@ GuiderOneStar::GuiderOneStar(wxWindow *parent)
 GuiderOneStar::~GuiderOneStar()
 {
     delete m_massChecker;
+    delete m_subframe;
+    delete m_secondary;
 }
 
 void GuiderOneStar::LoadProfileSettings(void)
@@ -180,6 +501,12 @@ void GuiderOneStar::LoadProfileSettings(void)
 
     int searchRegion = pConfig->Profile.GetInt("/guider/onestar/SearchRegion", DEFAULT_SEARCH_REGION);
     SetSearchRegion(searchRegion);
+
+    bool multiStar = pConfig->Profile.GetBoolean("/guider/onestar/MultiStar", false);
+    SetMultiStarEnabled(multiStar);
+
+    int maxStars = pConfig->Profile.GetInt("/guider/onestar/MaxStars", DEFAULT_GUIDE_STARS);
+    SetMaxStars(maxStars);
 }
 
 bool GuiderOneStar::GetMassChangeThresholdEnabled(void)
@@ -253,6 +580,57 @@ bool GuiderOneStar::SetSearchRegion(int searchRegion)
     return bError;
 }
 
+bool GuiderOneStar::GetMultiStarEnabled(void)
+{
+    return m_multiStarEnabled;
+}
+
+void GuiderOneStar::SetMultiStarEnabled(bool enable)
+{
+    m_multiStarEnabled = enable;
+    if (!enable)
+        m_secondary->Reset();
+    pConfig->Profile.SetBoolean("/guider/onestar/MultiStar", enable);
+}
+
+int GuiderOneStar::GetMaxStars(void)
+{
+    return m_maxStars;
+}
+
+bool GuiderOneStar::SetMaxStars(int maxStars)
+{
+    bool bError = false;
+
+    try
+    {
+        if (maxStars < MIN_GUIDE_STARS || maxStars > MAX_GUIDE_STARS)
+        {
+            throw ERROR_INFO("invalid maxStars");
+        }
+        m_maxStars = maxStars;
+    }
+    catch (wxString Msg)
+    {
+        POSSIBLY_UNUSED(Msg);
+        bError = true;
+        m_maxStars = DEFAULT_GUIDE_STARS;
+    }
+
+    pConfig->Profile.SetInt("/guider/onestar/MaxStars", m_maxStars);
+
+    return bError;
+}
+
+// Picks the secondary guide stars for the current primary star from the
+// candidates found by Star::AutoFind
+void GuiderOneStar::SelectSecondaryStars(const usImage *pImage, const std::vector<PHD_Point>& candidates)
+{
+    m_secondary->Reset();
+    if (m_multiStarEnabled && m_star.IsValid())
+        m_secondary->Init(pImage, m_searchRegion, m_star, candidates, m_maxStars - 1);
+}
+
 bool GuiderOneStar::SetCurrentPosition(usImage *pImage, const PHD_Point& position)
 {
     bool bError = true;
@@ -280,7 +658,20 @@ bool GuiderOneStar::SetCurrentPosition(usImage *pImage, const PHD_Point& positio
         }
 
         m_massChecker->Reset();
+        m_subframe->Reset();
+        m_secondary->Reset();
         bError = !m_star.Find(pImage, m_searchRegion, x, y, pFrame->GetStarFindMode());
+
+        if (!bError && m_multiStarEnabled && pImage->Subframe.IsEmpty())
+        {
+            // the star AutoFind would have picked is a candidate too, unless
+            // it is the one that was just selected
+            Star autoStar;
+            std::vector<PHD_Point> candidates;
+            if (autoStar.AutoFind(*pImage, 0, m_searchRegion, &candidates, m_maxStars))
+                candidates.insert(candidates.begin(), autoStar);
+            SelectSecondaryStars(pImage, candidates);
+        }
     }
     catch (wxString Msg)
     {
@@ -362,18 +753,24 @@ bool GuiderOneStar::AutoSelect(void)
             edgeAllowance = wxMax(edgeAllowance, pSecondaryMount->CalibrationTotDistance());
 
         Star newStar;
-        if (!newStar.AutoFind(*pImage, edgeAllowance, m_searchRegion))
+        std::vector<PHD_Point> candidates;
+        if (!newStar.AutoFind(*pImage, edgeAllowance, m_searchRegion,
+                              m_multiStarEnabled ? &candidates : 0, m_maxStars - 1))
         {
             throw ERROR_INFO("Unable to AutoFind");
         }
 
         m_massChecker->Reset();
+        m_subframe->Reset();
+        m_secondary->Reset();
 
         if (!m_star.Find(pImage, m_searchRegion, newStar.X, newStar.Y, Star::FIND_CENTROID))
         {
             throw ERROR_INFO("Unable to find");
         }
 
+        SelectSecondaryStars(pImage, candidates);
+
         if (SetLockPosition(m_star))
         {
             throw ERROR_INFO("Unable to set Lock Position");
@@ -390,7 +787,7 @@ bool GuiderOneStar::AutoSelect(void)
         }
 
         UpdateImageDisplay();
-        pFrame->pProfile->UpdateData(pImage, m_star.X, m_star.Y);
+        UpdateStarMetrics(pImage);
 
 #ifdef BRET_AO_DEBUG
         if (pMount && !pMount->IsCalibrated())
@@ -443,21 +840,25 @@ wxRect GuiderOneStar::GetBoundingBox(void)
     bool subframe;
     PHD_Point pos;
 
+    // while the star is lost, keep taking progressively larger subframes
+    // around its last known position until the tracker gives up
+    bool tracked = m_star.WasFound() || (m_star.IsValid() && m_subframe->Escalating());
+    const PHD_Point& predicted = m_subframe->Predicted();
+
     switch (state) {
     case STATE_SELECTED:
     case STATE_CALIBRATING_PRIMARY:
     case STATE_CALIBRATING_SECONDARY:
-        subframe = m_star.WasFound();
-        pos = CurrentPosition();
+        subframe = tracked;
+        pos = predicted.IsValid() ? predicted : CurrentPosition();
         break;
     case STATE_GUIDING: {
-        subframe = m_star.WasFound();  // true;
-        // As long as the star is close to the lock position, keep the subframe
-        // at the lock position. Otherwise, follow the star.
-        double dist = CurrentPosition().Distance(LockPosition());
-        if ((int) dist > m_searchRegion / 3)
-            pos = CurrentPosition();
-        else
+        subframe = tracked;
+        // As long as the star is expected close to the lock position, keep the
+        // subframe at the lock position. Otherwise, follow the star.
+        pos = predicted.IsValid() ? predicted : CurrentPosition();
+        double dist = pos.Distance(LockPosition());
+        if ((int) dist <= m_searchRegion / 3)
             pos = LockPosition();
         break;
     }
@@ -465,14 +866,19 @@ wxRect GuiderOneStar::GetBoundingBox(void)
         subframe = false;
     }
 
-    if (m_forceFullFrame)
+    if (m_forceFullFrame || m_subframe->FullFrameNeeded())
     {
         subframe = false;
     }
 
     if (subframe)
     {
-        wxRect box(SubframeRect(pos, m_searchRegion + SUBFRAME_BOUNDARY_PX));
+        int halfwidth = m_subframe->SubframeRegion(m_searchRegion) + SUBFRAME_BOUNDARY_PX;
+        wxRect box(SubframeRect(pos, halfwidth));
+        // the subframe must also cover the secondary stars
+        const std::vector<SecondaryStars::Entry>& stars = m_secondary->Stars();
+        for (std::vector<SecondaryStars::Entry>::const_iterator it = stars.begin(); it != stars.end(); ++it)
+            box.Union(SubframeRect(pos + it->offset, halfwidth));
         box.Intersect(wxRect(0, 0, pCamera->FullSize.x, pCamera->FullSize.y));
         return box;
     }
@@ -497,6 +903,30 @@ double GuiderOneStar::SNR(void)
     return m_star.SNR;
 }
 
+double GuiderOneStar::HFD(void)
+{
+    // prefer the PSF fit measurement when there is one
+    if (m_star.HFD > 0.0)
+        return m_star.HFD;
+    return m_metrics.Valid ? m_metrics.HFD : 0.0;
+}
+
+double GuiderOneStar::FWHM(void)
+{
+    return m_star.FWHM;
+}
+
+const StarMetrics& GuiderOneStar::CurrentStarMetrics(void)
+{
+    return m_metrics;
+}
+
+void GuiderOneStar::UpdateStarMetrics(usImage *pImage)
+{
+    m_metrics.Measure(pImage, m_star.X, m_star.Y);
+    pFrame->pProfile->UpdateData(m_metrics);
+}
+
 int GuiderOneStar::StarError(void)
 {
     return m_star.GetError();
@@ -505,10 +935,13 @@ int GuiderOneStar::StarError(void)
 void GuiderOneStar::InvalidateCurrentPosition(bool fullReset)
 {
     m_star.Invalidate();
+    m_subframe->Reset();
+    m_metrics.Invalidate();
 
     if (fullReset)
     {
         m_star.X = m_star.Y = 0.0;
+        m_secondary->Reset();
     }
 }
 
@@ -545,22 +978,37 @@ bool GuiderOneStar::UpdateCurrentPosition(usImage *pImage, FrameDroppedInfo *err
     {
         Star newStar(m_star);
 
-        if (!newStar.Find(pImage, m_searchRegion, pFrame->GetStarFindMode()))
+        // search around where the star was expected to end up after the last
+        // guide correction
+        const PHD_Point& predicted = m_subframe->Predicted();
+        int searchRegion = m_subframe->FindRegion(m_searchRegion);
+        int x = predicted.IsValid() ? ROUND(predicted.X) : ROUND(m_star.X);
+        int y = predicted.IsValid() ? ROUND(predicted.Y) : ROUND(m_star.Y);
+
+        if (!newStar.Find(pImage, searchRegion, x, y, pFrame->GetStarFindMode()))
         {
             errorInfo->starError = newStar.GetError();
             errorInfo->starMass = 0.0;
             errorInfo->starSNR = 0.0;
             errorInfo->status = StarStatusStr(newStar);
             m_star.SetError(newStar.GetError());
+            m_metrics.Invalidate();
             throw ERROR_INFO("UpdateCurrentPosition():newStar not found");
         }
 
+        // measure the star and the sky around it once for the mass check,
+        // the profile display and the guide log
+        m_metrics.Measure(pImage, newStar.X, newStar.Y);
+
         // check to see if it seems like the star we just found was the
         // same as the original star.  We do this by comparing the
-        // mass
+        // mass. The mass of a saturated star depends on the clipping rather
+        // than on the star, so saturated frames are neither checked nor
+        // added to the history.
         m_massChecker->SetExposure(pFrame->RequestedExposureDuration());
         double limits[3];
-        if (m_massChangeThresholdEnabled &&
+        bool checkMass = !m_metrics.Valid || !m_metrics.Saturated;
+        if (m_massChangeThresholdEnabled && checkMass &&
             m_massChecker->CheckMass(newStar.Mass, m_massChangeThreshold, limits))
         {
             m_star.SetError(Star::STAR_MASSCHANGE);
@@ -574,9 +1022,24 @@ bool GuiderOneStar::UpdateCurrentPosition(usImage *pImage, FrameDroppedInfo *err
             throw THROW_INFO("massChangeThreshold error");
         }
 
+        if (checkMass)
+            m_massChecker->AppendData(newStar.Mass);
+
+        // refine the position with the secondary stars
+        int secondaryStars = 0;
+        if (m_multiStarEnabled)
+        {
+            double massThreshold = m_massChangeThresholdEnabled ? m_massChangeThreshold : DefaultMassChangeThreshold;
+            // the secondary stars are searched for relative to where the primary
+            // star was just found, so the prediction margin does not apply
+            secondaryStars = m_secondary->Update(pImage, m_searchRegion, pFrame->GetStarFindMode(), newStar, massThreshold);
+        }
+
         // update the star position, mass, etc.
         m_star = newStar;
-        m_massChecker->AppendData(newStar.Mass);
+
+        // a guide correction is sent only while guiding and not paused
+        m_subframe->StarFound(m_star, LockPosition(), GetState() == STATE_GUIDING && !IsPaused());
 
         const PHD_Point& lockPos = LockPosition();
         if (lockPos.IsValid())
@@ -585,16 +1048,19 @@ bool GuiderOneStar::UpdateCurrentPosition(usImage *pImage, FrameDroppedInfo *err
             UpdateCurrentDistance(distance);
         }
 
-        pFrame->pProfile->UpdateData(pImage, m_star.X, m_star.Y);
+        pFrame->pProfile->UpdateData(m_metrics);
 
         pFrame->AdjustAutoExposure(m_star.SNR);
 
         errorInfo->status.Printf(_T("m=%.0f SNR=%.1f"), m_star.Mass, m_star.SNR);
+        if (secondaryStars > 0)
+            errorInfo->status += wxString::Format(_T(" stars=%d"), secondaryStars + 1);
     }
     catch (wxString Msg)
     {
         POSSIBLY_UNUSED(Msg);
         bError = true;
+        m_subframe->StarLost();
         pFrame->ResetAutoExposure(); // use max exposure duration
     }
 
@@ -675,7 +1141,7 @@ void GuiderOneStar::OnLClick(wxMouseEvent &mevent)
                 EvtServer.NotifyStarSelected(CurrentPosition());
                 SetState(STATE_SELECTED);
                 pFrame->UpdateButtonsStatus();
-                pFrame->pProfile->UpdateData(pImage, m_star.X, m_star.Y);
+                UpdateStarMetrics(pImage);
             }
 
             Refresh();
@@ -754,44 +1220,17 @@ void GuiderOneStar::OnPaint(wxPaintEvent& event)
             DrawBox(dc, m_star, m_searchRegion, m_scaleFactor);
         }
 
-        // Image logging
-        if (state >= STATE_SELECTED && pFrame->IsImageLoggingEnabled() && pFrame->m_frameCounter != pFrame->m_loggedImageFrame)
+        if (state >= STATE_SELECTED && state <= STATE_GUIDING && m_star.IsValid())
         {
-            // only log each image frame once
-            pFrame->m_loggedImageFrame = pFrame->m_frameCounter;
-
-            if (pFrame->GetLoggedImageFormat() == LIF_RAW_FITS) // Save star image as a FITS
-            {
-                SaveStarFITS();
-            }
-            else  // Save star image as a JPEG
+            // secondary stars
+            const std::vector<SecondaryStars::Entry>& stars = m_secondary->Stars();
+            for (std::vector<SecondaryStars::Entry>::const_iterator it = stars.begin(); it != stars.end(); ++it)
             {
-                double LockX = LockPosition().X;
-                double LockY = LockPosition().Y;
-
-                wxBitmap SubBmp(60,60,-1);
-                wxMemoryDC tmpMdc;
-                tmpMdc.SelectObject(SubBmp);
-                memDC.SetPen(wxPen(wxColor(0,255,0),1,wxDOT));
-                memDC.DrawLine(0, LockY * m_scaleFactor, XWinSize, LockY * m_scaleFactor);
-                memDC.DrawLine(LockX*m_scaleFactor, 0, LockX*m_scaleFactor, YWinSize);
-    #ifdef __APPLEX__
-                tmpMdc.Blit(0,0,60,60,&memDC,ROUND(m_star.X*m_scaleFactor)-30,Displayed_Image->GetHeight() - ROUND(m_star.Y*m_scaleFactor)-30,wxCOPY,false);
-    #else
-                tmpMdc.Blit(0,0,60,60,&memDC,ROUND(m_star.X*m_scaleFactor)-30,ROUND(m_star.Y*m_scaleFactor)-30,wxCOPY,false);
-    #endif
-                //          tmpMdc.Blit(0,0,200,200,&Cdc,0,0,wxCOPY);
-
-                wxString fname = Debug.GetLogDir() + PATHSEPSTR + "PHD_GuideStar" + wxDateTime::Now().Format(_T("_%j_%H%M%S")) + ".jpg";
-                wxImage subImg = SubBmp.ConvertToImage();
-                // subImg.Rescale(120, 120);  zoom up (not now)
-                if (pFrame->GetLoggedImageFormat() == LIF_HI_Q_JPEG)
-                {
-                    // set high(ish) JPEG quality
-                    subImg.SetOption(wxIMAGE_OPTION_QUALITY, 100);
-                }
-                subImg.SaveFile(fname, wxBITMAP_TYPE_JPEG);
-                tmpMdc.SelectObject(wxNullBitmap);
+                if (it->used)
+                    dc.SetPen(wxPen(wxColour(0,160,255), 1, wxSOLID));
+                else
+                    dc.SetPen(wxPen(wxColour(230,130,30), 1, wxDOT));
+                DrawBox(dc, m_star + it->offset, m_searchRegion / 2, m_scaleFactor);
             }
         }
     }
@@ -801,88 +1240,6 @@ void GuiderOneStar::OnPaint(wxPaintEvent& event)
     }
 }
 
-void GuiderOneStar::SaveStarFITS()
-{
-    double StarX = m_star.X;
-    double StarY = m_star.Y;
-    usImage *pImage = CurrentImage();
-    usImage tmpimg;
-
-    tmpimg.Init(60,60);
-    int start_x = ROUND(StarX)-30;
-    int start_y = ROUND(StarY)-30;
-    if ((start_x + 60) > pImage->Size.GetWidth())
-        start_x = pImage->Size.GetWidth() - 60;
-    if ((start_y + 60) > pImage->Size.GetHeight())
-        start_y = pImage->Size.GetHeight() - 60;
-    int x,y, width;
-    width = pImage->Size.GetWidth();
-    unsigned short *usptr = tmpimg.ImageData;
-    for (y=0; y<60; y++)
-        for (x=0; x<60; x++, usptr++)
-            *usptr = *(pImage->ImageData + (y+start_y)*width + (x+start_x));
-
-    wxString fname = Debug.GetLogDir() + PATHSEPSTR + "PHD_GuideStar" + wxDateTime::Now().Format(_T("_%j_%H%M%S")) + ".fit";
-
-    fitsfile *fptr;  // FITS file pointer
-    int status = 0;  // CFITSIO status value MUST be initialized to zero!
-    long fpixel[3] = {1,1,1};
-    long fsize[3];
-    char keyname[9]; // was 9
-    char keycomment[100];
-    char keystring[100];
-    int output_format=USHORT_IMG;
-
-    fsize[0] = 60;
-    fsize[1] = 60;
-    fsize[2] = 0;
-    PHD_fits_create_file(&fptr, fname, false, &status);
-    if (!status)
-    {
-        fits_create_img(fptr,output_format, 2, fsize, &status);
-
-        time_t now;
-        struct tm *timestruct;
-        time(&now);
-        timestruct=gmtime(&now);
-        sprintf(keyname,"DATE");
-        sprintf(keycomment,"UTC date that FITS file was created");
-        sprintf(keystring,"%.4d-%.2d-%.2d %.2d:%.2d:%.2d",timestruct->tm_year+1900,timestruct->tm_mon+1,timestruct->tm_mday,timestruct->tm_hour,timestruct->tm_min,timestruct->tm_sec);
-        if (!status) fits_write_key(fptr, TSTRING, keyname, keystring, keycomment, &status);
-
-        sprintf(keyname,"DATE-OBS");
-        sprintf(keycomment,"YYYY-MM-DDThh:mm:ss observation start, UT");
-        sprintf(keystring,"%s", (const char *) pImage->GetImgStartTime().c_str());
-        if (!status) fits_write_key(fptr, TSTRING, keyname, keystring, keycomment, &status);
-
-        sprintf(keyname,"EXPOSURE");
-        sprintf(keycomment,"Exposure time [s]");
-        float dur = (float) pImage->ImgExpDur / 1000.0;
-        if (!status) fits_write_key(fptr, TFLOAT, keyname, &dur, keycomment, &status);
-
-        unsigned int tmp = 1;
-        sprintf(keyname,"XBINNING");
-        sprintf(keycomment,"Camera binning mode");
-        fits_write_key(fptr, TUINT, keyname, &tmp, keycomment, &status);
-        sprintf(keyname,"YBINNING");
-        sprintf(keycomment,"Camera binning mode");
-        fits_write_key(fptr, TUINT, keyname, &tmp, keycomment, &status);
-
-        sprintf(keyname,"XORGSUB");
-        sprintf(keycomment,"Subframe x position in binned pixels");
-        tmp = start_x;
-        fits_write_key(fptr, TINT, keyname, &tmp, keycomment, &status);
-        sprintf(keyname,"YORGSUB");
-        sprintf(keycomment,"Subframe y position in binned pixels");
-        tmp = start_y;
-        fits_write_key(fptr, TINT, keyname, &tmp, keycomment, &status);
-
-        if (!status) fits_write_pix(fptr,TUSHORT,fpixel,tmpimg.NPixels,tmpimg.ImageData,&status);
-
-    }
-    PHD_fits_close_file(fptr);
-}
-
 wxString GuiderOneStar::GetSettingsSummary()
 {
     // return a loggable summary of guider configs
@@ -893,6 +1250,9 @@ wxString GuiderOneStar::GetSettingsSummary()
     else
         s += _T("disabled\n");
 
+    if (GetMultiStarEnabled())
+        s += wxString::Format(_T("Multi-star guiding, max %d stars\n"), GetMaxStars());
+
     return s;
 }
 
@@ -928,6 +1288,19 @@ GuiderOneStar::GuiderOneStarConfigDialogPane::GuiderOneStarConfigDialogPane(wxWi
           _("When star mass change detection is enabled, this is the tolerance for star mass changes between frames, in percent. "
           "Larger values are more tolerant (less sensitive) to star mass changes. Valid range is 10-100, default is 50. "
           "If star mass change detection is not enabled then this setting is ignored."));
+
+    m_pEnableMultiStar = new wxCheckBox(pParent, MULTI_STAR_ENABLE, _("Use multiple stars"));
+    DoAdd(m_pEnableMultiStar, _("Check to guide on several stars. When enabled, PHD tracks additional stars "
+        "chosen by Auto-select star along with the guide star and uses their weighted average position, "
+        "which reduces the effect of seeing and centroid noise."));
+
+    pParent->Bind(wxEVT_COMMAND_CHECKBOX_CLICKED, &GuiderOneStar::GuiderOneStarConfigDialogPane::OnMultiStarEnableChecked, this, MULTI_STAR_ENABLE);
+
+    width = StringWidth(_T("00"));
+    m_pMaxStars = new wxSpinCtrl(pParent, wxID_ANY, _T("foo2"), wxPoint(-1,-1),
+                                 wxSize(width+30, -1), wxSP_ARROW_KEYS, MIN_GUIDE_STARS, MAX_GUIDE_STARS, DEFAULT_GUIDE_STARS, _T("MaxStars"));
+    DoAdd(_("Max guide stars"), m_pMaxStars,
+          wxString::Format(_("Maximum number of stars used for multi-star guiding, including the guide star. Default = %d"), DEFAULT_GUIDE_STARS));
 }
 
 GuiderOneStar::GuiderOneStarConfigDialogPane::~GuiderOneStarConfigDialogPane(void)
@@ -943,6 +1316,10 @@ void GuiderOneStar::GuiderOneStarConfigDialogPane::LoadValues(void)
     m_pMassChangeThreshold->Enable(starMassEnabled);
     m_pMassChangeThreshold->SetValue(100.0 * m_pGuiderOneStar->GetMassChangeThreshold());
     m_pSearchRegion->SetValue(m_pGuiderOneStar->GetSearchRegion());
+    bool multiStar = m_pGuiderOneStar->GetMultiStarEnabled();
+    m_pEnableMultiStar->SetValue(multiStar);
+    m_pMaxStars->Enable(multiStar);
+    m_pMaxStars->SetValue(m_pGuiderOneStar->GetMaxStars());
 }
 
 void GuiderOneStar::GuiderOneStarConfigDialogPane::UnloadValues(void)
@@ -950,6 +1327,8 @@ void GuiderOneStar::GuiderOneStarConfigDialogPane::UnloadValues(void)
     m_pGuiderOneStar->SetMassChangeThresholdEnabled(m_pEnableStarMassChangeThresh->GetValue());
     m_pGuiderOneStar->SetMassChangeThreshold(m_pMassChangeThreshold->GetValue() / 100.0);
     m_pGuiderOneStar->SetSearchRegion(m_pSearchRegion->GetValue());
+    m_pGuiderOneStar->SetMultiStarEnabled(m_pEnableMultiStar->GetValue());
+    m_pGuiderOneStar->SetMaxStars(m_pMaxStars->GetValue());
 
     GuiderConfigDialogPane::UnloadValues();
 }
@@ -958,3 +1337,8 @@ void GuiderOneStar::GuiderOneStarConfigDialogPane::OnStarMassEnableChecked(wxCom
 {
     m_pMassChangeThreshold->Enable(event.IsChecked());
 }
+
+void GuiderOneStar::GuiderOneStarConfigDialogPane::OnMultiStarEnableChecked(wxCommandEvent& event)
+{
+    m_pMaxStars->Enable(event.IsChecked());
+}
@@ -41,17 +41,24 @@
 #define GUIDER_ONESTAR_H_INCLUDED
 
 class MassChecker;
+class SubframeTracker;
+class SecondaryStars;
 
 class GuiderOneStar : public Guider
 {
 private:
     Star m_star;
     MassChecker *m_massChecker;
+    SubframeTracker *m_subframe;
+    SecondaryStars *m_secondary;
+    StarMetrics m_metrics;
 
     // parameters
     bool m_massChangeThresholdEnabled;
     double m_massChangeThreshold;
     int m_searchRegion; // how far u/d/l/r do we do the initial search for a star
+    bool m_multiStarEnabled;
+    int m_maxStars;     // maximum number of guide stars, including the primary star
 
 protected:
     class GuiderOneStarConfigDialogPane : public GuiderConfigDialogPane
@@ -60,6 +67,8 @@ protected:
         wxSpinCtrl *m_pSearchRegion;
         wxCheckBox *m_pEnableStarMassChangeThresh;
         wxSpinCtrlDouble *m_pMassChangeThreshold;
+        wxCheckBox *m_pEnableMultiStar;
+        wxSpinCtrl *m_pMaxStars;
 
         public:
         GuiderOneStarConfigDialogPane(wxWindow *pParent, GuiderOneStar *pGuider);
@@ -69,6 +78,7 @@ protected:
         virtual void UnloadValues(void);
 
         void OnStarMassEnableChecked(wxCommandEvent& event);
+        void OnMultiStarEnableChecked(wxCommandEvent& event);
     };
 
     virtual bool GetMassChangeThresholdEnabled(void);
@@ -77,6 +87,10 @@ protected:
     virtual bool SetMassChangeThreshold(double starMassChangeThreshold);
     virtual int GetSearchRegion(void);
     virtual bool SetSearchRegion(int searchRegion);
+    virtual bool GetMultiStarEnabled(void);
+    virtual void SetMultiStarEnabled(bool enable);
+    virtual int GetMaxStars(void);
+    virtual bool SetMaxStars(int maxStars);
 
     friend class GuiderOneStarConfigDialogPane;
 
@@ -93,6 +107,9 @@ public:
     virtual int GetMaxMovePixels(void);
     virtual double StarMass(void);
     virtual double SNR(void);
+    virtual double HFD(void);
+    virtual double FWHM(void);
+    virtual const StarMetrics& CurrentStarMetrics(void);
     virtual int StarError(void);
     virtual wxString GetSettingsSummary();
 
@@ -105,11 +122,11 @@ private:
     virtual void InvalidateCurrentPosition(bool fullReset = false);
     virtual bool UpdateCurrentPosition(usImage *pImage, FrameDroppedInfo *errorInfo);
     virtual bool SetCurrentPosition(usImage *pImage, const PHD_Point& position);
+    void SelectSecondaryStars(const usImage *pImage, const std::vector<PHD_Point>& candidates);
+    void UpdateStarMetrics(usImage *pImage);
 
     void OnLClick(wxMouseEvent& evt);
 
-    void SaveStarFITS();
-
     DECLARE_EVENT_TABLE()
 };
 
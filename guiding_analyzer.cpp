@@ -0,0 +1,614 @@
+/*
+ *  guiding_analyzer.cpp
+ *  PHD Guiding
+ *
+ *  Created by the PHD2 developers
+ *  Copyright (c) 2014 PHD2 Developers
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of Craig Stark, Stark Labs nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "phd.h"
+#include "guiding_analyzer.h"
+
+#include <algorithm>
+
+// range of periodic error periods looked for, seconds
+static const double MinPEPeriod = 60.0;
+static const double MaxPEPeriod = 1200.0;
+// a period is only considered once the window spans this many cycles
+static const double MinPECycles = 2.0;
+// a peak must stand out this much from the average of the spectrum
+static const double PEPeakRatio = 2.0;
+// periods found in the spectrum are refined this often, in samples
+static const unsigned int RefineInterval = 32;
+
+static double BinPeriod(double k)
+{
+    return MinPEPeriod * pow(MaxPEPeriod / MinPEPeriod, k / (double) (PESpectrum::NumBins - 1));
+}
+
+void LinearFit::Reset(void)
+{
+    n = st = stt = sx = stx = 0.0;
+}
+
+void LinearFit::Add(double t, double x, double w)
+{
+    n += w;
+    st += w * t;
+    stt += w * t * t;
+    sx += w * x;
+    stx += w * t * x;
+}
+
+bool LinearFit::Solve(double *intercept, double *slope) const
+{
+    double const d = n * stt - st * st;
+    if (n < 2.0 || d <= 0.0)
+        return false;
+
+    *slope = (n * stx - st * sx) / d;
+    *intercept = (sx - *slope * st) / n;
+    return true;
+}
+
+PESpectrum::PESpectrum()
+{
+    Reset();
+}
+
+void PESpectrum::Reset(void)
+{
+    m_window.Reset();
+
+    for (int k = 0; k < NumBins; k++)
+    {
+        Bin& bin = m_bins[k];
+        bin.omega = 2.0 * M_PI / BinPeriod(k);
+        bin.c0re = bin.c0im = 0.0;
+        bin.c1re = bin.c1im = 0.0;
+        bin.xre = bin.xim = 0.0;
+    }
+
+    m_head = 0;
+    m_count = 0;
+    m_sinceRebuild = 0;
+}
+
+void PESpectrum::UpdateBins(double t, double x, double w)
+{
+    for (int k = 0; k < NumBins; k++)
+    {
+        Bin& bin = m_bins[k];
+        double const c = w * cos(bin.omega * t);
+        double const s = -w * sin(bin.omega * t);
+        bin.c0re += c;
+        bin.c0im += s;
+        bin.c1re += t * c;
+        bin.c1im += t * s;
+        bin.xre += x * c;
+        bin.xim += x * s;
+    }
+}
+
+// recompute the window sums from scratch so that rounding errors from
+// removing samples do not accumulate
+void PESpectrum::Rebuild(void)
+{
+    m_window.Reset();
+    for (int k = 0; k < NumBins; k++)
+    {
+        Bin& bin = m_bins[k];
+        bin.c0re = bin.c0im = 0.0;
+        bin.c1re = bin.c1im = 0.0;
+        bin.xre = bin.xim = 0.0;
+    }
+
+    for (unsigned int i = 0; i < m_count; i++)
+    {
+        const Sample& s = At(i);
+        m_window.Add(s.t, s.x, 1.0);
+        UpdateBins(s.t, s.x, 1.0);
+    }
+
+    m_sinceRebuild = 0;
+}
+
+void PESpectrum::Add(double t, double x)
+{
+    if (m_count == RingSize)
+    {
+        // slide the window, dropping the oldest sample
+        const Sample& old = m_ring[m_head];
+        m_window.Add(old.t, old.x, -1.0);
+        UpdateBins(old.t, old.x, -1.0);
+        --m_count;
+    }
+
+    m_ring[m_head].t = t;
+    m_ring[m_head].x = x;
+    m_head = (m_head + 1) % RingSize;
+    ++m_count;
+
+    m_window.Add(t, x, 1.0);
+    UpdateBins(t, x, 1.0);
+
+    if (++m_sinceRebuild >= RingSize)
+        Rebuild();
+}
+
+const PESpectrum::Sample& PESpectrum::At(unsigned int i) const
+{
+    return m_ring[(m_head + RingSize - m_count + i) % RingSize];
+}
+
+double PESpectrum::Span(void) const
+{
+    return m_count > 1 ? At(m_count - 1).t - At(0).t : 0.0;
+}
+
+struct PeakGreater
+{
+    bool operator()(const PESpectrum::Peak& a, const PESpectrum::Peak& b) const { return a.amplitude > b.amplitude; }
+};
+
+int PESpectrum::FindPeaks(Peak *peaks, int maxPeaks) const
+{
+    // the spectrum is taken after removing the trend over the window
+    double a, b;
+    if (m_count < 16 || !m_window.Solve(&a, &b))
+        return 0;
+
+    double const span = Span();
+
+    double mag[NumBins];
+    int count = 0;
+    double sum = 0.0;
+
+    for (int k = 0; k < NumBins; k++)
+    {
+        if (span < MinPECycles * BinPeriod(k))
+        {
+            mag[k] = -1.0;
+            continue;
+        }
+
+        const Bin& bin = m_bins[k];
+        double const re = bin.xre - a * bin.c0re - b * bin.c1re;
+        double const im = bin.xim - a * bin.c0im - b * bin.c1im;
+        mag[k] = sqrt(re * re + im * im);
+
+        sum += mag[k];
+        ++count;
+    }
+
+    if (count < 3)
+        return 0;
+
+    double const threshold = PEPeakRatio * sum / (double) count;
+
+    std::vector<Peak> found;
+    for (int k = 0; k < NumBins; k++)
+    {
+        double const prev = k > 0 ? mag[k - 1] : -1.0;
+        double const next = k < NumBins - 1 ? mag[k + 1] : -1.0;
+
+        if (mag[k] < threshold || mag[k] < prev || mag[k] < next)
+            continue;
+
+        // interpolate the peak position between the neighboring bins
+        double kpeak = k;
+        if (prev >= 0.0 && next >= 0.0)
+        {
+            double const d = prev - 2.0 * mag[k] + next;
+            if (d < 0.0)
+                kpeak += 0.5 * (prev - next) / d;
+        }
+
+        Peak pk;
+        pk.period = BinPeriod(kpeak);
+        pk.amplitude = 2.0 * mag[k] / (double) m_count;
+        found.push_back(pk);
+    }
+
+    std::sort(found.begin(), found.end(), PeakGreater());
+
+    int n = wxMin((int) found.size(), maxPeaks);
+    for (int i = 0; i < n; i++)
+        peaks[i] = found[i];
+
+    return n;
+}
+
+void GuidingAnalyzer::HPFStats::Init(double hpfCutoffPeriod, double samplePeriod)
+{
+    alpha = hpfCutoffPeriod / (hpfCutoffPeriod + samplePeriod);
+    n = 0;
+    a = 0.0;
+    q = 0.0;
+    hpf = lpf = xprev = 0.0;
+    peakRawDx = 0.0;
+}
+
+void GuidingAnalyzer::HPFStats::AddSample(double x)
+{
+    if (n == 0)
+    {
+        // first point
+        hpf = lpf = x;
+    }
+    else
+    {
+        hpf = alpha * (hpf + x - xprev);
+        lpf += (1.0 - alpha) * (x - xprev);
+    }
+
+    if (n >= 1)
+    {
+        double const dx = fabs(x - xprev);
+        if (dx > peakRawDx)
+            peakRawDx = dx;
+    }
+
+    xprev = x;
+
+    x = hpf;
+    ++n;
+    double const k = (double) n;
+    double const a0 = a;
+    a += (x - a) / k;
+    q += (x - a0) * (x - a);
+}
+
+double GuidingAnalyzer::HPFStats::Stdev(void) const
+{
+    return n > 0 ? sqrt(q / (double) n) : 0.0;
+}
+
+GuidingAnalyzer::GuidingAnalyzer()
+{
+    Reset(6.0, 1.0);
+}
+
+void GuidingAnalyzer::Reset(double hpfCutoffPeriod, double samplePeriod)
+{
+    m_ra.Init(hpfCutoffPeriod, samplePeriod);
+    m_dec.Init(hpfCutoffPeriod, samplePeriod);
+    m_raTrend.Reset();
+    m_decTrend.Reset();
+    m_raSpectrum.Reset();
+
+    m_t0 = 0.0;
+    m_minRA = m_maxRA = 0.0;
+    m_lastTime = 0.0;
+    m_maxRateRA = 0.0;
+    m_sumSNR = 0.0;
+    m_sumMass = 0.0;
+}
+
+void GuidingAnalyzer::AddSample(double time, double ra, double dec, double snr, double mass)
+{
+    double const prevRAlpf = m_ra.lpf;
+
+    m_ra.AddSample(ra);
+    m_dec.AddSample(dec);
+
+    if (m_ra.n == 1)
+    {
+        m_t0 = time;
+        m_minRA = m_maxRA = ra;
+        m_maxRateRA = 0.0;
+    }
+    else
+    {
+        if (ra < m_minRA)
+            m_minRA = ra;
+        if (ra > m_maxRA)
+            m_maxRA = ra;
+
+        double dt = time - m_lastTime;
+        if (dt > 0.0001)
+        {
+            double raRate = fabs(m_ra.lpf - prevRAlpf) / dt;
+            if (raRate > m_maxRateRA)
+                m_maxRateRA = raRate;
+        }
+    }
+
+    m_lastTime = time;
+    m_sumSNR += snr;
+    m_sumMass += mass;
+
+    double const t = time - m_t0;
+
+    m_raTrend.Add(t, ra, 1.0);
+    m_decTrend.Add(t, dec, 1.0);
+    m_raSpectrum.Add(t, ra);
+}
+
+double GuidingAnalyzer::RADriftRate(void) const
+{
+    double intercept, slope;
+    return m_raTrend.Solve(&intercept, &slope) ? slope * 60.0 : 0.0;
+}
+
+double GuidingAnalyzer::DecDriftRate(void) const
+{
+    double intercept, slope;
+    return m_decTrend.Solve(&intercept, &slope) ? slope * 60.0 : 0.0;
+}
+
+double GuidingAnalyzer::AvgSNR(void) const
+{
+    return m_ra.n > 0 ? m_sumSNR / (double) m_ra.n : 0.0;
+}
+
+double GuidingAnalyzer::AvgMass(void) const
+{
+    return m_ra.n > 0 ? m_sumMass / (double) m_ra.n : 0.0;
+}
+
+GuidingAnalyzer::PeriodicError GuidingAnalyzer::RAPeriodicError(void) const
+{
+    PeriodicError pe;
+    PESpectrum::Peak peak;
+
+    pe.valid = m_raSpectrum.FindPeaks(&peak, 1) > 0;
+    pe.period = pe.valid ? peak.period : 0.0;
+    pe.amplitude = pe.valid ? peak.amplitude : 0.0;
+
+    return pe;
+}
+
+PEPredictor::PEPredictor()
+    : m_fixedPeriod(0.0)
+{
+    Reset();
+}
+
+void PEPredictor::Reset(void)
+{
+    m_spectrum.Reset();
+    m_valid = false;
+    m_numTerms = 0;
+    m_slope = 0.0;
+    m_foundTerms = 0;
+    m_sinceRefine = RefineInterval;
+}
+
+void PEPredictor::SetPeriod(double period)
+{
+    m_fixedPeriod = period;
+    m_sinceRefine = RefineInterval;
+}
+
+// magnitude of the DFT of the detrended samples at frequency omega
+double PEPredictor::Power(double omega, double a, double b) const
+{
+    double re = 0.0;
+    double im = 0.0;
+
+    for (unsigned int i = 0; i < m_spectrum.Count(); i++)
+    {
+        const PESpectrum::Sample& s = m_spectrum.At(i);
+        double const r = s.x - a - b * s.t;
+        re += r * cos(omega * s.t);
+        im -= r * sin(omega * s.t);
+    }
+
+    return re * re + im * im;
+}
+
+// The spectrum bins are several percent apart. Over a window of many cycles
+// that is enough for a fitted sinusoid to drift out of phase with the data,
+// so search for the exact peak near each period found.
+void PEPredictor::FindPeriods(void)
+{
+    PESpectrum::Peak peaks[MaxTerms];
+    m_foundTerms = m_spectrum.FindPeaks(peaks, MaxTerms);
+
+    LinearFit trend;
+    trend.Reset();
+    for (unsigned int i = 0; i < m_spectrum.Count(); i++)
+        trend.Add(m_spectrum.At(i).t, m_spectrum.At(i).x, 1.0);
+
+    double a, b;
+    if (!trend.Solve(&a, &b))
+    {
+        m_foundTerms = 0;
+        return;
+    }
+
+    static const double golden = 0.618033988749895;
+
+    for (int i = 0; i < m_foundTerms; i++)
+    {
+        // golden section search over +/- 4% of the period
+        double lo = 2.0 * M_PI / (peaks[i].period * 1.04);
+        double hi = 2.0 * M_PI / (peaks[i].period / 1.04);
+        double w1 = hi - golden * (hi - lo);
+        double w2 = lo + golden * (hi - lo);
+        double p1 = Power(w1, a, b);
+        double p2 = Power(w2, a, b);
+
+        for (int iter = 0; iter < 16; iter++)
+        {
+            if (p1 > p2)
+            {
+                hi = w2;
+                w2 = w1;
+                p2 = p1;
+                w1 = hi - golden * (hi - lo);
+                p1 = Power(w1, a, b);
+            }
+            else
+            {
+                lo = w1;
+                w1 = w2;
+                p1 = p2;
+                w2 = lo + golden * (hi - lo);
+                p2 = Power(w2, a, b);
+            }
+        }
+
+        m_foundOmega[i] = 0.5 * (lo + hi);
+    }
+}
+
+// solve the n x n system in the first n columns of m with right-hand side
+// in column n, by Gaussian elimination with partial pivoting
+static bool SolveLinear(double m[][2 + 2 * PEPredictor::MaxTerms + 1], int n, double *x)
+{
+    for (int col = 0; col < n; col++)
+    {
+        int pivot = col;
+        for (int r = col + 1; r < n; r++)
+            if (fabs(m[r][col]) > fabs(m[pivot][col]))
+                pivot = r;
+
+        if (fabs(m[pivot][col]) < 1e-12)
+            return false;
+
+        if (pivot != col)
+            for (int c = 0; c <= n; c++)
+                std::swap(m[pivot][c], m[col][c]);
+
+        for (int r = col + 1; r < n; r++)
+        {
+            double const f = m[r][col] / m[col][col];
+            for (int c = col; c <= n; c++)
+                m[r][c] -= f * m[col][c];
+        }
+    }
+
+    for (int r = n - 1; r >= 0; r--)
+    {
+        double sum = m[r][n];
+        for (int c = r + 1; c < n; c++)
+            sum -= m[r][c] * x[c];
+        x[r] = sum / m[r][r];
+    }
+
+    return true;
+}
+
+bool PEPredictor::Fit(void)
+{
+    m_valid = false;
+
+    if (m_fixedPeriod > 0.0)
+    {
+        // a known worm period, fit it and its first harmonics once a full
+        // cycle has been seen
+        if (m_spectrum.Span() < m_fixedPeriod)
+            return false;
+
+        for (int i = 0; i < MaxTerms; i++)
+            m_omega[i] = 2.0 * M_PI * (double) (i + 1) / m_fixedPeriod;
+        m_numTerms = MaxTerms;
+    }
+    else
+    {
+        if (++m_sinceRefine >= RefineInterval)
+        {
+            FindPeriods();
+            m_sinceRefine = 0;
+        }
+        m_numTerms = m_foundTerms;
+        for (int i = 0; i < m_numTerms; i++)
+            m_omega[i] = m_foundOmega[i];
+    }
+
+    int const np = 2 + 2 * m_numTerms;
+    unsigned int const n = m_spectrum.Count();
+
+    if (m_numTerms == 0 || n < (unsigned int) (4 * np))
+        return false;
+
+    // least squares fit of x = a + b (t - tmid) + sum(c cos(w t) + s sin(w t))
+    double m[2 + 2 * MaxTerms][2 + 2 * MaxTerms + 1];
+    for (int r = 0; r < np; r++)
+        for (int c = 0; c <= np; c++)
+            m[r][c] = 0.0;
+
+    double const tmid = 0.5 * (m_spectrum.At(0).t + m_spectrum.At(n - 1).t);
+
+    for (unsigned int i = 0; i < n; i++)
+    {
+        const PESpectrum::Sample& s = m_spectrum.At(i);
+
+        double phi[2 + 2 * MaxTerms];
+        phi[0] = 1.0;
+        phi[1] = s.t - tmid;
+        for (int j = 0; j < m_numTerms; j++)
+        {
+            phi[2 + 2 * j] = cos(m_omega[j] * s.t);
+            phi[3 + 2 * j] = sin(m_omega[j] * s.t);
+        }
+
+        for (int r = 0; r < np; r++)
+        {
+            for (int c = r; c < np; c++)
+                m[r][c] += phi[r] * phi[c];
+            m[r][np] += phi[r] * s.x;
+        }
+    }
+
+    for (int r = 1; r < np; r++)
+        for (int c = 0; c < r; c++)
+            m[r][c] = m[c][r];
+
+    double coef[2 + 2 * MaxTerms];
+    if (!SolveLinear(m, np, coef))
+        return false;
+
+    m_slope = coef[1];
+    for (int j = 0; j < m_numTerms; j++)
+    {
+        m_cos[j] = coef[2 + 2 * j];
+        m_sin[j] = coef[3 + 2 * j];
+    }
+
+    m_valid = true;
+    return true;
+}
+
+double PEPredictor::Predict(double t0, double t1) const
+{
+    if (!m_valid)
+        return 0.0;
+
+    double dx = m_slope * (t1 - t0);
+    for (int j = 0; j < m_numTerms; j++)
+    {
+        dx += m_cos[j] * (cos(m_omega[j] * t1) - cos(m_omega[j] * t0));
+        dx += m_sin[j] * (sin(m_omega[j] * t1) - sin(m_omega[j] * t0));
+    }
+
+    return dx;
+}
@@ -0,0 +1,222 @@
+/*
+ *  guiding_analyzer.h
+ *  PHD Guiding
+ *
+ *  Created by the PHD2 developers
+ *  Copyright (c) 2014 PHD2 Developers
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of Craig Stark, Stark Labs nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef GUIDING_ANALYZER_INCLUDED
+#define GUIDING_ANALYZER_INCLUDED
+
+// least-squares line through (t, x)
+struct LinearFit
+{
+    double n;
+    double st;
+    double stt;
+    double sx;
+    double stx;
+
+    void Reset(void);
+    void Add(double t, double x, double w);     // w = -1 removes a point
+    bool Solve(double *intercept, double *slope) const;
+};
+
+// Spectrum of the most recent samples of a signal at a bank of trial
+// periods, with the linear trend over the window removed. The spectrum is
+// updated in constant time per sample as the window slides.
+class PESpectrum
+{
+public:
+    enum
+    {
+        RingSize = 2048,        // samples in the window
+        NumBins = 48            // trial periods, log-spaced
+    };
+
+    struct Sample
+    {
+        double t;
+        double x;
+    };
+
+    struct Peak
+    {
+        double period;          // seconds
+        double amplitude;       // half the peak-peak excursion
+    };
+
+private:
+    // sums for a DFT at one trial frequency over the samples in the window
+    struct Bin
+    {
+        double omega;
+        double c0re, c0im;      // sum of exp(-i w t)
+        double c1re, c1im;      // sum of t exp(-i w t)
+        double xre, xim;        // sum of x exp(-i w t)
+    };
+
+    LinearFit m_window;
+    Bin m_bins[NumBins];
+    Sample m_ring[RingSize];
+    unsigned int m_head;
+    unsigned int m_count;
+    unsigned int m_sinceRebuild;
+
+    void UpdateBins(double t, double x, double w);
+    void Rebuild(void);
+
+public:
+    PESpectrum();
+
+    void Reset(void);
+    void Add(double t, double x);
+
+    unsigned int Count(void) const { return m_count; }
+    const Sample& At(unsigned int i) const;     // 0 is the oldest sample
+    double Span(void) const;
+
+    // the strongest periodic terms, strongest first; returns the number found
+    int FindPeaks(Peak *peaks, int maxPeaks) const;
+};
+
+// Model of the uncorrected RA motion: a line for the drift plus sinusoids
+// at the strongest periods in its spectrum, or at a known worm period and
+// its harmonics. Kept free of any UI so it can be driven from recorded or
+// simulated data.
+class PEPredictor
+{
+public:
+    enum { MaxTerms = 3 };
+
+private:
+    PESpectrum m_spectrum;
+    double m_fixedPeriod;           // 0 to search the spectrum for periods
+    bool m_valid;
+    int m_numTerms;
+    double m_omega[MaxTerms];
+    double m_cos[MaxTerms];
+    double m_sin[MaxTerms];
+    double m_slope;
+
+    // periods found in the spectrum, refined every so many samples
+    int m_foundTerms;
+    double m_foundOmega[MaxTerms];
+    unsigned int m_sinceRefine;
+
+    double Power(double omega, double a, double b) const;
+    void FindPeriods(void);
+
+public:
+    PEPredictor();
+
+    void Reset(void);
+    void SetPeriod(double period);
+    void AddSample(double t, double x) { m_spectrum.Add(t, x); }
+    unsigned int SampleCount(void) const { return m_spectrum.Count(); }
+
+    bool Fit(void);
+    bool IsValid(void) const { return m_valid; }
+    int NumTerms(void) const { return m_numTerms; }
+    double TermPeriod(int i) const { return 2.0 * M_PI / m_omega[i]; }
+    double TermAmplitude(int i) const { return hypot(m_cos[i], m_sin[i]); }
+
+    // predicted change in position from t0 to t1
+    double Predict(double t0, double t1) const;
+};
+
+// Streaming analysis of the unguided star motion measured by the Guiding
+// Assistant. Each sample is folded into running sums in constant time, so
+// every result can be read at any point during the measurement.
+class GuidingAnalyzer
+{
+public:
+    struct PeriodicError
+    {
+        bool valid;
+        double period;          // seconds
+        double amplitude;       // pixels, half the peak-peak excursion
+    };
+
+private:
+    // high-pass filtered RMS, peak sample-sample deflection and a low-pass
+    // filtered position for the drift rate
+    struct HPFStats
+    {
+        double alpha;
+        unsigned int n;
+        double a;
+        double q;
+        double hpf;
+        double lpf;
+        double xprev;
+        double peakRawDx;
+
+        void Init(double hpfCutoffPeriod, double samplePeriod);
+        void AddSample(double x);
+        double Stdev(void) const;
+    };
+
+    HPFStats m_ra;
+    HPFStats m_dec;
+    LinearFit m_raTrend;        // whole measurement
+    LinearFit m_decTrend;
+    PESpectrum m_raSpectrum;
+    double m_t0;
+    double m_minRA;
+    double m_maxRA;
+    double m_lastTime;
+    double m_maxRateRA;
+    double m_sumSNR;
+    double m_sumMass;
+
+public:
+    GuidingAnalyzer();
+
+    void Reset(double hpfCutoffPeriod, double samplePeriod);
+    void AddSample(double time, double ra, double dec, double snr, double mass);
+
+    unsigned int SampleCount(void) const { return m_ra.n; }
+    double RARms(void) const { return m_ra.Stdev(); }
+    double DecRms(void) const { return m_dec.Stdev(); }
+    double RAPeak(void) const { return m_ra.peakRawDx; }
+    double DecPeak(void) const { return m_dec.peakRawDx; }
+    double RAPeakPeak(void) const { return m_maxRA - m_minRA; }
+    double RAMaxDriftRate(void) const { return m_maxRateRA; }  // px per second
+    double RADriftRate(void) const;                             // px per minute
+    double DecDriftRate(void) const;                            // px per minute
+    double AvgSNR(void) const;
+    double AvgMass(void) const;
+
+    // the strongest periodic term in the RA motion, evaluated on demand
+    PeriodicError RAPeriodicError(void) const;
+};
+
+#endif
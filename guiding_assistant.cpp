@@ -35,76 +35,8 @@
 #include "phd.h"
 #include "guiding_assistant.h"
 
-struct Stats
-{
-    double alpha;
-    unsigned int n;
-    double sum;
-    double a;
-    double q;
-    double hpf;
-    double lpf;
-    double xprev;
-    double peakRawDx;
-
-    void InitStats(double hpfCutoffPeriod, double samplePeriod)
-    {
-        alpha = hpfCutoffPeriod / (hpfCutoffPeriod + samplePeriod);
-        Reset();
-    }
-
-    void Reset()
-    {
-        n = 0;
-        sum = 0.0;
-        a = 0.0;
-        q = 0.0;
-        peakRawDx = 0.0;
-    }
-
-    void AddSample(double x)
-    {
-        if (n == 0)
-        {
-            // first point
-            hpf = lpf = x;
-        }
-        else
-        {
-            hpf = alpha * (hpf + x - xprev);
-            lpf += (1.0 - alpha) * (x - xprev);
-        }
-
-        if (n >= 1)
-        {
-            double const dx = fabs(x - xprev);
-            if (dx > peakRawDx)
-                peakRawDx = dx;
-        }
-
-        xprev = x;
-
-        x = hpf;
-        ++n;
-        double const k = (double) n;
-        double const a0 = a;
-        a += (x - a) / k;
-        q += (x - a0) * (x - a);
-    }
-
-    void GetMeanAndStdev(double *mean, double *stdev)
-    {
-        if (n == 0)
-        {
-            *mean = *stdev = 0.0;
-            return;
-        }
-
-        double const nn = (double) n;
-        *mean = sum / nn;
-        *stdev = sqrt(q / nn);
-    }
-};
+// minimum interval between refreshes of the result grids
+static const int GridRefreshIntervalMs = 1000;
 
 inline static void StartRow(int& row, int& column)
 {
@@ -159,6 +91,8 @@ struct GuidingAsstWin : public wxDialog
     wxGridCellCoords m_dec_drift_as_loc;
     wxGridCellCoords m_ra_peak_drift_px_loc;
     wxGridCellCoords m_ra_peak_drift_as_loc;
+    wxGridCellCoords m_ra_pe_px_loc;
+    wxGridCellCoords m_ra_pe_as_loc;
     wxButton* m_raMinMoveButton;
     wxButton* m_decMinMoveButton;
     wxStaticText* m_ra_msg;
@@ -168,17 +102,10 @@ struct GuidingAsstWin : public wxDialog
     DialogState m_dlgState;
     bool m_measuring;
     wxLongLong_t m_startTime;
-    PHD_Point m_startPos;
+    wxLongLong_t m_lastRefresh;
     wxString startStr;
     double m_freqThresh;
-    Stats m_statsRA;
-    Stats m_statsDec;
-    double sumSNR;
-    double sumMass;
-    double minRA;
-    double maxRA;
-    double m_lastTime;
-    double maxRateRA; // arc-sec per second
+    GuidingAnalyzer m_analyzer;
 
     bool m_savePrimaryMountEnabled;
     bool m_saveSecondaryMountEnabled;
@@ -199,6 +126,7 @@ struct GuidingAsstWin : public wxDialog
     wxStaticText* AddRecommendationEntry(const wxString& msg, wxObjectEventFunction handler, wxButton** ppButton);
     wxStaticText* AddRecommendationEntry(const wxString& msg);
     void UpdateInfo(const GuideStepInfo& info);
+    void RefreshGrids(void);
     void FillInstructions(DialogState eState);
     void MakeRecommendations();
 };
@@ -307,7 +235,7 @@ GuidingAsstWin::GuidingAsstWin()
     // Start of "Other" (peak and drift) group
     wxStaticBoxSizer* other_group = new wxStaticBoxSizer(wxVERTICAL, this, _("Other Star Motion"));
     m_othergrid = new wxGrid(this, wxID_ANY);
-    m_othergrid->CreateGrid(6, 3);
+    m_othergrid->CreateGrid(7, 3);
     m_othergrid->GetGridWindow()->Bind(wxEVT_MOTION, &GuidingAsstWin::OnMouseMove, this, wxID_ANY, wxID_ANY, new GridTooltipInfo(m_othergrid, 3));
     m_othergrid->SetRowLabelSize(1);
     m_othergrid->SetColLabelSize(1);
@@ -345,6 +273,11 @@ GuidingAsstWin::GuidingAsstWin()
     m_dec_drift_px_loc.Set(row, col++);
     m_dec_drift_as_loc.Set(row, col++);
 
+    StartRow(row, col);
+    m_othergrid->SetCellValue(_("Right ascension Periodic Error"), row, col++);
+    m_ra_pe_px_loc.Set(row, col++);
+    m_ra_pe_as_loc.Set(row, col++);
+
     other_group->Add(m_othergrid);
     m_vSizer->Add(other_group, wxSizerFlags(0).Border(wxALL, 8));
     // End of peak and drift group
@@ -435,6 +368,7 @@ static bool GetGridToolTip(int gridNum, const wxGridCellCoords& coords, wxString
         case 303: *s = _("Estimated overall drift rate in right ascension."); break;
         case 304: *s = _("Maximum drift rate in right ascension during sampling period; may be useful for setting exposure time."); break;
         case 305: *s = _("Estimated overall drift rate in declination."); break;
+        case 306: *s = _("Peak-peak amplitude and period of the strongest periodic motion in right ascension, usually the mount's periodic error. Needs a measurement lasting at least two periods."); break;
 
         default: return false;
     }
@@ -495,9 +429,7 @@ void GuidingAsstWin::OnRAMinMove(wxCommandEvent& event)
 
     if (raAlgo)
     {
-        double ramean;
-        double rarms;
-        m_statsRA.GetMeanAndStdev(&ramean, &rarms);
+        double rarms = m_analyzer.RARms();
         rarms = (round((rarms * 100) / 5.0) * 5) / 100.0;
         if (raAlgo->GetMinMove() >= 0)
         {
@@ -518,13 +450,11 @@ void GuidingAsstWin::OnRAMinMove(wxCommandEvent& event)
 
 void GuidingAsstWin::OnDecMinMove(wxCommandEvent& event)
 {
-    double decmean;
-    double decrms;
     GuideAlgorithm *decAlgo = pMount->GetYGuideAlgorithm();
 
     if (decAlgo)
     {
-        m_statsDec.GetMeanAndStdev(&decmean, &decrms);
+        double decrms = m_analyzer.DecRms();
         decrms = (round((decrms * 100) / 5.0) * 5) / 100.0;
         if (decAlgo->GetMinMove() >= 0)
         {
@@ -571,15 +501,11 @@ wxStaticText* GuidingAsstWin::AddRecommendationEntry(const wxString& msg)
 
 void GuidingAsstWin::MakeRecommendations()
 {
-    double rarms;
-    double ramean;
-    double decrms;
-    double decmean;
+    double rarms = m_analyzer.RARms();
+    double decrms = m_analyzer.DecRms();
     double rounded_rarms;
     double rounded_decrms;
 
-    m_statsRA.GetMeanAndStdev(&ramean, &rarms);
-    m_statsDec.GetMeanAndStdev(&decmean, &decrms);
     // Don't over-state the accuracy here - set things to the nearest .05
     rounded_rarms = (round((rarms * 100) / 5.0) * 5) / 100.0;
     rounded_decrms = (round((decrms * 100) / 5.0) * 5) / 100.0;
@@ -614,7 +540,7 @@ void GuidingAsstWin::MakeRecommendations()
         }
     }
 
-    if ((sumSNR / (double)m_statsRA.n) < 10)
+    if (m_analyzer.AvgSNR() < 10)
     {
         if (m_snr_msg == NULL)
             m_snr_msg = AddRecommendationEntry(_("Consider using a brighter star or increasing the exposure time"));
@@ -637,10 +563,7 @@ void GuidingAsstWin::OnStart(wxCommandEvent& event)
     double exposure = (double) pFrame->RequestedExposureDuration() / 1000.0;
     double cutoff = wxMax(6.0, 3.0 * exposure);
     m_freqThresh = 1.0 / cutoff;
-    m_statsRA.InitStats(cutoff, exposure);
-    m_statsDec.InitStats(cutoff, exposure);
-
-    sumSNR = sumMass = 0.0;
+    m_analyzer.Reset(cutoff, exposure);
 
     m_start->Enable(false);
     m_stop->Enable(true);
@@ -667,11 +590,15 @@ void GuidingAsstWin::OnStart(wxCommandEvent& event)
     startStr = wxDateTime::Now().FormatISOCombined(' ');
     m_measuring = true;
     m_startTime = ::wxGetUTCTimeMillis().GetValue();
+    m_lastRefresh = 0;
     SetSizerAndFit(m_vSizer);
 }
 
 void GuidingAsstWin::DoStop(const wxString& status)
 {
+    if (m_measuring && m_analyzer.SampleCount() > 0)
+        RefreshGrids(); // show the final values
+
     m_measuring = false;
 
     m_recommendgrid->Show(true);
@@ -733,57 +660,32 @@ void GuidingAsstWin::OnClose(wxCloseEvent& evt)
 
 void GuidingAsstWin::UpdateInfo(const GuideStepInfo& info)
 {
-    double ra = info.mountOffset->X;
-    double dec = info.mountOffset->Y;
-    double prevRAlpf = m_statsRA.lpf;
+    m_analyzer.AddSample(info.time, info.mountOffset->X, info.mountOffset->Y, info.starSNR, info.starMass);
 
-    m_statsRA.AddSample(ra);
-    m_statsDec.AddSample(dec);
-
-    if (m_statsRA.n == 1)
+    // formatting the grids costs more than the analysis, do not do it every frame
+    wxLongLong_t now = ::wxGetUTCTimeMillis().GetValue();
+    if (now - m_lastRefresh >= GridRefreshIntervalMs)
     {
-        minRA = maxRA = ra;
-        m_startPos = *info.mountOffset;
-        maxRateRA = 0.0;
+        m_lastRefresh = now;
+        RefreshGrids();
     }
-    else
-    {
-        if (ra < minRA)
-            minRA = ra;
-        if (ra > maxRA)
-            maxRA = ra;
-
-        double dt = info.time - m_lastTime;
-        if (dt > 0.0001)
-        {
-            double raRate = fabs(m_statsRA.lpf - prevRAlpf) / dt;
-            if (raRate > maxRateRA)
-                maxRateRA = raRate;
-        }
-    }
-    double rangeRA = maxRA - minRA;
-    double driftRA = ra - m_startPos.X;
-    double driftDec = dec - m_startPos.Y;
-
-    m_lastTime = info.time;
-    sumSNR += info.starSNR;
-    sumMass += info.starMass;
+}
 
-    double ramean, rarms;
-    double decmean, decrms;
+void GuidingAsstWin::RefreshGrids(void)
+{
     double pxscale = pFrame->GetCameraPixelScale();
 
-    m_statsRA.GetMeanAndStdev(&ramean, &rarms);
-    m_statsDec.GetMeanAndStdev(&decmean, &decrms);
-
-    double n = (double) m_statsRA.n;
+    double rarms = m_analyzer.RARms();
+    double decrms = m_analyzer.DecRms();
+    double n = (double) m_analyzer.SampleCount();
     double combined = hypot(rarms, decrms);
+    double rangeRA = m_analyzer.RAPeakPeak();
+    double maxRateRA = m_analyzer.RAMaxDriftRate();
+    double raDriftRate = m_analyzer.RADriftRate();
+    double decDriftRate = m_analyzer.DecDriftRate();
+    GuidingAnalyzer::PeriodicError pe = m_analyzer.RAPeriodicError();
 
     wxLongLong_t elapsedms = ::wxGetUTCTimeMillis().GetValue() - m_startTime;
-    double elapsed = (double) elapsedms / 1000.0;
-
-    double raDriftRate = driftRA / elapsed * 60.0;
-    double decDriftRate = driftDec / elapsed * 60.0;
 
     wxString SEC(_("s"));
     wxString PX(_("px"));
@@ -796,8 +698,8 @@ void GuidingAsstWin::UpdateInfo(const GuideStepInfo& info)
 
     m_statusgrid->SetCellValue(m_timestamp_loc, startStr);
     m_statusgrid->SetCellValue(m_exposuretime_loc, wxString::Format("%g%s", (double)pFrame->RequestedExposureDuration() / 1000.0, SEC));
-    m_statusgrid->SetCellValue(m_snr_loc, wxString::Format("%.1f", sumSNR / n));
-    m_statusgrid->SetCellValue(m_starmass_loc, wxString::Format("%.1f", sumMass / n));
+    m_statusgrid->SetCellValue(m_snr_loc, wxString::Format("%.1f", m_analyzer.AvgSNR()));
+    m_statusgrid->SetCellValue(m_starmass_loc, wxString::Format("%.1f", m_analyzer.AvgMass()));
     m_statusgrid->SetCellValue(m_elapsedtime_loc, wxString::Format("%u%s", (unsigned int)(elapsedms / 1000), SEC));
     m_statusgrid->SetCellValue(m_samplecount_loc, wxString::Format("%.0f", n));
     //m_statusgrid->SetCellValue(m_hfcutoff_loc, wxString::Format("%.2f %s", m_freqThresh, HZ));
@@ -809,10 +711,10 @@ void GuidingAsstWin::UpdateInfo(const GuideStepInfo& info)
     m_displacementgrid->SetCellValue(m_total_rms_px_loc, wxString::Format("%6.2f %s", combined, PX));
     m_displacementgrid->SetCellValue(m_total_rms_as_loc, wxString::Format("%6.2f %s", combined * pxscale, ARCSEC));
 
-    m_othergrid->SetCellValue(m_ra_peak_px_loc, wxString::Format("% .1f %s", m_statsRA.peakRawDx, PX));
-    m_othergrid->SetCellValue(m_ra_peak_as_loc, wxString::Format("% .1f %s", m_statsRA.peakRawDx * pxscale, ARCSEC));
-    m_othergrid->SetCellValue(m_dec_peak_px_loc, wxString::Format("% .1f %s", m_statsDec.peakRawDx, PX));
-    m_othergrid->SetCellValue(m_dec_peak_as_loc, wxString::Format("% .1f %s", m_statsRA.peakRawDx * pxscale, ARCSEC));
+    m_othergrid->SetCellValue(m_ra_peak_px_loc, wxString::Format("% .1f %s", m_analyzer.RAPeak(), PX));
+    m_othergrid->SetCellValue(m_ra_peak_as_loc, wxString::Format("% .1f %s", m_analyzer.RAPeak() * pxscale, ARCSEC));
+    m_othergrid->SetCellValue(m_dec_peak_px_loc, wxString::Format("% .1f %s", m_analyzer.DecPeak(), PX));
+    m_othergrid->SetCellValue(m_dec_peak_as_loc, wxString::Format("% .1f %s", m_analyzer.DecPeak() * pxscale, ARCSEC));
     m_othergrid->SetCellValue(m_ra_peakpeak_px_loc, wxString::Format("% .1f %s", rangeRA, PX));
     m_othergrid->SetCellValue(m_ra_peakpeak_as_loc, wxString::Format("% .1f %s", rangeRA * pxscale, ARCSEC));
     m_othergrid->SetCellValue(m_ra_drift_px_loc, wxString::Format("% .1f %s", raDriftRate, PXPERMIN));
@@ -822,6 +724,17 @@ void GuidingAsstWin::UpdateInfo(const GuideStepInfo& info)
         maxRateRA * pxscale, ARCSECPERSEC, _("Max Exp"), maxRateRA > 0.0 ? rarms / maxRateRA : 0.0, SEC));
     m_othergrid->SetCellValue(m_dec_drift_px_loc, wxString::Format("% .1f %s", decDriftRate, PXPERMIN));
     m_othergrid->SetCellValue(m_dec_drift_as_loc, wxString::Format("% .1f %s", decDriftRate * pxscale, ARCSECPERMIN));
+    if (pe.valid)
+    {
+        m_othergrid->SetCellValue(m_ra_pe_px_loc, wxString::Format("% .1f %s", 2.0 * pe.amplitude, PX));
+        m_othergrid->SetCellValue(m_ra_pe_as_loc, wxString::Format("% .1f %s (%s: %.0f%s)",
+            2.0 * pe.amplitude * pxscale, ARCSEC, _("Period"), pe.period, SEC));
+    }
+    else
+    {
+        m_othergrid->SetCellValue(m_ra_pe_px_loc, wxEmptyString);
+        m_othergrid->SetCellValue(m_ra_pe_as_loc, wxEmptyString);
+    }
 }
 
 wxWindow *GuidingAssistant::CreateDialogBox()
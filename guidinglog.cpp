@@ -378,7 +378,7 @@ void GuidingLog::GuidingHeader(void)
                 pFrame->pGuider->CurrentPosition().X,
                 pFrame->pGuider->CurrentPosition().Y));
 
-    m_file.Write("Frame,Time,mount,dx,dy,RARawDistance,DECRawDistance,RAGuideDistance,DECGuideDistance,RADuration,RADirection,DECDuration,DECDirection,XStep,YStep,StarMass,SNR,ErrorCode\n");
+    m_file.Write("Frame,Time,mount,dx,dy,RARawDistance,DECRawDistance,RAGuideDistance,DECGuideDistance,RADuration,RADirection,DECDuration,DECDirection,XStep,YStep,StarMass,SNR,ErrorCode,ErrorDescription,HFD,FWHM,Background,Noise,PeakADU,Saturated,Eccentricity\n");
 
     Flush();
 }
@@ -410,9 +410,27 @@ void GuidingLog::GuideStep(const GuideStepInfo& step)
             step.durationDec, step.durationDec > 0 ? step.mount->DirectionChar((GUIDE_DIRECTION)step.directionDec): ""));
     }
 
-    m_file.Write(wxString::Format("%.f,%.2f,%d\n",
+    // ErrorDescription is only filled in for dropped frames
+    m_file.Write(wxString::Format("%.f,%.2f,%d,,",
             step.starMass, step.starSNR, step.starError));
 
+    if (step.starHFD > 0.0)
+        m_file.Write(wxString::Format("%.2f,", step.starHFD));
+    else
+        m_file.Write(",");
+
+    if (step.starFWHM > 0.0)
+        m_file.Write(wxString::Format("%.2f,", step.starFWHM));
+    else
+        m_file.Write(",");
+
+    const StarMetrics& m = *step.starMetrics;
+    if (m.Valid)
+        m_file.Write(wxString::Format("%.1f,%.1f,%u,%d,%.3f\n",
+            m.Background, m.Noise, (unsigned int) m.Peak, m.Saturated ? 1 : 0, m.Eccentricity));
+    else
+        m_file.Write(",,,,\n");
+
     Flush();
 }
 
@@ -423,7 +441,7 @@ void GuidingLog::FrameDropped(const FrameDroppedInfo& info)
 
     assert(m_file.IsOpened());
 
-    m_file.Write(wxString::Format("%d,%.3f,\"DROP\",,,,,,,,,,,,,%.f,%.2f,%d,\"%s\"\n",
+    m_file.Write(wxString::Format("%d,%.3f,\"DROP\",,,,,,,,,,,,,%.f,%.2f,%d,\"%s\",,,,,,,\n",
         info.frameNumber, info.time, info.starMass, info.starSNR, info.starError, info.status));
 
     Flush();
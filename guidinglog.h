@@ -62,6 +62,9 @@ struct GuideStepInfo
     wxPoint aoPos;
     double starMass;
     double starSNR;
+    double starHFD;     // 0 when the star find mode does not measure it
+    double starFWHM;
+    const StarMetrics *starMetrics;
     double avgDist;
     int starError;
 };
@@ -0,0 +1,501 @@
+/*
+ *  image_logger.cpp
+ *  PHD Guiding
+ *
+ *  Created by the PHD2 developers
+ *  Copyright (c) 2014 PHD2 Developers
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of Craig Stark, Stark Labs nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "phd.h"
+
+#include <deque>
+
+// size of the region logged around the star
+static const int StarImageSize = 60;
+// frames waiting to be written; more than this and new frames are dropped
+static const unsigned int MaxQueuedFrames = 16;
+// a FITS cube is closed and a new one started when it reaches either limit
+static const int MaxCubeFrames = 1000;
+static const double MaxCubeBytes = 64.0 * 1024.0 * 1024.0;
+
+struct LoggedFrame
+{
+    usImage image;
+    LOGGED_IMAGE_FORMAT format;
+    wxPoint origin;         // position of image in the guide frame
+    PHD_Point star;         // star and lock positions, relative to origin
+    PHD_Point lock;
+    unsigned int frameNumber;
+    int blevel;             // display stretch, for JPEG
+    int wlevel;
+    double gamma;
+};
+
+class LoggerThread;
+
+struct LoggerState
+{
+    wxMutex lock;
+    wxCondition workReady;
+    std::deque<LoggedFrame *> queue;    // a NULL entry asks for the cube to be closed
+    bool stopping;
+
+    int decimation;
+    unsigned int frameCount;    // frames offered since the last flush
+    ImageLoggerStats stats;
+
+    LoggerThread *thread;
+
+    // current FITS cube, used only by the logger thread
+    fitsfile *cube;
+    wxSize cubeSize;
+    int cubeFrames;
+
+    LoggerState()
+        : workReady(lock),
+          stopping(false),
+          decimation(1),
+          frameCount(0),
+          thread(0),
+          cube(0),
+          cubeFrames(0)
+    {
+        memset(&stats, 0, sizeof(stats));
+    }
+
+    void ThreadLoop(void);
+    void Write(const LoggedFrame& frame);
+    void WriteFits(const LoggedFrame& frame);
+    void WriteJpeg(const LoggedFrame& frame);
+    void CloseCube(void);
+};
+
+static LoggerState *s_logger;
+
+class LoggerThread : public wxThread
+{
+    LoggerState *m_state;
+
+public:
+    LoggerThread(LoggerState *state)
+        : wxThread(wxTHREAD_JOINABLE),
+          m_state(state)
+    {
+    }
+
+protected:
+    ExitCode Entry()
+    {
+        m_state->ThreadLoop();
+        return (ExitCode) 0;
+    }
+};
+
+static wxString LogFileName(const wxString& ext)
+{
+    return Debug.GetLogDir() + PATHSEPSTR + "PHD_GuideStar" + wxDateTime::Now().Format(_T("_%j_%H%M%S")) + ext;
+}
+
+void LoggerState::ThreadLoop(void)
+{
+    lock.Lock();
+
+    while (true)
+    {
+        while (!stopping && queue.empty())
+            workReady.Wait();
+
+        if (queue.empty())
+            break; // stopping, and everything queued has been written
+
+        LoggedFrame *frame = queue.front();
+        queue.pop_front();
+
+        lock.Unlock();
+
+        if (frame)
+        {
+            Write(*frame);
+            delete frame;
+        }
+        else
+        {
+            CloseCube();
+        }
+
+        lock.Lock();
+
+        if (frame)
+            ++stats.written;
+    }
+
+    lock.Unlock();
+
+    CloseCube();
+}
+
+void LoggerState::Write(const LoggedFrame& frame)
+{
+    if (frame.format == LIF_RAW_FITS || frame.format == LIF_FULL_FITS)
+        WriteFits(frame);
+    else
+        WriteJpeg(frame);
+}
+
+void LoggerState::CloseCube(void)
+{
+    if (cube)
+    {
+        PHD_fits_close_file(cube);
+        Debug.AddLine("ImageLogger: closed FITS cube with %d frames", cubeFrames);
+        cube = 0;
+        cubeFrames = 0;
+    }
+}
+
+void LoggerState::WriteFits(const LoggedFrame& frame)
+{
+    const usImage& img = frame.image;
+    double frameBytes = (double) img.NPixels * sizeof(unsigned short);
+
+    if (cube && (img.Size != cubeSize || cubeFrames >= MaxCubeFrames || (cubeFrames + 1) * frameBytes > MaxCubeBytes))
+        CloseCube();
+
+    int status = 0;
+    long fsize[3] = { img.Size.GetWidth(), img.Size.GetHeight(), 1 };
+
+    if (!cube)
+    {
+        wxString fname = LogFileName(".fit");
+
+        PHD_fits_create_file(&cube, fname, false, &status);
+        if (status)
+        {
+            Debug.AddLine("ImageLogger: could not create " + fname);
+            cube = 0;
+            return;
+        }
+
+        fits_create_img(cube, USHORT_IMG, 3, fsize, &status);
+
+        char keyname[9];
+        char keycomment[100];
+        char keystring[100];
+
+        sprintf(keyname, "DATE-OBS");
+        sprintf(keycomment, "YYYY-MM-DDThh:mm:ss first frame start, UT");
+        sprintf(keystring, "%s", (const char *) img.GetImgStartTime().c_str());
+        if (!status) fits_write_key(cube, TSTRING, keyname, keystring, keycomment, &status);
+
+        sprintf(keyname, "EXPOSURE");
+        sprintf(keycomment, "Exposure time [s]");
+        float dur = (float) img.ImgExpDur / 1000.0;
+        if (!status) fits_write_key(cube, TFLOAT, keyname, &dur, keycomment, &status);
+
+        unsigned int tmp = 1;
+        sprintf(keyname, "XBINNING");
+        sprintf(keycomment, "Camera binning mode");
+        if (!status) fits_write_key(cube, TUINT, keyname, &tmp, keycomment, &status);
+        sprintf(keyname, "YBINNING");
+        if (!status) fits_write_key(cube, TUINT, keyname, &tmp, keycomment, &status);
+
+        int org = frame.origin.x;
+        sprintf(keyname, "XORGSUB");
+        sprintf(keycomment, "Subframe x position of the first frame in binned pixels");
+        if (!status) fits_write_key(cube, TINT, keyname, &org, keycomment, &status);
+        org = frame.origin.y;
+        sprintf(keyname, "YORGSUB");
+        sprintf(keycomment, "Subframe y position of the first frame in binned pixels");
+        if (!status) fits_write_key(cube, TINT, keyname, &org, keycomment, &status);
+
+        // the star region follows the star, so each plane's origin is recorded
+        // as well; reserve the header space for them now, as the header cannot
+        // grow without moving the data that follows it
+        if (!status) fits_set_hdrsize(cube, 2 * MaxCubeFrames, &status);
+
+        if (status)
+        {
+            Debug.AddLine("ImageLogger: error %d creating FITS cube", status);
+            PHD_fits_close_file(cube);
+            cube = 0;
+            return;
+        }
+
+        cubeSize = img.Size;
+        cubeFrames = 0;
+    }
+    else
+    {
+        // grow the cube by one plane
+        fsize[2] = cubeFrames + 1;
+        fits_resize_img(cube, USHORT_IMG, 3, fsize, &status);
+    }
+
+    long fpixel[3] = { 1, 1, cubeFrames + 1 };
+    if (!status) fits_write_pix(cube, TUSHORT, fpixel, img.NPixels, img.ImageData, &status);
+
+    char keyname[9];
+    char keycomment[100];
+    int org = frame.origin.x;
+    sprintf(keyname, "XORG%04d", cubeFrames + 1);
+    sprintf(keycomment, "Subframe x position of plane %d in binned pixels", cubeFrames + 1);
+    if (!status) fits_write_key(cube, TINT, keyname, &org, keycomment, &status);
+    org = frame.origin.y;
+    sprintf(keyname, "YORG%04d", cubeFrames + 1);
+    sprintf(keycomment, "Subframe y position of plane %d in binned pixels", cubeFrames + 1);
+    if (!status) fits_write_key(cube, TINT, keyname, &org, keycomment, &status);
+
+    // keep the header on disk consistent with the data in case we exit abnormally
+    if (!status) fits_flush_buffer(cube, 0, &status);
+
+    if (status)
+    {
+        Debug.AddLine("ImageLogger: error %d writing FITS frame %u", status, frame.frameNumber);
+        CloseCube();
+        return;
+    }
+
+    ++cubeFrames;
+}
+
+void LoggerState::WriteJpeg(const LoggedFrame& frame)
+{
+    const usImage& img = frame.image;
+    int const w = img.Size.GetWidth();
+    int const h = img.Size.GetHeight();
+
+    wxImage jpg(w, h, false);
+    unsigned char *dst = jpg.GetData();
+
+    int const blevel = frame.blevel;
+    int const wlevel = wxMax(frame.wlevel, blevel + 1);
+    float const range = (float) (wlevel - blevel);
+
+    const unsigned short *src = img.ImageData;
+    for (int i = 0; i < img.NPixels; i++)
+    {
+        float d;
+        if (src[i] <= blevel)
+            d = 0.0;
+        else if (src[i] >= wlevel)
+            d = 255.0;
+        else
+            d = pow(((float) src[i] - (float) blevel) / range, (float) frame.gamma) * 255.0;
+        dst[3 * i] = dst[3 * i + 1] = dst[3 * i + 2] = (unsigned char) d;
+    }
+
+    // dotted green lines through the lock position
+    int const lx = ROUND(frame.lock.X);
+    int const ly = ROUND(frame.lock.Y);
+    for (int x = 0; x < w; x += 2)
+        if (ly >= 0 && ly < h)
+            jpg.SetRGB(x, ly, 0, 255, 0);
+    for (int y = 0; y < h; y += 2)
+        if (lx >= 0 && lx < w)
+            jpg.SetRGB(lx, y, 0, 255, 0);
+
+    if (frame.format == LIF_HI_Q_JPEG)
+    {
+        // set high(ish) JPEG quality
+        jpg.SetOption(wxIMAGE_OPTION_QUALITY, 100);
+    }
+
+    wxString fname = LogFileName(wxString::Format("_%u.jpg", frame.frameNumber));
+    if (!jpg.SaveFile(fname, wxBITMAP_TYPE_JPEG))
+        Debug.AddLine("ImageLogger: could not write " + fname);
+}
+
+// copy the star region, or all of the guide frame, out of img
+static void CopyFrame(LoggedFrame *frame, const usImage& img, const PHD_Point& star)
+{
+    wxRect rect;
+
+    if (frame->format == LIF_FULL_FITS)
+    {
+        rect = wxRect(img.Size);
+    }
+    else
+    {
+        int size = wxMin(StarImageSize, wxMin(img.Size.GetWidth(), img.Size.GetHeight()));
+        int x = ROUND(star.X) - size / 2;
+        int y = ROUND(star.Y) - size / 2;
+        x = wxMax(0, wxMin(x, img.Size.GetWidth() - size));
+        y = wxMax(0, wxMin(y, img.Size.GetHeight() - size));
+        rect = wxRect(x, y, size, size);
+    }
+
+    frame->image.Init(rect.GetSize());
+    frame->image.ImgStartTime = img.ImgStartTime;
+    frame->image.ImgStartTimeMs = img.ImgStartTimeMs;
+    frame->image.ImgExpDur = img.ImgExpDur;
+    frame->origin = rect.GetPosition();
+
+    // pixels outside the data of a windowed frame are left black
+    unsigned short *dst = frame->image.ImageData;
+    memset(dst, 0, frame->image.NPixels * sizeof(unsigned short));
+
+    wxRect valid = rect.Intersect(img.DataRect);
+    for (int y = valid.GetTop(); y <= valid.GetBottom(); y++)
+    {
+        memcpy(dst + (y - rect.y) * rect.width + (valid.x - rect.x), &img.Pixel(valid.x, y),
+            valid.width * sizeof(unsigned short));
+    }
+}
+
+void ImageLogger::OnAppInit(void)
+{
+    s_logger = new LoggerState();
+    s_logger->decimation = wxMax(1, pConfig->Global.GetInt("/ImageLogDecimation", 1));
+
+    s_logger->thread = new LoggerThread(s_logger);
+    if (s_logger->thread->Create() != wxTHREAD_NO_ERROR || s_logger->thread->Run() != wxTHREAD_NO_ERROR)
+    {
+        Debug.AddLine("ImageLogger: could not start logger thread");
+        delete s_logger->thread;
+        s_logger->thread = 0;
+    }
+}
+
+void ImageLogger::OnAppExit(void)
+{
+    if (!s_logger)
+        return;
+
+    if (s_logger->thread)
+    {
+        {
+            wxMutexLocker lck(s_logger->lock);
+            s_logger->stopping = true;
+            s_logger->workReady.Signal();
+        }
+
+        s_logger->thread->Wait();
+        delete s_logger->thread;
+    }
+
+    for (std::deque<LoggedFrame *>::iterator it = s_logger->queue.begin(); it != s_logger->queue.end(); ++it)
+        delete *it;
+
+    delete s_logger;
+    s_logger = 0;
+}
+
+void ImageLogger::LogFrame(const usImage& img, const PHD_Point& star, const PHD_Point& lockPos, unsigned int frameNumber)
+{
+    if (!s_logger || !s_logger->thread)
+        return;
+
+    {
+        wxMutexLocker lck(s_logger->lock);
+
+        if (s_logger->frameCount++ % s_logger->decimation != 0)
+        {
+            ++s_logger->stats.skipped;
+            return;
+        }
+
+        if (s_logger->queue.size() >= MaxQueuedFrames)
+        {
+            // the disk is not keeping up; drop this frame rather than hold up guiding
+            if (s_logger->stats.dropped++ % 100 == 0)
+                Debug.AddLine("ImageLogger: queue full, %u frames dropped", s_logger->stats.dropped);
+            return;
+        }
+    }
+
+    LoggedFrame *frame = new LoggedFrame();
+    frame->format = pFrame->GetLoggedImageFormat();
+    frame->frameNumber = frameNumber;
+    frame->blevel = img.FiltMin;
+    frame->wlevel = img.FiltMax;
+    frame->gamma = pFrame->Stretch_gamma;
+
+    CopyFrame(frame, img, star);
+
+    frame->star.SetXY(star.X - frame->origin.x, star.Y - frame->origin.y);
+    if (lockPos.IsValid())
+        frame->lock.SetXY(lockPos.X - frame->origin.x, lockPos.Y - frame->origin.y);
+    else
+        frame->lock = frame->star;
+
+    wxMutexLocker lck(s_logger->lock);
+    s_logger->queue.push_back(frame);
+    ++s_logger->stats.queued;
+    s_logger->workReady.Signal();
+}
+
+void ImageLogger::Flush(void)
+{
+    if (!s_logger || !s_logger->thread)
+        return;
+
+    wxMutexLocker lck(s_logger->lock);
+    s_logger->queue.push_back(0);
+    s_logger->frameCount = 0;
+    s_logger->workReady.Signal();
+
+    Debug.AddLine("ImageLogger: %u frames queued, %u written, %u dropped, %u skipped",
+        s_logger->stats.queued, s_logger->stats.written, s_logger->stats.dropped, s_logger->stats.skipped);
+}
+
+void ImageLogger::SetDecimation(int n)
+{
+    if (n < 1)
+        n = 1;
+
+    if (s_logger)
+    {
+        wxMutexLocker lck(s_logger->lock);
+        s_logger->decimation = n;
+        s_logger->frameCount = 0;
+    }
+
+    pConfig->Global.SetInt("/ImageLogDecimation", n);
+}
+
+int ImageLogger::GetDecimation(void)
+{
+    if (!s_logger)
+        return 1;
+
+    wxMutexLocker lck(s_logger->lock);
+    return s_logger->decimation;
+}
+
+void ImageLogger::GetStats(ImageLoggerStats *stats)
+{
+    if (!s_logger)
+    {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+
+    wxMutexLocker lck(s_logger->lock);
+    *stats = s_logger->stats;
+}
@@ -0,0 +1,72 @@
+/*
+ *  image_logger.h
+ *  PHD Guiding
+ *
+ *  Created by the PHD2 developers
+ *  Copyright (c) 2014 PHD2 Developers
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of Craig Stark, Stark Labs nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef IMAGE_LOGGER_INCLUDED
+#define IMAGE_LOGGER_INCLUDED
+
+struct ImageLoggerStats
+{
+    unsigned int queued;    // frames accepted for logging
+    unsigned int written;   // frames written to disk
+    unsigned int dropped;   // frames discarded because the queue was full
+    unsigned int skipped;   // frames skipped by the decimation setting
+};
+
+// Writes logged guide frames on a background thread.
+//
+// The guider passes every frame to LogFrame(). It copies the star region,
+// or the whole frame, into a bounded queue and returns at once. The logger
+// thread encodes and writes the queued frames, so a slow disk never holds up
+// guiding. When the queue is full, new frames are dropped and counted.
+//
+// FITS frames are appended to a multi-frame cube that is started again when
+// it gets large. JPEG frames are still written one file per frame.
+class ImageLogger
+{
+public:
+    static void OnAppInit(void);
+    static void OnAppExit(void);
+
+    static void LogFrame(const usImage& img, const PHD_Point& star, const PHD_Point& lockPos, unsigned int frameNumber);
+    // close the current FITS cube once the queued frames are written
+    static void Flush(void);
+
+    // log one of every n frames
+    static void SetDecimation(int n);
+    static int GetDecimation(void);
+
+    static void GetStats(ImageLoggerStats *stats);
+};
+
+#endif
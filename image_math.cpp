@@ -76,17 +76,50 @@ double CalcSlope(const ArrayOfDbl& y)
     return (n * s_xy - (s_x * s_y)) / (n * s_xx - (s_x * s_x));
 }
 
+struct QuickLReconRows : public ParallelBody
+{
+    const unsigned short *src;
+    unsigned short *dst;
+    int W, RX, RY, RW;
+
+    void Run(int y0, int y1)
+    {
+#define IX(x_, y_) ((RY + (y_)) * W + RX + (x_))
+        for (int y = y0; y < y1; y++)
+        {
+            unsigned short *d = &dst[IX(0, y)];
+            unsigned int t;
+
+            for (int x = 0; x <= RW - 2; x++)
+            {
+                t  = src[IX(x    , y    )];
+                t += src[IX(x + 1, y    )];
+                t += src[IX(x    , y + 1)];
+                t += src[IX(x + 1, y + 1)];
+                *d++ = (unsigned short)(t >> 2);
+            }
+
+            // last col
+            t  = src[IX(RW - 1, y    )];
+            t += src[IX(RW - 1, y + 1)];
+            *d = (unsigned short)(t >> 1);
+        }
+#undef IX
+    }
+};
+
 bool QuickLRecon(usImage& img)
 {
     // Does a simple debayer of luminance data only -- sliding 2x2 window
     usImage tmp;
-    if (tmp.Init(img.Size))
+    if (tmp.InitAs(img))
     {
         pFrame->Alert(_("Memory allocation error"));
         return true;
     }
 
-    int const W = img.Size.GetWidth();
+    // coordinates are relative to the stored pixels, which may be a window
+    int const W = img.DataRect.GetWidth();
     int RX, RY, RW, RH;
     if (img.Subframe.IsEmpty())
     {
@@ -96,37 +129,27 @@ bool QuickLRecon(usImage& img)
     }
     else
     {
-        RX = img.Subframe.GetX();
-        RY = img.Subframe.GetY();
+        RX = img.Subframe.GetX() - img.DataRect.GetX();
+        RY = img.Subframe.GetY() - img.DataRect.GetY();
         RW = img.Subframe.GetWidth();
         RH = img.Subframe.GetHeight();
         tmp.Clear();
     }
 
+    QuickLReconRows rows;
+    rows.src = img.ImageData;
+    rows.dst = tmp.ImageData;
+    rows.W = W;
+    rows.RX = RX;
+    rows.RY = RY;
+    rows.RW = RW;
+    parallel_for(0, RH - 1, rows);
+
 #define IX(x_, y_) ((RY + (y_)) * W + RX + (x_))
 
     unsigned short *d;
     unsigned int t;
 
-    for (int y = 0; y <= RH - 2; y++)
-    {
-        d = &tmp.ImageData[IX(0, y)];
-
-        for (int x = 0; x <= RW - 2; x++)
-        {
-            t  = img.ImageData[IX(x    , y    )];
-            t += img.ImageData[IX(x + 1, y    )];
-            t += img.ImageData[IX(x    , y + 1)];
-            t += img.ImageData[IX(x + 1, y + 1)];
-            *d++ = (unsigned short)(t >> 2);
-        }
-
-        // last col
-        t  = img.ImageData[IX(RW - 1, y    )];
-        t += img.ImageData[IX(RW - 1, y + 1)];
-        *d = (unsigned short)(t >> 1);
-    }
-
     // last row
 
     d = &tmp.ImageData[IX(0, RH - 1)];
@@ -150,7 +173,7 @@ bool QuickLRecon(usImage& img)
 bool Median3(usImage& img)
 {
     usImage tmp;
-    tmp.Init(img.Size);
+    tmp.InitAs(img);
 
     bool err;
 
@@ -161,7 +184,9 @@ bool Median3(usImage& img)
     else
     {
         tmp.Clear();
-        err = Median3(tmp.ImageData, img.ImageData, img.Size, img.Subframe);
+        wxRect rect(img.Subframe);
+        rect.Offset(-img.DataRect.GetX(), -img.DataRect.GetY());
+        err = Median3(tmp.ImageData, img.ImageData, img.DataRect.GetSize(), rect);
     }
 
     img.SwapImageData(tmp);
@@ -316,6 +341,57 @@ inline static unsigned short median3(const unsigned short l[3])
     return l0;
 }
 
+struct Median3Rows : public ParallelBody
+{
+    unsigned short *dst;
+    const unsigned short *src;
+    int W, RX, RY, RW;
+
+    void Run(int y0, int y1)
+    {
+        unsigned short a[9];
+
+#define IX(x_, y_) ((RY + (y_)) * W + RX + (x_))
+        for (int y = y0; y < y1; y++)
+        {
+            unsigned short *d = &dst[IX(0, y)];
+
+            // leftmost pixel
+            a[0] = src[IX(0, y - 1)];
+            a[1] = src[IX(1, y - 1)];
+            a[2] = src[IX(0, y    )];
+            a[3] = src[IX(1, y    )];
+            a[4] = src[IX(0, y + 1)];
+            a[5] = src[IX(1, y + 1)];
+            *d++ = median6(a);
+
+            for (int x = 1; x <= RW - 2; x++)
+            {
+                a[0] = src[IX(x - 1, y - 1)];
+                a[1] = src[IX(x    , y - 1)];
+                a[2] = src[IX(x + 1, y - 1)];
+                a[3] = src[IX(x - 1, y    )];
+                a[4] = src[IX(x    , y    )];
+                a[5] = src[IX(x + 1, y    )];
+                a[6] = src[IX(x - 1, y + 1)];
+                a[7] = src[IX(x    , y + 1)];
+                a[8] = src[IX(x + 1, y + 1)];
+                *d++ = median9(a);
+            }
+
+            // rightmost pixel
+            a[0] = src[IX(RW - 2, y - 1)];
+            a[1] = src[IX(RW - 1, y - 1)];
+            a[2] = src[IX(RW - 2, y    )];
+            a[3] = src[IX(RW - 1, y    )];
+            a[4] = src[IX(RW - 2, y + 1)];
+            a[5] = src[IX(RW - 1, y + 1)];
+            *d++ = median6(a);
+        }
+#undef IX
+    }
+};
+
 bool Median3(unsigned short *dst, const unsigned short *src, const wxSize& size, const wxRect& rect)
 {
     int const W = size.GetWidth();
@@ -358,42 +434,14 @@ bool Median3(unsigned short *dst, const unsigned short *src, const wxSize& size,
     a[3] = src[IX(RW - 1, 1)];
     *d = median4(a);
 
-    for (int y = 1; y <= RH - 2; y++)
-    {
-        d = &dst[IX(0, y)];
-
-        // leftmost pixel
-        a[0] = src[IX(0, y - 1)];
-        a[1] = src[IX(1, y - 1)];
-        a[2] = src[IX(0, y    )];
-        a[3] = src[IX(1, y    )];
-        a[4] = src[IX(0, y + 1)];
-        a[5] = src[IX(1, y + 1)];
-        *d++ = median6(a);
-
-        for (int x = 1; x <= RW - 2; x++)
-        {
-            a[0] = src[IX(x - 1, y - 1)];
-            a[1] = src[IX(x    , y - 1)];
-            a[2] = src[IX(x + 1, y - 1)];
-            a[3] = src[IX(x - 1, y    )];
-            a[4] = src[IX(x    , y    )];
-            a[5] = src[IX(x + 1, y    )];
-            a[6] = src[IX(x - 1, y + 1)];
-            a[7] = src[IX(x    , y + 1)];
-            a[8] = src[IX(x + 1, y + 1)];
-            *d++ = median9(a);
-        }
-
-        // rightmost pixel
-        a[0] = src[IX(RW - 2, y - 1)];
-        a[1] = src[IX(RW - 1, y - 1)];
-        a[2] = src[IX(RW - 2, y    )];
-        a[3] = src[IX(RW - 1, y    )];
-        a[4] = src[IX(RW - 2, y + 1)];
-        a[5] = src[IX(RW - 1, y + 1)];
-        *d++ = median6(a);
-    }
+    Median3Rows rows;
+    rows.dst = dst;
+    rows.src = src;
+    rows.W = W;
+    rows.RX = RX;
+    rows.RY = RY;
+    rows.RW = RW;
+    parallel_for(1, RH - 1, rows);
 
     // bottom row
     d = &dst[IX(0, RH - 1)];
@@ -432,8 +480,12 @@ bool Median3(unsigned short *dst, const unsigned short *src, const wxSize& size,
 static unsigned short MedianBorderingPixels(const usImage& img, int x, int y)
 {
     unsigned short array[8];
-    int const xsize = img.Size.GetWidth();
-    int const ysize = img.Size.GetHeight();
+    // work in the coordinates of the stored pixels; the edges of a windowed
+    // image are treated like the edges of the sensor
+    int const xsize = img.DataRect.GetWidth();
+    int const ysize = img.DataRect.GetHeight();
+    x -= img.DataRect.GetX();
+    y -= img.DataRect.GetY();
 
     if (x > 0 && y > 0 && x < xsize - 1 && y < ysize - 1)
     {
@@ -529,6 +581,33 @@ static unsigned short MedianBorderingPixels(const usImage& img, int x, int y)
     return median3(array);
 }
 
+struct SquarePixelsRows : public ParallelBody
+{
+    unsigned short *dst;
+    const unsigned short *src;
+    int newsize;
+    int linesize;
+    double ratio;
+
+    void Run(int y0, int y1)
+    {
+        unsigned short *optr = dst + y0 * newsize;
+        for (int y = y0; y < y1; y++)
+        {
+            for (int x = 0; x < newsize; x++, optr++)
+            {
+                double oldposition = x * ratio;
+                int ind1 = (unsigned int) floor(oldposition);
+                int ind2 = (unsigned int) ceil(oldposition);
+                if (ind2 > (linesize - 1))
+                    ind2 = linesize - 1;
+                double weight = ceil(oldposition) - oldposition;
+                *optr = (unsigned short) (((float) *(src + y*linesize + ind1) * weight) + ((float) *(src + y*linesize + ind1) * (1.0 - weight)));
+            }
+        }
+    }
+};
+
 bool SquarePixels(usImage& img, float xsize, float ysize)
 {
     // Stretches one dimension to square up pixels
@@ -538,6 +617,12 @@ bool SquarePixels(usImage& img, float xsize, float ysize)
     if (xsize <= ysize)
         return false;
 
+    if (img.ExpandToFullFrame())
+    {
+        pFrame->Alert(_("Memory allocation error"));
+        return true;
+    }
+
     // Move the existing data to a temp image
     usImage tempimg;
     if (tempimg.Init(img.Size))
@@ -551,24 +636,76 @@ bool SquarePixels(usImage& img, float xsize, float ysize)
     double ratio = ysize / xsize;
     int newsize = ROUND((float) tempimg.Size.GetWidth() * (1.0/ratio));  // make new image correct size
     img.Init(newsize,tempimg.Size.GetHeight());
-    unsigned short *optr = img.ImageData;
-    int linesize = tempimg.Size.GetWidth();  // size of an original line
-    for (int y = 0; y < img.Size.GetHeight(); y++)
+    SquarePixelsRows rows;
+    rows.dst = img.ImageData;
+    rows.src = tempimg.ImageData;
+    rows.newsize = newsize;
+    rows.linesize = tempimg.Size.GetWidth();  // size of an original line
+    rows.ratio = ratio;
+    parallel_for(0, img.Size.GetHeight(), rows);
+
+    return false;
+}
+
+struct SubtractRows : public ParallelBody
+{
+    unsigned short *light;      // first pixel of the subtracted area
+    const unsigned short *dark;
+    int lightStride;
+    int darkStride;
+    int width;
+
+    // first pass: minimum of light - dark
+    bool findMin;
+    wxCriticalSection lock;
+    int mindiff;
+
+    // second pass
+    int offset;
+
+    void Run(int r0, int r1)
     {
-        for (int x = 0; x < newsize; x++, optr++)
+        unsigned short *pl0 = light + r0 * lightStride;
+        const unsigned short *pd0 = dark + r0 * darkStride;
+
+        if (findMin)
         {
-            double oldposition = x * ratio;
-            int ind1 = (unsigned int) floor(oldposition);
-            int ind2 = (unsigned int) ceil(oldposition);
-            if (ind2 > (tempimg.Size.GetWidth() - 1))
-                ind2 = tempimg.Size.GetWidth() - 1;
-            double weight = ceil(oldposition) - oldposition;
-            *optr = (unsigned short) (((float) *(tempimg.ImageData + y*linesize + ind1) * weight) + ((float) *(tempimg.ImageData + y*linesize + ind1) * (1.0 - weight)));
+            int bandmin = 65535;
+            for (int r = r0; r < r1; r++, pl0 += lightStride, pd0 += darkStride)
+            {
+                unsigned short *const endl = pl0 + width;
+                unsigned short *pl;
+                const unsigned short *pd;
+                for (pl = pl0, pd = pd0; pl < endl; pl++, pd++)
+                {
+                    int diff = (int) *pl - (int) *pd;
+                    if (diff < bandmin)
+                        bandmin = diff;
+                }
+            }
+
+            wxCriticalSectionLocker lck(lock);
+            if (bandmin < mindiff)
+                mindiff = bandmin;
+        }
+        else
+        {
+            for (int r = r0; r < r1; r++, pl0 += lightStride, pd0 += darkStride)
+            {
+                unsigned short *const endl = pl0 + width;
+                unsigned short *pl;
+                const unsigned short *pd;
+                for (pl = pl0, pd = pd0; pl < endl; pl++, pd++)
+                {
+                    int newval = (int) *pl - (int) *pd + offset;
+                    if (newval < 0) newval = 0; // shouldn't hit this...
+                    else if (newval > 65535) newval = 65535;
+                    *pl = (unsigned short) newval;
+                }
+            }
         }
     }
-
-    return false;
-}
+};
 
 bool Subtract(usImage& light, const usImage& dark)
 {
@@ -592,44 +729,23 @@ bool Subtract(usImage& light, const usImage& dark)
         height = light.Size.GetHeight();
     }
 
-    int mindiff = 65535;
+    SubtractRows rows;
+    rows.light = &light.Pixel(left, top);
+    rows.dark = &dark.Pixel(left, top);
+    rows.lightStride = light.DataRect.GetWidth();
+    rows.darkStride = dark.DataRect.GetWidth();
+    rows.width = width;
 
-    unsigned short *pl0 = &light.Pixel(left, top);
-    const unsigned short *pd0 = &dark.Pixel(left, top);
-    for (unsigned int r = 0; r < height;
-         r++, pl0 += light.Size.GetWidth(), pd0 += light.Size.GetWidth())
-    {
-        unsigned short *const endl = pl0 + width;
-        unsigned short *pl;
-        const unsigned short *pd;
-        for (pl = pl0, pd = pd0; pl < endl; pl++, pd++)
-        {
-            int diff = (int) *pl - (int) *pd;
-            if (diff < mindiff)
-                mindiff = diff;
-        }
-    }
+    rows.findMin = true;
+    rows.mindiff = 65535;
+    parallel_for(0, height, rows);
 
-    int offset = 0;
-    if (mindiff < 0) // dark was lighter than light
-        offset = -mindiff;
+    rows.offset = 0;
+    if (rows.mindiff < 0) // dark was lighter than light
+        rows.offset = -rows.mindiff;
 
-    pl0 = &light.Pixel(left, top);
-    pd0 = &dark.Pixel(left, top);
-    for (unsigned int r = 0; r < height;
-         r++, pl0 += light.Size.GetWidth(), pd0 += light.Size.GetWidth())
-    {
-        unsigned short *const endl = pl0 + width;
-        unsigned short *pl;
-        const unsigned short *pd;
-        for (pl = pl0, pd = pd0; pl < endl; pl++, pd++)
-        {
-            int newval = (int) *pl - (int) *pd + offset;
-            if (newval < 0) newval = 0; // shouldn't hit this...
-            else if (newval > 65535) newval = 65535;
-            *pl = (unsigned short) newval;
-        }
-    }
+    rows.findMin = false;
+    parallel_for(0, height, rows);
 
     return false;
 }
@@ -653,15 +769,29 @@ inline static unsigned short histo_median(unsigned short histo1[256], unsigned s
     return i;
 }
 
-static void MedianFilter(usImage& dst, const usImage& src, int halfWidth)
+struct MedianFilterRows : public ParallelBody
 {
-    dst.Init(src.Size);
-    unsigned short *d = &dst.ImageData[0];
+    unsigned short *dst;
+    const usImage *src;
+    int halfWidth;
+
+    void Run(int y0, int y1);
+};
 
-    int const width = src.Size.GetWidth();
-    int const height = src.Size.GetHeight();
+void MedianFilterRows::Run(int y0, int y1)
+{
+    int const width = src->Size.GetWidth();
+    int const height = src->Size.GetHeight();
+
+    // 2-level histogram, allocated once per band
+    std::vector<unsigned short> histo1v(256);
+    std::vector<unsigned short> histo2v(65536);
+    unsigned short *const histo1 = &histo1v[0];
+    unsigned short *const histo2 = &histo2v[0];
 
-    for (int y = 0; y < height; y++)
+    unsigned short *d = dst + y0 * width;
+
+    for (int y = y0; y < y1; y++)
     {
         int top = std::max(0, y - halfWidth);
         int bot = std::min(y + halfWidth, height - 1);
@@ -673,14 +803,12 @@ static void MedianFilter(usImage& dst, const usImage& src, int halfWidth)
         // reinitialize the histogram
 
         // initialize 2-level histogram
-        unsigned short histo1[256];
-        unsigned short histo2[65536];
-        memset(&histo1[0], 0, sizeof(histo1));
-        memset(&histo2[0], 0, sizeof(histo2));
+        memset(histo1, 0, 256 * sizeof(unsigned short));
+        memset(histo2, 0, 65536 * sizeof(unsigned short));
 
         for (int j = top; j <= bot; j++)
         {
-            const unsigned short *p = &src.Pixel(left, j);
+            const unsigned short *p = &src->Pixel(left, j);
             for (int i = left; i <= right; i++, p++)
             {
                 ++histo1[*p >> 8];
@@ -701,7 +829,7 @@ static void MedianFilter(usImage& dst, const usImage& src, int halfWidth)
             // remove leftmost column
             if (left > 0)
             {
-                const unsigned short *p = &src.Pixel(left - 1, top);
+                const unsigned short *p = &src->Pixel(left - 1, top);
                 for (int j = top; j <= bot; j++, p += width)
                 {
                     --histo1[*p >> 8];
@@ -713,7 +841,7 @@ static void MedianFilter(usImage& dst, const usImage& src, int halfWidth)
             // add new column on right
             if (i + halfWidth <= width - 1)
             {
-                const unsigned short *p = &src.Pixel(right, top);
+                const unsigned short *p = &src->Pixel(right, top);
                 for (int j = top; j <= bot; j++, p += width)
                 {
                     ++histo1[*p >> 8];
@@ -727,6 +855,17 @@ static void MedianFilter(usImage& dst, const usImage& src, int halfWidth)
     }
 }
 
+static void MedianFilter(usImage& dst, const usImage& src, int halfWidth)
+{
+    dst.Init(src.Size);
+
+    MedianFilterRows rows;
+    rows.dst = dst.ImageData;
+    rows.src = &src;
+    rows.halfWidth = halfWidth;
+    parallel_for(0, src.Size.GetHeight(), rows, 4);
+}
+
 struct ImageStatsWork
 {
     ImageStats stats;
@@ -973,7 +1112,7 @@ int DefectMapBuilder::GetHotPixelCnt() const
     return m_impl->hotPxSelected;
 }
 
-inline static unsigned int emit_defects(DefectMap& defectMap, BadPxSet::const_iterator p0, BadPxSet::const_iterator p1, double stdev, int sign, bool verbose)
+inline static unsigned int emit_defects(std::vector<wxPoint>& defects, BadPxSet::const_iterator p0, BadPxSet::const_iterator p1, double stdev, int sign, bool verbose)
 {
     unsigned int cnt = 0;
     for (BadPxSet::const_iterator it = p0; it != p1; ++it, ++cnt)
@@ -983,7 +1122,7 @@ inline static unsigned int emit_defects(DefectMap& defectMap, BadPxSet::const_it
             int v = sign * it->v;
             Debug.AddLine("DefectMap: defect @ (%d, %d) val = %d (%+.1f sigma)", it->x, it->y, v, stdev > 0.1 ? (double)v / stdev : 0.0);
         }
-        defectMap.push_back(wxPoint(it->x, it->y));
+        defects.push_back(wxPoint(it->x, it->y));
     }
     return cnt;
 }
@@ -1020,9 +1159,10 @@ void DefectMapBuilder::BuildDefectMap(DefectMap& defectMap, bool verbose) const
 
     FindThresh(m_impl);
 
-    defectMap.clear();
-    unsigned int nr_cold = emit_defects(defectMap, m_impl->coldPxThresh, m_impl->coldPx.end(), stats.stdev, -1, verbose);
-    unsigned int nr_hot = emit_defects(defectMap, m_impl->hotPxThresh, m_impl->hotPx.end(), stats.stdev, +1, verbose);
+    std::vector<wxPoint> defects;
+    unsigned int nr_cold = emit_defects(defects, m_impl->coldPxThresh, m_impl->coldPx.end(), stats.stdev, -1, verbose);
+    unsigned int nr_hot = emit_defects(defects, m_impl->hotPxThresh, m_impl->hotPx.end(), stats.stdev, +1, verbose);
+    defectMap.Assign(defects);
 
     if (verbose) Debug.AddLine("New defect map created, count=%d (cold=%d, hot=%d)", defectMap.size(), nr_cold, nr_hot);
 }
@@ -1040,9 +1180,10 @@ bool RemoveDefects(usImage& light, const DefectMap& defectMap)
 
     if (!light.Subframe.IsEmpty())
     {
-        // Step over each defect and replace the light value
-        // with the median of the surrounding pixels
-        for (DefectMap::const_iterator it = defectMap.begin(); it != defectMap.end(); ++it)
+        // Step over the defects in the rows of the subframe and replace the
+        // light value with the median of the surrounding pixels
+        DefectMap::const_iterator const end = defectMap.RowEnd(light.Subframe.GetBottom());
+        for (DefectMap::const_iterator it = defectMap.RowBegin(light.Subframe.GetTop()); it != end; ++it)
         {
             const wxPoint& pt = *it;
             // Check to see if we are within the subframe before correcting the defect
@@ -1072,6 +1213,15 @@ bool RemoveDefects(usImage& light, const DefectMap& defectMap)
 }
 
 wxString DefectMap::DefectMapFileName(int profileId)
+{
+    int inst = pFrame->GetInstanceNumber();
+    return MyFrame::GetDarksDir() + PATHSEPSTR +
+        wxString::Format("PHD2_defect_map%s_%d.bpm", inst > 1 ? wxString::Format("_%d", inst) : "", profileId);
+}
+
+// defect maps were originally saved as text; they are converted to the binary
+// format the first time they are loaded
+wxString DefectMap::LegacyDefectMapFileName(int profileId)
 {
     int inst = pFrame->GetInstanceNumber();
     return MyFrame::GetDarksDir() + PATHSEPSTR +
@@ -1086,6 +1236,11 @@ bool DefectMap::ImportFromProfile(int srcId, int destId)
 
     sourceName = DefectMapFileName(srcId);
     destName = DefectMapFileName(destId);
+    if (!wxFileExists(sourceName))
+    {
+        // convert the source profile's text map before copying it
+        delete LoadDefectMap(srcId);
+    }
     rslt = wxCopyFile(sourceName, destName, true);
     if (rslt != 1)
     {
@@ -1115,7 +1270,7 @@ bool DefectMap::DefectMapExists(int profileId, bool showAlert)
 {
     bool bOk = false;
 
-    if (wxFileExists(DefectMapFileName(profileId)))
+    if (wxFileExists(DefectMapFileName(profileId)) || wxFileExists(LegacyDefectMapFileName(profileId)))
     {
         wxString fName = DefectMapMasterPath(profileId);
         const wxSize& sensorSize = pCamera->DarkFrameSize();
@@ -1145,33 +1300,47 @@ bool DefectMap::DefectMapExists(int profileId, bool showAlert)
     return bOk;
 }
 
-void DefectMap::Save(const wxArrayString& info) const
+// Binary defect map file layout, all integers little-endian:
+//
+//   char[8]  magic "PHD2BPM1"
+//   uint32   defect count
+//   uint32   length in bytes of the info text
+//   char[]   info text, UTF-8, one line per info entry
+//   defects  count x { uint16 x, uint16 y }, sorted by y then x
+
+static const char BpmMagic[8] = { 'P', 'H', 'D', '2', 'B', 'P', 'M', '1' };
+enum { BPM_HEADER_SIZE = 16, BPM_DEFECT_SIZE = 4 };
+
+inline static unsigned int get_u16(const unsigned char *p)
 {
-    wxString filename = DefectMapFileName(m_profileId);
-    wxFileOutputStream oStream(filename);
-    wxTextOutputStream outText(oStream);
+    return p[0] | (p[1] << 8);
+}
 
-    if (oStream.GetLastError() != wxSTREAM_NO_ERROR)
-    {
-        Debug.AddLine(wxString::Format("Failed to save defect map to %s", filename));
-        return;
-    }
+inline static unsigned int get_u32(const unsigned char *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int) p[3] << 24);
+}
 
-    outText << "# PHD2 Defect Map v1\n";
+inline static void put_u16(std::vector<unsigned char>& buf, unsigned int v)
+{
+    buf.push_back((unsigned char) v);
+    buf.push_back((unsigned char) (v >> 8));
+}
 
-    for (wxArrayString::const_iterator it = info.begin(); it != info.end(); ++it)
-    {
-        outText << "# " << *it << "\n";
-    }
-    outText << "# Defect count: " << ((unsigned int) size()) << "\n";
+inline static void put_u32(std::vector<unsigned char>& buf, unsigned int v)
+{
+    put_u16(buf, v & 0xffff);
+    put_u16(buf, v >> 16);
+}
 
-    for (const_iterator it = begin(); it != end(); ++it)
-    {
-        outText << it->x << " " << it->y << "\n";
-    }
+inline static bool defect_less(const wxPoint& a, const wxPoint& b)
+{
+    return a.y < b.y || (a.y == b.y && a.x < b.x);
+}
 
-    oStream.Close();
-    Debug.AddLine(wxString::Format("Saved defect map to %s", filename));
+inline static bool defect_invalid(const wxPoint& a)
+{
+    return a.x < 0 || a.y < 0 || a.x > 0xffff || a.y > 0xffff;
 }
 
 DefectMap::DefectMap()
@@ -1184,44 +1353,191 @@ DefectMap::DefectMap(int profileId)
 {
 }
 
+void DefectMap::BuildIndex()
+{
+    m_rowStart.clear();
+
+    if (m_defects.empty())
+        return;
+
+    int const rows = m_defects.back().y + 1;
+    m_rowStart.resize(rows + 1);
+
+    unsigned int i = 0;
+    for (int y = 0; y <= rows; y++)
+    {
+        while (i < m_defects.size() && m_defects[i].y < y)
+            ++i;
+        m_rowStart[y] = i;
+    }
+}
+
+void DefectMap::Assign(std::vector<wxPoint>& defects)
+{
+    // takes the contents of defects
+    m_defects.swap(defects);
+    defects.clear();
+
+    m_defects.erase(std::remove_if(m_defects.begin(), m_defects.end(), defect_invalid), m_defects.end());
+    std::sort(m_defects.begin(), m_defects.end(), defect_less);
+    m_defects.erase(std::unique(m_defects.begin(), m_defects.end()), m_defects.end());
+
+    BuildIndex();
+}
+
+void DefectMap::clear()
+{
+    m_defects.clear();
+    m_rowStart.clear();
+}
+
+DefectMap::const_iterator DefectMap::RowBegin(int top) const
+{
+    if (top <= 0)
+        return m_defects.begin();
+    if (top >= (int) m_rowStart.size())
+        return m_defects.end();
+    return m_defects.begin() + m_rowStart[top];
+}
+
+DefectMap::const_iterator DefectMap::RowEnd(int bottom) const
+{
+    if (bottom < 0)
+        return m_defects.begin();
+    if (bottom + 1 >= (int) m_rowStart.size())
+        return m_defects.end();
+    return m_defects.begin() + m_rowStart[bottom + 1];
+}
+
 bool DefectMap::FindDefect(const wxPoint& pt) const
 {
-    return std::find(begin(), end(), pt) != end();
+    return std::binary_search(RowBegin(pt.y), RowEnd(pt.y), pt, defect_less);
+}
+
+bool DefectMap::SaveBinary(const wxString& filename) const
+{
+    wxString text;
+    for (wxArrayString::const_iterator it = m_info.begin(); it != m_info.end(); ++it)
+        text += *it + "\n";
+    const wxScopedCharBuffer info(text.ToUTF8());
+    size_t const infoLen = info.length();
+
+    std::vector<unsigned char> buf;
+    buf.reserve(BPM_HEADER_SIZE + infoLen + m_defects.size() * BPM_DEFECT_SIZE);
+    buf.insert(buf.end(), BpmMagic, BpmMagic + sizeof(BpmMagic));
+    put_u32(buf, (unsigned int) m_defects.size());
+    put_u32(buf, (unsigned int) infoLen);
+    buf.insert(buf.end(), info.data(), info.data() + infoLen);
+    for (const_iterator it = begin(); it != end(); ++it)
+    {
+        put_u16(buf, it->x);
+        put_u16(buf, it->y);
+    }
+
+    // write to a temporary file and rename it into place so a reader never
+    // sees a partially written map
+    wxString tmpname = filename + ".tmp";
+    {
+        wxFile file(tmpname, wxFile::write);
+        if (!file.IsOpened() || file.Write(&buf[0], buf.size()) != buf.size())
+        {
+            Debug.AddLine(wxString::Format("Failed to save defect map to %s", tmpname));
+            return true;
+        }
+    }
+
+    if (!wxRenameFile(tmpname, filename, true))
+    {
+        Debug.AddLine(wxString::Format("Failed to rename defect map %s to %s", tmpname, filename));
+        wxRemoveFile(tmpname);
+        return true;
+    }
+
+    return false;
+}
+
+void DefectMap::Save(const wxArrayString& info)
+{
+    m_info = info;
+
+    wxString filename = DefectMapFileName(m_profileId);
+    if (!SaveBinary(filename))
+        Debug.AddLine(wxString::Format("Saved defect map to %s", filename));
 }
 
 void DefectMap::AddDefect(const wxPoint& pt)
 {
+    if (defect_invalid(pt))
+        return;
+
     // first add the point
-    push_back(pt);
+    std::vector<wxPoint>::iterator pos = std::lower_bound(m_defects.begin(), m_defects.end(), pt, defect_less);
+    if (pos != m_defects.end() && *pos == pt)
+        return;
+    m_defects.insert(pos, pt);
+    BuildIndex();
 
     wxString filename = DefectMapFileName(m_profileId);
-    wxFile file(filename, wxFile::write_append);
-    wxFileOutputStream oStream(file);
-    wxTextOutputStream outText(oStream);
+    if (!SaveBinary(filename))
+        Debug.AddLine(wxString::Format("Saved defect map to %s", filename));
+}
+
+bool DefectMap::LoadBinary(const wxString& filename)
+{
+    MappedFile file;
+    if (file.Open(filename))
+        return true;
+
+    const unsigned char *p = file.Data();
+    size_t const size = file.Size();
 
-    if (oStream.GetLastError() != wxSTREAM_NO_ERROR)
+    if (size < BPM_HEADER_SIZE || memcmp(p, BpmMagic, sizeof(BpmMagic)) != 0)
     {
-        Debug.AddLine(wxString::Format("Failed to save defect map to %s", filename));
-        return;
+        Debug.AddLine(wxString::Format("Defect map file %s is not a PHD2 bad-pixel map", filename));
+        return true;
     }
 
-    outText << pt.x << " " << pt.y << "\n";
+    unsigned int count = get_u32(p + 8);
+    unsigned int infoLen = get_u32(p + 12);
 
-    oStream.Close();
-    Debug.AddLine(wxString::Format("Saved defect map to %s", filename));
-}
+    if (infoLen > size - BPM_HEADER_SIZE ||
+        count > (size - BPM_HEADER_SIZE - infoLen) / BPM_DEFECT_SIZE)
+    {
+        Debug.AddLine(wxString::Format("Defect map file %s is truncated", filename));
+        return true;
+    }
 
-DefectMap *DefectMap::LoadDefectMap(int profileId)
-{
-    wxString filename = DefectMapFileName(profileId);
-    Debug.AddLine(wxString::Format("Loading defect map file %s", filename));
+    const char *info = reinterpret_cast<const char *>(p + BPM_HEADER_SIZE);
+    wxStringTokenizer tok(wxString::FromUTF8(info, infoLen), "\n");
+    m_info.Clear();
+    while (tok.HasMoreTokens())
+        m_info.push_back(tok.GetNextToken());
 
-    if (!wxFileExists(filename))
+    m_defects.resize(count);
+    const unsigned char *d = p + BPM_HEADER_SIZE + infoLen;
+    bool sorted = true;
+    for (unsigned int i = 0; i < count; i++, d += BPM_DEFECT_SIZE)
     {
-        Debug.AddLine(wxString::Format("Defect map file not found: %s", filename));
-        return 0;
+        m_defects[i] = wxPoint(get_u16(d), get_u16(d + 2));
+        if (i > 0 && !defect_less(m_defects[i - 1], m_defects[i]))
+            sorted = false;
+    }
+
+    if (sorted)
+        BuildIndex();
+    else
+    {
+        Debug.AddLine("DefectMap: defects out of order, sorting");
+        std::vector<wxPoint> defects;
+        defects.swap(m_defects);
+        Assign(defects);
     }
 
+    return false;
+}
+
+bool DefectMap::LoadText(const wxString& filename)
+{
     wxFileInputStream iStream(filename);
     wxTextInputStream inText(iStream);
 
@@ -1229,10 +1545,11 @@ DefectMap *DefectMap::LoadDefectMap(int profileId)
     if (iStream.GetLastError() != wxSTREAM_NO_ERROR)
     {
         Debug.AddLine(wxString::Format("Unexpected eof on defect map file %s", filename));
-        return 0;
+        return true;
     }
 
-    DefectMap *defectMap = new DefectMap(profileId);
+    std::vector<wxPoint> defects;
+    m_info.Clear();
 
     int linenum = 0;
     while (!inText.GetInputStream().Eof())
@@ -1243,7 +1560,12 @@ DefectMap *DefectMap::LoadDefectMap(int profileId)
         if (line.IsEmpty())
             continue;
         if (line.StartsWith("#"))
+        {
+            wxString info = line.Mid(1).Trim(false);
+            if (!info.StartsWith("PHD2 Defect Map") && !info.StartsWith("Defect count:"))
+                m_info.push_back(info);
             continue;
+        }
 
         wxStringTokenizer tok(line);
         wxString s1 = tok.GetNextToken();
@@ -1251,7 +1573,7 @@ DefectMap *DefectMap::LoadDefectMap(int profileId)
         long x, y;
         if (s1.ToLong(&x) && s2.ToLong(&y))
         {
-            defectMap->push_back(wxPoint(x, y));
+            defects.push_back(wxPoint(x, y));
         }
         else
         {
@@ -1259,17 +1581,63 @@ DefectMap *DefectMap::LoadDefectMap(int profileId)
         }
     }
 
+    Assign(defects);
+
+    return false;
+}
+
+DefectMap *DefectMap::LoadDefectMap(int profileId)
+{
+    wxString filename = DefectMapFileName(profileId);
+    Debug.AddLine(wxString::Format("Loading defect map file %s", filename));
+
+    DefectMap *defectMap = new DefectMap(profileId);
+
+    if (wxFileExists(filename))
+    {
+        if (defectMap->LoadBinary(filename))
+        {
+            delete defectMap;
+            return 0;
+        }
+    }
+    else
+    {
+        wxString legacy = LegacyDefectMapFileName(profileId);
+        if (!wxFileExists(legacy))
+        {
+            Debug.AddLine(wxString::Format("Defect map file not found: %s", filename));
+            delete defectMap;
+            return 0;
+        }
+
+        Debug.AddLine(wxString::Format("Converting defect map file %s", legacy));
+
+        if (defectMap->LoadText(legacy))
+        {
+            delete defectMap;
+            return 0;
+        }
+
+        // the text file is left in place; from now on the binary file is used
+        if (defectMap->SaveBinary(filename))
+            Debug.AddLine("DefectMap: conversion failed, will retry on next load");
+    }
+
     Debug.AddLine(wxString::Format("Loaded %d defects", defectMap->size()));
     return defectMap;
 }
 
 void DefectMap::DeleteDefectMap(int profileId)
 {
-    wxString filename = DefectMapFileName(profileId);
-    if (wxFileExists(filename))
+    wxString filenames[] = { DefectMapFileName(profileId), LegacyDefectMapFileName(profileId) };
+    for (unsigned int i = 0; i < WXSIZEOF(filenames); i++)
     {
-        Debug.AddLine("Removing defect map file: " + filename);
-        wxRemoveFile(filename);
+        if (wxFileExists(filenames[i]))
+        {
+            Debug.AddLine("Removing defect map file: " + filenames[i]);
+            wxRemoveFile(filenames[i]);
+        }
     }
 }
 
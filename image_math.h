@@ -36,21 +36,45 @@
 #ifndef IMAGE_MATH_INCLUDED
 #define IMAGE_MATH_INCLUDED
 
-class DefectMap : public std::vector<wxPoint>
+// Bad-pixel map. The defects are kept sorted by row, then by column, with an
+// index of where each row starts, so the defects inside a subframe can be
+// visited without walking the whole map.
+class DefectMap
 {
     int m_profileId;
+    std::vector<wxPoint> m_defects;
+    std::vector<unsigned int> m_rowStart; // m_rowStart[y] = index of first defect in a row >= y
+    wxArrayString m_info;
+
     DefectMap(int profileId);
+    void BuildIndex();
+    bool LoadBinary(const wxString& filename);
+    bool LoadText(const wxString& filename);
+    bool SaveBinary(const wxString& filename) const;
+
 public:
+    typedef std::vector<wxPoint>::const_iterator const_iterator;
+
     static void DeleteDefectMap(int profileId);
     static bool DefectMapExists(int profileId, bool showAlert = true);
     static DefectMap *LoadDefectMap(int profileId);
     static wxString DefectMapFileName(int profileId);
+    static wxString LegacyDefectMapFileName(int profileId);
     static bool ImportFromProfile(int sourceId, int destId);
     DefectMap();
-    void Save(const wxArrayString& mapInfo) const;
+    void Assign(std::vector<wxPoint>& defects);
+    void Save(const wxArrayString& mapInfo);
     bool FindDefect(const wxPoint& pt) const;
     void AddDefect(const wxPoint& pt);
 
+    const_iterator begin() const { return m_defects.begin(); }
+    const_iterator end() const { return m_defects.end(); }
+    size_t size() const { return m_defects.size(); }
+    void clear();
+
+    // defects in rows [top, bottom]
+    const_iterator RowBegin(int top) const;
+    const_iterator RowEnd(int bottom) const;
 };
 
 extern bool QuickLRecon(usImage& img);
@@ -0,0 +1,300 @@
+/*
+ *  json_writer.cpp
+ *  PHD Guiding
+ *
+ *  Created by Andy Galasso.
+ *  Copyright (c) 2013 Andy Galasso.
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of Craig Stark, Stark Labs nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "phd.h"
+
+static void json_put_escaped(JBuf& b, unsigned int c)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    switch (c)
+    {
+    case '"':  b.append("\\\"", 2); break;
+    case '\\': b.append("\\\\", 2); break;
+    case '\n': b.append("\\n", 2); break;
+    case '\r': b.append("\\r", 2); break;
+    case '\t': b.append("\\t", 2); break;
+    default:
+        if (c < 0x20)
+        {
+            char u[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf] };
+            b.append(u, sizeof(u));
+        }
+        else if (c < 0x80)
+            b.append((char) c);
+        else if (c < 0x800)
+        {
+            b.append((char)(0xC0 | (c >> 6)));
+            b.append((char)(0x80 | (c & 0x3F)));
+        }
+        else if (c < 0x10000)
+        {
+            b.append((char)(0xE0 | (c >> 12)));
+            b.append((char)(0x80 | ((c >> 6) & 0x3F)));
+            b.append((char)(0x80 | (c & 0x3F)));
+        }
+        else
+        {
+            b.append((char)(0xF0 | (c >> 18)));
+            b.append((char)(0x80 | ((c >> 12) & 0x3F)));
+            b.append((char)(0x80 | ((c >> 6) & 0x3F)));
+            b.append((char)(0x80 | (c & 0x3F)));
+        }
+        break;
+    }
+}
+
+// quoted string from UTF-8 (or plain ASCII) input
+void json_put_str(JBuf& b, const char *s)
+{
+    b.append('"');
+    for (const char *p = s; *p; p++)
+    {
+        unsigned char c = (unsigned char) *p;
+        if (c < 0x20 || c == '"' || c == '\\')
+            json_put_escaped(b, c);
+        else
+            b.append((char) c);
+    }
+    b.append('"');
+}
+
+// quoted string from wide-character input, encoded to UTF-8 without an
+// intermediate conversion buffer
+void json_put_str(JBuf& b, const wchar_t *s, size_t len)
+{
+    b.append('"');
+    const wchar_t *end = s + len;
+    for (const wchar_t *p = s; p < end; p++)
+    {
+        unsigned int c = (unsigned int) *p;
+        if (sizeof(wchar_t) == 2 && c >= 0xD800 && c <= 0xDBFF && p + 1 < end)
+        {
+            unsigned int lo = (unsigned int) p[1];
+            if (lo >= 0xDC00 && lo <= 0xDFFF)
+            {
+                c = 0x10000 + ((c - 0xD800) << 10) + (lo - 0xDC00);
+                ++p;
+            }
+        }
+        json_put_escaped(b, c);
+    }
+    b.append('"');
+}
+
+void json_put_str(JBuf& b, const wxString& s)
+{
+    json_put_str(b, s.wc_str(), s.length());
+}
+
+void json_put_int(JBuf& b, long long v)
+{
+    char tmp[24];
+    char *p = &tmp[sizeof(tmp)];
+    unsigned long long u = v < 0 ? 0ULL - (unsigned long long) v : (unsigned long long) v;
+    do
+    {
+        *--p = (char)('0' + (u % 10));
+        u /= 10;
+    } while (u);
+    if (v < 0)
+        *--p = '-';
+    b.append(p, &tmp[sizeof(tmp)] - p);
+}
+
+// fixed-point formatting, equivalent to "%.*f" but without going through
+// printf and independent of the C locale's decimal separator
+void json_put_fixed(JBuf& b, double d, int prec)
+{
+    static const double pow10[] = { 1., 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9 };
+
+    if (d != d || d - d != 0.) // NaN or infinity
+    {
+        b.append("null", 4);
+        return;
+    }
+
+    if (prec < 0)
+        prec = 0;
+
+    double a = fabs(d);
+    if (prec >= (int) WXSIZEOF(pow10) || a * pow10[prec] >= 9.0e15)
+    {
+        char tmp[512];
+        int n = sprintf(tmp, "%.*f", prec, d);
+        for (int i = 0; i < n; i++)
+            if (tmp[i] == ',')
+                tmp[i] = '.';
+        b.append(tmp, n);
+        return;
+    }
+
+    unsigned long long scale = (unsigned long long) pow10[prec];
+    unsigned long long r = (unsigned long long) floor(a * pow10[prec] + 0.5);
+
+    if (d < 0. && r != 0)
+        b.append('-');
+
+    json_put_int(b, (long long)(r / scale));
+
+    if (prec > 0)
+    {
+        char frac[16];
+        unsigned long long f = r % scale;
+        for (int i = prec - 1; i >= 0; i--)
+        {
+            frac[i] = (char)('0' + (f % 10));
+            f /= 10;
+        }
+        b.append('.');
+        b.append(frac, prec);
+    }
+}
+
+// shortest representation that parses back to the same double; integral
+// values take a fast path that skips printf entirely
+void json_put_double(JBuf& b, double d)
+{
+    if (d != d || d - d != 0.) // NaN or infinity
+    {
+        b.append("null", 4);
+        return;
+    }
+
+    if (d == floor(d) && fabs(d) < 9.0e15)
+    {
+        json_put_int(b, (long long) d);
+        return;
+    }
+
+    char tmp[32];
+    int n = 0;
+    for (int prec = 15; prec <= 17; prec++)
+    {
+        n = sprintf(tmp, "%.*g", prec, d);
+        if (strtod(tmp, 0) == d)
+            break;
+    }
+    for (int i = 0; i < n; i++)
+        if (tmp[i] == ',')
+            tmp[i] = '.';
+    b.append(tmp, n);
+}
+
+void json_format(JBuf& b, const json_value *j)
+{
+    if (!j)
+    {
+        b.append("null", 4);
+        return;
+    }
+
+    switch (j->type) {
+    default:
+    case JSON_NULL:
+        b.append("null", 4);
+        break;
+    case JSON_OBJECT: {
+        b.append('{');
+        bool first = true;
+        json_for_each (jj, j)
+        {
+            if (first)
+                first = false;
+            else
+                b.append(',');
+            json_put_str(b, jj->name);
+            b.append(':');
+            json_format(b, jj);
+        }
+        b.append('}');
+        break;
+    }
+    case JSON_ARRAY: {
+        b.append('[');
+        bool first = true;
+        json_for_each (jj, j)
+        {
+            if (first)
+                first = false;
+            else
+                b.append(',');
+            json_format(b, jj);
+        }
+        b.append(']');
+        break;
+    }
+    case JSON_STRING: json_put_str(b, j->string_value); break;
+    case JSON_INT:    json_put_int(b, j->int_value); break;
+    case JSON_FLOAT:  json_put_double(b, (double) j->float_value); break;
+    case JSON_BOOL:   b.append(j->int_value ? "true" : "false"); break;
+    }
+}
+
+wxString json_format(const json_value *j)
+{
+    JBuf b;
+    json_format(b, j);
+    return b.str();
+}
+
+JObj& operator<<(JObj& j, const NV& nv)
+{
+    JBuf& b = j.m_s;
+
+    j.key(nv.n);
+
+    switch (nv.t)
+    {
+    case NV::NV_NULL:   b.append("null", 4); break;
+    case NV::NV_BOOL:   b.append(nv.b ? "true" : "false"); break;
+    case NV::NV_INT:    json_put_int(b, nv.i); break;
+    case NV::NV_DOUBLE: json_put_double(b, nv.d); break;
+    case NV::NV_FIXED:  json_put_fixed(b, nv.d, nv.prec); break;
+    case NV::NV_STR:    json_put_str(b, nv.s); break;
+    case NV::NV_WSTR:   json_put_str(b, nv.ws, wcslen(nv.ws)); break;
+    case NV::NV_WXSTR:  json_put_str(b, *nv.wxs); break;
+    case NV::NV_JSON:   json_format(b, nv.json); break;
+    case NV::NV_VEC:    (*nv.putvec)(b, nv.vec); break;
+    case NV::NV_POINT:
+        b.append('[');
+        json_put_fixed(b, nv.d, nv.prec);
+        b.append(',');
+        json_put_fixed(b, nv.d2, nv.prec);
+        b.append(']');
+        break;
+    }
+
+    return j;
+}
@@ -0,0 +1,283 @@
+/*
+ *  json_writer.h
+ *  PHD Guiding
+ *
+ *  Created by Andy Galasso.
+ *  Copyright (c) 2013 Andy Galasso.
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of Craig Stark, Stark Labs nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include "json_parser.h"
+
+// Growable UTF-8 output buffer. Like the parser's block_allocator, the storage is
+// kept when the buffer is reset so that a buffer that is reused for each message
+// stops touching the heap once it has grown to the size of the largest message.
+class JBuf
+{
+    char *m_buf;
+    size_t m_len;
+    size_t m_size;
+
+    void grow(size_t need)
+    {
+        size_t size = m_size ? m_size : 256;
+        while (size < need)
+            size *= 2;
+        m_buf = (char *) ::realloc(m_buf, size);
+        m_size = size;
+    }
+
+public:
+    JBuf() : m_buf(0), m_len(0), m_size(0) { }
+    JBuf(const JBuf& rhs) : m_buf(0), m_len(0), m_size(0) { append(rhs.m_buf, rhs.m_len); }
+    ~JBuf() { ::free(m_buf); }
+
+    JBuf& operator=(const JBuf& rhs)
+    {
+        if (this != &rhs)
+        {
+            m_len = 0;
+            append(rhs.m_buf, rhs.m_len);
+        }
+        return *this;
+    }
+
+    const char *data() const { return m_buf; }
+    char *data() { return m_buf; }
+    size_t len() const { return m_len; }
+    void reset() { m_len = 0; }
+
+    // make room for n more bytes and return a pointer to them; extend()
+    // then accounts for the bytes actually filled in
+    char *reserve(size_t n)
+    {
+        if (m_len + n > m_size)
+            grow(m_len + n);
+        return m_buf + m_len;
+    }
+
+    void extend(size_t n) { m_len += n; }
+
+    // discard the first n bytes
+    void consume(size_t n)
+    {
+        if (n >= m_len)
+            m_len = 0;
+        else
+        {
+            memmove(m_buf, m_buf + n, m_len - n);
+            m_len -= n;
+        }
+    }
+
+    void append(char c)
+    {
+        if (m_len + 1 > m_size)
+            grow(m_len + 1);
+        m_buf[m_len++] = c;
+    }
+
+    void append(const char *s, size_t n)
+    {
+        if (!n)
+            return;
+        if (m_len + n > m_size)
+            grow(m_len + n);
+        memcpy(m_buf + m_len, s, n);
+        m_len += n;
+    }
+
+    void append(const char *s) { append(s, strlen(s)); }
+    void append(const JBuf& b) { append(b.m_buf, b.m_len); }
+
+    wxString str() const { return wxString::FromUTF8(m_buf, m_len); }
+};
+
+extern void json_put_str(JBuf& b, const char *s);
+extern void json_put_str(JBuf& b, const wchar_t *s, size_t len);
+extern void json_put_str(JBuf& b, const wxString& s);
+extern void json_put_int(JBuf& b, long long v);
+extern void json_put_fixed(JBuf& b, double d, int prec);
+extern void json_put_double(JBuf& b, double d);
+extern void json_format(JBuf& b, const json_value *j);
+extern wxString json_format(const json_value *j);
+
+// A JSON object or array written directly into a buffer that it does not own.
+//
+// A top-level sequence starts the buffer over, so a buffer that is kept for
+// the purpose is reused for every message. A nested sequence is written
+// into its parent's buffer at the point it is constructed and is closed
+// when it goes out of scope; nothing else may be written to the parent
+// while the nested sequence is open.
+template<char LDELIM, char RDELIM>
+struct JSeq
+{
+    JBuf& m_s;
+    bool m_first;
+    mutable bool m_closed;
+    bool m_nested;
+
+    explicit JSeq(JBuf& buf)
+        : m_s(buf), m_first(true), m_closed(false), m_nested(false)
+    {
+        m_s.reset();
+        m_s.append(LDELIM);
+    }
+
+    // an element of the parent array, or the named member of the parent object
+    template<char PL, char PR>
+    explicit JSeq(JSeq<PL, PR>& parent, const char *name = 0)
+        : m_s(parent.m_s), m_first(true), m_closed(false), m_nested(true)
+    {
+        if (name)
+            parent.key(name);
+        else
+            parent.sep();
+        m_s.append(LDELIM);
+    }
+
+    ~JSeq() { if (m_nested && !m_closed) close(); }
+
+    void sep() { if (m_first) m_first = false; else m_s.append(','); }
+    void key(const char *name)
+    {
+        sep();
+        m_s.append('"');
+        m_s.append(name);
+        m_s.append("\":", 2);
+    }
+    void close() const { m_s.append(RDELIM); m_closed = true; }
+    const JBuf& buf() const { if (!m_closed) close(); return m_s; }
+    wxString str() const { return buf().str(); }
+};
+
+typedef JSeq<'[', ']'> JAry;
+typedef JSeq<'{', '}'> JObj;
+
+inline JAry& operator<<(JAry& a, double d)
+{
+    a.sep();
+    json_put_fixed(a.m_s, d, 2);
+    return a;
+}
+
+inline JAry& operator<<(JAry& a, int i)
+{
+    a.sep();
+    json_put_int(a.m_s, i);
+    return a;
+}
+
+inline JAry& operator<<(JAry& a, const char *str)
+{
+    a.sep();
+    json_put_str(a.m_s, str);
+    return a;
+}
+
+struct NULL_TYPE { };
+
+inline void json_put_vec_elem(JBuf& b, double v) { json_put_double(b, v); }
+inline void json_put_vec_elem(JBuf& b, float v) { json_put_double(b, v); }
+template<typename T>
+inline void json_put_vec_elem(JBuf& b, const T& v) { json_put_int(b, (long long) v); }
+
+template<typename T>
+void json_put_vec(JBuf& b, const void *p)
+{
+    const std::vector<T>& vec = *static_cast<const std::vector<T> *>(p);
+    b.append('[');
+    for (unsigned int i = 0; i < vec.size(); i++)
+    {
+        if (i != 0)
+            b.append(',');
+        json_put_vec_elem(b, vec[i]);
+    }
+    b.append(']');
+}
+
+// name-value pair
+//
+// An NV does not copy strings or vectors; it refers to the caller's and is
+// rendered straight into the destination buffer by operator<<, so it must be
+// written out in the same expression that creates it: obj << NV(...).
+struct NV
+{
+    enum Type
+    {
+        NV_NULL,
+        NV_BOOL,
+        NV_INT,
+        NV_DOUBLE,
+        NV_FIXED,
+        NV_STR,
+        NV_WSTR,
+        NV_WXSTR,
+        NV_JSON,
+        NV_POINT,
+        NV_VEC,
+    };
+
+    const char *n;
+    Type t;
+    union
+    {
+        bool b;
+        int i;
+        double d;
+        const char *s;
+        const wchar_t *ws;
+        const wxString *wxs;
+        const json_value *json;
+        const void *vec;
+    };
+    double d2;  // NV_POINT y
+    int prec;   // NV_FIXED, NV_POINT
+    void (*putvec)(JBuf& b, const void *vec);
+
+    NV(const char *n_, const wxString& v_) : n(n_), t(NV_WXSTR), wxs(&v_) { }
+    NV(const char *n_, const char *v_) : n(n_), t(NV_STR), s(v_) { }
+    NV(const char *n_, const wchar_t *v_) : n(n_), t(NV_WSTR), ws(v_) { }
+    NV(const char *n_, int v_) : n(n_), t(NV_INT), i(v_) { }
+    NV(const char *n_, double v_) : n(n_), t(NV_DOUBLE), d(v_) { }
+    NV(const char *n_, double v_, int prec_) : n(n_), t(NV_FIXED), d(v_), prec(prec_) { }
+    NV(const char *n_, bool v_) : n(n_), t(NV_BOOL), b(v_) { }
+    template<typename T>
+    NV(const char *n_, const std::vector<T>& vec_) : n(n_), t(NV_VEC), vec(&vec_), putvec(&json_put_vec<T>) { }
+    NV(const char *n_, const json_value *v_) : n(n_), t(NV_JSON), json(v_) { }
+    NV(const char *n_, const PHD_Point& p) : n(n_), t(NV_POINT), d(p.X), d2(p.Y), prec(2) { }
+    NV(const char *n_, const wxPoint& p) : n(n_), t(NV_POINT), d(p.x), d2(p.y), prec(0) { }
+    NV(const char *n_, const NULL_TYPE& nul) : n(n_), t(NV_NULL) { }
+};
+
+extern JObj& operator<<(JObj& j, const NV& nv);
+
+#endif
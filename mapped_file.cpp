@@ -0,0 +1,216 @@
+/*
+ *  mapped_file.cpp
+ *  PHD Guiding
+ *
+ *  Created by the PHD2 developers
+ *  Copyright (c) 2014 PHD2 Developers
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of Craig Stark, Stark Labs nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "phd.h"
+
+#if defined(__WINDOWS__)
+# include <wx/msw/wrapwin.h>
+#else
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <fcntl.h>
+# include <unistd.h>
+# include <errno.h>
+#endif
+
+MappedFile::MappedFile()
+    : m_data(0),
+      m_size(0),
+      m_view(0),
+      m_viewSize(0)
+#if defined(__WINDOWS__)
+      , m_file(INVALID_HANDLE_VALUE),
+      m_mapping(0)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+// work out the range to map; returns true if it is not inside the file or
+// cannot be mapped in this address space
+static bool map_range(wxUint64 fileSize, wxUint64 offset, size_t *length, wxUint64 granularity,
+                      wxUint64 *base, size_t *viewSize)
+{
+    if (offset >= fileSize)
+        return true;
+
+    wxUint64 const avail = fileSize - offset;
+    if (*length == 0)
+    {
+        if (avail > (size_t) -1)
+            return true;
+        *length = (size_t) avail;
+    }
+    else if (*length > avail)
+        return true;
+
+    *base = offset - offset % granularity;
+    size_t const delta = (size_t) (offset - *base);
+    if (*length > (size_t) -1 - delta)
+        return true;
+    *viewSize = delta + *length;
+
+    return false;
+}
+
+#if defined(__WINDOWS__)
+
+bool MappedFile::Open(const wxString& filename, wxUint64 offset, size_t length)
+{
+    Close();
+
+    HANDLE file = ::CreateFileW(filename.wc_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        Debug.AddLine(wxString::Format("MappedFile: cannot open %s, err = %lu", filename, ::GetLastError()));
+        return true;
+    }
+
+    // views must start on an allocation granularity boundary
+    SYSTEM_INFO si;
+    ::GetSystemInfo(&si);
+
+    LARGE_INTEGER size;
+    wxUint64 base;
+    size_t viewSize;
+    if (!::GetFileSizeEx(file, &size) ||
+        map_range((wxUint64) size.QuadPart, offset, &length, si.dwAllocationGranularity, &base, &viewSize))
+    {
+        Debug.AddLine(wxString::Format("MappedFile: cannot map %s, bad size or range", filename));
+        ::CloseHandle(file);
+        return true;
+    }
+
+    HANDLE mapping = ::CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    void *view = mapping ? ::MapViewOfFile(mapping, FILE_MAP_READ, (DWORD) (base >> 32), (DWORD) base, viewSize) : NULL;
+    if (!view)
+    {
+        Debug.AddLine(wxString::Format("MappedFile: cannot map %s, err = %lu", filename, ::GetLastError()));
+        if (mapping)
+            ::CloseHandle(mapping);
+        ::CloseHandle(file);
+        return true;
+    }
+
+    m_file = file;
+    m_mapping = mapping;
+    m_view = view;
+    m_viewSize = viewSize;
+    m_data = static_cast<const unsigned char *>(view) + (size_t) (offset - base);
+    m_size = length;
+
+    return false;
+}
+
+void MappedFile::Close()
+{
+    if (m_view)
+        ::UnmapViewOfFile(m_view);
+    if (m_mapping)
+        ::CloseHandle(m_mapping);
+    if (m_file != INVALID_HANDLE_VALUE)
+        ::CloseHandle(m_file);
+
+    m_data = 0;
+    m_size = 0;
+    m_view = 0;
+    m_viewSize = 0;
+    m_mapping = 0;
+    m_file = INVALID_HANDLE_VALUE;
+}
+
+#else // POSIX
+
+bool MappedFile::Open(const wxString& filename, wxUint64 offset, size_t length)
+{
+    Close();
+
+    int fd = open(filename.fn_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        Debug.AddLine(wxString::Format("MappedFile: cannot open %s, errno = %d", filename, errno));
+        return true;
+    }
+
+    // mappings must start on a page boundary
+    long const pageSize = sysconf(_SC_PAGESIZE);
+
+    struct stat st;
+    wxUint64 base;
+    size_t viewSize;
+    if (fstat(fd, &st) != 0 || pageSize <= 0 ||
+        map_range((wxUint64) st.st_size, offset, &length, (wxUint64) pageSize, &base, &viewSize) ||
+        (wxUint64) (off_t) base != base)
+    {
+        Debug.AddLine(wxString::Format("MappedFile: cannot map %s, bad size or range", filename));
+        close(fd);
+        return true;
+    }
+
+    void *view = mmap(0, viewSize, PROT_READ, MAP_PRIVATE, fd, (off_t) base);
+
+    // the mapping stays valid after the descriptor is closed
+    close(fd);
+
+    if (view == MAP_FAILED)
+    {
+        Debug.AddLine(wxString::Format("MappedFile: cannot map %s, errno = %d", filename, errno));
+        return true;
+    }
+
+    m_view = view;
+    m_viewSize = viewSize;
+    m_data = static_cast<const unsigned char *>(view) + (size_t) (offset - base);
+    m_size = length;
+
+    return false;
+}
+
+void MappedFile::Close()
+{
+    if (m_view)
+        munmap(m_view, m_viewSize);
+
+    m_data = 0;
+    m_size = 0;
+    m_view = 0;
+    m_viewSize = 0;
+}
+
+#endif
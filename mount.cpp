@@ -93,12 +93,17 @@ Mount::MountConfigDialogPane::MountConfigDialogPane(wxWindow *pParent, const wxS
     m_pEnableGuide = new wxCheckBox(pParent, wxID_ANY, _("Enable Guide Output"), wxDefaultPosition, wxSize(150, -1), 0);
     m_pEnableGuide->SetToolTip(_("Keep this checked for guiding. Un-check to disable all mount guide commands and allow the mount to run un-guided"));
 
+    m_pCentroidFilter = new wxCheckBox(pParent, wxID_ANY, _("Smooth star position"));
+    m_pCentroidFilter->SetToolTip(_("Filter the measured star position to reduce the effect of seeing, and predict where the star "
+        "will be when the guide correction is sent. Most useful with short exposures."));
+
     chkSizer->Add(m_pEnableGuide);
     chkSizer->Add(m_pClearCalibration);
     DoAdd(chkSizer);
+    DoAdd(m_pCentroidFilter);
 
     wxString xAlgorithms[] = {
-        _("None"),_("Hysteresis"),_("Lowpass"),_("Lowpass2"), _("Resist Switch")
+        _("None"),_("Hysteresis"),_("Lowpass"),_("Lowpass2"), _("Resist Switch"), _("Predictive PEC")
     };
 
     width = StringArrayWidth(xAlgorithms, WXSIZEOF(xAlgorithms));
@@ -186,6 +191,7 @@ void Mount::MountConfigDialogPane::LoadValues(void)
     m_pYGuideAlgorithmChoice->SetSelection(m_initYGuideAlgorithmSelection);
     m_pYGuideAlgorithmChoice->Enable(!pFrame->CaptureActive);
     m_pEnableGuide->SetValue(m_pMount->GetGuidingEnabled());
+    m_pCentroidFilter->SetValue(m_pMount->GetCentroidFilterEnabled());
 
     if (m_pXGuideAlgorithmConfigDialogPane)
     {
@@ -207,6 +213,7 @@ void Mount::MountConfigDialogPane::UnloadValues(void)
     }
 
     m_pMount->SetGuidingEnabled(m_pEnableGuide->GetValue());
+    m_pMount->SetCentroidFilterEnabled(m_pCentroidFilter->GetValue());
 
     // note these two have to be before the SetXxxAlgorithm calls, because if we
     // changed the algorithm, the current one will get freed, and if we make
@@ -298,6 +305,19 @@ void Mount::SetGuidingEnabled(bool guidingEnabled)
     }
 }
 
+void Mount::SetCentroidFilterEnabled(bool enable)
+{
+    if (enable != m_centroidFilterEnabled)
+    {
+        GuideLog.SetGuidingParam(IsStepGuider() ? "AOCentroidFilter" : "MountCentroidFilter", enable ? "true" : "false");
+        m_centroidFilterEnabled = enable;
+        m_xCentroidFilter.Reset();
+        m_yCentroidFilter.Reset();
+    }
+
+    pConfig->Profile.SetBoolean("/" + GetMountClassName() + "/CentroidFilter", enable);
+}
+
 GUIDE_ALGORITHM Mount::GetGuideAlgorithm(GuideAlgorithm *pAlgorithm)
 {
     return pAlgorithm ? pAlgorithm->Algorithm() : GUIDE_ALGORITHM_NONE;
@@ -317,6 +337,13 @@ bool Mount::CreateGuideAlgorithm(int guideAlgorithm, Mount *mount, GuideAxis axi
             case GUIDE_ALGORITHM_LOWPASS2:
             case GUIDE_ALGORITHM_RESIST_SWITCH:
                 break;
+            case GUIDE_ALGORITHM_PREDICTIVE_PE:
+                // only meaningful for the periodic error in RA
+                if (axis != GUIDE_RA)
+                {
+                    throw ERROR_INFO("invalid guideAlgorithm for axis");
+                }
+                break;
             case GUIDE_ALGORITHM_NONE:
             default:
                 throw ERROR_INFO("invalid guideAlgorithm");
@@ -347,6 +374,9 @@ bool Mount::CreateGuideAlgorithm(int guideAlgorithm, Mount *mount, GuideAxis axi
         case GUIDE_ALGORITHM_RESIST_SWITCH:
             *ppAlgorithm = (GuideAlgorithm *)new GuideAlgorithmResistSwitch(mount, axis);
             break;
+        case GUIDE_ALGORITHM_PREDICTIVE_PE:
+            *ppAlgorithm = (GuideAlgorithm *)new GuideAlgorithmPredictivePE(mount, axis);
+            break;
         case GUIDE_ALGORITHM_NONE:
         default:
             assert(false);
@@ -460,6 +490,7 @@ Mount::Mount(void)
     m_pYGuideAlgorithm = NULL;
     m_pXGuideAlgorithm = NULL;
     m_guidingEnabled = true;
+    m_centroidFilterEnabled = false;
 
     ClearCalibration();
 
@@ -583,6 +614,26 @@ Mount::MOVE_RESULT Mount::Move(const PHD_Point& cameraVectorEndpoint, bool norma
         Debug.AddLine(wxString::Format("Moving (%.2f, %.2f) raw xDistance=%.2f yDistance=%.2f",
             cameraVectorEndpoint.X, cameraVectorEndpoint.Y, xDistance, yDistance));
 
+        // the time the correction is being made, for the centroid filter
+        double const now = ::wxGetUTCTimeMillis().ToDouble() / 1000.0;
+
+        if (normalMove && m_centroidFilterEnabled)
+        {
+            // Replace the measured offsets with the filtered offsets predicted for
+            // now, bridging the time since the middle of the exposure
+            double const measTime = pFrame->pGuider->CurrentPositionTime();
+
+            m_xCentroidFilter.Measure(measTime, xDistance);
+            m_yCentroidFilter.Measure(measTime, yDistance);
+
+            xDistance = m_xCentroidFilter.Predict(now);
+            yDistance = m_yCentroidFilter.Predict(now);
+
+            Debug.AddLine(wxString::Format("Centroid filter: predicted xDistance=%.2f yDistance=%.2f latency=%.2fs noise=(%.2f,%.2f)",
+                xDistance, yDistance, now - measTime,
+                m_xCentroidFilter.MeasurementNoise(), m_yCentroidFilter.MeasurementNoise()));
+        }
+
         if (normalMove)
         {
             // Feed the raw distances to the guide algorithms
@@ -635,6 +686,32 @@ Mount::MOVE_RESULT Mount::Move(const PHD_Point& cameraVectorEndpoint, bool norma
             Debug.AddLine(msg);
         }
 
+        if (normalMove)
+        {
+            // tell the guide algorithms how much of their corrections was issued
+            double xIssued = xMoveResult.amountMoved * m_xRate;
+            double yIssued = yMoveResult.amountMoved * m_cal.yRate;
+
+            if (m_pXGuideAlgorithm)
+            {
+                m_pXGuideAlgorithm->correctionApplied(xDistance < 0.0 ? -xIssued : xIssued);
+            }
+
+            if (m_pYGuideAlgorithm)
+            {
+                m_pYGuideAlgorithm->correctionApplied(yDistance < 0.0 ? -yIssued : yIssued);
+            }
+        }
+
+        if (m_centroidFilterEnabled)
+        {
+            // tell the filters how far the corrections moved the star
+            double xMoved = xMoveResult.amountMoved * m_xRate;
+            double yMoved = yMoveResult.amountMoved * m_cal.yRate;
+            m_xCentroidFilter.Correct(now, xDistance < 0.0 ? -xMoved : xMoved);
+            m_yCentroidFilter.Correct(now, yDistance < 0.0 ? -yMoved : yMoved);
+        }
+
         GuideStepInfo info;
         info.mount = this;
         info.frameNumber = pFrame->m_frameCounter;
@@ -652,6 +729,9 @@ Mount::MOVE_RESULT Mount::Move(const PHD_Point& cameraVectorEndpoint, bool norma
         info.aoPos = GetAoPos();
         info.starMass = pFrame->pGuider->StarMass();
         info.starSNR = pFrame->pGuider->SNR();
+        info.starHFD = pFrame->pGuider->HFD();
+        info.starFWHM = pFrame->pGuider->FWHM();
+        info.starMetrics = &pFrame->pGuider->CurrentStarMetrics();
         info.avgDist = pFrame->pGuider->CurrentError();
         info.starError = pFrame->pGuider->StarError();
 
@@ -1174,6 +1254,9 @@ bool Mount::Disconnect(void)
 
 void Mount::ClearHistory(void)
 {
+    m_xCentroidFilter.Reset();
+    m_yCentroidFilter.Reset();
+
     if (m_pXGuideAlgorithm)
     {
         m_pXGuideAlgorithm->reset();
@@ -1258,14 +1341,15 @@ wxString Mount::GetSettingsSummary()
 {
     // return a loggable summary of current mount settings
     wxString algorithms[] = {
-        _T("None"),_T("Hysteresis"),_T("Lowpass"),_T("Lowpass2"), _T("Resist Switch")
+        _T("None"),_T("Hysteresis"),_T("Lowpass"),_T("Lowpass2"), _T("Resist Switch"), _T("Predictive PEC")
     };
 
-    return wxString::Format("%s = %s,%s connected, guiding %s, %s\n",
+    return wxString::Format("%s = %s,%s connected, guiding %s, centroid filter %s, %s\n",
         IsStepGuider() ? "AO" : "Mount",
         m_Name,
         IsConnected() ? " " : " not",
         m_guidingEnabled ? "enabled" : "disabled",
+        m_centroidFilterEnabled ? "on" : "off",
         IsCalibrated() ? wxString::Format("xAngle = %.1f, xRate = %.3f, yAngle = %.1f, yRate = %.3f",
                 degrees(xAngle()), xRate() * 1000.0, degrees(yAngle()), yRate() * 1000.0) : "not calibrated"
     ) + wxString::Format("X guide algorithm = %s, %s",
@@ -112,6 +112,10 @@ protected:
     GuideAlgorithm *m_pXGuideAlgorithm;
     GuideAlgorithm *m_pYGuideAlgorithm;
 
+    bool m_centroidFilterEnabled;
+    CentroidFilter m_xCentroidFilter;
+    CentroidFilter m_yCentroidFilter;
+
     wxString m_Name;
 
     // Things related to the Advanced Config Dialog
@@ -121,6 +125,7 @@ protected:
         Mount *m_pMount;
         wxCheckBox *m_pClearCalibration;
         wxCheckBox *m_pEnableGuide;
+        wxCheckBox *m_pCentroidFilter;
         wxChoice   *m_pXGuideAlgorithmChoice;
         wxChoice   *m_pYGuideAlgorithmChoice;
         int        m_initXGuideAlgorithmSelection;
@@ -177,6 +182,8 @@ public:
     bool FlipCalibration(void);
     bool GetGuidingEnabled(void);
     void SetGuidingEnabled(bool guidingEnabled);
+    bool GetCentroidFilterEnabled(void) const { return m_centroidFilterEnabled; }
+    void SetCentroidFilterEnabled(bool enable);
 
     virtual MOVE_RESULT Move(const PHD_Point& cameraVectorEndpoint, bool normalMove=true);
     bool TransformCameraCoordinatesToMountCoordinates(const PHD_Point& cameraVectorEndpoint,
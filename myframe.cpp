@@ -66,6 +66,7 @@ wxDEFINE_EVENT(STATUSBAR_ENQUEUE_EVENT, wxCommandEvent);
 wxDEFINE_EVENT(STATUSBAR_TIMER_EVENT, wxTimerEvent);
 wxDEFINE_EVENT(SET_STATUS_TEXT_EVENT, wxThreadEvent);
 wxDEFINE_EVENT(ALERT_FROM_THREAD_EVENT, wxThreadEvent);
+wxDEFINE_EVENT(DARK_MODEL_FITTED_EVENT, wxThreadEvent);
 
 BEGIN_EVENT_TABLE(MyFrame, wxFrame)
     EVT_MENU(wxID_EXIT,  MyFrame::OnQuit)
@@ -145,6 +146,7 @@ BEGIN_EVENT_TABLE(MyFrame, wxFrame)
 
     EVT_THREAD(SET_STATUS_TEXT_EVENT, MyFrame::OnSetStatusText)
     EVT_THREAD(ALERT_FROM_THREAD_EVENT, MyFrame::OnAlertFromThread)
+    EVT_THREAD(DARK_MODEL_FITTED_EVENT, MyFrame::OnDarkModelFitted)
     EVT_COMMAND(wxID_ANY, REQUEST_MOUNT_MOVE_EVENT, MyFrame::OnRequestMountMove)
     EVT_TIMER(STATUSBAR_TIMER_EVENT, MyFrame::OnStatusbarTimerEvent)
 
@@ -165,7 +167,6 @@ MyFrame::MyFrame(int instanceNumber, wxLocale *locale)
     m_mgr.SetManagedWindow(this);
 
     m_frameCounter = 0;
-    m_loggedImageFrame = 0;
     m_pPrimaryWorkerThread = NULL;
     StartWorkerThread(m_pPrimaryWorkerThread);
     m_pSecondaryWorkerThread = NULL;
@@ -204,6 +205,7 @@ MyFrame::MyFrame(int instanceNumber, wxLocale *locale)
     // Setup Status bar
     SetupStatusBar();
 
+    m_starFindMode = Star::FIND_CENTROID;
     LoadProfileSettings();
 
     // Setup container window for alert message info bar and guider window
@@ -305,7 +307,6 @@ MyFrame::MyFrame(int instanceNumber, wxLocale *locale)
     pRefineDefMap = NULL;
     pCalSanityCheckDlg = NULL;
     pCalReviewDlg = NULL;
-    m_starFindMode = Star::FIND_CENTROID;
     m_rawImageMode = false;
     m_rawImageModeWarningDone = false;
 
@@ -632,6 +633,8 @@ void MyFrame::ResetAutoExposure(void)
     {
         Debug.AddLine("AutoExp: reset exp to %d", m_autoExp.maxExposure);
         m_exposureDuration = m_autoExp.maxExposure;
+        if (pCamera)
+            pCamera->SelectDark(m_exposureDuration);
     }
 }
 
@@ -639,6 +642,8 @@ void MyFrame::AdjustAutoExposure(double curSNR)
 {
     if (m_autoExp.enabled)
     {
+        int const prevExposure = m_exposureDuration;
+
         if (curSNR < 1.0)
         {
             Debug.AddLine("AutoExp: low SNR (%.2f), reset exp to %d", curSNR, m_autoExp.maxExposure);
@@ -664,12 +669,18 @@ void MyFrame::AdjustAutoExposure(double curSNR)
                 m_exposureDuration = m_autoExp.maxExposure;
             Debug.AddLine("AutoExp: adjust SNR=%.2f new exposure %d", curSNR, m_exposureDuration);
         }
+
+        // keep the dark frame matched to the new exposure duration
+        if (m_exposureDuration != prevExposure && pCamera)
+            pCamera->SelectDark(m_exposureDuration);
     }
 }
 
 void MyFrame::EnableImageLogging(bool enable)
 {
     m_image_logging_enabled = enable;
+    if (!enable)
+        ImageLogger::Flush();
 }
 
 bool MyFrame::IsImageLoggingEnabled(void)
@@ -717,6 +728,11 @@ void MyFrame::LoadProfileSettings(void)
     int noiseReductionMethod = pConfig->Profile.GetInt("/NoiseReductionMethod", DefaultNoiseReductionMethod);
     SetNoiseReductionMethod(noiseReductionMethod);
 
+    // SetStarFindMode is also used for temporary changes, so the setting is
+    // only saved from the config dialog
+    int starFindMode = pConfig->Profile.GetInt("/StarFindMode", Star::FIND_CENTROID);
+    SetStarFindMode(starFindMode == Star::FIND_PSF_FIT ? Star::FIND_PSF_FIT : Star::FIND_CENTROID);
+
     double ditherScaleFactor = pConfig->Profile.GetDouble("/DitherScaleFactor", DefaultDitherScaleFactor);
     SetDitherScaleFactor(ditherScaleFactor);
 
@@ -1305,7 +1321,6 @@ void MyFrame::StartCapturing()
         m_continueCapturing = true;
         CaptureActive     = true;
         m_frameCounter = 0;
-        m_loggedImageFrame = 0;
 
         CheckGeometry();
         UpdateButtonsStatus();
@@ -1677,58 +1692,7 @@ void MyFrame::LoadCalibration(void)
     }
 }
 
-static bool save_multi_darks(const ExposureImgMap& darks, const wxString& fname, const wxString& note)
-{
-    bool bError = false;
-
-    try
-    {
-        fitsfile *fptr;  // FITS file pointer
-        int status = 0;  // CFITSIO status value MUST be initialized to zero!
-
-        PHD_fits_create_file(&fptr, fname, true, &status);
-        if (status)
-            throw ERROR_INFO("fits_create_file failed");
-
-        for (ExposureImgMap::const_iterator it = darks.begin(); it != darks.end(); ++it)
-        {
-            const usImage *const img = it->second;
-            long fpixel[3] = { 1, 1, 1 };
-            long fsize[] = {
-                (long)img->Size.GetWidth(),
-                (long)img->Size.GetHeight(),
-            };
-            if (!status)
-                fits_create_img(fptr, USHORT_IMG, 2, fsize, &status);
-
-            float exposure = (float)img->ImgExpDur / 1000.0;
-            char *keyname = const_cast<char *>("EXPOSURE");
-            char *comment = const_cast<char *>("Exposure time in seconds");
-            if (!status) fits_write_key(fptr, TFLOAT, keyname, &exposure, comment, &status);
-
-            if (!note.IsEmpty())
-            {
-                char *USERNOTE = const_cast<char *>("USERNOTE");
-                if (!status) fits_write_key(fptr, TSTRING, USERNOTE, const_cast<char *>(static_cast<const char *>(note)), NULL, &status);
-            }
-
-            if (!status) fits_write_pix(fptr, TUSHORT, fpixel, img->NPixels, img->ImageData, &status);
-            Debug.AddLine("saving dark frame exposure = %d", img->ImgExpDur);
-        }
-
-        PHD_fits_close_file(fptr);
-        bError = status ? true : false;
-    }
-    catch (wxString Msg)
-    {
-        POSSIBLY_UNUSED(Msg);
-        bError = true;
-    }
-
-    return bError;
-}
-
-static bool load_multi_darks(GuideCamera *camera, const wxString& fname)
+static bool load_multi_darks(GuideCamera *camera, const wxString& fname, wxString *note)
 {
     bool bError = false;
     fitsfile *fptr = 0;
@@ -1792,6 +1756,12 @@ static bool load_multi_darks(GuideCamera *camera, const wxString& fname)
                 }
                 img->ImgExpDur = (int)(exposure * 1000.0);
 
+                char userNote[FLEN_VALUE];
+                char usernoteKey[] = "USERNOTE";
+                int noteStatus = 0;
+                if (fits_read_key(fptr, TSTRING, usernoteKey, userNote, NULL, &noteStatus) == 0)
+                    *note = userNote;
+
                 Debug.AddLine("loaded dark frame exposure = %d", img->ImgExpDur);
                 camera->AddDark(img.release());
 
@@ -1835,6 +1805,14 @@ wxString MyFrame::GetDarksDir()
 }
 
 wxString MyFrame::DarkLibFileName(int profileId)
+{
+    int inst = pFrame->GetInstanceNumber();
+    return MyFrame::GetDarksDir() + PATHSEPSTR +
+        wxString::Format("PHD2_dark_lib%s_%d.dlb", inst > 1 ? wxString::Format("_%d", inst) : "", profileId);
+}
+
+// dark libraries were saved as multi-image FITS files before the mapped library format
+wxString MyFrame::LegacyDarkLibFileName(int profileId)
 {
     int inst = pFrame->GetInstanceNumber();
     return MyFrame::GetDarksDir() + PATHSEPSTR +
@@ -1845,20 +1823,33 @@ bool MyFrame::DarkLibExists(int profileId, bool showAlert)
 {
     bool bOk = false;
     wxString fileName = MyFrame::DarkLibFileName(profileId);
+    wxString legacyName = MyFrame::LegacyDarkLibFileName(profileId);
+    bool haveLib = wxFileExists(fileName);
 
-    if (wxFileExists(fileName))
+    if (haveLib || wxFileExists(legacyName))
     {
         const wxSize& sensorSize = pCamera->DarkFrameSize();
         if (sensorSize == UNDEFINED_FRAME_SIZE)
         {
             bOk = true;
         }
+        else if (haveLib)
+        {
+            DarkLibraryFile lib;
+            if (!lib.Open(fileName))
+            {
+                if (lib.FrameSize() == sensorSize)
+                    bOk = true;
+                else if (showAlert)
+                    Alert(_("Dark library does not match the camera in this profile - it needs to be replaced."));
+            }
+        }
         else
         {
             fitsfile *fptr;
             int status = 0;  // CFITSIO status value MUST be initialized to zero!
 
-            if (PHD_fits_open_diskfile(&fptr, fileName, READONLY, &status) == 0)
+            if (PHD_fits_open_diskfile(&fptr, legacyName, READONLY, &status) == 0)
             {
                 long fsize[2];
                 fits_get_img_size(fptr, 2, fsize, &status);
@@ -1924,9 +1915,22 @@ void MyFrame::SetDarkMenuState()
         item->Check(false);
 }
 
+static bool attach_dark_library(GuideCamera *camera, const wxString& fname)
+{
+    DarkLibraryFile *lib = new DarkLibraryFile();
+    if (lib->Open(fname))
+    {
+        delete lib;
+        return true;
+    }
+    camera->SetDarkLibrary(lib);
+    return false;
+}
+
 void MyFrame::LoadDarkLibrary()
 {
-    wxString filename = MyFrame::DarkLibFileName(pConfig->GetCurrentProfileId());
+    int profileId = pConfig->GetCurrentProfileId();
+    wxString filename = MyFrame::DarkLibFileName(profileId);
 
     if (!pCamera || !pCamera->Connected)
     {
@@ -1934,7 +1938,27 @@ void MyFrame::LoadDarkLibrary()
         return;
     }
 
-    if (load_multi_darks(pCamera, filename))
+    bool err;
+    if (wxFileExists(filename))
+    {
+        err = attach_dark_library(pCamera, filename);
+    }
+    else
+    {
+        // convert a library saved by an older version. If the conversion fails
+        // the darks we just loaded are still usable from memory.
+        wxString legacyName = MyFrame::LegacyDarkLibFileName(profileId);
+        wxString note;
+        err = load_multi_darks(pCamera, legacyName, &note);
+        if (!err)
+        {
+            Debug.AddLine(wxString::Format("converting dark library %s to %s", legacyName, filename));
+            if (!pCamera->SaveDarkLibrary(filename, note))
+                attach_dark_library(pCamera, filename);
+        }
+    }
+
+    if (err)
     {
         Debug.AddLine(wxString::Format("failed to load dark frames from %s", filename));
         SetStatusText(_("Darks not loaded"));
@@ -1947,21 +1971,54 @@ void MyFrame::LoadDarkLibrary()
     }
 }
 
+// the dark model for the loaded library has been fitted in the background;
+// switch to a synthesized dark if the current exposure is not in the library
+void MyFrame::OnDarkModelFitted(wxThreadEvent& event)
+{
+    if (pCamera)
+        pCamera->SelectDark(m_exposureDuration);
+}
+
 void MyFrame::SaveDarkLibrary(const wxString& note)
 {
     wxString filename = MyFrame::DarkLibFileName(pConfig->GetCurrentProfileId());
+    wxString tmpname = filename + ".tmp";
 
     Debug.AddLine("saving dark library");
 
-    if (save_multi_darks(pCamera->Darks, filename, note))
+    if (pCamera->SaveDarkLibrary(tmpname, note))
     {
-        Alert(_("Error saving darks FITS file ") + filename);
+        Alert(_("Error saving dark library file ") + filename);
+        return;
+    }
+
+    // replace the library file while the camera still holds the darks, so they
+    // are kept if the file cannot be replaced. The camera only opens the old
+    // file while it reads a frame, so nothing holds it open.
+    if (!wxRenameFile(tmpname, filename, true))
+    {
+        Debug.AddLine(wxString::Format("Failed to rename dark library %s to %s", tmpname, filename));
+        wxRemoveFile(tmpname);
+        Alert(_("Error saving dark library file ") + filename);
+        return;
+    }
+
+    // switch the camera over to the new file
+    if (attach_dark_library(pCamera, filename))
+    {
+        // darks that were only in the old file are gone with it
+        pCamera->ClearDarks();
+        Alert(_("Error loading dark library file ") + filename);
     }
 }
 
 // Delete both the dark library file and any defect map file for this profile
 void MyFrame::DeleteDarkLibraryFiles(int profileId)
 {
+    // stop using the library file before deleting it
+    if (pCamera && profileId == pConfig->GetCurrentProfileId())
+        pCamera->ClearDarks();
+
     wxString filename = MyFrame::DarkLibFileName(profileId);
 
     if (wxFileExists(filename))
@@ -1970,6 +2027,14 @@ void MyFrame::DeleteDarkLibraryFiles(int profileId)
         wxRemoveFile(filename);
     }
 
+    filename = MyFrame::LegacyDarkLibFileName(profileId);
+
+    if (wxFileExists(filename))
+    {
+        Debug.AddLine("Removing dark library file: " + filename);
+        wxRemoveFile(filename);
+    }
+
     DefectMap::DeleteDefectMap(profileId);
 }
 
@@ -2153,14 +2218,20 @@ MyFrameConfigDialogPane::MyFrameConfigDialogPane(wxWindow *pParent, MyFrame *pFr
 
     wxString img_formats[] =
     {
-        _("Low Q JPEG"),_("High Q JPEG"),_("Raw FITS")
+        _("Low Q JPEG"),_("High Q JPEG"),_("Raw FITS"),_("Raw FITS, full frame")
     };
 
     width = StringArrayWidth(img_formats, WXSIZEOF(img_formats));
     m_pLoggedImageFormat = new wxChoice(pParent, wxID_ANY, wxPoint(-1,-1),
             wxSize(width+35, -1), WXSIZEOF(img_formats), img_formats );
     DoAdd(_("Image logging format"), m_pLoggedImageFormat,
-          _("File format of logged images"));
+          _("File format of logged images. FITS frames are collected into multi-frame cubes."));
+
+    width = StringWidth(_T("0000"));
+    m_pImageLogDecimation = new wxSpinCtrl(pParent, wxID_ANY, _T("foo2"), wxPoint(-1,-1),
+            wxSize(width+30, -1), wxSP_ARROW_KEYS, 1, 1000, 1, _T("ImageLogDecimation"));
+    DoAdd(_("Log every Nth frame"), m_pImageLogDecimation,
+          _("When image logging is enabled, log only one of every N frames. Default = 1, log every frame"));
 
     m_pDitherRaOnly = new wxCheckBox(pParent, wxID_ANY,_("Dither RA only"), wxPoint(-1,-1), wxSize(75,-1));
     DoAdd(m_pDitherRaOnly, _("Constrain dither to RA only?"));
@@ -2183,6 +2254,18 @@ MyFrameConfigDialogPane::MyFrameConfigDialogPane(wxWindow *pParent, MyFrame *pFr
     DoAdd(_("Noise Reduction"), m_pNoiseReduction,
           _("Technique to reduce noise in images"));
 
+    wxString findmode_choices[] =
+    {
+        _("Centroid"),_("PSF fit")
+    };
+
+    width = StringArrayWidth(findmode_choices, WXSIZEOF(findmode_choices));
+    m_pStarFindMode = new wxChoice(pParent, wxID_ANY, wxPoint(-1,-1),
+            wxSize(width+35, -1), WXSIZEOF(findmode_choices), findmode_choices);
+    DoAdd(_("Star position"), m_pStarFindMode,
+          _("How the star position is measured. PSF fit fits a Gaussian star profile, which is more precise for small, "
+            "undersampled stars and also measures the star HFD and FWHM, at a small cost in processing time. Default = Centroid"));
+
     width = StringWidth(_T("00000"));
     m_pTimeLapse = new wxSpinCtrl(pParent, wxID_ANY,_T("foo2"), wxPoint(-1,-1),
             wxSize(width+30, -1), wxSP_ARROW_KEYS, 0, 10000, 0, _T("TimeLapse"));
@@ -2291,7 +2374,9 @@ void MyFrameConfigDialogPane::LoadValues(void)
     m_pResetConfiguration->Enable(!pFrame->CaptureActive);
     m_pResetDontAskAgain->SetValue(false);
     m_pLoggedImageFormat->SetSelection(m_pFrame->GetLoggedImageFormat());
+    m_pImageLogDecimation->SetValue(ImageLogger::GetDecimation());
     m_pNoiseReduction->SetSelection(m_pFrame->GetNoiseReductionMethod());
+    m_pStarFindMode->SetSelection(m_pFrame->GetStarFindMode() == Star::FIND_PSF_FIT ? 1 : 0);
     m_pDitherRaOnly->SetValue(m_pFrame->GetDitherRaOnly());
     m_pDitherScaleFactor->SetValue(m_pFrame->GetDitherScaleFactor());
     m_pTimeLapse->SetValue(m_pFrame->GetTimeLapse());
@@ -2344,7 +2429,11 @@ void MyFrameConfigDialogPane::UnloadValues(void)
         }
 
         m_pFrame->SetLoggedImageFormat((LOGGED_IMAGE_FORMAT) m_pLoggedImageFormat->GetSelection());
+        ImageLogger::SetDecimation(m_pImageLogDecimation->GetValue());
         m_pFrame->SetNoiseReductionMethod(m_pNoiseReduction->GetSelection());
+        Star::FindMode starFindMode = m_pStarFindMode->GetSelection() == 1 ? Star::FIND_PSF_FIT : Star::FIND_CENTROID;
+        m_pFrame->SetStarFindMode(starFindMode);
+        pConfig->Profile.SetInt("/StarFindMode", starFindMode);
         m_pFrame->SetDitherRaOnly(m_pDitherRaOnly->GetValue());
         m_pFrame->SetDitherScaleFactor(m_pDitherScaleFactor->GetValue());
         m_pFrame->SetTimeLapse(m_pTimeLapse->GetValue());
@@ -55,6 +55,7 @@ wxDECLARE_EVENT(STATUSBAR_ENQUEUE_EVENT, wxCommandEvent);
 wxDECLARE_EVENT(STATUSBAR_TIMER_EVENT, wxTimerEvent);
 wxDECLARE_EVENT(SET_STATUS_TEXT_EVENT, wxThreadEvent);
 wxDECLARE_EVENT(ALERT_FROM_THREAD_EVENT, wxThreadEvent);
+wxDECLARE_EVENT(DARK_MODEL_FITTED_EVENT, wxThreadEvent);
 
 enum NOISE_REDUCTION_METHOD
 {
@@ -67,7 +68,8 @@ enum LOGGED_IMAGE_FORMAT
 {
     LIF_LOW_Q_JPEG,
     LIF_HI_Q_JPEG,
-    LIF_RAW_FITS
+    LIF_RAW_FITS,
+    LIF_FULL_FITS
 };
 
 struct AutoExposureCfg
@@ -86,9 +88,11 @@ class MyFrameConfigDialogPane : public ConfigDialogPane
     wxCheckBox *m_pResetConfiguration;
     wxCheckBox *m_pResetDontAskAgain;
     wxChoice* m_pLoggedImageFormat;
+    wxSpinCtrl *m_pImageLogDecimation;
     wxCheckBox *m_pDitherRaOnly;
     wxSpinCtrlDouble *m_pDitherScaleFactor;
     wxChoice *m_pNoiseReduction;
+    wxChoice *m_pStarFindMode;
     wxSpinCtrl *m_pTimeLapse;
     wxTextCtrl *m_pFocalLength;
     wxChoice* m_pLanguage;
@@ -195,7 +199,6 @@ public:
     double Stretch_gamma;
     wxLocale *m_pLocale;
     unsigned int m_frameCounter;
-    unsigned int m_loggedImageFrame;
     wxDateTime m_guidingStarted;
     Star::FindMode m_starFindMode;
     bool m_rawImageMode;
@@ -302,6 +305,7 @@ public:
     void SaveDarkLibrary(const wxString& note);
     void DeleteDarkLibraryFiles(int profileID);
     static wxString DarkLibFileName(int profileId);
+    static wxString LegacyDarkLibFileName(int profileId);
     void SetDarkMenuState();
     void LoadDarkHandler(bool checkIt);         // Use to also set menu item states
     void LoadDefectMapHandler(bool checkIt);
@@ -384,6 +388,7 @@ private:
     void DoAlert(const alert_params& params);
     void OnAlertButton(wxCommandEvent& evt);
     void OnAlertFromThread(wxThreadEvent& event);
+    void OnDarkModelFitted(wxThreadEvent& event);
     void OnStatusbarTimerEvent(wxTimerEvent& evt);
     void OnMessageBoxProxy(wxCommandEvent& evt);
     void SetupMenuBar(void);
@@ -547,6 +552,7 @@ enum {
     EEGG_STICKY_LOCK,
     EEGG_FLIPRACAL,
     STAR_MASS_ENABLE,
+    MULTI_STAR_ENABLE,
     MENU_BOOKMARKS_SHOW,
     MENU_BOOKMARKS_SET_AT_LOCK,
     MENU_BOOKMARKS_SET_AT_STAR,
@@ -558,6 +564,9 @@ enum {
     SOCK_SERVER_CLIENT_ID,
     EVENT_SERVER_ID,
     EVENT_SERVER_CLIENT_ID,
+    FRAME_SERVER_ID,
+    FRAME_SERVER_CLIENT_ID,
+    FRAME_SERVER_ENCODED_ID,
 };
 
 wxDECLARE_EVENT(APPSTATE_NOTIFY_EVENT, wxCommandEvent);
@@ -299,6 +299,7 @@ void MyFrame::FinishStop(void)
     ResetAutoExposure();
     UpdateButtonsStatus();
     SetStatusText(_("Stopped."));
+    ImageLogger::Flush();
     PhdController::AbortController("Stopped capturing");
 }
 
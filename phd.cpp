@@ -166,6 +166,8 @@ bool PhdApp::OnInit()
     pConfig->InitializeProfile();
 
     PhdController::OnAppInit();
+    ThreadPool::OnAppInit();
+    ImageLogger::OnAppInit();
 
     wxImage::AddHandler(new wxJPEGHandler);
     wxImage::AddHandler(new wxPNGHandler);
@@ -189,6 +191,8 @@ int PhdApp::OnExit(void)
     assert(pCamera == NULL);
 
     PhdController::OnAppExit();
+    ImageLogger::OnAppExit();
+    ThreadPool::OnAppExit();
 
     delete pConfig;
     pConfig = NULL;
@@ -63,9 +63,11 @@
 #include <wx/thread.h>
 #include <wx/utils.h>
 
+#include <list>
 #include <map>
 #include <math.h>
 #include <stdarg.h>
+#include <vector>
 
 #define APPNAME _T("PHD2 Guiding")
 #define PHDVERSION _T("2.5.0")
@@ -150,6 +152,8 @@ WX_DEFINE_ARRAY_DOUBLE(double, ArrayOfDbl);
 #include "usImage.h"
 #include "point.h"
 #include "star.h"
+#include "psf_fit.h"
+#include "star_metrics.h"
 #include "circbuf.h"
 #include "guidinglog.h"
 #include "graph.h"
@@ -165,6 +169,9 @@ WX_DEFINE_ARRAY_DOUBLE(double, ArrayOfDbl);
 #include "onboard_st4.h"
 #include "cameras.h"
 #include "camera.h"
+#include "dark_model.h"
+#include "centroid_filter.h"
+#include "calibration_fit.h"
 #include "mount.h"
 #include "scopes.h"
 #include "stepguiders.h"
@@ -176,11 +183,17 @@ WX_DEFINE_ARRAY_DOUBLE(double, ArrayOfDbl);
 #include "myframe.h"
 #include "debuglog.h"
 #include "worker_thread.h"
+#include "json_writer.h"
 #include "event_server.h"
+#include "frame_server.h"
 #include "confirm_dialog.h"
 #include "phdcontrol.h"
 #include "runinbg.h"
 #include "fitsiowrap.h"
+#include "mapped_file.h"
+#include "dark_library.h"
+#include "thread_pool.h"
+#include "image_logger.h"
 
 class wxSingleInstanceChecker;
 
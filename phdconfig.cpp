@@ -39,14 +39,389 @@
 #include <wx/txtstrm.h>
 #include <wx/tokenzr.h>
 
+#include <set>
+
 // NOTE: Not translated here, explicitly translated below. Using _("...")
 // here in a static initializer crashes
 wxString PhdConfig::DefaultProfileName = wxTRANSLATE("My Equipment");
 
 #define PROFILE_STREAM_VERSION "1"
 
+// I thought wxConfigPathChanger would do this, but it didn't quite
+struct AutoConfigPath
+{
+    wxConfigBase *m_cfg;
+    wxString m_savePath;
+
+    AutoConfigPath(wxConfigBase *cfg, const wxString& path)
+        : m_cfg(cfg)
+    {
+        m_savePath = cfg->GetPath();
+        cfg->SetPath(path);
+    }
+    ~AutoConfigPath()
+    {
+        m_cfg->SetPath(m_savePath);
+    }
+};
+
+// flush pending config writes this often
+static const int ConfigFlushIntervalMs = 2000;
+
+struct ConfigCacheEntry
+{
+    bool exists;                        // false if the entry is known not to be in the config
+    unsigned int have;                  // which of the values below are valid
+    unsigned int logged;                // which types have been read (and logged) already
+    wxConfigBase::EntryType dirty;      // type of a write not yet flushed to wxConfig
+    bool b;
+    long l;
+    double d;
+    wxString s;
+
+    ConfigCacheEntry()
+        : exists(false),
+          have(0),
+          logged(0),
+          dirty(wxConfigBase::Type_Unknown),
+          b(false),
+          l(0),
+          d(0.0)
+    {
+    }
+};
+
+template <typename T> struct ConfigCacheSlot;
+
+template <> struct ConfigCacheSlot<bool>
+{
+    enum { Bit = 1 };
+    static const wxConfigBase::EntryType Type = wxConfigBase::Type_Boolean;
+    static bool& Ref(ConfigCacheEntry& e) { return e.b; }
+};
+
+template <> struct ConfigCacheSlot<long>
+{
+    enum { Bit = 2 };
+    static const wxConfigBase::EntryType Type = wxConfigBase::Type_Integer;
+    static long& Ref(ConfigCacheEntry& e) { return e.l; }
+};
+
+template <> struct ConfigCacheSlot<double>
+{
+    enum { Bit = 4 };
+    static const wxConfigBase::EntryType Type = wxConfigBase::Type_Float;
+    static double& Ref(ConfigCacheEntry& e) { return e.d; }
+};
+
+template <> struct ConfigCacheSlot<wxString>
+{
+    enum { Bit = 8 };
+    static const wxConfigBase::EntryType Type = wxConfigBase::Type_String;
+    static wxString& Ref(ConfigCacheEntry& e) { return e.s; }
+};
+
+// In-memory copy of the whole configuration. Settings are read from the
+// worker threads as well as the main thread, so every access to the cache
+// and to wxConfig goes through m_lock.
+class ConfigCache : public wxTimer
+{
+    typedef std::map<wxString, ConfigCacheEntry> EntryMap;
+
+    wxConfig *m_config;
+    wxCriticalSection m_lock;
+    EntryMap m_entries;
+    std::set<wxString> m_dirty;
+
+    static wxString Key(const wxString& name);
+    void LoadGroup(const wxString& group);
+    void LoadEntry(const wxString& name);
+    void WriteEntry(const wxString& name, ConfigCacheEntry& e);
+    void DoFlush(void);
+    void EraseGroup(const wxString& group);
+
+public:
+    ConfigCache(wxConfig *config);
+    ~ConfigCache(void);
+
+    template <typename T> T Get(const wxString& name, const T& defaultValue, bool *firstRead);
+    template <typename T> void Set(const wxString& name, const T& value);
+    bool HasEntry(const wxString& name);
+    void DeleteEntry(const wxString& name);
+    void DeleteGroup(const wxString& name);
+    void DeleteAll(void);
+    void Reload(const wxString& group);
+    void Flush(void);
+    int CreateNumberedGroup(const wxString& parent, const wxString& entry, const wxString& value);
+
+    void Notify(void);
+};
+
+ConfigCache::ConfigCache(wxConfig *config)
+    : m_config(config)
+{
+    // one bulk load up front, after this wxConfig is only read for a setting
+    // that is read back as a different type than it was stored with
+    LoadGroup(wxEmptyString);
+    Debug.AddLine(wxString::Format("ConfigCache: loaded %u entries", (unsigned int) m_entries.size()));
+
+    Start(ConfigFlushIntervalMs);
+}
+
+ConfigCache::~ConfigCache(void)
+{
+    Stop();
+    Flush();
+}
+
+wxString ConfigCache::Key(const wxString& name)
+{
+    // settings are cached by absolute path
+    return name.StartsWith("/") ? name : "/" + name;
+}
+
+void ConfigCache::LoadGroup(const wxString& group)
+{
+    wxString str;
+    long cookie;
+
+    AutoConfigPath changer(m_config, group.IsEmpty() ? wxString("/") : group);
+
+    bool more = m_config->GetFirstGroup(str, cookie);
+    while (more)
+    {
+        LoadGroup(group + "/" + str);
+        more = m_config->GetNextGroup(str, cookie);
+    }
+
+    more = m_config->GetFirstEntry(str, cookie);
+    while (more)
+    {
+        LoadEntry(group + "/" + str);
+        more = m_config->GetNextEntry(str, cookie);
+    }
+}
+
+void ConfigCache::LoadEntry(const wxString& name)
+{
+    ConfigCacheEntry& e = m_entries[name];
+    e.exists = true;
+    e.have = 0;
+
+    switch (m_config->GetEntryType(name))
+    {
+    case wxConfigBase::Type_Boolean:
+        if (m_config->Read(name, &e.b))
+            e.have = ConfigCacheSlot<bool>::Bit;
+        break;
+    case wxConfigBase::Type_Integer:
+        if (m_config->Read(name, &e.l))
+            e.have = ConfigCacheSlot<long>::Bit;
+        break;
+    case wxConfigBase::Type_Float:
+        if (m_config->Read(name, &e.d))
+            e.have = ConfigCacheSlot<double>::Bit;
+        break;
+    default:
+        // wxFileConfig does not know the types, everything is a string
+        if (m_config->Read(name, &e.s))
+            e.have = ConfigCacheSlot<wxString>::Bit;
+        break;
+    }
+}
+
+void ConfigCache::WriteEntry(const wxString& name, ConfigCacheEntry& e)
+{
+    switch (e.dirty)
+    {
+    case wxConfigBase::Type_Boolean:
+        m_config->Write(name, e.b);
+        break;
+    case wxConfigBase::Type_Integer:
+        m_config->Write(name, e.l);
+        break;
+    case wxConfigBase::Type_Float:
+        m_config->Write(name, e.d);
+        break;
+    case wxConfigBase::Type_String:
+        m_config->Write(name, e.s);
+        break;
+    case wxConfigBase::Type_Unknown:
+        break;
+    }
+    e.dirty = wxConfigBase::Type_Unknown;
+}
+
+template <typename T>
+T ConfigCache::Get(const wxString& name, const T& defaultValue, bool *firstRead)
+{
+    typedef ConfigCacheSlot<T> Slot;
+
+    wxCriticalSectionLocker lck(m_lock);
+
+    wxString key = Key(name);
+    ConfigCacheEntry& e = m_entries[key];
+
+    *firstRead = (e.logged & Slot::Bit) == 0;
+    e.logged |= Slot::Bit;
+
+    if (!e.exists)
+        return defaultValue;
+
+    if ((e.have & Slot::Bit) == 0)
+    {
+        // stored as a different type, let wxConfig do the conversion
+        if (e.dirty != wxConfigBase::Type_Unknown)
+        {
+            WriteEntry(key, e);
+            m_dirty.erase(key);
+        }
+        T val;
+        if (!m_config->Read(key, &val))
+            return defaultValue;
+        Slot::Ref(e) = val;
+        e.have |= Slot::Bit;
+    }
+
+    return Slot::Ref(e);
+}
+
+template <typename T>
+void ConfigCache::Set(const wxString& name, const T& value)
+{
+    typedef ConfigCacheSlot<T> Slot;
+
+    wxCriticalSectionLocker lck(m_lock);
+
+    wxString key = Key(name);
+    ConfigCacheEntry& e = m_entries[key];
+
+    // writing back the value we already have is common, skip it
+    if (e.exists && (e.have & Slot::Bit) && Slot::Ref(e) == value &&
+        (e.dirty == wxConfigBase::Type_Unknown || e.dirty == Slot::Type))
+    {
+        return;
+    }
+
+    e.exists = true;
+    e.have = Slot::Bit;
+    Slot::Ref(e) = value;
+    e.dirty = Slot::Type;
+    m_dirty.insert(key);
+}
+
+bool ConfigCache::HasEntry(const wxString& name)
+{
+    wxCriticalSectionLocker lck(m_lock);
+    EntryMap::const_iterator it = m_entries.find(Key(name));
+    return it != m_entries.end() && it->second.exists;
+}
+
+void ConfigCache::DeleteEntry(const wxString& name)
+{
+    wxCriticalSectionLocker lck(m_lock);
+    wxString key = Key(name);
+    m_entries.erase(key);
+    m_dirty.erase(key);
+    m_config->DeleteEntry(key);
+}
+
+void ConfigCache::EraseGroup(const wxString& group)
+{
+    wxString prefix = group + "/";
+
+    EntryMap::iterator it = m_entries.lower_bound(prefix);
+    while (it != m_entries.end() && it->first.StartsWith(prefix))
+        m_entries.erase(it++);
+
+    std::set<wxString>::iterator d = m_dirty.lower_bound(prefix);
+    while (d != m_dirty.end() && d->StartsWith(prefix))
+        m_dirty.erase(d++);
+}
+
+void ConfigCache::DeleteGroup(const wxString& name)
+{
+    wxCriticalSectionLocker lck(m_lock);
+    wxString key = Key(name);
+    EraseGroup(key);
+    m_config->DeleteGroup(key);
+}
+
+void ConfigCache::DeleteAll(void)
+{
+    wxCriticalSectionLocker lck(m_lock);
+    m_entries.clear();
+    m_dirty.clear();
+    m_config->DeleteAll();
+}
+
+void ConfigCache::Reload(const wxString& group)
+{
+    // re-read a group that was modified directly in wxConfig
+    wxCriticalSectionLocker lck(m_lock);
+    DoFlush();
+    wxString key = Key(group);
+    EraseGroup(key);
+    LoadGroup(key);
+}
+
+void ConfigCache::DoFlush(void)
+{
+    if (m_dirty.empty())
+        return;
+
+    for (std::set<wxString>::const_iterator it = m_dirty.begin(); it != m_dirty.end(); ++it)
+        WriteEntry(*it, m_entries[*it]);
+    m_dirty.clear();
+
+    // wxFileConfig writes a temporary file and renames it over the old one,
+    // so an interrupted flush leaves the previous config intact
+    m_config->Flush();
+}
+
+void ConfigCache::Flush(void)
+{
+    wxCriticalSectionLocker lck(m_lock);
+    DoFlush();
+}
+
+void ConfigCache::Notify(void)
+{
+    Flush();
+}
+
+int ConfigCache::CreateNumberedGroup(const wxString& parent, const wxString& entry, const wxString& value)
+{
+    // create the first numbered group under parent that does not exist yet,
+    // holding one string entry, and return its number. The groups are
+    // enumerated in wxConfig, so flush first, and hold the lock until the new
+    // group is written so two callers cannot pick the same number.
+
+    wxCriticalSectionLocker lck(m_lock);
+    DoFlush();
+
+    int id;
+    { // path scope
+        AutoConfigPath changer(m_config, Key(parent));
+        for (id = 1; m_config->HasGroup(wxString::Format("%d", id)); id++)
+            ;
+    } // path scope
+
+    wxString key = Key(parent) + wxString::Format("/%d/", id) + entry;
+    ConfigCacheEntry& e = m_entries[key];
+    e.exists = true;
+    e.have = ConfigCacheSlot<wxString>::Bit;
+    e.s = value;
+    e.dirty = ConfigCacheSlot<wxString>::Type;
+    m_dirty.insert(key);
+    DoFlush();
+
+    return id;
+}
+
 ConfigSection::ConfigSection(void)
-    : m_pConfig(NULL)
+    : m_pConfig(NULL),
+      m_cache(NULL)
 {
 }
 
@@ -63,13 +438,16 @@ bool ConfigSection::GetBoolean(const char *pName, bool defaultValue=false)
 {
     bool bReturn = defaultValue;
     wxString name = m_prefix + pName;
+    bool firstRead = true;
 
-    if (m_pConfig)
+    if (m_cache)
     {
-        m_pConfig->Read(name, &bReturn, defaultValue);
+        bReturn = m_cache->Get(name, defaultValue, &firstRead);
     }
 
-    Debug.AddLine(wxString::Format("GetBoolean(\"%s\", %d) returns %d", name, defaultValue, bReturn));
+    // later reads of a setting come from the cache, only log the first one
+    if (firstRead)
+        Debug.AddLine(wxString::Format("GetBoolean(\"%s\", %d) returns %d", name, defaultValue, bReturn));
 
     return bReturn;
 }
@@ -78,13 +456,15 @@ wxString ConfigSection::GetString(const char *pName, const wxString& defaultValu
 {
     wxString sReturn = defaultValue;
     wxString name = m_prefix + pName;
+    bool firstRead = true;
 
-    if (m_pConfig)
+    if (m_cache)
     {
-        m_pConfig->Read(name, &sReturn, defaultValue);
+        sReturn = m_cache->Get(name, defaultValue, &firstRead);
     }
 
-    Debug.AddLine(wxString::Format("GetString(\"%s\", \"%s\") returns \"%s\"", name, defaultValue, sReturn));
+    if (firstRead)
+        Debug.AddLine(wxString::Format("GetString(\"%s\", \"%s\") returns \"%s\"", name, defaultValue, sReturn));
 
     return sReturn;
 }
@@ -93,13 +473,15 @@ double ConfigSection::GetDouble(const char *pName, double defaultValue)
 {
     double dReturn = defaultValue;
     wxString name = m_prefix + pName;
+    bool firstRead = true;
 
-    if (m_pConfig)
+    if (m_cache)
     {
-        m_pConfig->Read(name, &dReturn, defaultValue);
+        dReturn = m_cache->Get(name, defaultValue, &firstRead);
     }
 
-    Debug.AddLine(wxString::Format("GetDouble(\"%s\", %lf) returns %lf", name, defaultValue, dReturn));
+    if (firstRead)
+        Debug.AddLine(wxString::Format("GetDouble(\"%s\", %lf) returns %lf", name, defaultValue, dReturn));
 
     return dReturn;
 }
@@ -108,13 +490,15 @@ long ConfigSection::GetLong(const char *pName, long defaultValue)
 {
     long lReturn = defaultValue;
     wxString name = m_prefix + pName;
+    bool firstRead = true;
 
-    if (m_pConfig)
+    if (m_cache)
     {
-        m_pConfig->Read(name, &lReturn, defaultValue);
+        lReturn = m_cache->Get(name, defaultValue, &firstRead);
     }
 
-    Debug.AddLine(wxString::Format("GetLong(\"%s\", %ld) returns %ld", name, defaultValue, lReturn));
+    if (firstRead)
+        Debug.AddLine(wxString::Format("GetLong(\"%s\", %ld) returns %ld", name, defaultValue, lReturn));
 
     return lReturn;
 }
@@ -123,46 +507,48 @@ int ConfigSection::GetInt(const char *pName, int defaultValue)
 {
     long lReturn = defaultValue;
     wxString name = m_prefix + pName;
+    bool firstRead = true;
 
-    if (m_pConfig)
+    if (m_cache)
     {
-        m_pConfig->Read(name, &lReturn, defaultValue);
+        lReturn = m_cache->Get(name, (long) defaultValue, &firstRead);
     }
 
-    Debug.AddLine(wxString::Format("GetInt(\"%s\", %d) returns %d", name, defaultValue, (int)lReturn));
+    if (firstRead)
+        Debug.AddLine(wxString::Format("GetInt(\"%s\", %d) returns %d", name, defaultValue, (int)lReturn));
 
     return (int)lReturn;
 }
 
 void ConfigSection::SetBoolean(const char *pName, bool value)
 {
-    if (m_pConfig)
+    if (m_cache)
     {
-        m_pConfig->Write(m_prefix + pName, value);
+        m_cache->Set(m_prefix + pName, value);
     }
 }
 
 void ConfigSection::SetString(const char *pName, const wxString& value)
 {
-    if (m_pConfig)
+    if (m_cache)
     {
-        m_pConfig->Write(m_prefix + pName, value);
+        m_cache->Set(m_prefix + pName, value);
     }
 }
 
 void ConfigSection::SetDouble(const char *pName, double value)
 {
-    if (m_pConfig)
+    if (m_cache)
     {
-        m_pConfig->Write(m_prefix + pName, value);
+        m_cache->Set(m_prefix + pName, value);
     }
 }
 
 void ConfigSection::SetLong(const char *pName, long value)
 {
-    if (m_pConfig)
+    if (m_cache)
     {
-        m_pConfig->Write(m_prefix + pName, value);
+        m_cache->Set(m_prefix + pName, value);
     }
 }
 
@@ -173,53 +559,46 @@ void ConfigSection::SetInt(const char *pName, int value)
 
 bool ConfigSection::HasEntry(const wxString& name) const
 {
-    return m_pConfig && m_pConfig->HasEntry(m_prefix + name);
+    return m_cache && m_cache->HasEntry(m_prefix + name);
 }
 
 void ConfigSection::DeleteEntry(const wxString& name)
 {
-    m_pConfig->DeleteEntry(m_prefix + name);
+    m_cache->DeleteEntry(m_prefix + name);
 }
 
 void ConfigSection::DeleteGroup(const wxString& name)
 {
-    m_pConfig->DeleteGroup(m_prefix + name);
+    m_cache->DeleteGroup(m_prefix + name);
 }
 
 PhdConfig::PhdConfig(void)
+    : m_cache(NULL)
 {
 }
 
 PhdConfig::PhdConfig(const wxString& baseConfigName, int instance)
+    : m_cache(NULL)
 {
     Initialize(baseConfigName, instance);
 }
 
 PhdConfig::~PhdConfig(void)
 {
+    delete m_cache; // flushes pending writes
     delete Global.m_pConfig;
 }
 
-// I thought wxConfigPathChanger would do this, but it didn't quite
-struct AutoConfigPath
+void PhdConfig::Flush(void)
 {
-    wxConfigBase *m_cfg;
-    wxString m_savePath;
-
-    AutoConfigPath(wxConfigBase *cfg, const wxString& path)
-        : m_cfg(cfg)
-    {
-        m_savePath = cfg->GetPath();
-        cfg->SetPath(path);
-    }
-    ~AutoConfigPath()
-    {
-        m_cfg->SetPath(m_savePath);
-    }
-};
+    if (m_cache)
+        m_cache->Flush();
+}
 
 int PhdConfig::FirstProfile(void)
 {
+    Flush(); // the profile groups are enumerated in wxConfig
+
     AutoConfigPath changer(Profile.m_pConfig, "/profile");
 
     long id = 0;
@@ -250,6 +629,8 @@ void PhdConfig::Initialize(const wxString& baseConfigName, int instance)
 
     wxConfig *config = new wxConfig(configName);
     Global.m_pConfig = Profile.m_pConfig = config;
+    m_cache = new ConfigCache(config);
+    Global.m_cache = Profile.m_cache = m_cache;
 
     m_isNewInstance = false;
 
@@ -290,7 +671,7 @@ void PhdConfig::DeleteAll(void)
         for (unsigned int i = 0; i < NumProfiles(); i++)
             pFrame->DeleteDarkLibraryFiles(i);
 
-        Global.m_pConfig->DeleteAll();
+        m_cache->DeleteAll();
         InitializeProfile();
     }
     m_isNewInstance = true;
@@ -327,6 +708,8 @@ bool PhdConfig::SetCurrentProfile(const wxString& name)
 
 int PhdConfig::GetProfileId(const wxString& name)
 {
+    Flush();
+
     AutoConfigPath changer(Profile.m_pConfig, "/profile");
 
     int ret = 0;
@@ -376,13 +759,8 @@ bool PhdConfig::CreateProfile(const wxString& name)
         return true;
     }
 
-    AutoConfigPath changer(Profile.m_pConfig, "/profile");
-
-    // find the first available id
-    for (id = 1; Profile.m_pConfig->HasGroup(wxString::Format("%d", id)); id++)
-        ;
-
-    Profile.m_pConfig->Write(wxString::Format("/profile/%d/name", id), name);
+    // take the first available id
+    m_cache->CreateNumberedGroup("/profile", "name", name);
 
     return false;
 }
@@ -468,7 +846,9 @@ bool PhdConfig::CloneProfile(const wxString& dest, const wxString& source)
     {
         return true; // ??? should never happen
     }
+    Flush();
     CopyGroup(Global.m_pConfig, wxString::Format("/profile/%d", srcId), wxString::Format("/profile/%d", dstId));
+    m_cache->Reload(wxString::Format("/profile/%d", dstId));
     // name was overwritten by copy
     Global.SetString(wxString::Format("/profile/%d/name", dstId), dest);
 
@@ -483,7 +863,7 @@ void PhdConfig::DeleteProfile(const wxString& name)
     if (id <= 0)
         return;
 
-    Global.m_pConfig->DeleteGroup(wxString::Format("/profile/%d", id));
+    Global.DeleteGroup(wxString::Format("/profile/%d", id));
 
     if (NumProfiles() == 0)
     {
@@ -512,7 +892,7 @@ bool PhdConfig::RenameProfile(const wxString& oldname, const wxString& newname)
         return true;
     }
 
-    Profile.m_pConfig->Write(wxString::Format("/profile/%d/name", id), newname);
+    Global.SetString(wxString::Format("/profile/%d/name", id), newname);
     return false;
 }
 
@@ -542,7 +922,7 @@ bool PhdConfig::ReadProfile(const wxString& filename)
     int id = GetProfileId(profileName);
     if (id > 0)
     {
-        Global.m_pConfig->DeleteGroup(wxString::Format("/profile/%d", id));
+        Global.DeleteGroup(wxString::Format("/profile/%d", id));
     }
 
     CreateProfile(profileName);
@@ -685,6 +1065,7 @@ bool PhdConfig::WriteProfile(const wxString& filename)
     wxTextOutputStream tos(os);
 
     tos.WriteString("PHD Profile " PROFILE_STREAM_VERSION "\n");
+    Flush();
     wxString profile = wxString::Format("/profile/%d", m_currentProfileId);
     WriteGroup(tos, Profile.m_pConfig, profile, profile);
 
@@ -693,6 +1074,8 @@ bool PhdConfig::WriteProfile(const wxString& filename)
 
 wxArrayString PhdConfig::ProfileNames(void)
 {
+    Flush();
+
     AutoConfigPath changer(Profile.m_pConfig, "/profile");
 
     wxArrayString ary;
@@ -717,6 +1100,8 @@ wxArrayString PhdConfig::ProfileNames(void)
 
 unsigned int PhdConfig::NumProfiles(void)
 {
+    Flush();
+
     AutoConfigPath changer(Profile.m_pConfig, "/profile");
 
     unsigned int count = 0;
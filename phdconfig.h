@@ -63,13 +63,19 @@
  * the configuration values for thier classes, and dialogs that modify them
  * write the values immediately.
  *
+ * The whole configuration is read into an in-memory cache at startup, so
+ * reads do not go to the registry or config file. Writes update the cache
+ * and are flushed to wxConfig in batches a couple of seconds later.
+ *
  */
 
 class PhdConfig;
+class ConfigCache;
 
 class ConfigSection
 {
     wxConfig *m_pConfig;
+    ConfigCache *m_cache;
     wxString m_prefix;
 
     friend class PhdConfig;
@@ -105,6 +111,7 @@ class PhdConfig
     long m_configVersion;
     bool m_isNewInstance;
     int m_currentProfileId;
+    ConfigCache *m_cache;
 
     void Initialize(const wxString& baseConfigName, int instance);
 
@@ -116,6 +123,7 @@ public:
     static wxString DefaultProfileName;
 
     void DeleteAll(void);
+    void Flush(void);
 
     void InitializeProfile(void);
     wxString GetCurrentProfile(void);
@@ -55,6 +55,12 @@ enum SettleOp
     OP_GUIDE,
 };
 
+struct SettleSample
+{
+    double t;  // exposure midpoint, seconds
+    double d;  // star distance from the lock position, pixels
+};
+
 struct ControllerState
 {
     State state;
@@ -68,6 +74,8 @@ struct ControllerState
     bool settlePriorFrameInRange;
     wxStopWatch *settleTimeout;
     wxStopWatch *settleInRange;
+    std::vector<SettleSample> settleSamples;
+    SettleDoneInfo settleInfo;
     bool succeeded;
     wxString errorMsg;
 };
@@ -93,6 +101,12 @@ void PhdController::OnAppExit()
     ctrl.state = newstate; \
 } while (false)
 
+static void reset_settle_info(void)
+{
+    ctrl.settleSamples.clear();
+    memset(&ctrl.settleInfo, 0, sizeof(ctrl.settleInfo));
+}
+
 static wxString ReentrancyError(const char *op)
 {
     return wxString::Format("Cannot initiate %s while %s is in progress", op, ctrl.settleOp == OP_DITHER ? "dither" : "guide");
@@ -111,6 +125,7 @@ bool PhdController::Guide(bool recalibrate, const SettleParams& settle, wxString
     ctrl.forceCalibration = recalibrate;
     ctrl.settleOp = OP_GUIDE;
     ctrl.settle = settle;
+    reset_settle_info();
     SETSTATE(STATE_SETUP);
     UpdateControllerState();
     return true;
@@ -145,6 +160,7 @@ bool PhdController::Dither(double pixels, bool raOnly, const SettleParams& settl
 
     ctrl.settleOp = OP_DITHER;
     ctrl.settle = settle;
+    reset_settle_info();
     SETSTATE(STATE_SETTLE_BEGIN);
     UpdateControllerState();
 
@@ -172,17 +188,103 @@ static void do_notify(void)
     if (ctrl.succeeded)
     {
         Debug.AddLine("PhdController complete: success");
-        EvtServer.NotifySettleDone(wxEmptyString);
+        EvtServer.NotifySettleDone(wxEmptyString, ctrl.settleInfo);
         GuideLog.NotifySettlingStateChange("Settling complete");
     }
     else
     {
         Debug.AddLine(wxString::Format("PHDController complete: fail: %s", ctrl.errorMsg));
-        EvtServer.NotifySettleDone(ctrl.errorMsg);
+        EvtServer.NotifySettleDone(ctrl.errorMsg, ctrl.settleInfo);
         GuideLog.NotifySettlingStateChange("Settling failed");
     }
 }
 
+// Statistical settle detection. The star distance after a dither or guide
+// start decays roughly exponentially, so fit ln(distance) against time over
+// the most recent frames. The guider is considered settled once the upper
+// confidence bound of the fitted distance at the latest frame is within
+// tolerance and the distance is not significantly increasing. A transient
+// seeing spike widens the bound for a few frames instead of restarting the
+// settle timer.
+
+enum
+{
+    SETTLE_FIT_WINDOW = 8,
+    SETTLE_FIT_MIN_SAMPLES = 4,
+};
+
+static const double SETTLE_FIT_FLOOR = 0.05;  // pixels, keeps the log finite for a perfect frame
+
+struct SettleFit
+{
+    double distance;   // fitted distance at the latest sample
+    double bound;      // upper confidence bound of distance
+    double decayTime;  // decay time constant, seconds (0 if not decaying)
+    bool diverging;    // the distance is significantly increasing
+};
+
+// one-sided 95% Student t quantile
+static double t95(int dof)
+{
+    static const double q[] = { 6.314, 2.920, 2.353, 2.132, 2.015, 1.943, 1.895, 1.860 };
+    if (dof < 1)
+        dof = 1;
+    return dof <= (int) WXSIZEOF(q) ? q[dof - 1] : 1.645;
+}
+
+static bool fit_settle(const std::vector<SettleSample>& samples, SettleFit *fit)
+{
+    size_t n = wxMin(samples.size(), (size_t) SETTLE_FIT_WINDOW);
+    if (n < SETTLE_FIT_MIN_SAMPLES)
+        return false;
+
+    const SettleSample *s = &samples[samples.size() - n];
+
+    double y[SETTLE_FIT_WINDOW];
+    double tm = 0.0, ym = 0.0;
+    for (size_t i = 0; i < n; i++)
+    {
+        y[i] = log(s[i].d + SETTLE_FIT_FLOOR);
+        tm += s[i].t;
+        ym += y[i];
+    }
+    tm /= n;
+    ym /= n;
+
+    double stt = 0.0, sty = 0.0;
+    for (size_t i = 0; i < n; i++)
+    {
+        double dt = s[i].t - tm;
+        stt += dt * dt;
+        sty += dt * (y[i] - ym);
+    }
+    if (stt <= 0.0)
+        return false;
+
+    double slope = sty / stt;
+    double icpt = ym - slope * tm;
+
+    double ssr = 0.0;
+    for (size_t i = 0; i < n; i++)
+    {
+        double r = y[i] - (icpt + slope * s[i].t);
+        ssr += r * r;
+    }
+    double sd = sqrt(ssr / (n - 2));
+    double q = t95(n - 2);
+
+    double tn = s[n - 1].t;
+    double yn = icpt + slope * tn;
+    double se = sd * sqrt(1.0 / n + (tn - tm) * (tn - tm) / stt);
+
+    fit->distance = wxMax(exp(yn) - SETTLE_FIT_FLOOR, 0.0);
+    fit->bound = wxMax(exp(yn + q * se) - SETTLE_FIT_FLOOR, 0.0);
+    fit->decayTime = slope < 0.0 ? -1.0 / slope : 0.0;
+    fit->diverging = slope - q * sd / sqrt(stt) > 0.0;
+
+    return true;
+}
+
 static bool start_capturing(void)
 {
     if (!pCamera || !pCamera->Connected)
@@ -373,6 +475,7 @@ void PhdController::UpdateControllerState(void)
 
         case STATE_SETTLE_BEGIN:
             ctrl.settlePriorFrameInRange = false;
+            ctrl.settleSamples.clear();
             ctrl.settleTimeout->Start();
             SETSTATE(STATE_SETTLE_WAIT);
             GuideLog.NotifySettlingStateChange("Settling started");
@@ -388,6 +491,46 @@ void PhdController::UpdateControllerState(void)
             Debug.AddLine("PhdController: settling, locked = %d, distance = %.2f (%.2f)", lockedOnStar, currentError,
                 ctrl.settle.tolerancePx);
 
+            SettleDoneInfo& info = ctrl.settleInfo;
+            ++info.frames;
+            info.settleTime = (double) ctrl.settleTimeout->Time() / 1000.;
+
+            if (lockedOnStar)
+            {
+                SettleSample sample;
+                sample.t = pFrame->pGuider->CurrentPositionTime();
+                sample.d = pFrame->pGuider->CurrentPosition().Distance(pFrame->pGuider->LockPosition());
+                ctrl.settleSamples.push_back(sample);
+                if (ctrl.settleSamples.size() > SETTLE_FIT_WINDOW)
+                    ctrl.settleSamples.erase(ctrl.settleSamples.begin());
+                info.distance = sample.d;
+
+                SettleFit fit;
+                if (fit_settle(ctrl.settleSamples, &fit))
+                {
+                    info.haveFit = true;
+                    info.fitDistance = fit.distance;
+                    info.fitBound = fit.bound;
+                    info.decayTime = fit.decayTime;
+
+                    Debug.AddLine("PhdController: settle fit distance = %.2f bound = %.2f decay = %.1fs diverging = %d",
+                        fit.distance, fit.bound, fit.decayTime, fit.diverging);
+
+                    if (ctrl.settle.fast && !fit.diverging && fit.bound <= ctrl.settle.tolerancePx &&
+                        sample.d <= ctrl.settle.tolerancePx)
+                    {
+                        info.converged = true;
+                        ctrl.succeeded = true;
+                        SETSTATE(STATE_FINISH);
+                        break;
+                    }
+                }
+            }
+            else
+            {
+                ++info.droppedFrames;
+            }
+
             if (inRange)
             {
                 if (!ctrl.settlePriorFrameInRange)
@@ -40,6 +40,21 @@ struct SettleParams
     double tolerancePx;  // settle threshold, pixels
     int settleTimeSec;   // time to be within tolerance
     int timeoutSec;      // timeout value
+    bool fast;           // also settle as soon as the error trend has converged
+};
+
+// diagnostics reported with the SettleDone event
+struct SettleDoneInfo
+{
+    int frames;          // frames received while settling
+    int droppedFrames;   // frames received while the star was not locked
+    double settleTime;   // seconds spent settling
+    double distance;     // star distance from the lock position in the last frame, pixels
+    bool converged;      // settling ended by the error trend converging
+    bool haveFit;        // the fit fields below are valid
+    double fitDistance;  // fitted star distance at the last frame, pixels
+    double fitBound;     // upper 95% confidence bound of fitDistance, pixels
+    double decayTime;    // fitted decay time constant, seconds (0 if not decaying)
 };
 
 class PhdController
@@ -219,11 +219,12 @@ class ShiftPoint : public PHD_Point
     PHD_Point m_rate; // rate of change (per second)
     double m_x0;    // initial x position
     double m_y0;    // initial y position
-    wxLongLong_t m_t0;      // initial time (seconds)
+    wxLongLong_t m_t0;      // initial time (milliseconds)
+    wxLongLong_t m_t;       // time the current position was computed for (milliseconds)
 
 public:
 
-    ShiftPoint() { }
+    ShiftPoint() : m_t(0) { }
 
     void SetShiftRate(double xrate, double yrate)
     {
@@ -237,7 +238,10 @@ public:
         {
             m_x0 = X;
             m_y0 = Y;
-            m_t0 = ::wxGetUTCTimeMillis().GetValue();
+            // the position may have been shifted ahead to a time that has not
+            // come yet; keep that time as the reference so restarting the
+            // shift does not move the point
+            m_t0 = wxMax(::wxGetUTCTimeMillis().GetValue(), m_t);
         }
     }
 
@@ -247,12 +251,19 @@ public:
     }
 
     void UpdateShift()
+    {
+        UpdateShift(::wxGetUTCTimeMillis().GetValue());
+    }
+
+    // move the point to where it will be at time t (UTC milliseconds)
+    void UpdateShift(wxLongLong_t t)
     {
         if (IsValid() && m_rate.IsValid())
         {
-            double dt = (double)(::wxGetUTCTimeMillis().GetValue() - m_t0) / 1000.;
+            double dt = (double)(t - m_t0) / 1000.;
             X = m_x0 + m_rate.X * dt;
             Y = m_y0 + m_rate.Y * dt;
+            m_t = t;
         }
     }
 
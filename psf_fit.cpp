@@ -0,0 +1,361 @@
+/*
+ *  psf_fit.cpp
+ *  PHD Guiding
+ *
+ *  Created by the PHD2 developers
+ *  Copyright (c) 2014 PHD2 Developers
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of Craig Stark, Stark Labs nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "phd.h"
+
+enum { MaxIterations = 30, NumParams = 5 };
+
+// fit parameters
+enum { P_FLUX, P_X, P_Y, P_SIGMA, P_BG };
+
+static const double MinSigma = 0.25;            // px
+static const double MaxSigma = 10.0;            // px
+static const double FWHMPerSigma = 2.3548200450309493;  // 2 sqrt(2 ln 2)
+static const double InvSqrt2 = 0.70710678118654752;
+static const double InvSqrt2Pi = 0.39894228040143268;
+
+// standard normal density and cumulative distribution
+inline static double Pdf(double t)
+{
+    return InvSqrt2Pi * exp(-0.5 * t * t);
+}
+
+inline static double Cdf(double t)
+{
+    return 0.5 * erfc(-t * InvSqrt2);
+}
+
+// The Gaussian profile along one axis integrated over each of n pixels
+// starting at pixel p0, and its derivatives with respect to the center c and
+// sigma. The 2D model is separable, so the full Jacobian is built from these
+// per-row and per-column terms without evaluating exp/erfc at every pixel.
+static void AxisProfile(int p0, int n, double c, double sigma, double *e, double *dc, double *ds)
+{
+    double inv = 1.0 / sigma;
+    double a = (p0 - 0.5 - c) * inv;
+    double pa = Pdf(a);
+    double ca = Cdf(a);
+
+    for (int i = 0; i < n; i++)
+    {
+        double b = a + inv;
+        double pb = Pdf(b);
+        double cb = Cdf(b);
+        e[i] = cb - ca;
+        dc[i] = (pa - pb) * inv;
+        ds[i] = (a * pa - b * pb) * inv;
+        a = b;
+        pa = pb;
+        ca = cb;
+    }
+}
+
+class GaussianModel
+{
+    int m_x0, m_y0, m_w, m_h;
+    std::vector<double> m_ex, m_dex, m_dsx;
+    std::vector<double> m_ey, m_dey, m_dsy;
+
+public:
+
+    GaussianModel(const wxRect& rect)
+        : m_x0(rect.GetLeft()), m_y0(rect.GetTop()), m_w(rect.GetWidth()), m_h(rect.GetHeight()),
+          m_ex(m_w), m_dex(m_w), m_dsx(m_w), m_ey(m_h), m_dey(m_h), m_dsy(m_h)
+    {
+    }
+
+    // sum of squared residuals for parameters p
+    double SumSq(const double *data, const double *p)
+    {
+        AxisProfile(m_x0, m_w, p[P_X], p[P_SIGMA], &m_ex[0], &m_dex[0], &m_dsx[0]);
+        AxisProfile(m_y0, m_h, p[P_Y], p[P_SIGMA], &m_ey[0], &m_dey[0], &m_dsy[0]);
+
+        double ss = 0.0;
+        for (int j = 0; j < m_h; j++)
+        {
+            double fy = p[P_FLUX] * m_ey[j];
+            const double *row = data + j * m_w;
+            for (int i = 0; i < m_w; i++)
+            {
+                double r = row[i] - (fy * m_ex[i] + p[P_BG]);
+                ss += r * r;
+            }
+        }
+        return ss;
+    }
+
+    // normal equations (J^T J, J^T r) for parameters p, returns the sum of
+    // squared residuals
+    double Normal(const double *data, const double *p, double jtj[NumParams][NumParams], double *jtr)
+    {
+        AxisProfile(m_x0, m_w, p[P_X], p[P_SIGMA], &m_ex[0], &m_dex[0], &m_dsx[0]);
+        AxisProfile(m_y0, m_h, p[P_Y], p[P_SIGMA], &m_ey[0], &m_dey[0], &m_dsy[0]);
+
+        for (int k = 0; k < NumParams; k++)
+        {
+            jtr[k] = 0.0;
+            for (int l = 0; l < NumParams; l++)
+                jtj[k][l] = 0.0;
+        }
+
+        double flux = p[P_FLUX];
+        double ss = 0.0;
+
+        for (int j = 0; j < m_h; j++)
+        {
+            double ey = m_ey[j];
+            double dey = m_dey[j];
+            double dsy = m_dsy[j];
+            const double *row = data + j * m_w;
+
+            for (int i = 0; i < m_w; i++)
+            {
+                double g = m_ex[i] * ey;
+                double r = row[i] - (flux * g + p[P_BG]);
+
+                double d[NumParams];
+                d[P_FLUX] = g;
+                d[P_X] = flux * m_dex[i] * ey;
+                d[P_Y] = flux * m_ex[i] * dey;
+                d[P_SIGMA] = flux * (m_dsx[i] * ey + m_ex[i] * dsy);
+                d[P_BG] = 1.0;
+
+                for (int k = 0; k < NumParams; k++)
+                {
+                    jtr[k] += d[k] * r;
+                    for (int l = k; l < NumParams; l++)
+                        jtj[k][l] += d[k] * d[l];
+                }
+                ss += r * r;
+            }
+        }
+
+        for (int k = 0; k < NumParams; k++)
+            for (int l = 0; l < k; l++)
+                jtj[k][l] = jtj[l][k];
+
+        return ss;
+    }
+};
+
+// solve a x = b for symmetric positive definite a by Cholesky decomposition;
+// returns true if a is not positive definite
+static bool CholeskySolve(double a[NumParams][NumParams], const double *b, double *x)
+{
+    double l[NumParams][NumParams];
+
+    for (int i = 0; i < NumParams; i++)
+    {
+        for (int j = 0; j <= i; j++)
+        {
+            double s = a[i][j];
+            for (int k = 0; k < j; k++)
+                s -= l[i][k] * l[j][k];
+            if (i == j)
+            {
+                if (s <= 0.0)
+                    return true;
+                l[i][i] = sqrt(s);
+            }
+            else
+                l[i][j] = s / l[j][j];
+        }
+    }
+
+    double y[NumParams];
+    for (int i = 0; i < NumParams; i++)
+    {
+        double s = b[i];
+        for (int k = 0; k < i; k++)
+            s -= l[i][k] * y[k];
+        y[i] = s / l[i][i];
+    }
+    for (int i = NumParams - 1; i >= 0; i--)
+    {
+        double s = y[i];
+        for (int k = i + 1; k < NumParams; k++)
+            s -= l[k][i] * x[k];
+        x[i] = s / l[i][i];
+    }
+
+    return false;
+}
+
+bool FitPSF(const usImage *pImg, const wxRect& rect, double x, double y, PSFFit *fit)
+{
+    static const double InitialLambda = 1e-3;
+    static const double MaxLambda = 1e8;
+    static const double PositionTolerance = 1e-4;   // px
+
+    int w = rect.GetWidth();
+    int h = rect.GetHeight();
+    if (w < 5 || h < 5)
+        return false;
+
+    std::vector<double> data(w * h);
+    for (int j = 0; j < h; j++)
+        for (int i = 0; i < w; i++)
+            data[j * w + i] = (double) pImg->Pixel(rect.GetLeft() + i, rect.GetTop() + j);
+
+    // initial guess: background from the box border, flux and width from the
+    // moments of the background subtracted pixels
+    double bg = 0.0;
+    int nb = 0;
+    for (int i = 0; i < w; i++)
+    {
+        bg += data[i] + data[(h - 1) * w + i];
+        nb += 2;
+    }
+    for (int j = 1; j < h - 1; j++)
+    {
+        bg += data[j * w] + data[j * w + w - 1];
+        nb += 2;
+    }
+    bg /= nb;
+
+    double flux = 0.0, m2 = 0.0, mean = 0.0;
+    for (int j = 0; j < h; j++)
+    {
+        for (int i = 0; i < w; i++)
+        {
+            double v = data[j * w + i];
+            mean += v;
+            v -= bg;
+            if (v <= 0.0)
+                continue;
+            double dx = rect.GetLeft() + i - x;
+            double dy = rect.GetTop() + j - y;
+            flux += v;
+            m2 += v * (dx * dx + dy * dy);
+        }
+    }
+    mean /= w * h;
+
+    if (flux <= 0.0)
+        return false;
+
+    double p[NumParams];
+    p[P_FLUX] = flux;
+    p[P_X] = x;
+    p[P_Y] = y;
+    p[P_SIGMA] = wxMax(0.5, wxMin(sqrt(0.5 * m2 / flux), 0.25 * wxMin(w, h)));
+    p[P_BG] = bg;
+
+    // Levenberg-Marquardt
+    GaussianModel model(rect);
+    double lambda = InitialLambda;
+    double jtj[NumParams][NumParams];
+    double jtr[NumParams];
+    double ss = model.Normal(&data[0], p, jtj, jtr);
+    bool converged = false;
+    int iter;
+
+    for (iter = 1; iter <= MaxIterations && !converged; iter++)
+    {
+        bool improved = false;
+
+        while (!improved && lambda < MaxLambda)
+        {
+            double a[NumParams][NumParams];
+            for (int k = 0; k < NumParams; k++)
+                for (int l = 0; l < NumParams; l++)
+                    a[k][l] = jtj[k][l] + (k == l ? lambda * jtj[k][k] : 0.0);
+
+            double delta[NumParams];
+            double trial[NumParams];
+            bool singular = CholeskySolve(a, jtr, delta);
+            if (!singular)
+            {
+                for (int k = 0; k < NumParams; k++)
+                    trial[k] = p[k] + delta[k];
+            }
+
+            if (singular || trial[P_SIGMA] < MinSigma || trial[P_SIGMA] > MaxSigma || trial[P_FLUX] <= 0.0)
+            {
+                lambda *= 10.0;
+                continue;
+            }
+
+            double trialSS = model.SumSq(&data[0], trial);
+            if (trialSS < ss)
+            {
+                converged = fabs(delta[P_X]) < PositionTolerance && fabs(delta[P_Y]) < PositionTolerance &&
+                    ss - trialSS <= 1e-6 * ss;
+                for (int k = 0; k < NumParams; k++)
+                    p[k] = trial[k];
+                lambda = wxMax(lambda * 0.1, 1e-7);
+                ss = model.Normal(&data[0], p, jtj, jtr);
+                improved = true;
+            }
+            else
+                lambda *= 10.0;
+        }
+
+        if (!improved)
+        {
+            // no step reduces the residuals any more: at the minimum
+            converged = true;
+            break;
+        }
+    }
+
+    if (!converged)
+    {
+        Debug.AddLine("FitPSF: no convergence after %d iterations", MaxIterations);
+        return false;
+    }
+
+    if (p[P_X] < rect.GetLeft() || p[P_X] > rect.GetRight() ||
+        p[P_Y] < rect.GetTop() || p[P_Y] > rect.GetBottom())
+    {
+        Debug.AddLine("FitPSF: center (%.2f, %.2f) outside the fit box", p[P_X], p[P_Y]);
+        return false;
+    }
+
+    double ssTot = 0.0;
+    for (int k = 0; k < w * h; k++)
+        ssTot += (data[k] - mean) * (data[k] - mean);
+
+    fit->X = p[P_X];
+    fit->Y = p[P_Y];
+    fit->Flux = p[P_FLUX];
+    fit->Background = p[P_BG];
+    fit->Sigma = p[P_SIGMA];
+    fit->FWHM = FWHMPerSigma * p[P_SIGMA];
+    fit->HFD = HalfFluxDiameter(&data[0], rect.GetLeft(), rect.GetTop(), w, h, p[P_X], p[P_Y], p[P_BG]);
+    fit->Quality = ssTot > 0.0 ? wxMax(0.0, 1.0 - ss / ssTot) : 0.0;
+    fit->Iterations = iter;
+
+    return true;
+}
@@ -0,0 +1,59 @@
+/*
+ *  psf_fit.h
+ *  PHD Guiding
+ *
+ *  Created by the PHD2 developers
+ *  Copyright (c) 2014 PHD2 Developers
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of Craig Stark, Stark Labs nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef PSF_FIT_INCLUDED
+#define PSF_FIT_INCLUDED
+
+// Least-squares fit of a star image to a circular Gaussian PSF plus a constant
+// background. The Gaussian is integrated over the area of each pixel rather
+// than sampled at the pixel centers, which keeps the fitted position and width
+// unbiased for undersampled guide stars spanning only a few pixels.
+
+struct PSFFit
+{
+    double X, Y;        // star center
+    double Flux;        // total star flux above the background (ADU)
+    double Background;  // ADU
+    double Sigma;       // Gaussian sigma (px)
+    double FWHM;        // full width at half maximum of the fitted profile (px)
+    double HFD;         // half-flux diameter measured from the pixels (px)
+    double Quality;     // fraction of the pixel variance explained by the fit (0-1)
+    int Iterations;
+};
+
+// Fit the star near (x, y) to the pixels in rect. Like Star::Find, returns
+// true on success.
+extern bool FitPSF(const usImage *pImg, const wxRect& rect, double x, double y, PSFFit *fit);
+
+#endif
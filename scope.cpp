@@ -64,7 +64,8 @@ Scope::Scope(void)
     : m_raLimitReachedDirection(NONE),
       m_raLimitReachedCount(0),
       m_decLimitReachedDirection(NONE),
-      m_decLimitReachedCount(0)
+      m_decLimitReachedCount(0),
+      m_lastDecDirection(NONE)
 {
     m_calibrationSteps = 0;
     m_graphControlPane = NULL;
@@ -88,11 +89,16 @@ Scope::Scope(void)
     int decGuideAlgorithm = pConfig->Profile.GetInt(prefix + "/YGuideAlgorithm", DefaultDecGuideAlgorithm);
     SetYGuideAlgorithm(decGuideAlgorithm);
 
+    SetCentroidFilterEnabled(pConfig->Profile.GetBoolean(prefix + "/CentroidFilter", false));
+
     bool val = pConfig->Profile.GetBoolean(prefix + "/CalFlipRequiresDecFlip", false);
     SetCalibrationFlipRequiresDecFlip(val);
 
     val = pConfig->Profile.GetBoolean(prefix + "/AssumeOrthogonal", false);
     SetAssumeOrthogonal(val);
+
+    val = pConfig->Profile.GetBoolean(prefix + "/FastCalibration", false);
+    SetFastCalibration(val);
 }
 
 Scope::~Scope(void)
@@ -434,6 +440,12 @@ void Scope::SetAssumeOrthogonal(bool val)
     pConfig->Profile.SetBoolean("/scope/AssumeOrthogonal", val);
 }
 
+void Scope::SetFastCalibration(bool val)
+{
+    m_fastCalibration = val;
+    pConfig->Profile.SetBoolean("/scope/FastCalibration", val);
+}
+
 void Scope::EnableStopGuidingWhenSlewing(bool enable)
 {
     if (enable)
@@ -625,6 +637,10 @@ Mount::MOVE_RESULT Scope::Move(GUIDE_DIRECTION direction, int duration, bool nor
             {
                 throw ERROR_INFO("guide failed");
             }
+
+            // remember which way the dec gears were last driven, for backlash
+            if (direction == NORTH || direction == SOUTH)
+                m_lastDecDirection = direction;
         }
     }
     catch (const wxString& Msg)
@@ -819,6 +835,7 @@ bool Scope::BeginCalibration(const PHD_Point& currentLocation)
         m_calibrationInitialLocation = currentLocation;
         m_calibrationStartingLocation.Invalidate();
         m_calibrationState = CALIBRATION_STATE_GO_WEST;
+        ResetCalibrationDirection();
         m_calibrationDetails.raSteps.clear();
         m_calibrationDetails.decSteps.clear();
     }
@@ -898,6 +915,31 @@ static PHD_Point MountCoords(const PHD_Point& cameraVector, double xCalibAngle,
     return PHD_Point(hyp * cos(xAngle), hyp * sin(yAngle));
 }
 
+void Scope::ResetCalibrationDirection(void)
+{
+    m_calibrationFit.Reset();
+    m_calibrationTotalDuration = 0;
+    m_calibrationPulse = m_calibrationDuration;
+}
+
+void Scope::AddCalibrationSample(const PHD_Point& currentLocation)
+{
+    m_calibrationFit.AddSample(m_calibrationTotalDuration, currentLocation);
+}
+
+// In fast calibration mode the pulse grows once the star has clearly moved,
+// spreading the remaining distance over the steps the too-few-steps sanity
+// check still needs and never moving the star more than half the search region.
+int Scope::NextCalibrationPulse(double dist, double distCrit, int stepsDone)
+{
+    if (!m_fastCalibration)
+        return m_calibrationPulse;
+
+    int stepsLeft = wxMax(1, CAL_ALERT_MINSTEPS - stepsDone);
+    return m_calibrationFit.NextPulse(m_calibrationPulse, m_calibrationDuration, dist, distCrit, stepsLeft,
+        pFrame->pGuider->GetMaxMovePixels() / 2.0);
+}
+
 bool Scope::UpdateCalibrationState(const PHD_Point& currentLocation)
 {
     bool bError = false;
@@ -917,6 +959,8 @@ bool Scope::UpdateCalibrationState(const PHD_Point& currentLocation)
         double dist = m_calibrationStartingLocation.Distance(currentLocation);
         double dist_crit = CalibrationDistance();
         double nudge_amt;
+        double yAngle, yDist;
+        PHD_Point velocity;
 
         switch (m_calibrationState)
         {
@@ -929,6 +973,7 @@ bool Scope::UpdateCalibrationState(const PHD_Point& currentLocation)
                 // step number in the log is the step that just finished
                 GuideLog.CalibrationStep(this, "West", m_calibrationSteps, dX, dY, currentLocation, dist);
                 m_calibrationDetails.raSteps.push_back(wxRealPoint(dX, dY));
+                AddCalibrationSample(currentLocation);
 
                 if (dist < dist_crit)
                 {
@@ -942,12 +987,26 @@ bool Scope::UpdateCalibrationState(const PHD_Point& currentLocation)
                         throw ERROR_INFO("RA calibration failed");
                     }
                     status0.Printf(_("West step %3d"), m_calibrationSteps);
-                    pFrame->ScheduleCalibrationMove(this, WEST, m_calibrationDuration);
+                    m_calibrationPulse = NextCalibrationPulse(dist, dist_crit, m_calibrationSteps - 1);
+                    m_calibrationTotalDuration += m_calibrationPulse;
+                    pFrame->ScheduleCalibrationMove(this, WEST, m_calibrationPulse);
                     break;
                 }
 
-                m_calibration.xAngle = m_calibrationStartingLocation.Angle(currentLocation);
-                m_calibration.xRate = dist / (m_calibrationSteps * m_calibrationDuration);
+                if (m_fastCalibration && m_calibrationFit.Velocity(&velocity))
+                {
+                    // fit over all the steps rather than the end points alone
+                    m_calibration.xAngle = (velocity * -1.0).Angle();
+                    m_calibration.xRate = velocity.Distance();
+                    Debug.AddLine(wxString::Format("WEST fit: angle=%.1f rate=%.3f, end points: angle=%.1f rate=%.3f",
+                        degrees(m_calibration.xAngle), m_calibration.xRate * 1000.0,
+                        degrees(m_calibrationStartingLocation.Angle(currentLocation)), dist / m_calibrationTotalDuration * 1000.0));
+                }
+                else
+                {
+                    m_calibration.xAngle = m_calibrationStartingLocation.Angle(currentLocation);
+                    m_calibration.xRate = dist / m_calibrationTotalDuration;
+                }
 
                 Debug.AddLine(wxString::Format("WEST calibration completes with steps=%d angle=%.1f rate=%.3f", m_calibrationSteps, degrees(m_calibration.xAngle), m_calibration.xRate * 1000.0));
                 status1.Printf(_("angle=%.1f rate=%.3f"), degrees(m_calibration.xAngle), m_calibration.xRate * 1000.0);
@@ -958,7 +1017,7 @@ bool Scope::UpdateCalibrationState(const PHD_Point& currentLocation)
                 // Choose the largest pulse size that will not lose the guide star or exceed
                 // the user-specified max pulse
 
-                m_recenterRemaining = m_calibrationSteps * m_calibrationDuration;
+                m_recenterRemaining = m_calibrationTotalDuration;
 
                 if (pFrame->pGuider->IsFastRecenterEnabled())
                 {
@@ -1002,6 +1061,7 @@ bool Scope::UpdateCalibrationState(const PHD_Point& currentLocation)
                 m_calibrationSteps = 0;
                 dist = dX = dY = 0.0;
                 m_calibrationStartingLocation = currentLocation;
+                ResetCalibrationDirection();
 
                 if (m_decGuideMode == DEC_NONE)
                 {
@@ -1033,13 +1093,21 @@ bool Scope::UpdateCalibrationState(const PHD_Point& currentLocation)
                         throw ERROR_INFO("Clear backlash failed");
                     }
                     status0.Printf(_("Clear backlash step %3d"), m_calibrationSteps);
-                    pFrame->ScheduleCalibrationMove(this, NORTH, m_calibrationDuration);
+                    if (m_fastCalibration && m_calibrationSteps > 1)
+                    {
+                        // nothing has moved yet; keep doubling the pulse, limited to what
+                        // would move the star a quarter of the search region at the RA rate
+                        int maxPulse = (int) floor(pFrame->pGuider->GetMaxMovePixels() / 4.0 / m_calibration.xRate);
+                        m_calibrationPulse = wxMax(m_calibrationDuration, wxMin(2 * m_calibrationPulse, maxPulse));
+                    }
+                    pFrame->ScheduleCalibrationMove(this, NORTH, m_calibrationPulse);
                     break;
                 }
 
                 m_calibrationSteps = 0;
                 dist = dX = dY = 0.0;
                 m_calibrationStartingLocation = currentLocation;
+                ResetCalibrationDirection();
                 m_calibrationState = CALIBRATION_STATE_GO_NORTH;
 
                 // fall through
@@ -1049,6 +1117,7 @@ bool Scope::UpdateCalibrationState(const PHD_Point& currentLocation)
 
                 GuideLog.CalibrationStep(this, "North", m_calibrationSteps, dX, dY, currentLocation, dist);
                 m_calibrationDetails.decSteps.push_back(wxRealPoint(dX, dY));
+                AddCalibrationSample(currentLocation);
 
                 if (dist < dist_crit)
                 {
@@ -1062,29 +1131,43 @@ bool Scope::UpdateCalibrationState(const PHD_Point& currentLocation)
                         throw ERROR_INFO("Dec calibration failed");
                     }
                     status0.Printf(_("North step %3d"), m_calibrationSteps);
-                    pFrame->ScheduleCalibrationMove(this, NORTH, m_calibrationDuration);
+                    m_calibrationPulse = NextCalibrationPulse(dist, dist_crit, m_calibrationSteps - 1);
+                    m_calibrationTotalDuration += m_calibrationPulse;
+                    pFrame->ScheduleCalibrationMove(this, NORTH, m_calibrationPulse);
                     break;
                 }
 
                 // note: this calculation is reversed from the ra calculation, because
                 // that one was calibrating WEST, but the angle is really relative
                 // to EAST
+                yAngle = currentLocation.Angle(m_calibrationStartingLocation);
+                yDist = dist;
+
+                if (m_fastCalibration && m_calibrationFit.Velocity(&velocity))
+                {
+                    // fit over all the steps rather than the end points alone
+                    Debug.AddLine(wxString::Format("NORTH fit: angle=%.1f rate=%.3f, end points: angle=%.1f rate=%.3f",
+                        degrees(velocity.Angle()), velocity.Distance() * 1000.0,
+                        degrees(yAngle), dist / m_calibrationTotalDuration * 1000.0));
+                    yAngle = velocity.Angle();
+                    yDist = velocity.Distance() * m_calibrationTotalDuration;
+                }
+
                 if (m_assumeOrthogonal)
                 {
                     double a1 = norm_angle(m_calibration.xAngle + M_PI / 2.);
                     double a2 = norm_angle(m_calibration.xAngle - M_PI / 2.);
-                    double yAngle = currentLocation.Angle(m_calibrationStartingLocation);
                     m_calibration.yAngle = fabs(norm_angle(a1 - yAngle)) < fabs(norm_angle(a2 - yAngle)) ? a1 : a2;
-                    double dec_dist = dist * cos(yAngle - m_calibration.yAngle);
-                    m_calibration.yRate = dec_dist / (m_calibrationSteps * m_calibrationDuration);
+                    double dec_dist = yDist * cos(yAngle - m_calibration.yAngle);
+                    m_calibration.yRate = dec_dist / m_calibrationTotalDuration;
 
                     Debug.AddLine("Assuming orthogonal axes: measured Y angle = %.1f, X angle = %.1f, orthogonal = %.1f, %.1f, best = %.1f, dist = %.2f, dec_dist = %.2f",
-                        degrees(yAngle), degrees(m_calibration.xAngle), degrees(a1), degrees(a2), degrees(m_calibration.yAngle), dist, dec_dist);
+                        degrees(yAngle), degrees(m_calibration.xAngle), degrees(a1), degrees(a2), degrees(m_calibration.yAngle), yDist, dec_dist);
                 }
                 else
                 {
-                    m_calibration.yAngle = currentLocation.Angle(m_calibrationStartingLocation);
-                    m_calibration.yRate = dist / (m_calibrationSteps * m_calibrationDuration);
+                    m_calibration.yAngle = yAngle;
+                    m_calibration.yRate = yDist / m_calibrationTotalDuration;
                 }
 
                 m_decSteps = m_calibrationSteps;
@@ -1096,7 +1179,7 @@ bool Scope::UpdateCalibrationState(const PHD_Point& currentLocation)
                 // for GO_SOUTH m_recenterRemaining contains the total remaining duration.
                 // Choose the largest pulse size that will not lose the guide star or exceed
                 // the user-specified max pulse
-                m_recenterRemaining = m_calibrationSteps * m_calibrationDuration;
+                m_recenterRemaining = m_calibrationTotalDuration;
 
                 if (pFrame->pGuider->IsFastRecenterEnabled())
                 {
@@ -1242,8 +1325,8 @@ wxString Scope::GetSettingsSummary()
 
 wxString Scope::CalibrationSettingsSummary()
 {
-    return wxString::Format("Calibration Step = %d ms, Assume orthogonal axes = %s", GetCalibrationDuration(),
-        IsAssumeOrthogonal() ? "yes" : "no");
+    return wxString::Format("Calibration Step = %d ms, Assume orthogonal axes = %s, Fast calibration = %s", GetCalibrationDuration(),
+        IsAssumeOrthogonal() ? "yes" : "no", IsFastCalibration() ? "yes" : "no");
 }
 
 wxString Scope::GetMountClassName() const
@@ -1311,6 +1394,9 @@ Scope::ScopeConfigDialogPane::ScopeConfigDialogPane(wxWindow *pParent, Scope *pS
         _("Assume Dec orthogonal to RA"));
     DoAdd(m_assumeOrthogonal, _("Assume Dec axis is perpendicular to RA axis, regardless of calibration. Prevents RA periodic error from affecting Dec calibration. Option takes effect when calibrating DEC."));
 
+    m_fastCalibration = new wxCheckBox(pParent, wxID_ANY, _("Fast calibration"));
+    DoAdd(m_fastCalibration, _("Lengthen the calibration pulses once the star starts to move, and fit the rates and angles to all of the calibration steps. Calibration takes fewer steps."));
+
     wxString dec_choices[] = {
         _("Off"),_("Auto"),_("North"),_("South")
     };
@@ -1363,6 +1449,7 @@ void Scope::ScopeConfigDialogPane::LoadValues(void)
     if (m_pStopGuidingWhenSlewing)
         m_pStopGuidingWhenSlewing->SetValue(m_pScope->IsStopGuidingWhenSlewingEnabled());
     m_assumeOrthogonal->SetValue(m_pScope->IsAssumeOrthogonal());
+    m_fastCalibration->SetValue(m_pScope->IsFastCalibration());
 }
 
 void Scope::ScopeConfigDialogPane::UnloadValues(void)
@@ -1375,6 +1462,7 @@ void Scope::ScopeConfigDialogPane::UnloadValues(void)
     if (m_pStopGuidingWhenSlewing)
         m_pScope->EnableStopGuidingWhenSlewing(m_pStopGuidingWhenSlewing->GetValue());
     m_pScope->SetAssumeOrthogonal(m_assumeOrthogonal->GetValue());
+    m_pScope->SetFastCalibration(m_fastCalibration->GetValue());
 
     MountConfigDialogPane::UnloadValues();
 }
@@ -59,11 +59,15 @@ class Scope : public Mount
     int m_raLimitReachedCount;
     GUIDE_DIRECTION m_decLimitReachedDirection;
     int m_decLimitReachedCount;
+    GUIDE_DIRECTION m_lastDecDirection;  // direction of the most recent dec pulse
 
     // Calibration variables
     int m_calibrationSteps;
     int m_recenterRemaining;
     int m_recenterDuration;
+    int m_calibrationPulse;          // duration of the latest calibration pulse, ms
+    int m_calibrationTotalDuration;  // total of the pulses in the current direction, ms
+    CalibrationFit m_calibrationFit;
     PHD_Point m_calibrationInitialLocation;   // initial position of guide star
     PHD_Point m_calibrationStartingLocation;  // position of guide star at start of calibration measurement (after clear backlash etc.)
     PHD_Point m_southStartingLocation;        // Needed to be sure nudging is in south-only direction
@@ -73,6 +77,7 @@ class Scope : public Mount
     Calibration m_calibration;
     CalibrationDetails m_calibrationDetails;
     bool m_assumeOrthogonal;
+    bool m_fastCalibration;
     int m_raSteps;
     int m_decSteps;
 
@@ -107,6 +112,7 @@ protected:
         wxCheckBox *m_pNeedFlipDec;
         wxCheckBox *m_pStopGuidingWhenSlewing;
         wxCheckBox *m_assumeOrthogonal;
+        wxCheckBox *m_fastCalibration;
 
         void OnCalcCalibrationStep(wxCommandEvent& evt);
 
@@ -150,6 +156,7 @@ public:
     virtual bool SetMaxRaDuration(double maxRaDuration);
     virtual DEC_GUIDE_MODE GetDecGuideMode(void);
     virtual bool SetDecGuideMode(int decGuideMode);
+    GUIDE_DIRECTION LastDecDirection(void) const { return m_lastDecDirection; }
 
     virtual ConfigDialogPane *GetConfigDialogPane(wxWindow *pParent);
     virtual GraphControlPane *GetGraphControlPane(wxWindow *pParent, const wxString& label);
@@ -179,6 +186,8 @@ public:
     bool IsStopGuidingWhenSlewingEnabled(void) const;
     void SetAssumeOrthogonal(bool val);
     bool IsAssumeOrthogonal(void) const;
+    void SetFastCalibration(bool val);
+    bool IsFastCalibration(void) const;
     void HandleSanityCheckDialog();
     void SetCalibrationWarning(Calibration_Issues etype, bool val);
 
@@ -197,6 +206,9 @@ private:
     void ClearCalibration(void);
     wxString GetCalibrationStatus(double dX, double dY, double dist, double dist_crit);
     void SanityCheckCalibration(const Calibration& oldCal, const CalibrationDetails& oldDetails);
+    void ResetCalibrationDirection(void);
+    void AddCalibrationSample(const PHD_Point& currentLocation);
+    int NextCalibrationPulse(double dist, double distCrit, int stepsDone);
 
 // these MUST be supplied by a subclass
 private:
@@ -213,4 +225,9 @@ inline bool Scope::IsAssumeOrthogonal(void) const
     return m_assumeOrthogonal;
 }
 
+inline bool Scope::IsFastCalibration(void) const
+{
+    return m_fastCalibration;
+}
+
 #endif /* SCOPE_H_INCLUDED */
@@ -47,6 +47,8 @@ SerialPort *SerialPort::SerialPortFactory(void)
 {
 #if defined(_WINDOWS_)
     return new SerialPortWin32();
+#elif defined(__LINUX__)
+    return new SerialPortPosix();
 #else
     return 0;
 #endif
@@ -0,0 +1,427 @@
+/*
+ *  serialport_posix.cpp
+ *  PHD Guiding
+ *
+ *  Created by the PHD2 developers
+ *  Copyright (c) 2014 PHD2 Developers
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of Craig Stark, Stark Labs nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifdef __LINUX__
+
+#include "phd.h"
+
+#include <wx/dir.h>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <linux/serial.h>
+
+static const int DefaultReceiveTimeoutMs = 1000;
+static const int SendTimeoutMs = 1000;
+
+static speed_t BaudToSpeed(int baud)
+{
+    switch (baud)
+    {
+        case 1200:   return B1200;
+        case 2400:   return B2400;
+        case 4800:   return B4800;
+        case 9600:   return B9600;
+        case 19200:  return B19200;
+        case 38400:  return B38400;
+        case 57600:  return B57600;
+        case 115200: return B115200;
+        case 230400: return B230400;
+        default:     return B0;
+    }
+}
+
+// true if the device node is a usable serial port; the kernel creates
+// ttyS nodes for every possible 8250 UART whether or not it exists
+static bool IsSerialDevice(const wxString& path)
+{
+    int fd = open(path.mb_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (fd < 0)
+        return false;
+
+    bool ok = true;
+    struct serial_struct ss;
+    if (ioctl(fd, TIOCGSERIAL, &ss) == 0 && ss.type == PORT_UNKNOWN)
+        ok = false;
+
+    close(fd);
+    return ok;
+}
+
+SerialPortPosix::SerialPortPosix(void)
+{
+    m_fd = -1;
+    m_receiveTimeoutMs = DefaultReceiveTimeoutMs;
+}
+
+SerialPortPosix::~SerialPortPosix(void)
+{
+    if (m_fd >= 0)
+    {
+        close(m_fd);
+        m_fd = -1;
+    }
+}
+
+wxArrayString SerialPortPosix::GetSerialPortList(void)
+{
+    wxArrayString ret;
+
+    static const char *patterns[] = { "ttyUSB*", "ttyACM*", "ttyS*" };
+
+    wxDir dir("/dev");
+    if (!dir.IsOpened())
+        return ret;
+
+    for (unsigned int i = 0; i < WXSIZEOF(patterns); i++)
+    {
+        wxArrayString found;
+        wxString name;
+        for (bool cont = dir.GetFirst(&name, patterns[i], wxDIR_FILES); cont; cont = dir.GetNext(&name))
+        {
+            wxString path = "/dev/" + name;
+            if (IsSerialDevice(path))
+                found.Add(path);
+        }
+        found.Sort();
+        WX_APPEND_ARRAY(ret, found);
+    }
+
+    return ret;
+}
+
+bool SerialPortPosix::Connect(const wxString& portName, int baud, int dataBits, int stopBits, PARITY Parity, bool useRTS, bool useDTR)
+{
+    bool bError = false;
+
+    // checked outside the try block, whose error path closes the port
+    if (m_fd >= 0)
+    {
+        Debug.AddLine("SerialPortPosix: already connected");
+        return true;
+    }
+
+    try
+    {
+        // non-blocking, so that open does not wait for carrier detect and so that
+        // reads and writes never block; timeouts are done with poll()
+        m_fd = open(portName.mb_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+        if (m_fd < 0)
+        {
+            Debug.AddLine(wxString::Format("SerialPortPosix: open %s failed, errno = %d", portName, errno));
+            throw ERROR_INFO("SerialPortPosix: open failed");
+        }
+
+        if (ioctl(m_fd, TIOCEXCL) == -1)
+        {
+            Debug.AddLine("SerialPortPosix: TIOCEXCL failed, errno = %d", errno);
+        }
+
+        struct termios options;
+        if (tcgetattr(m_fd, &options) == -1)
+        {
+            throw ERROR_INFO("SerialPortPosix: tcgetattr failed");
+        }
+
+        cfmakeraw(&options);
+
+        speed_t speed = BaudToSpeed(baud);
+        if (speed == B0)
+        {
+            throw ERROR_INFO("SerialPortPosix: unsupported baud rate");
+        }
+        cfsetispeed(&options, speed);
+        cfsetospeed(&options, speed);
+
+        options.c_cflag &= ~CSIZE;
+        switch (dataBits)
+        {
+            case 5: options.c_cflag |= CS5; break;
+            case 6: options.c_cflag |= CS6; break;
+            case 7: options.c_cflag |= CS7; break;
+            case 8: options.c_cflag |= CS8; break;
+            default:
+                throw ERROR_INFO("SerialPortPosix: invalid dataBits");
+        }
+
+        switch (stopBits)
+        {
+            case 1:
+                options.c_cflag &= ~CSTOPB;
+                break;
+            case 2:
+                options.c_cflag |= CSTOPB;
+                break;
+            default:
+                throw ERROR_INFO("SerialPortPosix: invalid stopBits");
+        }
+
+        options.c_cflag &= ~(PARENB | PARODD | CMSPAR);
+        switch (Parity)
+        {
+            case ParityNone:
+                break;
+            case ParityOdd:
+                options.c_cflag |= PARENB | PARODD;
+                break;
+            case ParityEven:
+                options.c_cflag |= PARENB;
+                break;
+            case ParityMark:
+                options.c_cflag |= PARENB | CMSPAR | PARODD;
+                break;
+            case ParitySpace:
+                options.c_cflag |= PARENB | CMSPAR;
+                break;
+        }
+
+        options.c_cflag |= CLOCAL | CREAD;
+        if (useRTS)
+            options.c_cflag |= CRTSCTS;
+        else
+            options.c_cflag &= ~CRTSCTS;
+
+        // reads return whatever is available at once; Receive() waits with poll()
+        options.c_cc[VMIN] = 0;
+        options.c_cc[VTIME] = 0;
+
+        if (tcsetattr(m_fd, TCSANOW, &options) == -1)
+        {
+            throw ERROR_INFO("SerialPortPosix: tcsetattr failed");
+        }
+
+        // ask the driver to pass received bytes on immediately instead of
+        // batching them; USB adapters otherwise add several ms per reply
+        struct serial_struct ss;
+        if (ioctl(m_fd, TIOCGSERIAL, &ss) == 0)
+        {
+            ss.flags |= ASYNC_LOW_LATENCY;
+            if (ioctl(m_fd, TIOCSSERIAL, &ss) == -1)
+                Debug.AddLine("SerialPortPosix: could not set low latency mode, errno = %d", errno);
+        }
+
+        // the Win32 port asserts DTR and RTS when they are not used for handshaking
+        SetDTR(true);
+        if (!useRTS)
+            SetRTS(true);
+        POSSIBLY_UNUSED(useDTR);
+
+        tcflush(m_fd, TCIOFLUSH);
+
+        Debug.AddLine(wxString::Format("SerialPortPosix: connected to %s at %d baud", portName, baud));
+    }
+    catch (wxString Msg)
+    {
+        POSSIBLY_UNUSED(Msg);
+        if (m_fd >= 0)
+        {
+            close(m_fd);
+            m_fd = -1;
+        }
+        bError = true;
+    }
+
+    return bError;
+}
+
+bool SerialPortPosix::Disconnect(void)
+{
+    bool bError = false;
+
+    if (m_fd >= 0)
+    {
+        if (close(m_fd))
+            bError = true;
+        m_fd = -1;
+    }
+
+    return bError;
+}
+
+bool SerialPortPosix::SetReceiveTimeout(int timeoutMs)
+{
+    m_receiveTimeoutMs = timeoutMs;
+    return false;
+}
+
+bool SerialPortPosix::Send(const unsigned char *pData, unsigned count)
+{
+    bool bError = false;
+
+    try
+    {
+        if (m_fd < 0)
+        {
+            throw ERROR_INFO("SerialPortPosix: not connected");
+        }
+
+        Debug.AddBytes("Sending", pData, count);
+
+        unsigned int sent = 0;
+        while (sent < count)
+        {
+            ssize_t n = write(m_fd, pData + sent, count - sent);
+            if (n > 0)
+            {
+                sent += n;
+                continue;
+            }
+
+            if (n < 0 && errno != EAGAIN && errno != EINTR)
+            {
+                throw ERROR_INFO("SerialPortPosix: write failed");
+            }
+
+            // output buffer is full
+            struct pollfd pfd = { m_fd, POLLOUT, 0 };
+            if (poll(&pfd, 1, SendTimeoutMs) == 0)
+            {
+                throw ERROR_INFO("SerialPortPosix: write timed out");
+            }
+        }
+    }
+    catch (wxString Msg)
+    {
+        POSSIBLY_UNUSED(Msg);
+        bError = true;
+    }
+
+    return bError;
+}
+
+bool SerialPortPosix::Receive(unsigned char *pData, unsigned count)
+{
+    bool bError = false;
+
+    try
+    {
+        if (m_fd < 0)
+        {
+            throw ERROR_INFO("SerialPortPosix: not connected");
+        }
+
+        wxStopWatch swatch;
+        unsigned int received = 0;
+        bool hungUp = false;
+
+        while (received < count)
+        {
+            ssize_t n = read(m_fd, pData + received, count - received);
+            if (n > 0)
+            {
+                received += n;
+                continue;
+            }
+
+            if (n < 0 && errno != EAGAIN && errno != EINTR)
+            {
+                throw ERROR_INFO("SerialPortPosix: read failed");
+            }
+
+            // after a hangup poll() keeps reporting the port readable and
+            // read() keeps returning nothing, so stop once it is drained
+            if (n == 0 && hungUp)
+            {
+                throw ERROR_INFO("SerialPortPosix: port closed");
+            }
+
+            long remaining = m_receiveTimeoutMs - swatch.Time();
+            if (remaining <= 0)
+            {
+                Debug.AddLine("SerialPortPosix: receive timed out with %u of %u bytes", received, count);
+                throw ERROR_INFO("SerialPortPosix: receive timed out");
+            }
+
+            struct pollfd pfd = { m_fd, POLLIN, 0 };
+            int ret = poll(&pfd, 1, remaining);
+            if (ret < 0 && errno != EINTR)
+            {
+                throw ERROR_INFO("SerialPortPosix: poll failed");
+            }
+            if (ret > 0 && (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)))
+            {
+                if (!(pfd.revents & POLLIN))
+                {
+                    throw ERROR_INFO("SerialPortPosix: port closed");
+                }
+                hungUp = true;
+            }
+        }
+
+        Debug.AddBytes("Received", pData, received);
+    }
+    catch (wxString Msg)
+    {
+        POSSIBLY_UNUSED(Msg);
+        bError = true;
+    }
+
+    return bError;
+}
+
+bool SerialPortPosix::SetModemLine(int line, bool asserted)
+{
+    bool bError = false;
+
+    try
+    {
+        if (ioctl(m_fd, asserted ? TIOCMBIS : TIOCMBIC, &line) == -1)
+        {
+            throw ERROR_INFO("SerialPortPosix: TIOCMBIS/TIOCMBIC failed");
+        }
+    }
+    catch (wxString Msg)
+    {
+        POSSIBLY_UNUSED(Msg);
+        bError = true;
+    }
+
+    return bError;
+}
+
+bool SerialPortPosix::SetRTS(bool asserted)
+{
+    return SetModemLine(TIOCM_RTS, asserted);
+}
+
+bool SerialPortPosix::SetDTR(bool asserted)
+{
+    return SetModemLine(TIOCM_DTR, asserted);
+}
+
+#endif // __LINUX__
@@ -39,6 +39,7 @@
 #include "serialport.h"
 #include "serialport_win32.h"
 #include "serialport_mac.h"
+#include "serialport_posix.h"
 
 #ifdef USE_LOOPBACK_SERIAL
 #include "serialport_loopback.h"
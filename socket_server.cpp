@@ -107,6 +107,10 @@ bool MyFrame::StartServer(bool state)
             return true;
         }
 
+        // the frame server is optional; guiding and the event server work without it
+        if (FrameSrv.FrameServerStart(m_instanceNumber))
+            Debug.AddLine("frame server not available");
+
         SetStatusText(_("Server started"));
         Debug.AddLine(wxString::Format("Server started, listening on port %u", port));
     }
@@ -115,6 +119,7 @@ bool MyFrame::StartServer(bool state)
         std::for_each(s_clients.begin(), s_clients.end(), std::mem_fun(&wxSocketBase::Destroy));
         s_clients.empty();
         EvtServer.EventServerStop();
+        FrameSrv.FrameServerStop();
         delete SocketServer;
         SocketServer = NULL;
         SetStatusText(_("Server stopped"));
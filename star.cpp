@@ -70,6 +70,9 @@ void Star::Invalidate(void)
 {
     Mass = 0.0;
     SNR = 0.0;
+    HFD = 0.0;
+    FWHM = 0.0;
+    FitQuality = 0.0;
     m_lastFindResult = STAR_ERROR;
     PHD_Point::Invalidate();
 }
@@ -84,6 +87,8 @@ bool Star::Find(const usImage *pImg, int searchRegion, int base_x, int base_y, F
     FindResult Result = STAR_OK;
     double newX = base_x;
     double newY = base_y;
+    PSFFit fit;
+    bool fitted = false;
 
     try
     {
@@ -117,9 +122,6 @@ bool Star::Find(const usImage *pImg, int searchRegion, int base_x, int base_y, F
             end_y = wxMin(end_y, pImg->Size.GetHeight() - 1);
         }
 
-        const unsigned short *dataptr = pImg->ImageData;
-        int rowsize = pImg->Size.GetWidth();
-
         // compute localmin and localmean, which we need to find the star
         unsigned short localmin = 65535;
         double localmean = 0.0;
@@ -127,7 +129,7 @@ bool Star::Find(const usImage *pImg, int searchRegion, int base_x, int base_y, F
         {
             for (int x = start_x; x <= end_x; x++)
             {
-                unsigned short val = *(dataptr + x + rowsize * y);
+                unsigned short val = pImg->Pixel(x, y);
                 if (val < localmin)
                     localmin = val;
                 localmean += (double) val;
@@ -149,12 +151,12 @@ bool Star::Find(const usImage *pImg, int searchRegion, int base_x, int base_y, F
             {
                 unsigned long lval;
 
-                lval = *(dataptr + (x + 0) + rowsize * (y + 0)) +  // combine adjacent pixels to smooth image
-                       *(dataptr + (x + 1) + rowsize * (y + 0)) +        // find max of this smoothed area and set
-                       *(dataptr + (x - 1) + rowsize * (y + 0)) +        // base_x and y to be this spot
-                       *(dataptr + (x + 0) + rowsize * (y + 1)) +
-                       *(dataptr + (x + 0) + rowsize * (y - 1)) +
-                       *(dataptr + (x + 0) + rowsize * (y + 0));  // weight current pixel by 2x
+                lval = pImg->Pixel(x + 0, y + 0) +  // combine adjacent pixels to smooth image
+                       pImg->Pixel(x + 1, y + 0) +        // find max of this smoothed area and set
+                       pImg->Pixel(x - 1, y + 0) +        // base_x and y to be this spot
+                       pImg->Pixel(x + 0, y + 1) +
+                       pImg->Pixel(x + 0, y - 1) +
+                       pImg->Pixel(x + 0, y + 0);  // weight current pixel by 2x
 
                 if (lval >= maxlval)
                 {
@@ -163,7 +165,7 @@ bool Star::Find(const usImage *pImg, int searchRegion, int base_x, int base_y, F
                     maxlval = lval;
                 }
 
-                unsigned short sval = *(dataptr + x + rowsize * y) - localmin;
+                unsigned short sval = pImg->Pixel(x, y) - localmin;
                 sum += sval;
 
                 if (sval > max)
@@ -217,7 +219,7 @@ bool Star::Find(const usImage *pImg, int searchRegion, int base_x, int base_y, F
                 {
                     for (int x = startx1; x <= endx1; x++)
                     {
-                        double val = (double) *(dataptr + x + rowsize * y) - threshold;
+                        double val = (double) pImg->Pixel(x, y) - threshold;
                         if (val > 0.0)
                         {
                             mx += (double) x * val;
@@ -243,6 +245,24 @@ bool Star::Find(const usImage *pImg, int searchRegion, int base_x, int base_y, F
                 if ((unsigned int)(max - nearmax2) * 65535U < 32U * (unsigned int) max)
                     Result = STAR_SATURATED;
             }
+
+            // refine the centroid with a PSF fit; saturated stars do not
+            // follow the model, so they keep the centroid
+            if (mode == FIND_PSF_FIT && Result == STAR_OK)
+            {
+                wxRect fitRect(startx1, starty1, endx1 - startx1 + 1, endy1 - starty1 + 1);
+                fitted = FitPSF(pImg, fitRect, newX, newY, &fit) &&
+                    hypot(fit.X - newX, fit.Y - newY) < 2.0;
+                if (fitted)
+                {
+                    newX = fit.X;
+                    newY = fit.Y;
+                }
+                else
+                {
+                    Debug.AddLine("Star::Find: PSF fit failed, using centroid");
+                }
+            }
         }
     }
     catch (wxString Msg)
@@ -258,6 +278,9 @@ bool Star::Find(const usImage *pImg, int searchRegion, int base_x, int base_y, F
     // update state
     SetXY(newX, newY);
     m_lastFindResult = Result;
+    HFD = fitted ? fit.HFD : 0.0;
+    FWHM = fitted ? fit.FWHM : 0.0;
+    FitQuality = fitted ? fit.Quality : 0.0;
 
     bool bReturn = WasFound(Result);
 
@@ -269,6 +292,11 @@ bool Star::Find(const usImage *pImg, int searchRegion, int base_x, int base_y, F
 
     Debug.AddLine(wxString::Format("Star::Find returns %d (%d), X=%.2f, Y=%.2f, Mass=%.f, SNR=%.1f",
         bReturn, Result, newX, newY, Mass, SNR));
+    if (fitted)
+    {
+        Debug.AddLine(wxString::Format("Star::Find PSF fit FWHM=%.2f HFD=%.2f quality=%.3f iterations=%d",
+            FWHM, HFD, FitQuality, fit.Iterations));
+    }
 
     return bReturn;
 }
@@ -355,44 +383,30 @@ static void SaveImage(const FloatImg& img, const char *name)
 #endif // SAVE_AUTOFIND_IMG
 }
 
-static void psf_conv(FloatImg& dst, const FloatImg& src)
+// the PSF convolution of the rows in a band
+struct PsfConvRows : public ParallelBody
 {
-    dst.Init(src.Size);
-
-    //                       A      B1     B2    C1     C2    C3     D1     D2     D3
-    const double PSF[] = { 0.906, 0.584, 0.365, .117, .049, -0.05, -.064, -.074, -.094 };
+    float *dst;
+    const float *src;
+    int width;
 
-    int const width = src.Size.GetWidth();
-    int const height = src.Size.GetHeight();
-
-    memset(dst.px, 0, src.NPixels * sizeof(float));
-
-    /* PSF Grid is:
-    D3 D3 D3 D3 D3 D3 D3 D3 D3
-    D3 D3 D3 D2 D1 D2 D3 D3 D3
-    D3 D3 C3 C2 C1 C2 C3 D3 D3
-    D3 D2 C2 B2 B1 B2 C2 D2 D3
-    D3 D1 C1 B1 A  B1 C1 D1 D3
-    D3 D2 C2 B2 B1 B2 C2 D2 D3
-    D3 D3 C3 C2 C1 C2 C3 D3 D3
-    D3 D3 D3 D2 D1 D2 D3 D3 D3
-    D3 D3 D3 D3 D3 D3 D3 D3 D3
+    enum { PsfSize = 4 };
 
-    1@A
-    4@B1, B2, C1, C3, D1
-    8@C2, D2
-    44 * D3
-    */
+    void Run(int y0, int y1);
+};
 
-    int psf_size = 4;
+void PsfConvRows::Run(int y0, int y1)
+{
+    //                       A      B1     B2    C1     C2    C3     D1     D2     D3
+    const double PSF[] = { 0.906, 0.584, 0.365, .117, .049, -0.05, -.064, -.074, -.094 };
 
-    for (int y = psf_size; y < height - psf_size; y++)
+    for (int y = y0; y < y1; y++)
     {
-        for (int x = psf_size; x < width - psf_size; x++)
+        for (int x = PsfSize; x < width - PsfSize; x++)
         {
             float A, B1, B2, C1, C2, C3, D1, D2, D3;
 
-#define PX(dx, dy) *(src.px + width * (y + (dy)) + x + (dx))
+#define PX(dx, dy) *(src + width * (y + (dy)) + x + (dx))
             A =  PX(+0, +0);
             B1 = PX(+0, -1) + PX(+0, +1) + PX(+1, +0) + PX(-1, +0);
             B2 = PX(-1, -1) + PX(+1, -1) + PX(-1, +1) + PX(+1, +1);
@@ -406,25 +420,25 @@ static void psf_conv(FloatImg& dst, const FloatImg& src)
             int i;
             const float *uptr;
 
-            uptr = src.px + width * (y - 4) + (x - 4);
+            uptr = src + width * (y - 4) + (x - 4);
             for (i = 0; i < 9; i++)
                 D3 += *uptr++;
 
-            uptr = src.px + width * (y - 3) + (x - 4);
+            uptr = src + width * (y - 3) + (x - 4);
             for (i = 0; i < 3; i++)
                 D3 += *uptr++;
             uptr += 3;
             for (i = 0; i < 3; i++)
                 D3 += *uptr++;
 
-            uptr = src.px + width * (y + 3) + (x - 4);
+            uptr = src + width * (y + 3) + (x - 4);
             for (i = 0; i < 3; i++)
                 D3 += *uptr++;
             uptr += 3;
             for (i = 0; i < 3; i++)
                 D3 += *uptr++;
 
-            uptr = src.px + width * (y + 4) + (x - 4);
+            uptr = src + width * (y + 4) + (x - 4);
             for (i = 0; i < 9; i++)
                 D3 += *uptr++;
 
@@ -433,11 +447,69 @@ static void psf_conv(FloatImg& dst, const FloatImg& src)
                 PSF[3] * (C1 - 4.0 * mean) + PSF[4] * (C2 - 8.0 * mean) + PSF[5] * (C3 - 4.0 * mean) +
                 PSF[6] * (D1 - 4.0 * mean) + PSF[7] * (D2 - 8.0 * mean) + PSF[8] * (D3 - 44.0 * mean);
 
-            dst.px[width * y + x] = (float) PSF_fit;
+            dst[width * y + x] = (float) PSF_fit;
         }
     }
 }
 
+static void psf_conv(FloatImg& dst, const FloatImg& src)
+{
+    dst.Init(src.Size);
+
+    int const width = src.Size.GetWidth();
+    int const height = src.Size.GetHeight();
+
+    memset(dst.px, 0, src.NPixels * sizeof(float));
+
+    /* PSF Grid is:
+    D3 D3 D3 D3 D3 D3 D3 D3 D3
+    D3 D3 D3 D2 D1 D2 D3 D3 D3
+    D3 D3 C3 C2 C1 C2 C3 D3 D3
+    D3 D2 C2 B2 B1 B2 C2 D2 D3
+    D3 D1 C1 B1 A  B1 C1 D1 D3
+    D3 D2 C2 B2 B1 B2 C2 D2 D3
+    D3 D3 C3 C2 C1 C2 C3 D3 D3
+    D3 D3 D3 D2 D1 D2 D3 D3 D3
+    D3 D3 D3 D3 D3 D3 D3 D3 D3
+
+    1@A
+    4@B1, B2, C1, C3, D1
+    8@C2, D2
+    44 * D3
+    */
+
+    PsfConvRows rows;
+    rows.dst = dst.px;
+    rows.src = src.px;
+    rows.width = width;
+    parallel_for(PsfConvRows::PsfSize, height - PsfConvRows::PsfSize, rows);
+}
+
+struct DownsampleRows : public ParallelBody
+{
+    float *dst;
+    const float *src;
+    int width;
+    int dw;
+    int downsample;
+
+    void Run(int y0, int y1)
+    {
+        for (int yy = y0; yy < y1; yy++)
+        {
+            for (int xx = 0; xx < dw; xx++)
+            {
+                float sum = 0.0;
+                for (int j = 0; j < downsample; j++)
+                    for (int i = 0; i < downsample; i++)
+                        sum += src[(yy * downsample + j) * width + xx * downsample + i];
+                float val = sum / (downsample * downsample);
+                dst[yy * dw + xx] = val;
+            }
+        }
+    }
+};
+
 static void Downsample(FloatImg& dst, const FloatImg& src, int downsample)
 {
     int width = src.Size.GetWidth();
@@ -446,18 +518,13 @@ static void Downsample(FloatImg& dst, const FloatImg& src, int downsample)
 
     dst.Init(wxSize(dw, dh));
 
-    for (int yy = 0; yy < dh; yy++)
-    {
-        for (int xx = 0; xx < dw; xx++)
-        {
-            float sum = 0.0;
-            for (int j = 0; j < downsample; j++)
-                for (int i = 0; i < downsample; i++)
-                    sum += src.px[(yy * downsample + j) * width + xx * downsample + i];
-            float val = sum / (downsample * downsample);
-            dst.px[yy * dw + xx] = val;
-        }
-    }
+    DownsampleRows rows;
+    rows.dst = dst.px;
+    rows.src = src.px;
+    rows.width = width;
+    rows.dw = dw;
+    rows.downsample = downsample;
+    parallel_for(0, dh, rows);
 }
 
 struct Peak
@@ -488,7 +555,33 @@ static void RemoveItems(std::set<Peak>& stars, const std::set<int>& to_erase)
     }
 }
 
-bool Star::AutoFind(const usImage& image, int extraEdgeAllowance, int searchRegion)
+// collect the remaining candidates, brightest first, skipping the primary
+// star and any stars that are saturated or cannot be centroided
+static void FindExtraStars(const usImage& image, int searchRegion, const std::set<Peak>& stars,
+                           const Peak& primary, std::vector<PHD_Point> *extraStars,
+                           unsigned int maxExtraStars)
+{
+    extraStars->clear();
+
+    for (std::set<Peak>::const_reverse_iterator it = stars.rbegin();
+         it != stars.rend() && extraStars->size() < maxExtraStars; ++it)
+    {
+        if (it->x == primary.x && it->y == primary.y)
+            continue;
+        Star tmp;
+        tmp.Find(&image, searchRegion, it->x, it->y, Star::FIND_CENTROID);
+        if (tmp.GetError() != Star::STAR_OK)
+            continue;
+        Debug.AddLine("Autofind: extra star at [%d, %d] %.1f Mass %.f SNR %.1f", it->x, it->y, it->val, tmp.Mass, tmp.SNR);
+        extraStars->push_back(PHD_Point(tmp.X, tmp.Y));
+    }
+}
+
+// Finds the best guide star. When extraStars is given, the positions of up to
+// maxExtraStars more non-saturated stars, brightest first, are returned in it
+// for use as secondary guide stars.
+bool Star::AutoFind(const usImage& image, int extraEdgeAllowance, int searchRegion,
+                    std::vector<PHD_Point> *extraStars, unsigned int maxExtraStars)
 {
     if (!image.Subframe.IsEmpty())
     {
@@ -701,6 +794,8 @@ bool Star::AutoFind(const usImage& image, int extraEdgeAllowance, int searchRegi
                 }
                 SetXY(it->x, it->y);
                 Debug.AddLine("Autofind returns star at [%d, %d] %.1f Mass %.f SNR %.1f", it->x, it->y, it->val, tmp.Mass, tmp.SNR);
+                if (extraStars)
+                    FindExtraStars(image, searchRegion, stars, *it, extraStars, maxExtraStars);
                 return true;
             }
         }
@@ -47,6 +47,7 @@ public:
     {
         FIND_CENTROID,
         FIND_PEAK,
+        FIND_PSF_FIT,
     };
 
     enum FindResult
@@ -62,6 +63,9 @@ public:
 
     double Mass;
     double SNR;
+    double HFD;         // half-flux diameter (px), FIND_PSF_FIT only
+    double FWHM;        // (px), FIND_PSF_FIT only
+    double FitQuality;  // 0-1, FIND_PSF_FIT only
 
     Star(void);
     ~Star();
@@ -73,7 +77,8 @@ public:
      */
     bool Find(const usImage *pImg, int searchRegion, FindMode mode);
     bool Find(const usImage *pImg, int searchRegion, int X, int Y, FindMode mode);
-    bool AutoFind(const usImage& image, int edgeAllowance, int searchRegion);
+    bool AutoFind(const usImage& image, int edgeAllowance, int searchRegion,
+                  std::vector<PHD_Point> *extraStars = 0, unsigned int maxExtraStars = 0);
 
     bool WasFound(FindResult result);
     bool WasFound(void);
@@ -0,0 +1,215 @@
+/*
+ *  star_metrics.cpp
+ *  PHD Guiding
+ *
+ *  Created by the PHD2 developers
+ *  Copyright (c) 2014 PHD2 Developers
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of Craig Stark, Stark Labs nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "phd.h"
+
+#include <algorithm>
+
+struct RadialPixel
+{
+    double r;
+    double val;
+    bool operator<(const RadialPixel& rhs) const { return r < rhs.r; }
+};
+
+// Only the largest circle that fits in the data is used, and negative pixels
+// are kept so the background noise cancels instead of inflating the flux at
+// large radii.
+double HalfFluxDiameter(const double *data, int x0, int y0, int w, int h, double cx, double cy, double bg)
+{
+    double maxR = wxMin(wxMin(cx - x0, x0 + w - 1 - cx), wxMin(cy - y0, y0 + h - 1 - cy));
+    if (maxR <= 0.0)
+        return 0.0;
+
+    std::vector<RadialPixel> px;
+    px.reserve(w * h);
+
+    double total = 0.0;
+    for (int j = 0; j < h; j++)
+    {
+        double dy = y0 + j - cy;
+        const double *row = data + j * w;
+        for (int i = 0; i < w; i++)
+        {
+            RadialPixel p;
+            p.r = hypot(x0 + i - cx, dy);
+            if (p.r > maxR)
+                continue;
+            p.val = row[i] - bg;
+            px.push_back(p);
+            total += p.val;
+        }
+    }
+
+    if (total <= 0.0)
+        return 0.0;
+
+    std::sort(px.begin(), px.end());
+
+    double half = 0.5 * total;
+    double sum = 0.0;
+    double prevR = 0.0;
+    for (std::vector<RadialPixel>::const_iterator it = px.begin(); it != px.end(); ++it)
+    {
+        if (it->val > 0.0 && sum + it->val >= half)
+            return 2.0 * (prevR + (it->r - prevR) * (half - sum) / it->val);
+        sum += it->val;
+        prevR = it->r;
+    }
+
+    return 2.0 * prevR;
+}
+
+static double Median(std::vector<double>& v)
+{
+    size_t mid = v.size() / 2;
+    std::nth_element(v.begin(), v.begin() + mid, v.end());
+    return v[mid];
+}
+
+void StarMetrics::Measure(const usImage *pImg, double x, double y)
+{
+    static const double SkyRadius = 7.0;    // px, pixels beyond this are background
+    static const double StarSigma = 3.0;    // star pixels for the moments are this far above the noise
+
+    enum { HalfBox = BoxSize / 2 };
+
+    Valid = false;
+
+    // same placement as the profile window has always used
+    BoxX = ROUND(x) - HalfBox;
+    BoxY = ROUND(y) - HalfBox;
+    BoxX = wxMax(0, wxMin(BoxX, pImg->Size.GetWidth() - BoxSize - 1));
+    BoxY = wxMax(0, wxMin(BoxY, pImg->Size.GetHeight() - BoxSize - 1));
+
+    Box = wxRect(BoxX, BoxY, BoxSize, BoxSize).Intersect(pImg->DataRect);
+    if (!pImg->Subframe.IsEmpty())
+        Box.Intersect(pImg->Subframe);
+
+    memset(Pixels, 0, sizeof(Pixels));
+
+    if (Box.IsEmpty())
+        return;
+
+    int w = Box.GetWidth();
+    int h = Box.GetHeight();
+    std::vector<double> data(w * h);
+    std::vector<double> sky;
+    sky.reserve(w * h);
+
+    unsigned short peak = 0, near1 = 0, near2 = 0;
+
+    for (int j = 0; j < h; j++)
+    {
+        int py = Box.GetTop() + j;
+        const unsigned short *src = &pImg->Pixel(Box.GetLeft(), py);
+        unsigned short *dst = &Pixels[(py - BoxY) * BoxSize + Box.GetLeft() - BoxX];
+        double *row = &data[j * w];
+        double dy2 = (py - y) * (py - y);
+
+        for (int i = 0; i < w; i++)
+        {
+            unsigned short val = src[i];
+            dst[i] = val;
+            row[i] = (double) val;
+
+            double dx = Box.GetLeft() + i - x;
+            if (dx * dx + dy2 > SkyRadius * SkyRadius)
+                sky.push_back((double) val);
+
+            // the three highest values, for the saturation test
+            if (val > peak)
+                std::swap(val, peak);
+            if (val > near1)
+                std::swap(val, near1);
+            if (val > near2)
+                std::swap(val, near2);
+        }
+    }
+
+    if (sky.size() < 8)
+        return;
+
+    Background = Median(sky);
+    for (std::vector<double>::iterator it = sky.begin(); it != sky.end(); ++it)
+        *it = fabs(*it - Background);
+    Noise = 1.4826 * Median(sky);
+
+    Peak = peak;
+    // same test as Star::Find: flat-topped when the top three values are
+    // within 32 parts per 65535 of the peak
+    Saturated = peak > 0 && (unsigned int)(peak - near2) * 65535U < 32U * (unsigned int) peak;
+
+    HFD = HalfFluxDiameter(&data[0], Box.GetLeft(), Box.GetTop(), w, h, x, y, Background);
+
+    // second moments of the pixels clearly above the background
+    double threshold = Background + StarSigma * wxMax(Noise, 1.0);
+    double m0 = 0.0, mx = 0.0, my = 0.0, mxx = 0.0, myy = 0.0, mxy = 0.0;
+    for (int j = 0; j < h; j++)
+    {
+        double py = Box.GetTop() + j - y;
+        const double *row = &data[j * w];
+        for (int i = 0; i < w; i++)
+        {
+            double v = row[i] - threshold;
+            if (v <= 0.0)
+                continue;
+            double px = Box.GetLeft() + i - x;
+            m0 += v;
+            mx += v * px;
+            my += v * py;
+            mxx += v * px * px;
+            myy += v * py * py;
+            mxy += v * px * py;
+        }
+    }
+
+    Eccentricity = 0.0;
+    if (m0 > 0.0)
+    {
+        mx /= m0;
+        my /= m0;
+        double cxx = mxx / m0 - mx * mx;
+        double cyy = myy / m0 - my * my;
+        double cxy = mxy / m0 - mx * my;
+        double mean = 0.5 * (cxx + cyy);
+        double diff = sqrt(0.25 * (cxx - cyy) * (cxx - cyy) + cxy * cxy);
+        double major = mean + diff;
+        double minor = mean - diff;
+        if (major > 0.0)
+            Eccentricity = sqrt(wxMax(0.0, 1.0 - minor / major));
+    }
+
+    Valid = true;
+}
@@ -0,0 +1,69 @@
+/*
+ *  star_metrics.h
+ *  PHD Guiding
+ *
+ *  Created by the PHD2 developers
+ *  Copyright (c) 2014 PHD2 Developers
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of Craig Stark, Stark Labs nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef STAR_METRICS_INCLUDED
+#define STAR_METRICS_INCLUDED
+
+// Per-frame measurements of the guide star and the sky around it, taken once
+// from a small box around the star and shared by the profile display, the
+// guide log, the event server and the star mass check.
+
+struct StarMetrics
+{
+    enum { BoxSize = 21 };
+
+    bool Valid;
+    wxRect Box;             // the box in image coordinates, clipped to the image data
+    unsigned short Pixels[BoxSize * BoxSize]; // the box, row by row; 0 outside the image data
+    int BoxX, BoxY;         // top-left corner of Pixels in image coordinates
+
+    double Background;      // ADU, median of the pixels away from the star
+    double Noise;           // ADU, robust standard deviation of the background
+    unsigned short Peak;    // ADU
+    bool Saturated;
+    double HFD;             // half-flux diameter (px)
+    double Eccentricity;    // 0 for a round star, approaching 1 when elongated
+
+    StarMetrics(void) : Valid(false) { }
+
+    void Invalidate(void) { Valid = false; }
+    // measure the star centered at (x, y)
+    void Measure(const usImage *pImg, double x, double y);
+};
+
+// diameter of the circle around (cx, cy) enclosing half of the background
+// subtracted flux of the w x h pixels data whose top-left pixel is at (x0, y0)
+extern double HalfFluxDiameter(const double *data, int x0, int y0, int w, int h, double cx, double cy, double bg);
+
+#endif
@@ -48,14 +48,12 @@ ProfileWindow::ProfileWindow(wxWindow *parent) :
     this->visible = false;
     this->mode = 0; // 2D profile
     this->SetBackgroundStyle(wxBG_STYLE_CUSTOM);
-    this->data = new unsigned short[441];  // 21x21 subframe
+    this->hfd = 0.0;
+    for (int i = 0; i < 21; i++)
+        horiz_profile[i] = vert_profile[i] = midrow_profile[i] = 0;
 }
 
 ProfileWindow::~ProfileWindow() {
-    if (this->data) {
-        delete [] this->data;
-        this->data = NULL;
-    }
 }
 
 void ProfileWindow::OnLClick(wxMouseEvent& WXUNUSED(mevent)) {
@@ -70,32 +68,23 @@ void ProfileWindow::SetState(bool is_active) {
         Refresh();
 }
 
-void ProfileWindow::UpdateData(usImage *pImg, float xpos, float ypos) {
-    if (this->data == NULL) return;
-    int xstart = ROUND(xpos) - 10;
-    int ystart = ROUND(ypos) - 10;
-    if (xstart < 0) xstart = 0;
-    else if (xstart > (pImg->Size.GetWidth() - 22))
-        xstart = pImg->Size.GetWidth() - 22;
-    if (ystart < 0) ystart = 0;
-    else if (ystart > (pImg->Size.GetHeight() - 22))
-        ystart = pImg->Size.GetHeight() - 22;
-
+// the profiles are taken from the pixels the guider already gathered for the
+// star metrics, so there is no second pass over the image
+void ProfileWindow::UpdateData(const StarMetrics& metrics) {
     int x,y;
-    unsigned short *uptr = this->data;
-    const int xrowsize = pImg->Size.GetWidth();
+    const unsigned short *uptr = metrics.Pixels;
     for (x=0; x<21; x++)
         horiz_profile[x] = vert_profile[x] = midrow_profile[x] = 0;
     for (y=0; y<21; y++) {
         for (x=0; x<21; x++, uptr++) {
-            *uptr = *(pImg->ImageData + xstart + x + (ystart + y) * xrowsize);
             horiz_profile[x] += (int) *uptr;
             vert_profile[y] += (int) *uptr;
         }
     }
-    uptr = this->data + 210;
+    uptr = metrics.Pixels + 210;
     for (x=0; x<21; x++, uptr++)
         midrow_profile[x] = (int) *uptr;
+    this->hfd = metrics.Valid ? metrics.HFD : 0.0;
     if (this->visible)
         Refresh();
 
@@ -195,8 +184,15 @@ void ProfileWindow::OnPaint(wxPaintEvent& WXUNUSED(evt))
     dc.SetFont(*wxSWISS_FONT);
 #endif
     dc.DrawText(label,5,ysize - 20);
+    int textX = 50;
     if (fwhm != 0)
-        dc.DrawText(wxString::Format(_("FWHM: %.2f"), fwhm),50,ysize - 20);
+    {
+        wxString fwhmText = wxString::Format(_("FWHM: %.2f"), fwhm);
+        dc.DrawText(fwhmText, textX, ysize - 20);
+        textX += dc.GetTextExtent(fwhmText).GetWidth() + 10;
+    }
+    if (hfd != 0)
+        dc.DrawText(wxString::Format(_("HFD: %.2f"), hfd), textX, ysize - 20);
 
     // JBW: draw zoomed guidestar subframe (todo: make constants symbolic)
     wxImage* img = pFrame->pGuider->DisplayedImage();
@@ -47,6 +47,9 @@ static const int DefaultGuideAlgorithm = GUIDE_ALGORITHM_IDENTITY;
 // Time limit for bump to complete. If bump does not complete in this amount of time (seconds),
 // we will pop up a warning message with a suggestion to increase the MaxStepsPerCycle setting
 static const int BumpWarnTime = 240;
+static const unsigned int DriftHistorySize = 30;    // frames used for the drift rate fit
+static const unsigned int DriftMinSamples = 8;
+static const double ContinuousBumpCenteringGain = 0.1;  // fraction of the AO offset removed per frame
 
 StepGuider::StepGuider(void)
 {
@@ -56,6 +59,7 @@ StepGuider::StepGuider(void)
     m_bumpInProgress = false;
     m_bumpTimeoutAlertSent = false;
     m_bumpStepWeight = 1.0;
+    ResetDriftHistory();
 
     wxString prefix = "/" + GetMountClassName();
 
@@ -68,6 +72,8 @@ StepGuider::StepGuider(void)
     double bumpMaxStepsPerCycle = pConfig->Profile.GetDouble(prefix + "/BumpMaxStepsPerCycle", DefaultBumpMaxStepsPerCycle);
     SetBumpMaxStepsPerCycle(bumpMaxStepsPerCycle);
 
+    EnableContinuousBump(pConfig->Profile.GetBoolean(prefix + "/ContinuousBump", false));
+
     int calibrationStepsPerIteration = pConfig->Profile.GetInt(prefix + "/CalibrationStepsPerIteration", DefaultCalibrationStepsPerIteration);
     SetCalibrationStepsPerIteration(calibrationStepsPerIteration);
 
@@ -76,6 +82,8 @@ StepGuider::StepGuider(void)
 
     int yGuideAlgorithm = pConfig->Profile.GetInt(prefix + "/YGuideAlgorithm", DefaultGuideAlgorithm);
     SetYGuideAlgorithm(yGuideAlgorithm);
+
+    SetCentroidFilterEnabled(pConfig->Profile.GetBoolean(prefix + "/CentroidFilter", false));
 }
 
 StepGuider::~StepGuider(void)
@@ -299,6 +307,17 @@ bool StepGuider::SetBumpMaxStepsPerCycle(double bumpStepsPerCycle)
     return bError;
 }
 
+bool StepGuider::IsContinuousBumpEnabled(void) const
+{
+    return m_continuousBump;
+}
+
+void StepGuider::EnableContinuousBump(bool enable)
+{
+    m_continuousBump = enable;
+    pConfig->Profile.SetBoolean("/stepguider/ContinuousBump", m_continuousBump);
+}
+
 int StepGuider::GetCalibrationStepsPerIteration(void)
 {
     return m_calibrationStepsPerIteration;
@@ -741,6 +760,7 @@ bool StepGuider::GuidingCeases(void)
     m_bumpInProgress = false;
     m_bumpStepWeight = 1.0;
     m_bumpTimeoutAlertSent = false;
+    ResetDriftHistory();
     // clear bump display in stepguider graph
     pFrame->pStepGuiderGraph->ShowBump(PHD_Point());
 
@@ -887,6 +907,95 @@ Mount::MOVE_RESULT StepGuider::Move(GUIDE_DIRECTION direction, int steps, bool n
     return result;
 }
 
+// Continuous bumping. Once the mount is being bumped, the AO position by
+// itself no longer shows the mount drift, so the bumps requested so far are
+// added back to recover the uncorrected drift. A least squares line through
+// the recent history gives the drift rate in AO steps per second. Each frame
+// the secondary mount is moved by the drift expected before the next frame
+// plus a small fraction of the current offset, so the AO stays near its
+// center and its travel is left for seeing. The threshold bump remains in
+// place for when the AO still gets too far out.
+
+void StepGuider::ResetDriftHistory(void)
+{
+    m_driftHistory.clear();
+    m_bumpTotal.SetXY(0.0, 0.0);
+    m_driftRate.SetXY(0.0, 0.0);
+    m_driftInterval = 0.0;
+}
+
+void StepGuider::UpdateDriftRate(void)
+{
+    AoDriftSample sample;
+    sample.t = pFrame->pGuider->CurrentPositionTime();
+    sample.pos = PHD_Point((double) m_xOffset, (double) m_yOffset) + m_bumpTotal;
+
+    if (!m_driftHistory.empty() && sample.t <= m_driftHistory.back().t)
+        return;
+
+    m_driftHistory.push_back(sample);
+    if (m_driftHistory.size() > DriftHistorySize)
+        m_driftHistory.erase(m_driftHistory.begin());
+
+    size_t n = m_driftHistory.size();
+    if (n < DriftMinSamples)
+        return;
+
+    double tm = 0.0, xm = 0.0, ym = 0.0;
+    for (size_t i = 0; i < n; i++)
+    {
+        tm += m_driftHistory[i].t;
+        xm += m_driftHistory[i].pos.X;
+        ym += m_driftHistory[i].pos.Y;
+    }
+    tm /= n;
+    xm /= n;
+    ym /= n;
+
+    double stt = 0.0, stx = 0.0, sty = 0.0;
+    for (size_t i = 0; i < n; i++)
+    {
+        double dt = m_driftHistory[i].t - tm;
+        stt += dt * dt;
+        stx += dt * (m_driftHistory[i].pos.X - xm);
+        sty += dt * (m_driftHistory[i].pos.Y - ym);
+    }
+    if (stt <= 0.0)
+        return;
+
+    m_driftRate.SetXY(stx / stt, sty / stt);
+    m_driftInterval = (m_driftHistory.back().t - m_driftHistory.front().t) / (n - 1);
+
+    Debug.AddLine("AO drift rate = (%.3f, %.3f) steps/s, frame interval = %.2fs",
+        m_driftRate.X, m_driftRate.Y, m_driftInterval);
+}
+
+bool StepGuider::ScheduleContinuousBump(void)
+{
+    PHD_Point bumpSteps(m_driftRate.X * m_driftInterval + ContinuousBumpCenteringGain * m_avgOffset.X,
+                        m_driftRate.Y * m_driftInterval + ContinuousBumpCenteringGain * m_avgOffset.Y);
+
+    double maxSteps = m_bumpMaxStepsPerCycle * m_bumpStepWeight;
+    bumpSteps.X = wxMax(-maxSteps, wxMin(maxSteps, bumpSteps.X));
+    bumpSteps.Y = wxMax(-maxSteps, wxMin(maxSteps, bumpSteps.Y));
+
+    PHD_Point vectorEndpoint(xRate() * -bumpSteps.X, yRate() * -bumpSteps.Y);
+    PHD_Point bumpVec;
+
+    if (TransformMountCoordinatesToCameraCoordinates(vectorEndpoint, bumpVec))
+    {
+        return true;
+    }
+
+    Debug.AddLine("Scheduling continuous mount bump of (%.3f, %.3f) for (%.2f, %.2f) AO steps",
+        bumpVec.X, bumpVec.Y, bumpSteps.X, bumpSteps.Y);
+
+    pFrame->ScheduleSecondaryMove(pSecondaryMount, bumpVec, false);
+    m_bumpTotal += bumpSteps;
+
+    return false;
+}
+
 Mount::MOVE_RESULT StepGuider::Move(const PHD_Point& cameraVectorEndpoint, bool normalMove)
 {
     MOVE_RESULT result = MOVE_OK;
@@ -911,6 +1020,11 @@ Mount::MOVE_RESULT StepGuider::Move(const PHD_Point& cameraVectorEndpoint, bool
 
         pFrame->pStepGuiderGraph->AppendData(m_xOffset, m_yOffset, m_avgOffset);
 
+        if (normalMove && m_continuousBump)
+        {
+            UpdateDriftRate();
+        }
+
         // consider bumping the secondary mount if this is a normal move
         if (normalMove && pSecondaryMount && pSecondaryMount->IsConnected())
         {
@@ -1009,18 +1123,29 @@ Mount::MOVE_RESULT StepGuider::Move(const PHD_Point& cameraVectorEndpoint, bool
 
             PHD_Point thisBump(xBumpSize, yBumpSize);
 
+            // the bump in AO steps
+            PHD_Point tcur;
+            TransformCameraCoordinatesToMountCoordinates(thisBump, tcur);
+            tcur.X /= xRate();
+            tcur.Y /= yRate();
+
             // display the current bump vector on the stepguider graph
-            {
-                PHD_Point tcur;
-                TransformCameraCoordinatesToMountCoordinates(thisBump, tcur);
-                tcur.X /= xRate();
-                tcur.Y /= yRate();
-                pFrame->pStepGuiderGraph->ShowBump(tcur);
-            }
+            pFrame->pStepGuiderGraph->ShowBump(tcur);
 
             Debug.AddLine("Scheduling Mount bump of (%.3f, %.3f)", thisBump.X, thisBump.Y);
 
             pFrame->ScheduleSecondaryMove(pSecondaryMount, thisBump, false);
+
+            // the bump moves the AO by -tcur; keep the drift history continuous
+            m_bumpTotal -= tcur;
+        }
+        else if (normalMove && m_continuousBump && pSecondaryMount && pSecondaryMount->IsConnected() &&
+                 !pSecondaryMount->IsBusy())
+        {
+            if (ScheduleContinuousBump())
+            {
+                throw ERROR_INFO("MountToCamera failed");
+            }
         }
     }
     catch (wxString Msg)
@@ -1058,9 +1183,10 @@ wxString StepGuider::GetSettingsSummary()
 {
     // return a loggable summary of current mount settings
     return Mount::GetSettingsSummary() +
-        wxString::Format("Bump percentage = %d, Bump step = %.2f\n",
+        wxString::Format("Bump percentage = %d, Bump step = %.2f, Continuous bump = %s\n",
             GetBumpPercentage(),
-            GetBumpMaxStepsPerCycle()
+            GetBumpMaxStepsPerCycle(),
+            IsContinuousBumpEnabled() ? "yes" : "no"
         );
 }
 
@@ -1155,6 +1281,9 @@ StepGuider::StepGuiderConfigDialogPane::StepGuiderConfigDialogPane(wxWindow *pPa
 
     DoAdd(_("Bump Step"), m_pBumpMaxStepsPerCycle,
         wxString::Format(_("How far should a mount bump move the mount between images (in AO steps). Default = %.2f, decrease if mount bumps cause spikes on the graph"), DefaultBumpMaxStepsPerCycle));
+
+    m_pContinuousBump = new wxCheckBox(pParent, wxID_ANY, _("Continuous bump"));
+    DoAdd(m_pContinuousBump, _("Bump the mount a little every frame to follow the measured drift and keep the AO near its center, instead of waiting for the AO to reach the bump percentage"));
 }
 
 StepGuider::StepGuiderConfigDialogPane::~StepGuiderConfigDialogPane(void)
@@ -1168,6 +1297,7 @@ void StepGuider::StepGuiderConfigDialogPane::LoadValues(void)
     m_pSamplesToAverage->SetValue(m_pStepGuider->GetSamplesToAverage());
     m_pBumpPercentage->SetValue(m_pStepGuider->GetBumpPercentage());
     m_pBumpMaxStepsPerCycle->SetValue(m_pStepGuider->GetBumpMaxStepsPerCycle());
+    m_pContinuousBump->SetValue(m_pStepGuider->IsContinuousBumpEnabled());
 }
 
 void StepGuider::StepGuiderConfigDialogPane::UnloadValues(void)
@@ -1176,6 +1306,7 @@ void StepGuider::StepGuiderConfigDialogPane::UnloadValues(void)
     m_pStepGuider->SetSamplesToAverage(m_pSamplesToAverage->GetValue());
     m_pStepGuider->SetBumpPercentage(m_pBumpPercentage->GetValue(), true);
     m_pStepGuider->SetBumpMaxStepsPerCycle(m_pBumpMaxStepsPerCycle->GetValue());
+    m_pStepGuider->EnableContinuousBump(m_pContinuousBump->GetValue());
 
     MountConfigDialogPane::UnloadValues();
 }
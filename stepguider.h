@@ -36,6 +36,12 @@
 #ifndef STEPGUIDER_H_INCLUDED
 #define STEPGUIDER_H_INCLUDED
 
+struct AoDriftSample
+{
+    double t;       // exposure midpoint, seconds
+    PHD_Point pos;  // AO position plus the bumps made so far, AO steps
+};
+
 class StepGuider : public Mount, public OnboardST4
 {
     int m_samplesToAverage;
@@ -58,6 +64,12 @@ class StepGuider : public Mount, public OnboardST4
     long m_bumpStartTime;
     double m_bumpStepWeight;
 
+    bool m_continuousBump;
+    PHD_Point m_bumpTotal;    // bumps requested since guiding started, AO steps
+    PHD_Point m_driftRate;    // uncorrected drift, AO steps per second
+    double m_driftInterval;   // mean time between frames, seconds
+    std::vector<AoDriftSample> m_driftHistory;
+
     // Calibration variables
     int   m_calibrationStepsPerIteration;
     int   m_calibrationIterations;
@@ -90,6 +102,7 @@ protected:
         wxSpinCtrl *m_pSamplesToAverage;
         wxSpinCtrl *m_pBumpPercentage;
         wxSpinCtrlDouble *m_pBumpMaxStepsPerCycle;
+        wxCheckBox *m_pContinuousBump;
 
         public:
         StepGuiderConfigDialogPane(wxWindow *pParent, StepGuider *pStepGuider);
@@ -108,6 +121,9 @@ protected:
     virtual double GetBumpMaxStepsPerCycle(void);
     virtual bool SetBumpMaxStepsPerCycle(double maxBumpPerCycle);
 
+    bool IsContinuousBumpEnabled(void) const;
+    void EnableContinuousBump(bool enable);
+
     virtual int GetCalibrationStepsPerIteration(void);
     virtual bool SetCalibrationStepsPerIteration(int calibrationStepsPerIteration);
 
@@ -153,6 +169,9 @@ private:
     int CalibrationMoveSize(void);
     int CalibrationTotDistance(void);
     void InitBumpPositions(void);
+    void ResetDriftHistory(void);
+    void UpdateDriftRate(void);
+    bool ScheduleContinuousBump(void);
 
     double CalibrationTime(int nCalibrationSteps);
 protected:
@@ -37,6 +37,10 @@
 
 #ifdef STEPGUIDER_SXAO
 
+#if !defined(__WINDOWS__)
+#define _snprintf snprintf
+#endif
+
 StepGuiderSxAO::StepGuiderSxAO(void)
 {
     m_Name = "SXV-AO";
@@ -170,6 +174,8 @@ bool StepGuiderSxAO::Disconnect(void)
         return true;
     }
 
+    LogAllTimings();
+
     bool bError = false;
 
     try
@@ -188,12 +194,53 @@ bool StepGuiderSxAO::Disconnect(void)
     return bError;
 }
 
+void StepGuiderSxAO::RecordTiming(unsigned char command, const wxStopWatch& swatch)
+{
+    double ms = swatch.TimeInMicro().ToDouble() / 1000.0;
+
+    CommandTiming& t = m_timing[command];
+    ++t.count;
+    t.totalMs += ms;
+    if (ms > t.maxMs)
+        t.maxMs = ms;
+
+    if (t.count >= TimingLogInterval)
+    {
+        LogTiming(command);
+    }
+}
+
+void StepGuiderSxAO::LogTiming(unsigned char command)
+{
+    CommandTiming& t = m_timing[command];
+
+    if (t.count)
+    {
+        Debug.AddLine(wxString::Format("SX AO command '%c': %u round trips, mean %.2f ms, max %.2f ms",
+            command, t.count, t.totalMs / t.count, t.maxMs));
+    }
+
+    t.count = 0;
+    t.totalMs = 0.0;
+    t.maxMs = 0.0;
+}
+
+void StepGuiderSxAO::LogAllTimings(void)
+{
+    for (std::map<unsigned char, CommandTiming>::iterator it = m_timing.begin(); it != m_timing.end(); ++it)
+    {
+        LogTiming(it->first);
+    }
+}
+
 bool StepGuiderSxAO::SendThenReceive(unsigned char sendChar, unsigned char *receivedChar)
 {
     bool bError = false;
 
     try
     {
+        wxStopWatch swatch;
+
         if (m_pSerialPort->Send(&sendChar, 1))
         {
             throw ERROR_INFO("StepGuiderSxAO::SendThenReceive serial send failed");
@@ -203,6 +250,8 @@ bool StepGuiderSxAO::SendThenReceive(unsigned char sendChar, unsigned char *rece
         {
             throw ERROR_INFO("StepGuiderSxAO::SendThenReceive serial receive failed");
         }
+
+        RecordTiming(sendChar, swatch);
     }
     catch (wxString Msg)
     {
@@ -219,6 +268,8 @@ bool StepGuiderSxAO::SendThenReceive(const unsigned char *pBuffer, unsigned int
 
     try
     {
+        wxStopWatch swatch;
+
         if (m_pSerialPort->Send(pBuffer, bufferSize))
         {
             throw ERROR_INFO("StepGuiderSxAO::SendThenReceive serial send failed");
@@ -236,6 +287,8 @@ bool StepGuiderSxAO::SendThenReceive(const unsigned char *pBuffer, unsigned int
                 throw ERROR_INFO("StepGuiderSxAO::step: Error reading another character after 'W'");
             }
         }
+
+        RecordTiming(pBuffer[0], swatch);
     }
     catch (wxString Msg)
     {
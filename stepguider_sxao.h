@@ -44,9 +44,19 @@ class StepGuiderSxAO : public StepGuider
     static const int DefaultTimeout =  1*1000;
     static const int CenterTimeout  = 45*1000;
 
+    static const unsigned int TimingLogInterval = 500;
+
+    struct CommandTiming
+    {
+        unsigned int count;
+        double totalMs;
+        double maxMs;
+    };
+
     wxString m_serialPortName;
     SerialPort *m_pSerialPort;
     int m_maxSteps;
+    std::map<unsigned char, CommandTiming> m_timing; // round-trip times by command
 
 public:
     StepGuiderSxAO(void);
@@ -62,6 +72,10 @@ private:
     virtual int MaxPosition(GUIDE_DIRECTION direction) const;
     virtual bool IsAtLimit(GUIDE_DIRECTION direction, bool *isAtLimit);
 
+    void RecordTiming(unsigned char command, const wxStopWatch& swatch);
+    void LogTiming(unsigned char command);
+    void LogAllTimings(void);
+
     bool SendThenReceive(unsigned char sendChar, unsigned char *receivedChar);
     bool SendThenReceive(const unsigned char *pBuffer, unsigned int bufferSize, unsigned char *receivedChar);
 
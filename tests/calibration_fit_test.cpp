@@ -0,0 +1,155 @@
+/*
+ *  calibration_fit_test.cpp
+ *  PHD Guiding
+ *
+ *  Checks the fast calibration velocity fit and pulse growth, and runs
+ *  them through a simulated West calibration the way Scope does.
+ */
+
+#include "phd.h"
+#include "test.h"
+
+static void TestVelocity(void)
+{
+    CalibrationFit fit;
+    PHD_Point v;
+
+    CHECK(!fit.Velocity(&v));
+    fit.AddSample(0.0, PHD_Point(5.0, 3.0));
+    CHECK(!fit.Velocity(&v));
+
+    // all the samples at the same duration say nothing about the rate
+    fit.AddSample(0.0, PHD_Point(5.1, 3.0));
+    CHECK(!fit.Velocity(&v));
+
+    fit.Reset();
+    CHECK(fit.SampleCount() == 0);
+    for (int i = 0; i < 6; i++)
+    {
+        double t = i * 500.0;
+        fit.AddSample(t, PHD_Point(5.0 + 0.01 * t, 3.0 - 0.005 * t));
+    }
+    CHECK(fit.Velocity(&v));
+    CHECK_NEAR(v.X, 0.01, 1e-12);
+    CHECK_NEAR(v.Y, -0.005, 1e-12);
+
+    // alternating errors in the positions average out of the slope, while
+    // the end points alone would be off by the full error
+    fit.Reset();
+    for (int i = 0; i < 8; i++)
+    {
+        double t = i * 500.0;
+        double e = (i % 2) ? 0.2 : -0.2;
+        fit.AddSample(t, PHD_Point(0.002 * t + e, 0.0));
+    }
+    CHECK(fit.Velocity(&v));
+    CHECK_NEAR(v.X, 0.002, 0.0001);
+}
+
+// a fit of the given number of 500 ms steps moving 0.002 px/ms
+static CalibrationFit Steps(int n)
+{
+    CalibrationFit fit;
+    for (int i = 0; i <= n; i++)
+        fit.AddSample(i * 500.0, PHD_Point(0.002 * i * 500.0, 0.0));
+    return fit;
+}
+
+static void TestNextPulse(void)
+{
+    // no change until the star has clearly moved, or without a fit
+    CHECK(Steps(1).NextPulse(500, 500, 1.0, 25.0, 3, 10.0) == 500);
+    CHECK(CalibrationFit().NextPulse(500, 500, 3.0, 25.0, 3, 10.0) == 500);
+
+    // aim to cover the rest in the steps left, but at most double
+    CHECK(Steps(3).NextPulse(500, 500, 3.0, 25.0, 1, 10.0) == 1000);
+
+    // 22 px to go over 4 steps is 6.05 px, about 3025 ms, within double
+    CHECK_NEAR(Steps(3).NextPulse(2000, 500, 3.0, 25.0, 4, 10.0), 3025, 1);
+
+    // never more than the largest step allowed
+    CHECK(Steps(3).NextPulse(4000, 500, 5.0, 25.0, 1, 8.0) == 4000);
+
+    // 5 px to go in one step
+    CHECK(Steps(3).NextPulse(2000, 500, 20.0, 25.0, 1, 10.0) == 2750);
+
+    // never shorter than the configured pulse
+    CHECK(Steps(3).NextPulse(500, 600, 24.5, 25.0, 1, 10.0) == 600);
+}
+
+// Calibrate West on a mount moving the star rate px per ms at the given
+// angle, with a position error on every frame, starting from the
+// configured pulse. Returns the number of steps and sets the fitted rate
+// and angle and the largest move in one step.
+static int Calibrate(bool fast, double rate, double angle, double *fitRate, double *fitAngle, double *maxStep)
+{
+    static const int minSteps = 4;          // CAL_ALERT_MINSTEPS
+    static const double distCrit = 25.0;
+    static const double maxStepPixels = 7.5;
+    static const int calibrationDuration = 500;
+
+    CalibrationFit fit;
+    TestRandom rng(21);
+
+    PHD_Point start(100.0, 100.0);
+    double total = 0.0;
+    int pulse = calibrationDuration;
+    int steps = 1;
+    *maxStep = 0.0;
+
+    for (;;)
+    {
+        PHD_Point pos(start.X + rate * total * cos(angle) + 0.1 * rng.Normal(),
+            start.Y + rate * total * sin(angle) + 0.1 * rng.Normal());
+        fit.AddSample(total, pos);
+
+        double dist = start.Distance(pos);
+        if (dist >= distCrit || steps > 60)
+            break;
+
+        if (fast)
+        {
+            int stepsLeft = wxMax(1, minSteps - (steps - 1));
+            pulse = fit.NextPulse(pulse, calibrationDuration, dist, distCrit, stepsLeft, maxStepPixels);
+        }
+        *maxStep = wxMax(*maxStep, rate * pulse);
+        total += pulse;
+        steps++;
+    }
+
+    PHD_Point v;
+    fit.Velocity(&v);
+    *fitRate = v.Distance();
+    *fitAngle = v.Angle();
+
+    return steps;
+}
+
+static void TestCalibration(void)
+{
+    static const double rate = 0.0015;      // 7.5 px/s at 1x sidereal and 1"/px
+    static const double angle = M_PI / 6.0;
+
+    double fitRate, fitAngle, maxStep;
+
+    int slow = Calibrate(false, rate, angle, &fitRate, &fitAngle, &maxStep);
+    int fast = Calibrate(true, rate, angle, &fitRate, &fitAngle, &maxStep);
+    printf("calibration steps: fixed %d, fast %d; fitted rate %.5f angle %.2f deg; largest step %.2f px\n",
+        slow, fast, fitRate, fitAngle * 180.0 / M_PI, maxStep);
+
+    CHECK(fast >= 4);
+    CHECK(fast <= slow / 2);
+    // the limit applies to the fitted rate, which is a little off
+    CHECK(maxStep <= 1.05 * 7.5);
+    CHECK_NEAR(fitRate, rate, 0.02 * rate);
+    CHECK_NEAR(fitAngle, angle, 1.0 * M_PI / 180.0);
+}
+
+int main(void)
+{
+    TestVelocity();
+    TestNextPulse();
+    TestCalibration();
+
+    return TEST_RESULT();
+}
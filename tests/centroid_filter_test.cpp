@@ -0,0 +1,197 @@
+/*
+ *  centroid_filter_test.cpp
+ *  PHD Guiding
+ *
+ *  Checks CentroidFilter against synthetic star positions: seeing as white
+ *  noise on the centroid, drift as a constant rate, and guide pulses as
+ *  known steps, the way Mount::Move feeds it.
+ */
+
+#include "phd.h"
+#include "test.h"
+
+static const double Interval = 2.0;         // seconds between exposures
+static const double Latency = 1.5;          // exposure midpoint to guide pulse
+
+static void TestValidity(void)
+{
+    CentroidFilter filter;
+    CHECK(!filter.IsValid());
+
+    filter.Measure(10.0, 0.7);
+    CHECK(filter.IsValid());
+    CHECK_NEAR(filter.Predict(10.0), 0.7, 1e-12);
+    CHECK_NEAR(filter.Predict(12.0), 0.7, 1e-12);
+
+    filter.Reset();
+    CHECK(!filter.IsValid());
+}
+
+// a stationary star: the noise estimate converges on the seeing and the
+// filtered position is much steadier than the raw centroids
+static void TestSeeing(void)
+{
+    static const double sigma = 0.3;
+
+    CentroidFilter filter;
+    TestRandom rng(11);
+
+    double sumRaw = 0.0, sumFilt = 0.0, sumRate = 0.0, sumNoise = 0.0;
+    int n = 0;
+
+    for (int i = 0; i < 600; i++)
+    {
+        double const t = i * Interval;
+        double const x = 0.5 + sigma * rng.Normal();
+        filter.Measure(t, x);
+
+        if (i >= 100)
+        {
+            double const e = filter.Predict(t) - 0.5;
+            sumRaw += (x - 0.5) * (x - 0.5);
+            sumFilt += e * e;
+            sumRate += filter.Rate();
+            sumNoise += filter.MeasurementNoise();
+            n++;
+        }
+    }
+
+    double const rmsRaw = sqrt(sumRaw / n);
+    double const rmsFilt = sqrt(sumFilt / n);
+    printf("seeing: raw rms %.4f px, filtered rms %.4f px, mean estimated noise %.4f px\n",
+        rmsRaw, rmsFilt, sumNoise / n);
+
+    CHECK_NEAR(sumNoise / n, rmsRaw, 0.15 * rmsRaw);
+    CHECK(rmsFilt < 0.6 * rmsRaw);
+    CHECK_NEAR(sumRate / n, 0.0, 0.002);
+}
+
+// a drifting star: the filter learns the rate and its prediction for the
+// time of the pulse has no lag, unlike the centroid from mid-exposure
+static void TestDrift(void)
+{
+    static const double sigma = 0.25;
+    static const double rate = 0.02;        // px per second
+
+    CentroidFilter filter;
+    TestRandom rng(12);
+
+    double sumRaw = 0.0, sumPred = 0.0, sumRate = 0.0;
+    int n = 0;
+
+    for (int i = 0; i < 600; i++)
+    {
+        double const t = i * Interval;
+        filter.Measure(t, rate * t + sigma * rng.Normal());
+
+        if (i >= 100)
+        {
+            sumRate += filter.Rate();
+            double const truth = rate * (t + Latency);
+            double const lag = rate * t - truth;
+            double const e = filter.Predict(t + Latency) - truth;
+            sumRaw += lag * lag + sigma * sigma;
+            sumPred += e * e;
+            n++;
+        }
+    }
+
+    double const rmsRaw = sqrt(sumRaw / n);
+    double const rmsPred = sqrt(sumPred / n);
+    printf("drift: raw rms %.4f px, predicted rms %.4f px, mean rate %.4f px/s\n",
+        rmsRaw, rmsPred, sumRate / n);
+
+    CHECK_NEAR(sumRate / n, rate, 0.002);
+    CHECK(rmsPred < 0.7 * rmsRaw);
+}
+
+// Guide a drifting star, correcting a fraction of either the raw centroid
+// or the filtered offset predicted for the time of the pulse. Returns the
+// mean and RMS of the star's true offset once settled.
+static void Guide(bool filtered, double *mean, double *rms)
+{
+    static const double sigma = 0.25;
+    static const double rate = 0.02;
+    static const double aggressiveness = 0.7;
+
+    CentroidFilter filter;
+    TestRandom rng(13);
+
+    double offset = 0.0;
+    double sum = 0.0, sum2 = 0.0;
+    int n = 0;
+
+    for (int i = 0; i < 900; i++)
+    {
+        double const t = i * Interval;
+        double const measured = offset + sigma * rng.Normal();
+        filter.Measure(t, measured);
+
+        double const pulse = t + Latency;
+        offset += rate * Latency;
+        double const correction = (filtered ? filter.Predict(pulse) : measured) * aggressiveness;
+        filter.Correct(pulse, correction);
+        offset -= correction;
+        offset += rate * (Interval - Latency);
+
+        if (i >= 300)
+        {
+            sum += offset;
+            sum2 += offset * offset;
+            n++;
+        }
+    }
+
+    *mean = sum / n;
+    *rms = sqrt(sum2 / n - *mean * *mean);
+}
+
+// a guide pulse moves the estimate by the amount corrected, and guiding on
+// the predicted offset holds a drifting star on the lock position more
+// steadily than guiding on the raw centroids
+static void TestCorrections(void)
+{
+    CentroidFilter filter;
+    filter.Measure(0.0, 1.0);
+    filter.Measure(Interval, 1.0);
+    filter.Correct(Interval + Latency, 0.6);
+    CHECK_NEAR(filter.Predict(Interval + Latency), 0.4, 1e-9);
+
+    double rawMean, rawRms, mean, rms;
+    Guide(false, &rawMean, &rawRms);
+    Guide(true, &mean, &rms);
+    printf("guiding: raw mean %.4f rms %.4f px, filtered mean %.4f rms %.4f px\n",
+        rawMean, rawRms, mean, rms);
+
+    CHECK_NEAR(mean, 0.0, 0.05);
+    CHECK(fabs(mean) < fabs(rawMean));
+    CHECK(rms < 0.9 * rawRms);
+}
+
+// a real jump in position is followed within a couple of frames rather
+// than being averaged away as seeing
+static void TestJump(void)
+{
+    CentroidFilter filter;
+    TestRandom rng(14);
+
+    int i = 0;
+    for (; i < 200; i++)
+        filter.Measure(i * Interval, 0.1 * rng.Normal());
+
+    for (int j = 0; j < 2; j++, i++)
+        filter.Measure(i * Interval, 3.0 + 0.1 * rng.Normal());
+
+    CHECK_NEAR(filter.Predict((i - 1) * Interval), 3.0, 0.5);
+}
+
+int main(void)
+{
+    TestValidity();
+    TestSeeing();
+    TestDrift();
+    TestCorrections();
+    TestJump();
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,158 @@
+/*
+ *  json_writer_test.cpp
+ *  PHD Guiding
+ *
+ *  Checks the event server's JSON writer output and measures how many
+ *  GuideStep events per second it can serialize, with the buffer reused
+ *  for every event as the event server does and with a new buffer for
+ *  each event for comparison.
+ */
+
+#include "phd.h"
+#include "test.h"
+
+static const int BenchEvents = 200000;
+
+static void TestValues(void)
+{
+    JBuf buf;
+    std::vector<int> vec;
+    vec.push_back(1);
+    vec.push_back(-2);
+    wxString str("xyz");
+
+    JObj j(buf);
+    j << NV("i", 42)
+      << NV("d", 0.1)
+      << NV("f", 1.23456, 3)
+      << NV("s", "a\"b\n")
+      << NV("w", str)
+      << NV("b", true)
+      << NV("n", NULL_TYPE())
+      << NV("p", PHD_Point(1.5, -2.25))
+      << NV("q", wxPoint(3, -4))
+      << NV("v", vec);
+
+    CHECK(j.str() == "{\"i\":42,\"d\":0.1,\"f\":1.235,\"s\":\"a\\\"b\\n\",\"w\":\"xyz\",\"b\":true,"
+        "\"n\":null,\"p\":[1.50,-2.25],\"q\":[3,-4],\"v\":[1,-2]}");
+}
+
+static void TestNesting(void)
+{
+    JBuf buf;
+
+    JObj top(buf);
+    top << NV("a", 1);
+    {
+        JAry ary(top, "list");
+        {
+            JObj e(ary);
+            e << NV("x", 1);
+        }
+        {
+            JObj e(ary);
+        }
+        ary << 2;
+    }
+    top << NV("z", false);
+
+    CHECK(top.str() == "{\"a\":1,\"list\":[{\"x\":1},{},2],\"z\":false}");
+}
+
+// a top-level object starts its buffer over and keeps the storage
+static void TestReuse(void)
+{
+    JBuf buf;
+
+    {
+        JObj j(buf);
+        j << NV("first", "a longer message than the second one");
+        CHECK(j.str() == "{\"first\":\"a longer message than the second one\"}");
+    }
+
+    const char *storage = buf.data();
+
+    {
+        JObj j(buf);
+        j << NV("second", 2);
+        CHECK(j.str() == "{\"second\":2}");
+    }
+
+    CHECK(buf.data() == storage);
+}
+
+// the fields of a typical GuideStep event
+static void GuideStep(JObj& ev, int frame, const wxString& host, const wxString& mount)
+{
+    double t = frame * 2.5;
+
+    ev << NV("Event", "GuideStep")
+       << NV("Timestamp", 1400000000.0 + t, 3)
+       << NV("Host", host)
+       << NV("Inst", 1)
+       << NV("Frame", frame)
+       << NV("Time", t, 3)
+       << NV("Mount", mount)
+       << NV("dx", 0.123 * (frame % 7), 3)
+       << NV("dy", -0.456 * (frame % 5), 3)
+       << NV("RADistanceRaw", 0.21 * (frame % 3), 3)
+       << NV("DECDistanceRaw", -0.33 * (frame % 4), 3)
+       << NV("RADistanceGuide", 0.2 * (frame % 3), 3)
+       << NV("DECDistanceGuide", -0.3 * (frame % 4), 3)
+       << NV("RADuration", 120 + frame % 50)
+       << NV("RADirection", "West")
+       << NV("DECDuration", 80 + frame % 30)
+       << NV("DECDirection", "North")
+       << NV("StarMass", 12345.6 + frame, 0)
+       << NV("SNR", 45.67, 2)
+       << NV("AvgDist", 0.34, 2)
+       << NV("HFD", 2.71, 2);
+}
+
+static double EventsPerSec(int events, long ms)
+{
+    return ms > 0 ? events * 1000.0 / ms : 0.0;
+}
+
+static void BenchGuideStep(void)
+{
+    wxString host("observatory");
+    wxString mount("On Camera");
+    size_t bytes = 0;
+
+    JBuf scratch;
+    wxStopWatch reused;
+    for (int i = 0; i < BenchEvents; i++)
+    {
+        JObj ev(scratch);
+        GuideStep(ev, i, host, mount);
+        bytes += ev.buf().len();
+    }
+    long reusedMs = reused.Time();
+
+    wxStopWatch fresh;
+    for (int i = 0; i < BenchEvents; i++)
+    {
+        JBuf buf;
+        JObj ev(buf);
+        GuideStep(ev, i, host, mount);
+        bytes -= ev.buf().len();
+    }
+    long freshMs = fresh.Time();
+
+    // both ways produce the same events
+    CHECK(bytes == 0);
+
+    printf("GuideStep events/sec: %.0f reusing the buffer, %.0f with a new buffer per event\n",
+        EventsPerSec(BenchEvents, reusedMs), EventsPerSec(BenchEvents, freshMs));
+}
+
+int main(void)
+{
+    TestValues();
+    TestNesting();
+    TestReuse();
+    BenchGuideStep();
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,172 @@
+/*
+ *  pe_predictor_test.cpp
+ *  PHD Guiding
+ *
+ *  Drives PEPredictor with the RA motion the camera simulator produces with
+ *  its default settings, without the simulator or any of the UI.
+ */
+
+#include "phd.h"
+#include "test.h"
+
+// the simulator's canned periodic error terms (cam_simulator.cpp), arc-sec
+static const double PEPeriod[] = { 230.5, 122.0, 49.4, 9.56, 76.84 };
+static const double PEAmp[] = { 2.02, 0.69, 0.22, 0.137, 0.14 };
+static const double PEPhase[] = { 0.0, 1.4, 98.8, 35.9, 150.4 };
+static const int NumPETerms = sizeof(PEPeriod) / sizeof(PEPeriod[0]);
+
+// simulator defaults: 5 arc-sec PE, 2 arc-sec FWHM seeing, at 1 arc-sec/px
+static const double PEScale = 5.0 / 4.85;
+static const double SeeingSigma = 2.0 / (2.345 * 1.4 * 2.4);
+
+static const double Interval = 2.0;         // seconds between guide steps
+
+// the simulated PE, optionally only its terms with periods of at least
+// minPeriod seconds
+static double SimPE(double t, double minPeriod = 0.0)
+{
+    double pe = 0.0;
+    for (int i = 0; i < NumPETerms; i++)
+        if (PEPeriod[i] >= minPeriod)
+            pe += PEAmp[i] * cos((t - PEPhase[i]) / PEPeriod[i] * 2.0 * M_PI);
+    return pe * PEScale;
+}
+
+// feed an hour of unguided motion and check the model finds the worm period
+static void TestFindsWormPeriod(void)
+{
+    PEPredictor predictor;
+    TestRandom rng(1);
+
+    double t = 0.0;
+    for (; t < 3600.0; t += Interval)
+    {
+        predictor.AddSample(t, SimPE(t) + SeeingSigma * rng.Normal());
+        predictor.Fit();
+    }
+
+    CHECK(predictor.IsValid());
+    CHECK(predictor.NumTerms() >= 1);
+    if (!predictor.IsValid() || predictor.NumTerms() < 1)
+        return;
+
+    CHECK_NEAR(predictor.TermPeriod(0), 230.5, 230.5 * 0.01);
+    CHECK_NEAR(predictor.TermAmplitude(0), 2.02 * PEScale, 2.02 * PEScale * 0.1);
+
+    // over the next ten minutes the model should account for most of the
+    // motion from one guide step to the next, apart from the 9.56 s term,
+    // which is too fast to be worth modeling
+    double sumErr = 0.0, sumMove = 0.0;
+    int n = 0;
+    for (double t0 = t; t0 < t + 600.0; t0 += Interval, n++)
+    {
+        double const move = SimPE(t0 + Interval, 60.0) - SimPE(t0, 60.0);
+        double const err = predictor.Predict(t0, t0 + Interval) - move;
+        sumMove += move * move;
+        sumErr += err * err;
+    }
+    double const rmsMove = sqrt(sumMove / n);
+    double const rmsErr = sqrt(sumErr / n);
+    printf("step motion rms %.4f px, prediction error rms %.4f px\n", rmsMove, rmsErr);
+    CHECK(rmsErr < 0.25 * rmsMove);
+}
+
+// with a known worm period the model fits it and its harmonics once a full
+// cycle has been seen
+static void TestFixedPeriod(void)
+{
+    PEPredictor predictor;
+    predictor.SetPeriod(230.5);
+    TestRandom rng(2);
+
+    double t = 0.0;
+    for (; t < 200.0; t += Interval)
+    {
+        predictor.AddSample(t, SimPE(t) + SeeingSigma * rng.Normal());
+        predictor.Fit();
+    }
+    CHECK(!predictor.IsValid());
+
+    for (; t < 1200.0; t += Interval)
+    {
+        predictor.AddSample(t, SimPE(t) + SeeingSigma * rng.Normal());
+        predictor.Fit();
+    }
+    CHECK(predictor.IsValid());
+    CHECK(predictor.NumTerms() == PEPredictor::MaxTerms);
+    CHECK_NEAR(predictor.TermPeriod(0), 230.5, 1e-9);
+    CHECK_NEAR(predictor.TermPeriod(1), 230.5 / 2.0, 1e-9);
+    CHECK_NEAR(predictor.TermAmplitude(0), 2.02 * PEScale, 2.02 * PEScale * 0.1);
+
+    predictor.Reset();
+    CHECK(!predictor.IsValid());
+    CHECK(predictor.SampleCount() == 0);
+}
+
+// Closed loop guiding of the simulated RA axis, following
+// GuideAlgorithmPredictivePE::result(): a proportional correction of the
+// measured offset, plus the motion the model expects before the next step.
+// The mount moves at most maxMove per step and the model is told what was
+// actually moved, as Mount::Move does. Returns the RMS of the star's true
+// offset, without the seeing, over the second hour.
+static double GuideRMS(bool predictive, double maxMove)
+{
+    static const double aggressiveness = 0.7;
+    static const double predictionGain = 0.8;
+    static const double minMove = 0.2;
+
+    PEPredictor predictor;
+    TestRandom rng(3);
+
+    double corrected = 0.0;
+    double sum2 = 0.0;
+    int n = 0;
+
+    for (double t = 0.0; t < 7200.0; t += Interval)
+    {
+        double const offset = SimPE(t) - corrected;
+        double const input = offset + SeeingSigma * rng.Normal();
+
+        predictor.AddSample(t, input + corrected);
+        predictor.Fit();
+
+        double correction = 0.0;
+        if (fabs(input) >= minMove)
+            correction = input * aggressiveness;
+        if (predictive && predictor.IsValid())
+            correction += predictor.Predict(t, t + Interval) * predictionGain;
+
+        correction = wxMax(-maxMove, wxMin(maxMove, correction));
+        corrected += correction;
+
+        if (t >= 3600.0)
+        {
+            sum2 += offset * offset;
+            n++;
+        }
+    }
+
+    return sqrt(sum2 / n);
+}
+
+static void TestGuiding(void)
+{
+    double const reactive = GuideRMS(false, 10.0);
+    double const predictive = GuideRMS(true, 10.0);
+    printf("guiding rms: reactive %.4f px, predictive %.4f px\n", reactive, predictive);
+    CHECK(predictive < 0.9 * reactive);
+
+    // corrections clamped by the mount must not throw the model off
+    double const clamped = GuideRMS(true, 0.3);
+    printf("guiding rms with 0.3 px max move: predictive %.4f px\n", clamped);
+    CHECK(clamped < 1.1 * predictive);
+}
+
+int main(void)
+{
+    TestFindsWormPeriod();
+    TestFixedPeriod();
+    TestGuiding();
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,139 @@
+/*
+ *  phd.h
+ *  PHD Guiding
+ *
+ *  Stand-in for the application's phd.h when building the unit tests.
+ *  It provides just enough of the environment for the components under
+ *  test: a few wxWidgets helpers, a wxString that is a std::string, and
+ *  a debug log that discards everything.
+ */
+
+#ifndef PHD_H_INCLUDED
+#define PHD_H_INCLUDED
+
+#define _USE_MATH_DEFINES
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <wchar.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define wxMin(a, b) (((a) < (b)) ? (a) : (b))
+#define wxMax(a, b) (((a) > (b)) ? (a) : (b))
+#define WXSIZEOF(array) (sizeof(array) / sizeof(array[0]))
+
+#define POSSIBLY_UNUSED(x) (void)(x)
+#define ERROR_INFO(s) wxString(s)
+
+// what wxString::wc_str() returns
+class wxWCharBuffer
+{
+    std::wstring m_s;
+
+public:
+    wxWCharBuffer(const std::wstring& s) : m_s(s) { }
+    operator const wchar_t *(void) const { return m_s.c_str(); }
+};
+
+// the characters are bytes, so only ASCII converts to wide characters
+// correctly
+class wxString : public std::string
+{
+    template<typename T> static T Arg(T t) { return t; }
+    static const char *Arg(const wxString& s) { return s.c_str(); }
+
+public:
+    wxString(void) { }
+    wxString(const char *s) : std::string(s) { }
+    wxString(const std::string& s) : std::string(s) { }
+
+    const char *mb_str(void) const { return c_str(); }
+    wxWCharBuffer wc_str(void) const { return std::wstring(begin(), end()); }
+    bool IsEmpty(void) const { return empty(); }
+
+    static wxString FromUTF8(const char *s, size_t len) { return wxString(std::string(s, len)); }
+
+    template<typename... Args> static wxString Format(const char *format, Args... args)
+    {
+        char buf[1024];
+        snprintf(buf, sizeof(buf), format, Arg(args)...);
+        return wxString(buf);
+    }
+};
+
+class wxArrayString : public std::vector<wxString>
+{
+public:
+    void Add(const wxString& s) { push_back(s); }
+    void Sort(void) { std::sort(begin(), end()); }
+};
+
+#define WX_APPEND_ARRAY(dst, src) (dst).insert((dst).end(), (src).begin(), (src).end())
+
+class wxStopWatch
+{
+    struct timespec m_start;
+
+public:
+    wxStopWatch(void) { clock_gettime(CLOCK_MONOTONIC, &m_start); }
+
+    long Time(void) const
+    {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return (now.tv_sec - m_start.tv_sec) * 1000 + (now.tv_nsec - m_start.tv_nsec) / 1000000;
+    }
+};
+
+struct wxPoint
+{
+    int x, y;
+    wxPoint(int x_, int y_) : x(x_), y(y_) { }
+};
+
+typedef long long wxLongLong_t;
+
+class wxLongLong
+{
+    wxLongLong_t m_value;
+
+public:
+    wxLongLong(wxLongLong_t value) : m_value(value) { }
+    wxLongLong_t GetValue(void) const { return m_value; }
+    double ToDouble(void) const { return (double) m_value; }
+};
+
+inline wxLongLong wxGetUTCTimeMillis(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return wxLongLong(now.tv_sec * 1000LL + now.tv_nsec / 1000000);
+}
+
+class DebugLog
+{
+public:
+    template<typename... Args> void AddLine(const char *format, Args... args) { }
+    void AddLine(const wxString& str) { }
+    void AddBytes(const wxString& str, const unsigned char *pBytes, unsigned count) { }
+};
+
+extern DebugLog Debug;     // defined in test.h
+
+#include "point.h"
+#include "guiding_analyzer.h"
+#include "centroid_filter.h"
+#include "calibration_fit.h"
+#include "serialports.h"
+#include "json_writer.h"
+
+#endif /* PHD_H_INCLUDED */
@@ -0,0 +1,239 @@
+/*
+ *  serialport_posix_test.cpp
+ *  PHD Guiding
+ *
+ *  Runs SerialPortPosix against an SX AO emulator on the other end of a
+ *  pseudo-terminal, so the termios setup, the poll() based timeouts and
+ *  the reassembly of replies that arrive in pieces are exercised without
+ *  any hardware.
+ */
+
+#include "phd.h"
+#include "test.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+static const int BulkSize = 2000;
+
+static bool ReadExact(int fd, unsigned char *buf, size_t count)
+{
+    while (count > 0)
+    {
+        ssize_t n = read(fd, buf, count);
+        if (n <= 0)
+            return false;
+        buf += n;
+        count -= n;
+    }
+    return true;
+}
+
+static void Reply(int fd, const char *s)
+{
+    if (write(fd, s, strlen(s)) < 0)
+        perror("emulator write");
+}
+
+// The emulated SX AO. Single character commands are answered the way the
+// firmware does; 'V' answers in pieces, as a USB adapter may deliver them.
+// 'G' and 'M' take a direction and a five digit count and answer 'L' past
+// the travel limit. 'B' is followed by BulkSize bytes and answered with
+// their sum. 'Q' hangs up, and anything else gets no answer at all.
+struct SxAOEmulator
+{
+    int fd;
+    std::string longCommand;        // the last 'G' or 'M' command received
+
+    static void *Run(void *arg)
+    {
+        SxAOEmulator *emu = (SxAOEmulator *) arg;
+        unsigned char cmd;
+
+        while (ReadExact(emu->fd, &cmd, 1))
+        {
+            switch (cmd)
+            {
+                case 'V':
+                    Reply(emu->fd, "V");
+                    usleep(20000);
+                    Reply(emu->fd, "1");
+                    usleep(20000);
+                    Reply(emu->fd, "05");
+                    break;
+
+                case 'K':
+                case 'R':
+                    Reply(emu->fd, "K");
+                    break;
+
+                case 'G':
+                case 'M':
+                {
+                    unsigned char buf[7] = { cmd };
+                    if (!ReadExact(emu->fd, buf + 1, 6))
+                        return 0;
+                    emu->longCommand.assign((const char *) buf, 7);
+                    char reply[2] = { atoi((const char *) buf + 2) > 50 ? 'L' : (char) cmd, 0 };
+                    Reply(emu->fd, reply);
+                    break;
+                }
+
+                case 'B':
+                {
+                    std::vector<unsigned char> buf(BulkSize);
+                    if (!ReadExact(emu->fd, &buf[0], BulkSize))
+                        return 0;
+                    unsigned int sum = 0;
+                    for (int i = 0; i < BulkSize; i++)
+                        sum += buf[i];
+                    char reply[2] = { (char) (sum & 0xff), 0 };
+                    if (write(emu->fd, reply, 1) < 0)
+                        perror("emulator write");
+                    break;
+                }
+
+                case 'Q':
+                    close(emu->fd);
+                    emu->fd = -1;
+                    return 0;
+
+                default:
+                    break;
+            }
+        }
+
+        return 0;
+    }
+};
+
+static bool SendThenReceive(SerialPort& port, const char *cmd, unsigned char *reply, unsigned int count)
+{
+    return port.Send((const unsigned char *) cmd, strlen(cmd)) || port.Receive(reply, count);
+}
+
+// the pseudo-terminal is not a serial device and must not be offered
+static void TestPortList(SerialPortPosix& port, const wxString& device)
+{
+    wxArrayString ports = port.GetSerialPortList();
+    for (size_t i = 0; i < ports.size(); i++)
+    {
+        CHECK(ports[i].compare(0, 8, "/dev/tty") == 0);
+        CHECK(ports[i] != device);
+    }
+}
+
+static void TestConnect(SerialPort& port, const char *device)
+{
+    CHECK(port.Connect("/dev/phd2-no-such-port", 9600, 8, 1, SerialPort::ParityNone, false, false));
+    CHECK(port.Connect(device, 12345, 8, 1, SerialPort::ParityNone, false, false));
+    CHECK(port.Connect(device, 9600, 9, 1, SerialPort::ParityNone, false, false));
+    CHECK(!port.Connect(device, 9600, 8, 1, SerialPort::ParityNone, false, false));
+    // a second connect must not leak or replace the open port
+    CHECK(port.Connect(device, 9600, 8, 1, SerialPort::ParityNone, false, false));
+}
+
+static void TestCommands(SerialPort& port, SxAOEmulator& emu)
+{
+    unsigned char buf[4];
+
+    // the firmware version arrives in three pieces
+    CHECK(!SendThenReceive(port, "V", buf, 4));
+    CHECK(memcmp(buf, "V105", 4) == 0);
+
+    CHECK(!SendThenReceive(port, "K", buf, 1));
+    CHECK(buf[0] == 'K');
+
+    CHECK(!SendThenReceive(port, "GN00010", buf, 1));
+    CHECK(buf[0] == 'G');
+    CHECK(emu.longCommand == "GN00010");
+
+    CHECK(!SendThenReceive(port, "MW00099", buf, 1));
+    CHECK(buf[0] == 'L');
+    CHECK(emu.longCommand == "MW00099");
+}
+
+// a send larger than the terminal buffers, which has to wait for room
+static void TestBulk(SerialPort& port)
+{
+    std::vector<unsigned char> data(BulkSize + 1);
+    data[0] = 'B';
+    unsigned int sum = 0;
+    for (int i = 1; i <= BulkSize; i++)
+    {
+        data[i] = (unsigned char) (i * 7);
+        sum += data[i];
+    }
+
+    unsigned char reply;
+    CHECK(!port.Send(&data[0], data.size()));
+    CHECK(!port.Receive(&reply, 1));
+    CHECK(reply == (sum & 0xff));
+}
+
+static void TestTimeout(SerialPort& port)
+{
+    CHECK(!port.SetReceiveTimeout(200));
+
+    unsigned char buf[1];
+    wxStopWatch swatch;
+    CHECK(SendThenReceive(port, "X", buf, 1));
+    long elapsed = swatch.Time();
+    printf("receive timed out after %ld ms\n", elapsed);
+    CHECK(elapsed >= 190 && elapsed < 1000);
+
+    // the port still works after a timeout
+    CHECK(!SendThenReceive(port, "R", buf, 1));
+    CHECK(buf[0] == 'K');
+}
+
+// when the device goes away a receive fails at once instead of waiting out
+// the timeout
+static void TestHangup(SerialPort& port, pthread_t thread)
+{
+    CHECK(!port.SetReceiveTimeout(2000));
+
+    unsigned char buf[1];
+    CHECK(!port.Send((const unsigned char *) "Q", 1));
+    pthread_join(thread, 0);
+
+    wxStopWatch swatch;
+    CHECK(port.Receive(buf, 1));
+    long elapsed = swatch.Time();
+    printf("receive failed %ld ms after hangup\n", elapsed);
+    CHECK(elapsed < 500);
+}
+
+int main(void)
+{
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) || unlockpt(master))
+    {
+        perror("posix_openpt");
+        return 1;
+    }
+    wxString device(ptsname(master));
+
+    SerialPortPosix port;
+    TestPortList(port, device);
+    TestConnect(port, device.c_str());
+
+    SxAOEmulator emu;
+    emu.fd = master;
+    pthread_t thread;
+    pthread_create(&thread, 0, SxAOEmulator::Run, &emu);
+
+    TestCommands(port, emu);
+    TestBulk(port);
+    TestTimeout(port);
+    TestHangup(port, thread);
+
+    CHECK(!port.Disconnect());
+    unsigned char c = 'K';
+    CHECK(port.Send(&c, 1));
+    CHECK(port.Receive(&c, 1));
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,72 @@
+/*
+ *  test.h
+ *  PHD Guiding
+ *
+ *  Minimal checks for the unit tests. A failed check is reported and the
+ *  test carries on, so one run shows every failure; TEST_RESULT() makes the
+ *  exit status nonzero if any check failed.
+ */
+
+#ifndef TEST_H_INCLUDED
+#define TEST_H_INCLUDED
+
+#include <stdio.h>
+
+static int s_testFailures;
+
+DebugLog Debug;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) \
+        { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            ++s_testFailures; \
+        } \
+    } while (0)
+
+#define CHECK_NEAR(a, b, tol) \
+    do { \
+        double const a_ = (a); \
+        double const b_ = (b); \
+        if (!(fabs(a_ - b_) <= (tol))) \
+        { \
+            fprintf(stderr, "%s:%d: check failed: %s = %g, expected %g +/- %g\n", __FILE__, __LINE__, #a, a_, b_, (double) (tol)); \
+            ++s_testFailures; \
+        } \
+    } while (0)
+
+#define TEST_RESULT() (s_testFailures ? 1 : 0)
+
+// deterministic normal deviates, so every run sees the same seeing
+class TestRandom
+{
+    unsigned int m_state;
+    bool m_haveSpare;
+    double m_spare;
+
+public:
+    TestRandom(unsigned int seed) : m_state(seed), m_haveSpare(false), m_spare(0.0) { }
+
+    double Uniform(void)
+    {
+        m_state = m_state * 1664525u + 1013904223u;
+        return ((m_state >> 8) + 0.5) / 16777216.0;
+    }
+
+    double Normal(void)
+    {
+        if (m_haveSpare)
+        {
+            m_haveSpare = false;
+            return m_spare;
+        }
+        double const r = sqrt(-2.0 * log(Uniform()));
+        double const theta = 2.0 * M_PI * Uniform();
+        m_spare = r * sin(theta);
+        m_haveSpare = true;
+        return r * cos(theta);
+    }
+};
+
+#endif /* TEST_H_INCLUDED */
@@ -0,0 +1,50 @@
+/*
+ *  wx/dir.h
+ *  PHD Guiding
+ *
+ *  Stand-in for wxDir when building the unit tests, enough to list the
+ *  files in a directory that match a wildcard.
+ */
+
+#ifndef WX_DIR_H_INCLUDED
+#define WX_DIR_H_INCLUDED
+
+#include <dirent.h>
+#include <fnmatch.h>
+
+enum { wxDIR_FILES = 1 };
+
+class wxDir
+{
+    DIR *m_dir;
+    wxString m_pattern;
+
+public:
+    wxDir(const wxString& path) : m_dir(opendir(path.c_str())) { }
+    ~wxDir(void) { if (m_dir) closedir(m_dir); }
+
+    bool IsOpened(void) const { return m_dir != 0; }
+
+    bool GetFirst(wxString *name, const wxString& pattern, int flags)
+    {
+        m_pattern = pattern;
+        rewinddir(m_dir);
+        return GetNext(name);
+    }
+
+    bool GetNext(wxString *name)
+    {
+        struct dirent *ent;
+        while ((ent = readdir(m_dir)) != 0)
+        {
+            if (fnmatch(m_pattern.c_str(), ent->d_name, 0) == 0)
+            {
+                *name = ent->d_name;
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+#endif /* WX_DIR_H_INCLUDED */
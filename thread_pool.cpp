@@ -0,0 +1,237 @@
+/*
+ *  thread_pool.cpp
+ *  PHD Guiding
+ *
+ *  Created by the PHD2 developers
+ *  Copyright (c) 2014 PHD2 Developers
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of Craig Stark, Stark Labs nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "phd.h"
+
+#include <algorithm>
+
+// Each parallel_for is split into a few bands per thread. Threads take the
+// next band from a shared counter until none are left, so a thread that
+// finishes early picks up work that would otherwise wait for a slow one.
+static const int BandsPerThread = 4;
+static const int MaxThreads = 32;
+
+class PoolThread;
+
+struct PoolState
+{
+    wxMutex lock;
+    wxCondition workReady;
+    wxCondition workDone;
+    wxMutex callLock;           // one parallel_for at a time uses the pool
+
+    std::vector<PoolThread *> threads;
+    bool stopping;
+    unsigned int generation;    // incremented for each parallel_for
+
+    ParallelBody *body;
+    int next;
+    int end;
+    int band;
+    int active;                 // pool threads still working on the current job
+
+    PoolState()
+        : workReady(lock),
+          workDone(lock),
+          stopping(false),
+          generation(0),
+          body(0),
+          next(0),
+          end(0),
+          band(1),
+          active(0)
+    {
+    }
+
+    void RunBands(void);
+    void ThreadLoop(void);
+};
+
+static PoolState *s_pool;
+
+class PoolThread : public wxThread
+{
+    PoolState *m_pool;
+
+public:
+    PoolThread(PoolState *pool)
+        : wxThread(wxTHREAD_JOINABLE),
+          m_pool(pool)
+    {
+    }
+
+protected:
+    ExitCode Entry()
+    {
+        m_pool->ThreadLoop();
+        return (ExitCode) 0;
+    }
+};
+
+void PoolState::RunBands(void)
+{
+    while (true)
+    {
+        int b, e;
+        {
+            wxMutexLocker lck(lock);
+            if (next >= end)
+                break;
+            b = next;
+            e = std::min(b + band, end);
+            next = e;
+        }
+        body->Run(b, e);
+    }
+}
+
+void PoolState::ThreadLoop(void)
+{
+    unsigned int seen = 0;
+
+    lock.Lock();
+
+    while (true)
+    {
+        while (!stopping && seen == generation)
+            workReady.Wait();
+
+        if (stopping)
+            break;
+
+        seen = generation;
+
+        lock.Unlock();
+        RunBands();
+        lock.Lock();
+
+        if (--active == 0)
+            workDone.Signal();
+    }
+
+    lock.Unlock();
+}
+
+void ThreadPool::OnAppInit(void)
+{
+    // /ImageThreads is the total number of threads used for image processing,
+    // including the calling thread; 0 means one per CPU
+    int nthreads = pConfig->Global.GetInt("/ImageThreads", 0);
+    if (nthreads <= 0)
+        nthreads = wxThread::GetCPUCount();
+    nthreads = std::max(1, std::min(nthreads, MaxThreads));
+
+    s_pool = new PoolState();
+
+    for (int i = 0; i < nthreads - 1; i++)
+    {
+        PoolThread *thread = new PoolThread(s_pool);
+        if (thread->Create() != wxTHREAD_NO_ERROR || thread->Run() != wxTHREAD_NO_ERROR)
+        {
+            Debug.AddLine("ThreadPool: could not start thread %d", i);
+            delete thread;
+            break;
+        }
+        s_pool->threads.push_back(thread);
+    }
+
+    Debug.AddLine("ThreadPool: %d image processing threads", NumThreads());
+}
+
+void ThreadPool::OnAppExit(void)
+{
+    if (!s_pool)
+        return;
+
+    {
+        wxMutexLocker lck(s_pool->lock);
+        s_pool->stopping = true;
+        s_pool->workReady.Broadcast();
+    }
+
+    for (std::vector<PoolThread *>::iterator it = s_pool->threads.begin(); it != s_pool->threads.end(); ++it)
+    {
+        (*it)->Wait();
+        delete *it;
+    }
+
+    delete s_pool;
+    s_pool = 0;
+}
+
+int ThreadPool::NumThreads(void)
+{
+    return s_pool ? (int) s_pool->threads.size() + 1 : 1;
+}
+
+void parallel_for(int begin, int end, ParallelBody& body, int minBand)
+{
+    int const n = end - begin;
+    if (n <= 0)
+        return;
+
+    // run small jobs inline, and do not wait for the pool if another thread is using it
+    if (!s_pool || s_pool->threads.empty() || n < 2 * minBand || s_pool->callLock.TryLock() != wxMUTEX_NO_ERROR)
+    {
+        body.Run(begin, end);
+        return;
+    }
+
+    PoolState *const pool = s_pool;
+
+    {
+        wxMutexLocker lck(pool->lock);
+
+        int const nthreads = pool->threads.size() + 1;
+        int band = (n + nthreads * BandsPerThread - 1) / (nthreads * BandsPerThread);
+        pool->band = std::max(band, minBand);
+        pool->body = &body;
+        pool->next = begin;
+        pool->end = end;
+        pool->active = pool->threads.size();
+        ++pool->generation;
+        pool->workReady.Broadcast();
+    }
+
+    pool->RunBands();
+
+    {
+        wxMutexLocker lck(pool->lock);
+        while (pool->active > 0)
+            pool->workDone.Wait();
+        pool->body = 0;
+    }
+
+    pool->callLock.Unlock();
+}
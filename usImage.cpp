@@ -35,16 +35,10 @@
 #include "phd.h"
 #include "image_math.h"
 
-bool usImage::Init(const wxSize& size)
+bool usImage::AllocPixels(int npixels)
 {
-    // Allocates space for image and sets params up
-    // returns true on error
-
     int prev = NPixels;
-    NPixels = size.GetWidth() * size.GetHeight();
-    Size = size;
-    Subframe = wxRect(0, 0, 0, 0);
-    Min = Max = 0;
+    NPixels = npixels;
 
     if (NPixels != prev)
     {
@@ -66,11 +60,74 @@ bool usImage::Init(const wxSize& size)
     return false;
 }
 
+bool usImage::Init(const wxSize& size)
+{
+    // Allocates space for image and sets params up
+    // returns true on error
+
+    Size = size;
+    Subframe = wxRect(0, 0, 0, 0);
+    DataRect = wxRect(size);
+    Min = Max = 0;
+
+    return AllocPixels(size.GetWidth() * size.GetHeight());
+}
+
+bool usImage::InitWindow(const wxSize& size, const wxRect& window)
+{
+    // Allocates space for the pixels inside window only. The image keeps its
+    // full dimensions, with the window as its subframe.
+    // returns true on error
+
+    Size = size;
+    Subframe = window;
+    DataRect = window;
+    Min = Max = 0;
+
+    return AllocPixels(window.GetWidth() * window.GetHeight());
+}
+
+bool usImage::InitAs(const usImage& src)
+{
+    // Allocates an image with the same dimensions and storage window as src
+    if (src.IsWindowed())
+        return InitWindow(src.Size, src.DataRect);
+    return Init(src.Size);
+}
+
+bool usImage::ExpandToFullFrame(void)
+{
+    // Converts a windowed image to full sensor storage, leaving the area
+    // outside the window black. The window remains the subframe.
+
+    if (!IsWindowed())
+        return false;
+
+    usImage tmp;
+    if (tmp.Init(Size))
+        return true;
+    tmp.Clear();
+
+    for (int y = DataRect.GetTop(); y <= DataRect.GetBottom(); y++)
+        memcpy(&tmp.Pixel(DataRect.x, y), &Pixel(DataRect.x, y), DataRect.width * sizeof(unsigned short));
+
+    SwapImageData(tmp);
+    return false;
+}
+
 void usImage::SwapImageData(usImage& other)
 {
     unsigned short *t = ImageData;
     ImageData = other.ImageData;
     other.ImageData = t;
+
+    int n = NPixels;
+    NPixels = other.NPixels;
+    other.NPixels = n;
+
+    wxRect r = DataRect;
+    DataRect = other.DataRect;
+    other.DataRect = r;
 }
 
 void usImage::CalcStats()
@@ -121,7 +178,7 @@ void usImage::CalcStats()
         dst = tmpdata;
         for (int y = 0; y < Subframe.height; y++)
         {
-            const unsigned short *src = ImageData + Subframe.x + (Subframe.y + y) * Size.GetWidth();
+            const unsigned short *src = &Pixel(Subframe.x, Subframe.y + y);
             for (int x = 0; x < Subframe.width; x++)
             {
                int d = (int) *src;
@@ -158,43 +215,56 @@ bool usImage::CopyToImage(wxImage **rawimg, int blevel, int wlevel, double power
         img = new wxImage(Size.GetWidth(), Size.GetHeight(), false);
     }
 
-    unsigned char *ImgPtr = img->GetData();
-    unsigned short *RawPtr = ImageData;
+    unsigned char *const ImgData = img->GetData();
+
+    // pixels outside the window of a windowed image are black
+    if (IsWindowed())
+        memset(ImgData, 0, Size.GetWidth() * Size.GetHeight() * 3);
 
     if (power == 1.0 || blevel >= wlevel)
     {
         float range = (float) wxMax(1, wlevel);  // Go 0-max
-        for (int i = 0; i < NPixels; i++, RawPtr++)
+        for (int y = DataRect.GetTop(); y <= DataRect.GetBottom(); y++)
         {
-            float d;
-            if (*RawPtr >= range)
-                d = 255.0;
-            else
-                d = ((float) (*RawPtr) / range) * 255.0;
-
-            *ImgPtr++ = (unsigned char) d;
-            *ImgPtr++ = (unsigned char) d;
-            *ImgPtr++ = (unsigned char) d;
+            const unsigned short *RawPtr = &Pixel(DataRect.x, y);
+            unsigned char *ImgPtr = ImgData + 3 * (y * Size.GetWidth() + DataRect.x);
+            for (int x = 0; x < DataRect.width; x++, RawPtr++)
+            {
+                float d;
+                if (*RawPtr >= range)
+                    d = 255.0;
+                else
+                    d = ((float) (*RawPtr) / range) * 255.0;
+
+                *ImgPtr++ = (unsigned char) d;
+                *ImgPtr++ = (unsigned char) d;
+                *ImgPtr++ = (unsigned char) d;
+            }
         }
     }
     else
     {
         float range = (float) (wlevel - blevel);
-        for (int i = 0; i < NPixels; i++, RawPtr++ )
+        for (int y = DataRect.GetTop(); y <= DataRect.GetBottom(); y++)
         {
-            float d;
-            if (*RawPtr <= blevel)
-                d = 0.0;
-            else if (*RawPtr >= wlevel)
-                d = 255.0;
-            else
+            const unsigned short *RawPtr = &Pixel(DataRect.x, y);
+            unsigned char *ImgPtr = ImgData + 3 * (y * Size.GetWidth() + DataRect.x);
+            for (int x = 0; x < DataRect.width; x++, RawPtr++)
             {
-                d = ((float) (*RawPtr) - (float) blevel) / range;
-                d = pow(d, (float) power) * 255.0;
+                float d;
+                if (*RawPtr <= blevel)
+                    d = 0.0;
+                else if (*RawPtr >= wlevel)
+                    d = 255.0;
+                else
+                {
+                    d = ((float) (*RawPtr) - (float) blevel) / range;
+                    d = pow(d, (float) power) * 255.0;
+                }
+                *ImgPtr++ = (unsigned char) d;
+                *ImgPtr++ = (unsigned char) d;
+                *ImgPtr++ = (unsigned char) d;
             }
-            *ImgPtr++ = (unsigned char) d;
-            *ImgPtr++ = (unsigned char) d;
-            *ImgPtr++ = (unsigned char) d;
         }
     }
 
@@ -229,18 +299,29 @@ bool usImage::BinnedCopyToImage(wxImage **rawimg, int blevel, int wlevel, double
         }
         img = new wxImage(full_xsize/2, full_ysize/2, false);
     }
-    ImgPtr = img->GetData();
-    RawPtr = ImageData;
+    unsigned char *const ImgData = img->GetData();
+    int const stride = DataRect.width;
+    int x0 = 0, y0 = 0;
+    if (IsWindowed())
+    {
+        // only the 2x2 blocks entirely inside the window have data
+        memset(ImgData, 0, (full_xsize/2) * (full_ysize/2) * 3);
+        x0 = (DataRect.GetLeft() + 1) & ~1;
+        y0 = (DataRect.GetTop() + 1) & ~1;
+        use_xsize = wxMin(use_xsize, (DataRect.GetRight() + 1) & ~1);
+        use_ysize = wxMin(use_ysize, (DataRect.GetBottom() + 1) & ~1);
+    }
 //  s_factor = (((float) Max - (float) Min) / 255.0);
     float range = (float) (wlevel - blevel);
 
     if ((power == 1.0) || (range == 0.0)) {
         range = wlevel;  // Go 0-max
         if (range == 0.0) range = 0.001;
-        for (y=0; y<use_ysize; y+=2) {
-            for (x=0; x<use_xsize; x+=2) {
-                RawPtr = ImageData + x + y*full_xsize;
-                d = (float) (*RawPtr + *(RawPtr+1) + *(RawPtr+full_xsize) + *(RawPtr+1+full_xsize)) / 4.0;
+        for (y=y0; y<use_ysize; y+=2) {
+            ImgPtr = ImgData + 3 * ((y/2) * (full_xsize/2) + x0/2);
+            for (x=x0; x<use_xsize; x+=2) {
+                RawPtr = &Pixel(x, y);
+                d = (float) (*RawPtr + *(RawPtr+1) + *(RawPtr+stride) + *(RawPtr+1+stride)) / 4.0;
                 d = (d / range) * 255.0;
                 if (d < 0.0) d = 0.0;
                 else if (d > 255.0) d = 255.0;
@@ -254,10 +335,11 @@ bool usImage::BinnedCopyToImage(wxImage **rawimg, int blevel, int wlevel, double
         }
     }
     else {
-        for (y=0; y<use_ysize; y+=2) {
-            for (x=0; x<use_xsize; x+=2) {
-                RawPtr = ImageData + x + y*full_xsize;
-                d = (float) (*RawPtr + *(RawPtr+1) + *(RawPtr+full_xsize) + *(RawPtr+1+full_xsize)) / 4.0;
+        for (y=y0; y<use_ysize; y+=2) {
+            ImgPtr = ImgData + 3 * ((y/2) * (full_xsize/2) + x0/2);
+            for (x=x0; x<use_xsize; x+=2) {
+                RawPtr = &Pixel(x, y);
+                d = (float) (*RawPtr + *(RawPtr+1) + *(RawPtr+stride) + *(RawPtr+1+stride)) / 4.0;
                 d = (d - (float) blevel) / range ;
                 if (d < 0.0) d= 0.0;
                 else if (d > 1.0) d = 1.0;
@@ -277,7 +359,8 @@ bool usImage::BinnedCopyToImage(wxImage **rawimg, int blevel, int wlevel, double
 
 void usImage::InitImgStartTime()
 {
-    ImgStartTime = time(0);
+    ImgStartTimeMs = ::wxGetUTCTimeMillis().GetValue();
+    ImgStartTime = (time_t) (ImgStartTimeMs / 1000);
 }
 
 wxString usImage::GetImgStartTime() const
@@ -292,6 +375,19 @@ wxString usImage::GetImgStartTime() const
 
 bool usImage::Save(const wxString& fname, const wxString& hdrNote) const
 {
+    if (IsWindowed())
+    {
+        // FITS files always get the full frame
+        usImage full;
+        if (full.CopyFrom(*this) || full.ExpandToFullFrame())
+            return true;
+        full.ImgStartTime = ImgStartTime;
+        full.ImgStartTimeMs = ImgStartTimeMs;
+        full.ImgExpDur = ImgExpDur;
+        full.ImgStackCnt = ImgStackCnt;
+        return full.Save(fname, hdrNote);
+    }
+
     bool bError = false;
 
     try
@@ -421,7 +517,7 @@ bool usImage::Load(const wxString& fname)
 
 bool usImage::CopyFrom(const usImage& src)
 {
-    if (Init(src.Size))
+    if (InitAs(src))
         return true;
     memcpy(ImageData, src.ImageData, NPixels * sizeof(unsigned short));
     return false;
@@ -41,11 +41,13 @@ public:
     unsigned short      *ImageData;     // Pointer to raw data
     wxSize              Size;               // Dimensions of image
     wxRect              Subframe;       // were the valid data is
-    int                 NPixels;
+    wxRect              DataRect;       // part of the image held in ImageData, all of it unless windowed
+    int                 NPixels;        // number of pixels in ImageData
     int                 Min;
     int                 Max;
     int                 FiltMin, FiltMax;
     time_t              ImgStartTime;
+    wxLongLong_t        ImgStartTimeMs; // UTC milliseconds, for timing the guide loop
     int                 ImgExpDur;
     int                 ImgStackCnt;
 
@@ -54,6 +56,7 @@ public:
         NPixels = 0;
         ImageData = NULL;
         ImgStartTime = 0;
+        ImgStartTimeMs = 0;
         ImgExpDur = 0;
         ImgStackCnt = 1;
     }
@@ -61,6 +64,11 @@ public:
 
     bool                Init(const wxSize& size);
     bool                Init(int width, int height) { return Init(wxSize(width, height)); }
+    bool                InitWindow(const wxSize& size, const wxRect& window);
+    bool                InitAs(const usImage& src);
+    bool                IsWindowed(void) const { return DataRect.GetSize() != Size; }
+    bool                HasPixel(int x, int y) const { return DataRect.Contains(x, y); }
+    bool                ExpandToFullFrame(void);
     void                SwapImageData(usImage& other);
     void                CalcStats();
     void                InitImgStartTime();
@@ -72,9 +80,12 @@ public:
     bool                Load(const wxString& fname);
     bool                Save(const wxString& fname, const wxString& hdrComment = wxEmptyString) const;
     bool                Rotate(double theta, bool mirror=false);
-    unsigned short&     Pixel(int x, int y) { return ImageData[y * Size.x + x]; }
-    const unsigned short& Pixel(int x, int y) const { return ImageData[y * Size.x + x]; }
+    unsigned short&     Pixel(int x, int y) { return ImageData[(y - DataRect.y) * DataRect.width + x - DataRect.x]; }
+    const unsigned short& Pixel(int x, int y) const { return ImageData[(y - DataRect.y) * DataRect.width + x - DataRect.x]; }
     void                Clear(void);
+
+private:
+    bool                AllocPixels(int npixels);
 };
 
 inline void usImage::Clear(void)